@@ -5,10 +5,11 @@
 
 //
 // Deal with the differences between Microsoft and GNU implemenations
-// of hash_map. Allows all platforms to use |base::hash_map| and
-// |base::hash_set|.
+// of hash_map. Allows all platforms to use |base::hash_map|,
+// |base::hash_multimap| and |base::hash_set|.
 //  eg:
 //   base::hash_map<int> my_map;
+//   base::hash_multimap<int> my_multimap;
 //   base::hash_set<int> my_set;
 //
 // NOTE: It is an explicit non-goal of this class to provide a generic hash
@@ -31,6 +32,7 @@
 #include <hash_set>
 namespace base {
 using stdext::hash_map;
+using stdext::hash_multimap;
 using stdext::hash_set;
 }
 #elif defined(COMPILER_GCC)
@@ -53,6 +55,7 @@ using stdext::hash_set;
 
 namespace base {
 using __gnu_cxx::hash_map;
+using __gnu_cxx::hash_multimap;
 using __gnu_cxx::hash_set;
 }  // namespace base
 
@@ -9,6 +9,7 @@
 #include "base/basictypes.h"
 #include "base/command_line.h"
 #include "base/i18n/number_formatting.h"
+#include "base/message_loop.h"
 #include "base/metrics/histogram.h"
 #include "base/string_number_conversions.h"
 #include "base/string_util.h"
@@ -774,6 +775,10 @@ void AutocompleteResult::MergeMatchesByProvider(const ACMatches& old_matches,
 
 const int AutocompleteController::kNoItemSelected = -1;
 
+// A little over one frame, so that the first matches show up with the
+// keystroke that produced them while slow providers do not hold up the next.
+const int AutocompleteController::kSynchronousPassBudgetMS = 20;
+
 // Amount of time (in ms) between when the user stops typing and when we remove
 // any copied entries. We do this from the time the user stopped typing as some
 // providers (such as SearchProvider) wait for the user to stop typing before
@@ -784,8 +789,12 @@ AutocompleteController::AutocompleteController(
     Profile* profile,
     AutocompleteControllerDelegate* delegate)
     : delegate_(delegate),
+      minimal_changes_(false),
+      synchronous_pass_budget_(
+          TimeDelta::FromMilliseconds(kSynchronousPassBudgetMS)),
       done_(true),
-      in_start_(false) {
+      in_start_(false),
+      ALLOW_THIS_IN_INITIALIZER_LIST(method_factory_(this)) {
   search_provider_ = new SearchProvider(this, profile);
   providers_.push_back(search_provider_);
   if (CommandLine::ForCurrentProcess()->HasSwitch(
@@ -802,6 +811,7 @@ AutocompleteController::AutocompleteController(
   providers_.push_back(new ExtensionAppProvider(this, profile));
   for (ACProviders::iterator i(providers_.begin()); i != providers_.end(); ++i)
     (*i)->AddRef();
+  next_provider_ = providers_.size();
 }
 
 AutocompleteController::~AutocompleteController() {
@@ -855,15 +865,17 @@ void AutocompleteController::Start(
 
   expire_timer_.Stop();
 
+  // Passes still pending from the last query are stale now. The providers
+  // they were for never saw the last input, so they cannot take a shortcut
+  // based on it.
+  method_factory_.RevokeAll();
+  minimal_changes_ = minimal_changes && (next_provider_ == providers_.size());
+  next_provider_ = 0;
+
   // Start the new query.
   in_start_ = true;
   base::TimeTicks start_time = base::TimeTicks::Now();
-  for (ACProviders::iterator i(providers_.begin()); i != providers_.end();
-       ++i) {
-    (*i)->Start(input_, minimal_changes);
-    if (matches_requested != AutocompleteInput::ALL_MATCHES)
-      DCHECK((*i)->done());
-  }
+  RunSynchronousPasses();
   if (matches_requested == AutocompleteInput::ALL_MATCHES && text.size() < 6) {
     base::TimeTicks end_time = base::TimeTicks::Now();
     std::string name = "Omnibox.QueryTime." + base::IntToString(text.size());
@@ -886,6 +898,7 @@ void AutocompleteController::Stop(bool clear_result) {
   }
 
   expire_timer_.Stop();
+  method_factory_.RevokeAll();
   done_ = true;
   if (clear_result && !result_.empty()) {
     result_.Reset();
@@ -927,9 +940,8 @@ void AutocompleteController::UpdateResult(bool is_synchronous_pass) {
   AutocompleteResult last_result;
   last_result.Swap(&result_);
 
-  for (ACProviders::const_iterator i(providers_.begin()); i != providers_.end();
-       ++i)
-    result_.AppendMatches((*i)->matches());
+  for (size_t i = 0; i < next_provider_; ++i)
+    result_.AppendMatches(providers_[i]->matches());
 
   // Sort the matches and trim to a small number of "best" matches.
   result_.SortAndCull(input_);
@@ -977,6 +989,10 @@ void AutocompleteController::NotifyChanged(bool notify_default_match) {
 }
 
 void AutocompleteController::CheckIfDone() {
+  if (next_provider_ < providers_.size()) {
+    done_ = false;
+    return;
+  }
   for (ACProviders::const_iterator i(providers_.begin()); i != providers_.end();
        ++i) {
     if (!(*i)->done()) {
@@ -987,6 +1003,43 @@ void AutocompleteController::CheckIfDone() {
   done_ = true;
 }
 
+void AutocompleteController::RunSynchronousPasses() {
+  const bool all_matches =
+      input_.matches_requested() == AutocompleteInput::ALL_MATCHES;
+  const base::TimeTicks deadline =
+      base::TimeTicks::Now() + synchronous_pass_budget_;
+  while (next_provider_ < providers_.size()) {
+    AutocompleteProvider* provider = providers_[next_provider_++];
+    base::TimeTicks start_time = base::TimeTicks::Now();
+    provider->Start(input_, minimal_changes_);
+    if (!all_matches) {
+      DCHECK(provider->done());
+      continue;
+    }
+
+    base::TimeTicks end_time = base::TimeTicks::Now();
+    base::Histogram* counter = base::Histogram::FactoryGet(
+        std::string("Omnibox.ProviderTime.") + provider->name(), 1, 1000, 50,
+        base::Histogram::kUmaTargetedHistogramFlag);
+    counter->Add(static_cast<int>((end_time - start_time).InMilliseconds()));
+
+    if (end_time >= deadline && next_provider_ < providers_.size()) {
+      MessageLoop::current()->PostTask(FROM_HERE,
+          method_factory_.NewRunnableMethod(
+              &AutocompleteController::ContinueSynchronousPasses));
+      return;
+    }
+  }
+}
+
+void AutocompleteController::ContinueSynchronousPasses() {
+  in_start_ = true;
+  RunSynchronousPasses();
+  in_start_ = false;
+  CheckIfDone();
+  UpdateResult(false);
+}
+
 void AutocompleteController::StartExpireTimer() {
   if (result_.HasCopiedMatches())
     expire_timer_.Start(base::TimeDelta::FromMilliseconds(kExpireTimeMS),
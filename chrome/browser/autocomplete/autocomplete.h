@@ -10,9 +10,12 @@
 #include <string>
 #include <vector>
 
+#include "base/compiler_specific.h"
 #include "base/logging.h"
 #include "base/memory/ref_counted.h"
 #include "base/string16.h"
+#include "base/task.h"
+#include "base/time.h"
 #include "base/timer.h"
 #include "googleurl/src/gurl.h"
 #include "googleurl/src/url_parse.h"
@@ -596,6 +599,10 @@ class AutocompleteController : public ACProviderListener {
   // Used to indicate an index that is not selected in a call to Update().
   static const int kNoItemSelected;
 
+  // Time (in ms) the synchronous passes of an ALL_MATCHES query may take
+  // before the remaining ones are deferred to a later task.
+  static const int kSynchronousPassBudgetMS;
+
   // Normally, you will call the first constructor.  Unit tests can use the
   // second to set the providers to some known testing providers.  The default
   // providers will be overridden and the controller will take ownership of the
@@ -606,9 +613,18 @@ class AutocompleteController : public ACProviderListener {
   explicit AutocompleteController(const ACProviders& providers)
       : delegate_(NULL),
         providers_(providers),
+        next_provider_(providers.size()),
         search_provider_(NULL),
+        minimal_changes_(false),
+        synchronous_pass_budget_(
+            base::TimeDelta::FromMilliseconds(kSynchronousPassBudgetMS)),
         done_(true),
-        in_start_(false) {
+        in_start_(false),
+        ALLOW_THIS_IN_INITIALIZER_LIST(method_factory_(this)) {
+  }
+
+  void set_synchronous_pass_budget(base::TimeDelta budget) {
+    synchronous_pass_budget_ = budget;
   }
 #endif
   ~AutocompleteController();
@@ -621,6 +637,12 @@ class AutocompleteController : public ACProviderListener {
   // done or the query is Stop()ed.  It is safe to Start() a new query without
   // Stop()ing the previous one.
   //
+  // For ALL_MATCHES queries the synchronous passes of the providers are run in
+  // order until they have taken kSynchronousPassBudgetMS; the remaining passes
+  // are run from a task on the current message loop so that input is not
+  // blocked, and their matches are merged into the result as they complete.
+  // Starting a new query cancels any passes still pending from the last one.
+  //
   // See AutocompleteInput::desired_tld() for meaning of |desired_tld|.
   //
   // |prevent_inline_autocomplete| is true if the generated result set should
@@ -693,6 +715,14 @@ class AutocompleteController : public ACProviderListener {
   // Updates |done_| to be accurate with respect to current providers' statuses.
   void CheckIfDone();
 
+  // Runs the synchronous pass of the providers from |next_provider_| on. For
+  // ALL_MATCHES queries this stops once |synchronous_pass_budget_| is used up
+  // and posts ContinueSynchronousPasses() to run the rest.
+  void RunSynchronousPasses();
+
+  // Runs the deferred synchronous passes and merges their matches.
+  void ContinueSynchronousPasses();
+
   // Starts the expire timer.
   void StartExpireTimer();
 
@@ -701,11 +731,22 @@ class AutocompleteController : public ACProviderListener {
   // A list of all providers.
   ACProviders providers_;
 
+  // Index of the first provider whose synchronous pass has not yet run for
+  // |input_|. Providers from here on have matches from an earlier query,
+  // which are left out of |result_|.
+  size_t next_provider_;
+
   SearchProvider* search_provider_;
 
   // Input passed to Start.
   AutocompleteInput input_;
 
+  // The |minimal_changes| value passed to the providers for |input_|.
+  bool minimal_changes_;
+
+  // See kSynchronousPassBudgetMS.
+  base::TimeDelta synchronous_pass_budget_;
+
   // Data from the autocomplete query.
   AutocompleteResult result_;
 
@@ -720,6 +761,9 @@ class AutocompleteController : public ACProviderListener {
   // notifications until Start() has been invoked on all providers.
   bool in_start_;
 
+  // Used to post, and to cancel, the deferred synchronous passes.
+  ScopedRunnableMethodFactory<AutocompleteController> method_factory_;
+
   DISALLOW_COPY_AND_ASSIGN(AutocompleteController);
 };
 
@@ -37,7 +37,8 @@ class TestProvider : public AutocompleteProvider {
   TestProvider(int relevance, const string16& prefix)
       : AutocompleteProvider(NULL, NULL, ""),
         relevance_(relevance),
-        prefix_(prefix) {
+        prefix_(prefix),
+        start_count_(0) {
   }
 
   virtual void Start(const AutocompleteInput& input,
@@ -47,6 +48,8 @@ class TestProvider : public AutocompleteProvider {
     listener_ = listener;
   }
 
+  int start_count() const { return start_count_; }
+
  private:
   ~TestProvider() {}
 
@@ -56,10 +59,12 @@ class TestProvider : public AutocompleteProvider {
 
   int relevance_;
   const string16 prefix_;
+  int start_count_;
 };
 
 void TestProvider::Start(const AutocompleteInput& input,
                          bool minimal_changes) {
+  ++start_count_;
   if (minimal_changes)
     return;
 
@@ -114,6 +119,12 @@ class AutocompleteProviderTest : public testing::Test,
   void ResetControllerWithTestProvidersWithKeywordAndSearchProviders();
   void RunExactKeymatchTest(bool allow_exact_keyword_match);
 
+  AutocompleteController* controller() { return controller_.get(); }
+
+  TestProvider* test_provider(size_t index) {
+    return static_cast<TestProvider*>(providers_[index]);
+  }
+
   // These providers are owned by the controller once it's created.
   ACProviders providers_;
 
@@ -261,6 +272,47 @@ TEST_F(AutocompleteProviderTest, RemoveDuplicates) {
     EXPECT_EQ(providers_[1], i->provider);
 }
 
+// Tests that passes over the budget are deferred, and that their matches are
+// merged once they run.
+TEST_F(AutocompleteProviderTest, DeferredSynchronousPasses) {
+  ResetControllerWithTestProviders(false);
+  controller()->set_synchronous_pass_budget(base::TimeDelta());
+  controller()->Start(ASCIIToUTF16("a"), string16(), true, false, true,
+                      AutocompleteInput::ALL_MATCHES);
+
+  // Only the first provider has run, and the result only has its match.
+  EXPECT_FALSE(controller()->done());
+  EXPECT_EQ(1, test_provider(0)->start_count());
+  EXPECT_EQ(0, test_provider(1)->start_count());
+  ASSERT_EQ(1U, controller()->result().size());
+  EXPECT_EQ(providers_[0], controller()->result().begin()->provider);
+
+  MessageLoop::current()->Run();
+
+  EXPECT_EQ(1, test_provider(1)->start_count());
+  EXPECT_EQ(num_results_per_provider * 2, result_.size());
+  ASSERT_NE(result_.end(), result_.default_match());
+  EXPECT_EQ(providers_[1], result_.default_match()->provider);
+}
+
+// Tests that starting a new query cancels the passes still pending from the
+// last one.
+TEST_F(AutocompleteProviderTest, CancelDeferredSynchronousPasses) {
+  ResetControllerWithTestProviders(false);
+  controller()->set_synchronous_pass_budget(base::TimeDelta());
+  controller()->Start(ASCIIToUTF16("a"), string16(), true, false, true,
+                      AutocompleteInput::ALL_MATCHES);
+  controller()->Start(ASCIIToUTF16("ab"), string16(), true, false, true,
+                      AutocompleteInput::ALL_MATCHES);
+  EXPECT_EQ(2, test_provider(0)->start_count());
+  EXPECT_EQ(0, test_provider(1)->start_count());
+
+  MessageLoop::current()->Run();
+
+  EXPECT_TRUE(controller()->done());
+  EXPECT_EQ(1, test_provider(1)->start_count());
+}
+
 TEST_F(AutocompleteProviderTest, AllowExactKeywordMatch) {
   ResetControllerWithTestProvidersWithKeywordAndSearchProviders();
   RunExactKeymatchTest(true);
@@ -1124,6 +1124,15 @@ void AboutMemoryHandler::AppendProcess(ListValue* child_data,
   child->Set("titles", titles);
   for (size_t i = 0; i < info->titles.size(); ++i)
     titles->Append(new StringValue(info->titles[i]));
+  ListValue* tile_memory = new ListValue();
+  child->Set("tile_memory", tile_memory);
+  for (size_t i = 0; i < info->tile_memory.size(); ++i) {
+    DictionaryValue* tab = new DictionaryValue();
+    tab->SetString("title", info->tile_memory[i].first);
+    tab->SetInteger("tile_kb",
+                    static_cast<int>(info->tile_memory[i].second / 1024));
+    tile_memory->Append(tab);
+  }
 }
 
 
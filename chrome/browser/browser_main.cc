@@ -307,6 +307,16 @@ void BrowserMainParts::ConnectionFieldTrial() {
   } else {
     NOTREACHED();
   }
+
+  if (parsed_command_line().HasSwitch(switches::kEnableAdaptiveSocketPools)) {
+    // Let hosts that are slow to connect to use up to twice as many sockets,
+    // and keep a socket open for a minute for the hosts that are preconnected.
+    net::internal::ClientSocketPoolBaseHelper::set_adaptive_group_limits(
+        2 * net::ClientSocketPoolManager::max_sockets_per_group(),
+        base::TimeDelta::FromMilliseconds(100));
+    net::internal::ClientSocketPoolBaseHelper::set_warm_idle_socket_timeout(
+        base::TimeDelta::FromMinutes(1));
+  }
 }
 
 // A/B test for determining a value for unused socket timeout. Currently the
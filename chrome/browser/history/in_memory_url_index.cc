@@ -5,6 +5,7 @@
 #include "chrome/browser/history/in_memory_url_index.h"
 
 #include <algorithm>
+#include <functional>
 #include <iterator>
 #include <limits>
 #include <numeric>
@@ -23,30 +24,10 @@
 #include "googleurl/src/url_util.h"
 #include "net/base/escape.h"
 #include "net/base/net_util.h"
-#include "third_party/protobuf/src/google/protobuf/repeated_field.h"
 #include "ui/base/l10n/l10n_util.h"
 
-using google::protobuf::RepeatedField;
-using google::protobuf::RepeatedPtrField;
-using in_memory_url_index::InMemoryURLIndexCacheItem;
-
 namespace history {
 
-typedef imui::InMemoryURLIndexCacheItem_WordListItem WordListItem;
-typedef imui::InMemoryURLIndexCacheItem_WordMapItem_WordMapEntry WordMapEntry;
-typedef imui::InMemoryURLIndexCacheItem_WordMapItem WordMapItem;
-typedef imui::InMemoryURLIndexCacheItem_CharWordMapItem CharWordMapItem;
-typedef imui::InMemoryURLIndexCacheItem_CharWordMapItem_CharWordMapEntry
-    CharWordMapEntry;
-typedef imui::InMemoryURLIndexCacheItem_WordIDHistoryMapItem
-    WordIDHistoryMapItem;
-typedef imui::
-    InMemoryURLIndexCacheItem_WordIDHistoryMapItem_WordIDHistoryMapEntry
-    WordIDHistoryMapEntry;
-typedef imui::InMemoryURLIndexCacheItem_HistoryInfoMapItem HistoryInfoMapItem;
-typedef imui::InMemoryURLIndexCacheItem_HistoryInfoMapItem_HistoryInfoMapEntry
-    HistoryInfoMapEntry;
-
 const size_t InMemoryURLIndex::kNoCachedResultForTerm = -1;
 
 // Score ranges used to get a 'base' score for each of the scoring factors
@@ -92,6 +73,101 @@ struct InMemoryURLIndex::TermCharWordSet {
   bool used_;  // true if this set has been used for the current term search.
 };
 
+namespace {
+
+// A posting list at least this many times longer than the one it is
+// intersected with is searched rather than merged.
+const size_t kGallopRatio = 16;
+
+// Inserts |id| into the sorted posting list |ids| unless it is already there.
+// Appending an ID larger than all others, which is what happens for nearly
+// every ID while the index is built, does not search the list.
+template <typename T>
+void InsertSortedID(T id, std::vector<T>* ids) {
+  if (ids->empty() || ids->back() < id) {
+    ids->push_back(id);
+    return;
+  }
+  typename std::vector<T>::iterator pos =
+      std::lower_bound(ids->begin(), ids->end(), id);
+  if (*pos != id)
+    ids->insert(pos, id);
+}
+
+// Sets |result| to the IDs found in both of the sorted posting lists |a| and
+// |b|. Lists of similar length are merged in a single pass which advances
+// each side by the outcome of the comparisons rather than by branching on
+// them. When one list is much shorter each of its IDs is instead found in
+// the longer one with an exponential search from the previous hit, so that
+// a rare word does not pay for walking the posting list of a common one.
+template <typename T>
+void IntersectSortedIDs(const std::vector<T>& a,
+                        const std::vector<T>& b,
+                        std::vector<T>* result) {
+  result->clear();
+  const std::vector<T>& shorter(a.size() <= b.size() ? a : b);
+  const std::vector<T>& longer(a.size() <= b.size() ? b : a);
+  if (shorter.empty())
+    return;
+  result->reserve(shorter.size());
+
+  if (shorter.size() * kGallopRatio < longer.size()) {
+    typename std::vector<T>::const_iterator low = longer.begin();
+    const typename std::vector<T>::const_iterator end = longer.end();
+    for (typename std::vector<T>::const_iterator iter = shorter.begin();
+         iter != shorter.end() && low != end; ++iter) {
+      // Double the step until it passes |*iter|, then search the last step.
+      size_t step = 1;
+      typename std::vector<T>::const_iterator high = low;
+      while (high != end && *high < *iter) {
+        low = high;
+        high = static_cast<size_t>(end - high) > step ? high + step : end;
+        step *= 2;
+      }
+      low = std::lower_bound(low, high, *iter);
+      if (low != end && *low == *iter)
+        result->push_back(*iter);
+    }
+    return;
+  }
+
+  const T* left = &shorter[0];
+  const T* const left_end = left + shorter.size();
+  const T* right = &longer[0];
+  const T* const right_end = right + longer.size();
+  while (left != left_end && right != right_end) {
+    const T left_id = *left;
+    const T right_id = *right;
+    if (left_id == right_id)
+      result->push_back(left_id);
+    left += left_id <= right_id;
+    right += right_id <= left_id;
+  }
+}
+
+// Orders posting lists by length, for intersecting the shortest ones first.
+template <typename T>
+bool ShorterPostingList(const std::vector<T>* a, const std::vector<T>* b) {
+  return a->size() < b->size();
+}
+
+// Returns true if |ids| is sorted and holds no duplicates, as a posting list
+// is.
+template <typename T>
+bool IsPostingList(const std::vector<T>& ids) {
+  return std::adjacent_find(ids.begin(), ids.end(),
+                            std::greater_equal<T>()) == ids.end();
+}
+
+// Drops the spare capacity of |ids|.
+template <typename T>
+void ShrinkPostingList(std::vector<T>* ids) {
+  if (ids->capacity() > ids->size())
+    std::vector<T>(*ids).swap(*ids);
+}
+
+}  // namespace
+
 // Comparison function for sorting TermMatches by their offsets.
 bool MatchOffsetLess(const TermMatch& m1, const TermMatch& m2) {
   return m1.offset < m2.offset;
@@ -212,6 +288,7 @@ bool InMemoryURLIndex::ReloadFromHistory(history::URLDatabase* history_db,
       if (!IndexRow(row))
         return false;
     }
+    CompactPostingLists();
     UMA_HISTOGRAM_TIMES("History.InMemoryURLIndexingTime",
                         base::TimeTicks::Now() - beginning_time);
     SaveToCacheFile();
@@ -221,6 +298,9 @@ bool InMemoryURLIndex::ReloadFromHistory(history::URLDatabase* history_db,
 
 void InMemoryURLIndex::ClearPrivateData() {
   history_item_count_ = 0;
+  image_.reset();
+  image_word_history_map_.clear();
+  removed_image_rows_.clear();
   word_list_.clear();
   word_map_.clear();
   char_word_map_.clear();
@@ -238,58 +318,36 @@ bool InMemoryURLIndex::RestoreFromCacheFile() {
   FilePath file_path;
   if (!GetCacheFilePath(&file_path) || !file_util::PathExists(file_path))
     return false;
-  std::string data;
-  if (!file_util::ReadFileToString(file_path, &data)) {
-    LOG(WARNING) << "Failed to read InMemoryURLIndex cache from "
-                 << file_path.value();
+  InMemoryURLIndexImage* image = InMemoryURLIndexImage::Open(file_path);
+  if (!image)
     return false;
-  }
 
-  InMemoryURLIndexCacheItem index_cache;
-  if (!index_cache.ParseFromArray(data.c_str(), data.size())) {
-    LOG(WARNING) << "Failed to parse InMemoryURLIndex cache data read from "
-                 << file_path.value();
-    return false;
-  }
-
-  if (!RestorePrivateData(index_cache)) {
-    ClearPrivateData();  // Back to square one -- must build from scratch.
-    return false;
-  }
+  // The image is searched in place; nothing else needs to be built.
+  image_.reset(image);
+  last_saved_ = image_->timestamp();
+  history_item_count_ = image_->history_item_count();
 
   UMA_HISTOGRAM_TIMES("History.InMemoryURLIndexRestoreCacheTime",
                       base::TimeTicks::Now() - beginning_time);
   UMA_HISTOGRAM_COUNTS("History.InMemoryURLHistoryItems", history_item_count_);
-  UMA_HISTOGRAM_COUNTS("History.InMemoryURLCacheSize", data.size());
-  UMA_HISTOGRAM_COUNTS_10000("History.InMemoryURLWords", word_map_.size());
-  UMA_HISTOGRAM_COUNTS_10000("History.InMemoryURLChars", char_word_map_.size());
+  UMA_HISTOGRAM_COUNTS("History.InMemoryURLCacheSize", image_->file_size());
+  UMA_HISTOGRAM_COUNTS_10000("History.InMemoryURLWords",
+                             image_->word_count());
   return true;
 }
 
 bool InMemoryURLIndex::SaveToCacheFile() {
   base::TimeTicks beginning_time = base::TimeTicks::Now();
-  InMemoryURLIndexCacheItem index_cache;
-  SavePrivateData(&index_cache);
-  std::string data;
-  if (!index_cache.SerializeToString(&data)) {
-    LOG(WARNING) << "Failed to serialize the InMemoryURLIndex cache.";
-    return false;
-  }
-
-  // Write the cache to a file then swap it for the old cache, if any, and
-  // delete the old cache.
   FilePath file_path;
   if (!GetCacheFilePath(&file_path))
     return false;
-  file_util::ScopedFILE file(file_util::OpenFile(file_path, "w"));
-  if (!file.get())
-    return false;
-
-  int size = data.size();
-  if (file_util::WriteFile(file_path, data.c_str(), size) != size) {
+  InMemoryURLIndexImage::Contents contents;
+  GetImageContents(&contents);
+  if (!InMemoryURLIndexImage::Write(file_path, contents)) {
     LOG(WARNING) << "Failed to write " << file_path.value();
     return false;
   }
+  last_saved_ = contents.timestamp;
   UMA_HISTOGRAM_TIMES("History.InMemoryURLIndexSaveCacheTime",
                       base::TimeTicks::Now() - beginning_time);
   return true;
@@ -301,7 +359,21 @@ void InMemoryURLIndex::UpdateURL(URLID row_id, const URLRow& row) {
   // indexed and still qualifies then it gets updated, otherwise it
   // is deleted from the index.
   HistoryInfoMap::iterator row_pos = history_info_map_.find(row_id);
-  if (row_pos == history_info_map_.end()) {
+  URLRow image_row;
+  if (row_pos == history_info_map_.end() && GetImageRow(row_id, &image_row)) {
+    // The row is indexed by the image. Its words are already there, so only
+    // the details need to shadow the image row or, if it no longer
+    // qualifies, it gets hidden.
+    if (RowQualifiesAsSignificant(row, base::Time())) {
+      image_row.set_visit_count(row.visit_count());
+      image_row.set_typed_count(row.typed_count());
+      image_row.set_last_visit(row.last_visit());
+      image_row.set_title(row.title());
+      history_info_map_[row_id] = image_row;
+    } else {
+      InsertSortedID(row_id, &removed_image_rows_);
+    }
+  } else if (row_pos == history_info_map_.end()) {
     // This new row should be indexed if it qualifies.
     if (RowQualifiesAsSignificant(row, base::Time()))
       IndexRow(row);
@@ -319,6 +391,8 @@ void InMemoryURLIndex::UpdateURL(URLID row_id, const URLRow& row) {
   } else {
     // This indexed row no longer qualifies and will be de-indexed.
     history_info_map_.erase(row_id);
+    if (image_.get() && image_->HasRow(row_id))
+      InsertSortedID(row_id, &removed_image_rows_);
   }
   // This invalidates the cache.
   term_char_word_set_cache_.clear();
@@ -332,6 +406,8 @@ void InMemoryURLIndex::DeleteURL(URLID row_id) {
   // history_info_map_ no longer references the row no erroneous results
   // will propagate to the user.
   history_info_map_.erase(row_id);
+  if (image_.get() && image_->HasRow(row_id))
+    InsertSortedID(row_id, &removed_image_rows_);
   // This invalidates the word cache.
   term_char_word_set_cache_.clear();
   // TODO(mrossetti): Record this transaction in the cache.
@@ -409,25 +485,33 @@ InMemoryURLIndex::HistoryIDSet InMemoryURLIndex::HistoryIDSetFromWords(
   // is four words: 'http', 'www', 'somewebsite', and 'com'.
   HistoryIDSet history_id_set;
   String16Set words = WordSetFromString16(uni_string);
-  bool first_word = true;
+  if (words.empty())
+    return history_id_set;
+  std::vector<HistoryIDSet> term_history_id_sets;
+  term_history_id_sets.reserve(words.size());
   for (String16Set::iterator iter = words.begin();
        iter != words.end(); ++iter) {
-    String16Set::value_type uni_word = *iter;
-    HistoryIDSet term_history_id_set =
-        InMemoryURLIndex::HistoryIDsForTerm(uni_word);
-    if (first_word) {
-      history_id_set.swap(term_history_id_set);
-      first_word = false;
-    } else {
-      HistoryIDSet old_history_id_set(history_id_set);
-      history_id_set.clear();
-      std::set_intersection(old_history_id_set.begin(),
-                            old_history_id_set.end(),
-                            term_history_id_set.begin(),
-                            term_history_id_set.end(),
-                            std::inserter(history_id_set,
-                                          history_id_set.begin()));
-    }
+    term_history_id_sets.push_back(HistoryIDSet());
+    HistoryIDsForTerm(*iter).swap(term_history_id_sets.back());
+    if (term_history_id_sets.back().empty())
+      return history_id_set;
+  }
+
+  // Intersect starting with the shortest sets so that the intermediate
+  // result is small from the start.
+  std::vector<const HistoryIDSet*> ordered_sets;
+  for (std::vector<HistoryIDSet>::const_iterator iter =
+       term_history_id_sets.begin(); iter != term_history_id_sets.end();
+       ++iter)
+    ordered_sets.push_back(&(*iter));
+  std::sort(ordered_sets.begin(), ordered_sets.end(),
+            ShorterPostingList<HistoryID>);
+  history_id_set = *ordered_sets[0];
+  HistoryIDSet intersection;
+  for (size_t i = 1; i < ordered_sets.size() && !history_id_set.empty();
+       ++i) {
+    IntersectSortedIDs(history_id_set, *ordered_sets[i], &intersection);
+    history_id_set.swap(intersection);
   }
   return history_id_set;
 }
@@ -450,18 +534,15 @@ InMemoryURLIndex::HistoryIDSet InMemoryURLIndex::HistoryIDsForTerm(
   // in the process in any case.
 
   // If any words resulted then we can compose a set of history IDs by unioning
-  // the sets from each word.
-  if (!word_id_set.empty()) {
-    for (WordIDSet::iterator word_id_iter = word_id_set.begin();
-         word_id_iter != word_id_set.end(); ++word_id_iter) {
-      WordID word_id = *word_id_iter;
-      WordIDHistoryMap::iterator word_iter = word_id_history_map_.find(word_id);
-      if (word_iter != word_id_history_map_.end()) {
-        HistoryIDSet& word_history_id_set(word_iter->second);
-        history_id_set.insert(word_history_id_set.begin(),
-                              word_history_id_set.end());
-      }
-    }
+  // the sets from each word: concatenate them and sort the result once.
+  for (WordIDSet::const_iterator word_id_iter = word_id_set.begin();
+       word_id_iter != word_id_set.end(); ++word_id_iter)
+    AppendHistoryIDsForWord(*word_id_iter, &history_id_set);
+  if (!IsPostingList(history_id_set)) {
+    std::sort(history_id_set.begin(), history_id_set.end());
+    history_id_set.erase(
+        std::unique(history_id_set.begin(), history_id_set.end()),
+        history_id_set.end());
   }
 
   return history_id_set;
@@ -529,17 +610,29 @@ InMemoryURLIndex::Char16Set InMemoryURLIndex::Char16SetFromString16(
 void InMemoryURLIndex::AddWordToIndex(const string16& uni_word,
                                       HistoryID history_id) {
   WordMap::iterator word_pos = word_map_.find(uni_word);
-  if (word_pos != word_map_.end())
+  if (word_pos != word_map_.end()) {
     UpdateWordHistory(word_pos->second, history_id);
+    return;
+  }
+  WordID image_word_id = image_.get() ? image_->FindWord(uni_word) : -1;
+  if (image_word_id >= 0)
+    UpdateWordHistory(image_word_id, history_id);
   else
     AddWordHistory(uni_word, history_id);
 }
 
 void InMemoryURLIndex::UpdateWordHistory(WordID word_id, HistoryID history_id) {
-    WordIDHistoryMap::iterator history_pos = word_id_history_map_.find(word_id);
-    DCHECK(history_pos != word_id_history_map_.end());
-    HistoryIDSet& history_id_set(history_pos->second);
-    history_id_set.insert(history_id);
+  const WordID image_word_count = ImageWordCount();
+  if (word_id < image_word_count) {
+    size_t count = 0;
+    const int64* image_ids = image_->HistoryIDsForWord(word_id, &count);
+    if (!std::binary_search(image_ids, image_ids + count, history_id))
+      InsertSortedID(history_id, &image_word_history_map_[word_id]);
+    return;
+  }
+  DCHECK_LT(static_cast<size_t>(word_id - image_word_count),
+            word_id_history_map_.size());
+  InsertSortedID(history_id, &word_id_history_map_[word_id - image_word_count]);
 }
 
 // Add a new word to the word list and the word map, and then create a
@@ -547,31 +640,142 @@ void InMemoryURLIndex::UpdateWordHistory(WordID word_id, HistoryID history_id) {
 void InMemoryURLIndex::AddWordHistory(const string16& uni_word,
                                       HistoryID history_id) {
   word_list_.push_back(uni_word);
-  WordID word_id = word_list_.size() - 1;
+  WordID word_id = ImageWordCount() + word_list_.size() - 1;
   word_map_[uni_word] = word_id;
-  HistoryIDSet history_id_set;
-  history_id_set.insert(history_id);
-  word_id_history_map_[word_id] = history_id_set;
+  DCHECK_EQ(word_list_.size(), word_id_history_map_.size() + 1);
+  word_id_history_map_.push_back(HistoryIDSet(1, history_id));
   // For each character in the newly added word (i.e. a word that is not
-  // already in the word index), add the word to the character index.
+  // already in the word index), add the word to the character index. The new
+  // word_id is the largest yet so it always goes at the end of the lists.
   Char16Set characters = Char16SetFromString16(uni_word);
   for (Char16Set::iterator uni_char_iter = characters.begin();
-       uni_char_iter != characters.end(); ++uni_char_iter) {
-    Char16Set::value_type uni_char = *uni_char_iter;
-    CharWordIDMap::iterator char_iter = char_word_map_.find(uni_char);
-    if (char_iter != char_word_map_.end()) {
-      // Update existing entry in the char/word index.
-      WordIDSet& word_id_set(char_iter->second);
-      word_id_set.insert(word_id);
-    } else {
-      // Create a new entry in the char/word index.
-      WordIDSet word_id_set;
-      word_id_set.insert(word_id);
-      char_word_map_[uni_char] = word_id_set;
+       uni_char_iter != characters.end(); ++uni_char_iter)
+    InsertSortedID(word_id, &char_word_map_[*uni_char_iter]);
+}
+
+InMemoryURLIndex::WordID InMemoryURLIndex::ImageWordCount() const {
+  return image_.get() ? image_->word_count() : 0;
+}
+
+const InMemoryURLIndex::WordIDSet& InMemoryURLIndex::WordIDsForChar(
+    char16 uni_char,
+    WordIDSet* storage) const {
+  size_t image_count = 0;
+  const int32* image_ids =
+      image_.get() ? image_->WordIDsForChar(uni_char, &image_count) : NULL;
+  CharWordIDMap::const_iterator char_iter = char_word_map_.find(uni_char);
+  if (!image_count && char_iter != char_word_map_.end())
+    return char_iter->second;
+  // Words added since the image have larger IDs than any in it, so the two
+  // lists simply follow each other.
+  storage->assign(image_ids, image_ids + image_count);
+  if (char_iter != char_word_map_.end()) {
+    storage->insert(storage->end(), char_iter->second.begin(),
+                    char_iter->second.end());
+  }
+  return *storage;
+}
+
+void InMemoryURLIndex::AppendHistoryIDsForWord(
+    WordID word_id,
+    HistoryIDSet* history_ids) const {
+  const WordID image_word_count = ImageWordCount();
+  if (word_id >= image_word_count) {
+    const HistoryIDSet& word_history_ids(
+        word_id_history_map_[word_id - image_word_count]);
+    history_ids->insert(history_ids->end(), word_history_ids.begin(),
+                        word_history_ids.end());
+    return;
+  }
+  size_t count = 0;
+  const int64* image_ids = image_->HistoryIDsForWord(word_id, &count);
+  history_ids->insert(history_ids->end(), image_ids, image_ids + count);
+  std::map<WordID, HistoryIDSet>::const_iterator added =
+      image_word_history_map_.find(word_id);
+  if (added != image_word_history_map_.end()) {
+    history_ids->insert(history_ids->end(), added->second.begin(),
+                        added->second.end());
+  }
+}
+
+const URLRow* InMemoryURLIndex::RowForHistoryID(HistoryID history_id,
+                                                URLRow* image_row) const {
+  HistoryInfoMap::const_iterator hist_pos = history_info_map_.find(history_id);
+  if (hist_pos != history_info_map_.end())
+    return &hist_pos->second;
+  return GetImageRow(history_id, image_row) ? image_row : NULL;
+}
+
+bool InMemoryURLIndex::GetImageRow(HistoryID history_id, URLRow* row) const {
+  return image_.get() &&
+      !std::binary_search(removed_image_rows_.begin(),
+                          removed_image_rows_.end(), history_id) &&
+      image_->GetRow(history_id, row);
+}
+
+void InMemoryURLIndex::GetImageContents(
+    InMemoryURLIndexImage::Contents* contents) const {
+  contents->timestamp = base::Time::Now();
+  contents->history_item_count = history_item_count_;
+
+  const WordID image_word_count = ImageWordCount();
+  const size_t word_count = image_word_count + word_list_.size();
+  contents->words.reserve(word_count);
+  contents->word_history_ids.resize(word_count);
+  for (WordID word_id = 0; word_id < image_word_count; ++word_id) {
+    contents->words.push_back(image_->GetWord(word_id));
+    HistoryIDSet& history_ids(contents->word_history_ids[word_id]);
+    AppendHistoryIDsForWord(word_id, &history_ids);
+    // The IDs added since the image follow those from it; merge them in.
+    std::map<WordID, HistoryIDSet>::const_iterator added =
+        image_word_history_map_.find(word_id);
+    if (added != image_word_history_map_.end()) {
+      std::inplace_merge(history_ids.begin(),
+                         history_ids.end() - added->second.size(),
+                         history_ids.end());
+    }
+  }
+  contents->words.insert(contents->words.end(), word_list_.begin(),
+                         word_list_.end());
+  std::copy(word_id_history_map_.begin(), word_id_history_map_.end(),
+            contents->word_history_ids.begin() + image_word_count);
+
+  std::vector<char16> image_chars;
+  if (image_.get())
+    image_->GetChars(&image_chars);
+  for (std::vector<char16>::const_iterator iter = image_chars.begin();
+       iter != image_chars.end(); ++iter) {
+    WordIDSet storage;
+    contents->char_word_ids[*iter] = WordIDsForChar(*iter, &storage);
+  }
+  for (CharWordIDMap::const_iterator iter = char_word_map_.begin();
+       iter != char_word_map_.end(); ++iter) {
+    if (!contents->char_word_ids.count(iter->first))
+      contents->char_word_ids[iter->first] = iter->second;
+  }
+
+  contents->rows = history_info_map_;
+  if (image_.get()) {
+    for (size_t i = 0; i < image_->row_count(); ++i) {
+      URLRow row;
+      image_->GetRowAt(i, &row);
+      if (!contents->rows.count(row.id()) &&
+          !std::binary_search(removed_image_rows_.begin(),
+                              removed_image_rows_.end(), row.id()))
+        contents->rows[row.id()] = row;
     }
   }
 }
 
+void InMemoryURLIndex::CompactPostingLists() {
+  for (CharWordIDMap::iterator iter = char_word_map_.begin();
+       iter != char_word_map_.end(); ++iter)
+    ShrinkPostingList(&iter->second);
+  for (WordIDHistoryMap::iterator iter = word_id_history_map_.begin();
+       iter != word_id_history_map_.end(); ++iter)
+    ShrinkPostingList(&(*iter));
+}
+
 InMemoryURLIndex::WordIDSet InMemoryURLIndex::WordIDSetForTermChars(
     const InMemoryURLIndex::Char16Vector& uni_chars) {
   size_t index = CachedResultsIndexForTerm(uni_chars);
@@ -595,15 +799,12 @@ InMemoryURLIndex::WordIDSet InMemoryURLIndex::WordIDSetForTermChars(
   // Now process the remaining characters in the search term.
   for (; c_iter != uni_chars.end(); ++c_iter) {
     Char16Vector::value_type uni_char = *c_iter;
-    CharWordIDMap::iterator char_iter = char_word_map_.find(uni_char);
-    if (char_iter == char_word_map_.end()) {
-      // A character was not found so there are no matching results: bail.
-      word_id_set.clear();
-      break;
-    }
-    WordIDSet& char_word_id_set(char_iter->second);
-    // It is possible for there to no longer be any words associated with
-    // a particular character. Give up in that case.
+    WordIDSet char_word_id_storage;
+    const WordIDSet& char_word_id_set(
+        WordIDsForChar(uni_char, &char_word_id_storage));
+    // If a character was not found there are no matching results. It is also
+    // possible for there to no longer be any words associated with a
+    // particular character. Give up in either case.
     if (char_word_id_set.empty()) {
       word_id_set.clear();
       break;
@@ -612,14 +813,9 @@ InMemoryURLIndex::WordIDSet InMemoryURLIndex::WordIDSetForTermChars(
     if (word_id_set.empty()) {
       word_id_set = char_word_id_set;
     } else {
-      WordIDSet old_word_id_set(word_id_set);
-      word_id_set.clear();
-      std::set_intersection(old_word_id_set.begin(),
-                            old_word_id_set.end(),
-                            char_word_id_set.begin(),
-                            char_word_id_set.end(),
-                            std::inserter(word_id_set,
-                            word_id_set.begin()));
+      WordIDSet old_word_id_set;
+      old_word_id_set.swap(word_id_set);
+      IntersectSortedIDs(old_word_id_set, char_word_id_set, &word_id_set);
     }
     // Add this new char/set instance to the cache.
     term_char_word_set_cache_.push_back(TermCharWordSet(
@@ -843,14 +1039,13 @@ InMemoryURLIndex::AddHistoryMatch::~AddHistoryMatch() {}
 
 void InMemoryURLIndex::AddHistoryMatch::operator()(
     const InMemoryURLIndex::HistoryID history_id) {
-  HistoryInfoMap::const_iterator hist_pos =
-      index_.history_info_map_.find(history_id);
+  URLRow image_row;
+  const URLRow* hist_item = index_.RowForHistoryID(history_id, &image_row);
   // Note that a history_id may be present in the word_id_history_map_ yet not
   // be found in the history_info_map_. This occurs when an item has been
   // deleted by the user or the item no longer qualifies as a quick result.
-  if (hist_pos != index_.history_info_map_.end()) {
-    const URLRow& hist_item = hist_pos->second;
-    ScoredHistoryMatch match(ScoredMatchForURL(hist_item, lower_terms_));
+  if (hist_item) {
+    ScoredHistoryMatch match(ScoredMatchForURL(*hist_item, lower_terms_));
     if (match.raw_score > 0)
       scored_matches_.push_back(match);
   }
@@ -863,220 +1058,4 @@ bool InMemoryURLIndex::GetCacheFilePath(FilePath* file_path) {
   return true;
 }
 
-void InMemoryURLIndex::SavePrivateData(InMemoryURLIndexCacheItem* cache) const {
-  DCHECK(cache);
-  cache->set_timestamp(base::Time::Now().ToInternalValue());
-  cache->set_history_item_count(history_item_count_);
-  SaveWordList(cache);
-  SaveWordMap(cache);
-  SaveCharWordMap(cache);
-  SaveWordIDHistoryMap(cache);
-  SaveHistoryInfoMap(cache);
-}
-
-bool InMemoryURLIndex::RestorePrivateData(
-    const InMemoryURLIndexCacheItem& cache) {
-  last_saved_ = base::Time::FromInternalValue(cache.timestamp());
-  history_item_count_ = cache.history_item_count();
-  return (history_item_count_ == 0) || (RestoreWordList(cache) &&
-      RestoreWordMap(cache) && RestoreCharWordMap(cache) &&
-      RestoreWordIDHistoryMap(cache) && RestoreHistoryInfoMap(cache));
-}
-
-
-void InMemoryURLIndex::SaveWordList(InMemoryURLIndexCacheItem* cache) const {
-  if (word_list_.empty())
-    return;
-  WordListItem* list_item = cache->mutable_word_list();
-  list_item->set_word_count(word_list_.size());
-  for (String16Vector::const_iterator iter = word_list_.begin();
-       iter != word_list_.end(); ++iter)
-    list_item->add_word(UTF16ToUTF8(*iter));
-}
-
-bool InMemoryURLIndex::RestoreWordList(const InMemoryURLIndexCacheItem& cache) {
-  if (!cache.has_word_list())
-    return false;
-  const WordListItem& list_item(cache.word_list());
-  uint32 expected_item_count = list_item.word_count();
-  uint32 actual_item_count = list_item.word_size();
-  if (actual_item_count == 0 || actual_item_count != expected_item_count)
-    return false;
-  const RepeatedPtrField<std::string>& words(list_item.word());
-  for (RepeatedPtrField<std::string>::const_iterator iter = words.begin();
-       iter != words.end(); ++iter)
-    word_list_.push_back(UTF8ToUTF16(*iter));
-  return true;
-}
-
-void InMemoryURLIndex::SaveWordMap(InMemoryURLIndexCacheItem* cache) const {
-  if (word_map_.empty())
-    return;
-  WordMapItem* map_item = cache->mutable_word_map();
-  map_item->set_item_count(word_map_.size());
-  for (WordMap::const_iterator iter = word_map_.begin();
-       iter != word_map_.end(); ++iter) {
-    WordMapEntry* map_entry = map_item->add_word_map_entry();
-    map_entry->set_word(UTF16ToUTF8(iter->first));
-    map_entry->set_word_id(iter->second);
-  }
-}
-
-bool InMemoryURLIndex::RestoreWordMap(const InMemoryURLIndexCacheItem& cache) {
-  if (!cache.has_word_map())
-    return false;
-  const WordMapItem& list_item(cache.word_map());
-  uint32 expected_item_count = list_item.item_count();
-  uint32 actual_item_count = list_item.word_map_entry_size();
-  if (actual_item_count == 0 || actual_item_count != expected_item_count)
-    return false;
-  const RepeatedPtrField<WordMapEntry>& entries(list_item.word_map_entry());
-  for (RepeatedPtrField<WordMapEntry>::const_iterator iter = entries.begin();
-       iter != entries.end(); ++iter)
-    word_map_[UTF8ToUTF16(iter->word())] = iter->word_id();
-  return true;
-}
-
-void InMemoryURLIndex::SaveCharWordMap(InMemoryURLIndexCacheItem* cache) const {
-  if (char_word_map_.empty())
-    return;
-  CharWordMapItem* map_item = cache->mutable_char_word_map();
-  map_item->set_item_count(char_word_map_.size());
-  for (CharWordIDMap::const_iterator iter = char_word_map_.begin();
-       iter != char_word_map_.end(); ++iter) {
-    CharWordMapEntry* map_entry = map_item->add_char_word_map_entry();
-    map_entry->set_char_16(iter->first);
-    const WordIDSet& word_id_set(iter->second);
-    map_entry->set_item_count(word_id_set.size());
-    for (WordIDSet::const_iterator set_iter = word_id_set.begin();
-         set_iter != word_id_set.end(); ++set_iter)
-      map_entry->add_word_id(*set_iter);
-  }
-}
-
-bool InMemoryURLIndex::RestoreCharWordMap(
-    const InMemoryURLIndexCacheItem& cache) {
-  if (!cache.has_char_word_map())
-    return false;
-  const CharWordMapItem& list_item(cache.char_word_map());
-  uint32 expected_item_count = list_item.item_count();
-  uint32 actual_item_count = list_item.char_word_map_entry_size();
-  if (actual_item_count == 0 || actual_item_count != expected_item_count)
-    return false;
-  const RepeatedPtrField<CharWordMapEntry>&
-      entries(list_item.char_word_map_entry());
-  for (RepeatedPtrField<CharWordMapEntry>::const_iterator iter =
-       entries.begin(); iter != entries.end(); ++iter) {
-    expected_item_count = iter->item_count();
-    actual_item_count = iter->word_id_size();
-    if (actual_item_count == 0 || actual_item_count != expected_item_count)
-      return false;
-    char16 uni_char = static_cast<char16>(iter->char_16());
-    WordIDSet word_id_set;
-    const RepeatedField<int32>& word_ids(iter->word_id());
-    for (RepeatedField<int32>::const_iterator jiter = word_ids.begin();
-         jiter != word_ids.end(); ++jiter)
-      word_id_set.insert(*jiter);
-    char_word_map_[uni_char] = word_id_set;
-  }
-  return true;
-}
-
-void InMemoryURLIndex::SaveWordIDHistoryMap(InMemoryURLIndexCacheItem* cache)
-    const {
-  if (word_id_history_map_.empty())
-    return;
-  WordIDHistoryMapItem* map_item = cache->mutable_word_id_history_map();
-  map_item->set_item_count(word_id_history_map_.size());
-  for (WordIDHistoryMap::const_iterator iter = word_id_history_map_.begin();
-       iter != word_id_history_map_.end(); ++iter) {
-    WordIDHistoryMapEntry* map_entry =
-        map_item->add_word_id_history_map_entry();
-    map_entry->set_word_id(iter->first);
-    const HistoryIDSet& history_id_set(iter->second);
-    map_entry->set_item_count(history_id_set.size());
-    for (HistoryIDSet::const_iterator set_iter = history_id_set.begin();
-         set_iter != history_id_set.end(); ++set_iter)
-      map_entry->add_history_id(*set_iter);
-  }
-}
-
-bool InMemoryURLIndex::RestoreWordIDHistoryMap(
-    const InMemoryURLIndexCacheItem& cache) {
-  if (!cache.has_word_id_history_map())
-    return false;
-  const WordIDHistoryMapItem& list_item(cache.word_id_history_map());
-  uint32 expected_item_count = list_item.item_count();
-  uint32 actual_item_count = list_item.word_id_history_map_entry_size();
-  if (actual_item_count == 0 || actual_item_count != expected_item_count)
-    return false;
-  const RepeatedPtrField<WordIDHistoryMapEntry>&
-      entries(list_item.word_id_history_map_entry());
-  for (RepeatedPtrField<WordIDHistoryMapEntry>::const_iterator iter =
-       entries.begin(); iter != entries.end(); ++iter) {
-    expected_item_count = iter->item_count();
-    actual_item_count = iter->history_id_size();
-    if (actual_item_count == 0 || actual_item_count != expected_item_count)
-      return false;
-    WordID word_id = iter->word_id();
-    HistoryIDSet history_id_set;
-    const RepeatedField<int64>& history_ids(iter->history_id());
-    for (RepeatedField<int64>::const_iterator jiter = history_ids.begin();
-         jiter != history_ids.end(); ++jiter)
-      history_id_set.insert(*jiter);
-    word_id_history_map_[word_id] = history_id_set;
-  }
-  return true;
-}
-
-void InMemoryURLIndex::SaveHistoryInfoMap(
-    InMemoryURLIndexCacheItem* cache) const {
-  if (history_info_map_.empty())
-    return;
-  HistoryInfoMapItem* map_item = cache->mutable_history_info_map();
-  map_item->set_item_count(history_info_map_.size());
-  for (HistoryInfoMap::const_iterator iter = history_info_map_.begin();
-       iter != history_info_map_.end(); ++iter) {
-    HistoryInfoMapEntry* map_entry = map_item->add_history_info_map_entry();
-    map_entry->set_history_id(iter->first);
-    const URLRow& url_row(iter->second);
-    // Note: We only save information that contributes to the index so there
-    // is no need to save term_char_word_set_cache_ (not persistent),
-    // languages_, etc.
-    map_entry->set_visit_count(url_row.visit_count());
-    map_entry->set_typed_count(url_row.typed_count());
-    map_entry->set_last_visit(url_row.last_visit().ToInternalValue());
-    map_entry->set_url(url_row.url().spec());
-    map_entry->set_title(UTF16ToUTF8(url_row.title()));
-  }
-}
-
-bool InMemoryURLIndex::RestoreHistoryInfoMap(
-    const InMemoryURLIndexCacheItem& cache) {
-  if (!cache.has_history_info_map())
-    return false;
-  const HistoryInfoMapItem& list_item(cache.history_info_map());
-  uint32 expected_item_count = list_item.item_count();
-  uint32 actual_item_count = list_item.history_info_map_entry_size();
-  if (actual_item_count == 0 || actual_item_count != expected_item_count)
-    return false;
-  const RepeatedPtrField<HistoryInfoMapEntry>&
-      entries(list_item.history_info_map_entry());
-  for (RepeatedPtrField<HistoryInfoMapEntry>::const_iterator iter =
-       entries.begin(); iter != entries.end(); ++iter) {
-    HistoryID history_id = iter->history_id();
-    GURL url(iter->url());
-    URLRow url_row(url, history_id);
-    url_row.set_visit_count(iter->visit_count());
-    url_row.set_typed_count(iter->typed_count());
-    url_row.set_last_visit(base::Time::FromInternalValue(iter->last_visit()));
-    if (iter->has_title()) {
-      string16 title(UTF8ToUTF16(iter->title()));
-      url_row.set_title(title);
-    }
-    history_info_map_[history_id] = url_row;
-  }
-  return true;
-}
-
 }  // namespace history
@@ -22,7 +22,7 @@
 #include "chrome/browser/autocomplete/autocomplete_match.h"
 #include "chrome/browser/autocomplete/history_provider_util.h"
 #include "chrome/browser/history/history_types.h"
-#include "chrome/browser/history/in_memory_url_index_cache.pb.h"
+#include "chrome/browser/history/in_memory_url_index_image.h"
 #include "testing/gtest/include/gtest/gtest_prod.h"
 
 class Profile;
@@ -31,14 +31,8 @@ namespace base {
 class Time;
 }
 
-namespace in_memory_url_index {
-class InMemoryURLIndexCacheItem;
-}
-
 namespace history {
 
-namespace imui = in_memory_url_index;
-
 class URLDatabase;
 
 // Specifies where an omnibox term occurs within a string. Used for specifying
@@ -93,6 +87,14 @@ typedef std::vector<ScoredHistoryMatch> ScoredHistoryMatches;
 // will eliminate such words except in the case where a single character
 // is being searched on and which character occurs as the second char16 of a
 // multi-char16 instance.
+//
+// The index is cached in an InMemoryURLIndexImage which is mapped and searched
+// in place when the index is next restored. Words and rows added after that
+// are kept in the containers below, on top of the image: new words take IDs
+// following those of the image, rows updated since the image was written
+// shadow their image rows in |history_info_map_|, and image rows which have
+// been deleted are listed in |removed_image_rows_|. Saving the cache writes a
+// new image combining both.
 class InMemoryURLIndex {
  public:
   // |history_dir| is a path to the directory containing the history database
@@ -119,12 +121,12 @@ class InMemoryURLIndex {
   // flushes the cache to disk.
   void ShutDown();
 
-  // Restores the index's private data from the cache file stored in the
-  // profile directory and returns true if successful.
+  // Maps the index image cached in the profile directory and returns true if
+  // successful.
   bool RestoreFromCacheFile();
 
-  // Caches the index private data and writes the cache file to the profile
-  // directory.
+  // Writes the index, including any changes made since it was restored, to a
+  // new image in the profile directory.
   bool SaveToCacheFile();
 
   // Given a vector containing one or more words as string16s, scans the
@@ -179,7 +181,9 @@ class InMemoryURLIndex {
   FRIEND_TEST_ALL_PREFIXES(LimitedInMemoryURLIndexTest, Initialization);
   FRIEND_TEST_ALL_PREFIXES(InMemoryURLIndexTest, CacheFilePath);
   FRIEND_TEST_ALL_PREFIXES(InMemoryURLIndexTest, CacheSaveRestore);
+  FRIEND_TEST_ALL_PREFIXES(InMemoryURLIndexTest, CacheUpdateAfterRestore);
   FRIEND_TEST_ALL_PREFIXES(InMemoryURLIndexTest, Char16Utilities);
+  FRIEND_TEST_ALL_PREFIXES(InMemoryURLIndexTest, LargeIndex);
   FRIEND_TEST_ALL_PREFIXES(InMemoryURLIndexTest, Scoring);
   FRIEND_TEST_ALL_PREFIXES(InMemoryURLIndexTest, StaticFunctions);
   FRIEND_TEST_ALL_PREFIXES(InMemoryURLIndexTest, TitleSearch);
@@ -202,16 +206,21 @@ class InMemoryURLIndex {
   // A map allowing a WordID to be determined given a word.
   typedef std::map<string16, WordID> WordMap;
 
+  // The posting lists of the index are kept as sorted vectors without
+  // duplicates rather than as std::sets: on a large history the per-node
+  // overhead of a set costs several times the IDs themselves, and
+  // intersecting contiguous lists is much friendlier to the cache.
+
   // A map from character to word_ids.
-  typedef std::set<WordID> WordIDSet;  // An index into the WordList.
+  typedef std::vector<WordID> WordIDSet;  // Indexes into the WordList.
   typedef std::map<char16, WordIDSet> CharWordIDMap;
 
-  // A map from word_id to history item.
+  // A map from word_id to history item, indexed by word_id.
   // TODO(mrossetti): URLID is 64 bit: a memory bloat and performance hit.
   // Consider using a smaller type.
   typedef URLID HistoryID;
-  typedef std::set<HistoryID> HistoryIDSet;
-  typedef std::map<WordID, HistoryIDSet> WordIDHistoryMap;
+  typedef std::vector<HistoryID> HistoryIDSet;
+  typedef std::vector<HistoryIDSet> WordIDHistoryMap;
 
   // Support caching of term character results so that we can optimize
   // searches which build upon a previous search. Each entry in this vector
@@ -311,6 +320,31 @@ class InMemoryURLIndex {
   // |history_id| as the initial element of the word's set.
   void AddWordHistory(const string16& uni_word, HistoryID history_id);
 
+  // Releases the spare capacity left in the posting lists by building the
+  // index one row at a time.
+  void CompactPostingLists();
+
+  // Number of words in |image_|. The IDs of words added since follow these.
+  WordID ImageWordCount() const;
+
+  // Returns the posting list of words containing |uni_char|. If part of it
+  // lives in |image_| the list is assembled in |storage|.
+  const WordIDSet& WordIDsForChar(char16 uni_char, WordIDSet* storage) const;
+
+  // Appends the history items containing the word |word_id| to |history_ids|.
+  void AppendHistoryIDsForWord(WordID word_id, HistoryIDSet* history_ids) const;
+
+  // Returns the indexed row for |history_id|, or NULL if there is none. Rows
+  // coming from |image_| are unpacked into |image_row|.
+  const URLRow* RowForHistoryID(HistoryID history_id, URLRow* image_row) const;
+
+  // Fetches the row for |history_id| from |image_| unless it has been removed
+  // since.
+  bool GetImageRow(HistoryID history_id, URLRow* row) const;
+
+  // Gathers the image and the changes made on top of it into |contents|.
+  void GetImageContents(InMemoryURLIndexImage::Contents* contents) const;
+
   // Clears the search term cache. This cache holds on to the intermediate
   // word results for each previously typed character to eliminate the need
   // to re-perform set operations for previously typed characters.
@@ -356,23 +390,6 @@ class InMemoryURLIndex {
   // provided as a hook for unit testing.)
   bool GetCacheFilePath(FilePath* file_path);
 
-  // Encode a data structure into the protobuf |cache|.
-  void SavePrivateData(imui::InMemoryURLIndexCacheItem* cache) const;
-  void SaveWordList(imui::InMemoryURLIndexCacheItem* cache) const;
-  void SaveWordMap(imui::InMemoryURLIndexCacheItem* cache) const;
-  void SaveCharWordMap(imui::InMemoryURLIndexCacheItem* cache) const;
-  void SaveWordIDHistoryMap(imui::InMemoryURLIndexCacheItem* cache) const;
-  void SaveHistoryInfoMap(imui::InMemoryURLIndexCacheItem* cache) const;
-
-  // Decode a data structure from the protobuf |cache|. Return false if there
-  // is any kind of failure.
-  bool RestorePrivateData(const imui::InMemoryURLIndexCacheItem& cache);
-  bool RestoreWordList(const imui::InMemoryURLIndexCacheItem& cache);
-  bool RestoreWordMap(const imui::InMemoryURLIndexCacheItem& cache);
-  bool RestoreCharWordMap(const imui::InMemoryURLIndexCacheItem& cache);
-  bool RestoreWordIDHistoryMap(const imui::InMemoryURLIndexCacheItem& cache);
-  bool RestoreHistoryInfoMap(const imui::InMemoryURLIndexCacheItem& cache);
-
   // Directory where cache file resides. This is, except when unit testing,
   // the same directory in which the profile's history database is found. It
   // should never be empty.
@@ -384,9 +401,19 @@ class InMemoryURLIndex {
   // the InMemoryURLIndex was last populated.
   base::Time last_saved_;
 
-  // A list of all of indexed words. The index of a word in this list is the
-  // ID of the word in the word_map_. It reduces the memory overhead by
-  // replacing a potentially long and repeated string with a simple index.
+  // The cached image the index was restored from, if any.
+  scoped_ptr<InMemoryURLIndexImage> image_;
+
+  // History IDs added to the posting lists of words from |image_|.
+  std::map<WordID, HistoryIDSet> image_word_history_map_;
+
+  // Rows of |image_| which have been deleted, or no longer qualify, since.
+  HistoryIDSet removed_image_rows_;
+
+  // A list of all of indexed words not in |image_|. The index of a word in
+  // this list, plus ImageWordCount(), is the ID of the word in the word_map_.
+  // It reduces the memory overhead by replacing a potentially long and
+  // repeated string with a simple index.
   // NOTE: A word will _never_ be removed from this vector thus insuring
   // the immutability of the word_id throughout the session, reducing
   // maintenance complexity.
@@ -395,6 +422,8 @@ class InMemoryURLIndex {
   String16Vector word_list_;
 
   int history_item_count_;
+  // Like |word_list_|, these only hold words added since |image_|, with
+  // |word_id_history_map_| indexed by word ID less ImageWordCount().
   WordMap word_map_;
   CharWordIDMap char_word_map_;
   WordIDHistoryMap word_id_history_map_;
@@ -0,0 +1,512 @@
+// Copyright (c) 2011 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "chrome/browser/history/in_memory_url_index_image.h"
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+
+#include "base/eintr_wrapper.h"
+#include "base/file_path.h"
+#include "base/file_util.h"
+#include "base/logging.h"
+#include "googleurl/src/gurl.h"
+
+namespace history {
+
+namespace {
+
+const uint32 kImageMagic = 0x49505148;  // 'HQPI'
+
+// Bump whenever the layout of the image changes; older images are then
+// ignored and the index rebuilt from the history database.
+const uint32 kImageVersion = 1;
+
+enum {
+  // uint32[word_count + 1]: start of each word in kWordCharsSection.
+  kWordOffsetsSection,
+  // char16[]: the words, back to back.
+  kWordCharsSection,
+  // int32[word_count]: word IDs in the order of their words.
+  kSortedWordsSection,
+  // CharEntry[char_count], in order of the characters.
+  kCharsSection,
+  // int32[]: the char/word posting lists.
+  kCharWordIDsSection,
+  // uint32[word_count + 1]: start of each word's list in kHistoryIDsSection.
+  kWordHistoryOffsetsSection,
+  // int64[]: the word/history posting lists.
+  kHistoryIDsSection,
+  // RowEntry[row_count], in order of the history IDs.
+  kRowsSection,
+  // char[]: the URL specs, back to back.
+  kURLCharsSection,
+  // char16[]: the titles, back to back.
+  kTitleCharsSection,
+  kSectionCount
+};
+
+const size_t kSectionAlignment = 8;
+
+size_t AlignSection(size_t offset) {
+  return (offset + kSectionAlignment - 1) & ~(kSectionAlignment - 1);
+}
+
+template <typename T>
+void AppendToSection(const T& value, std::string* section) {
+  section->append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template <typename T>
+void AppendArrayToSection(const T* values, size_t count,
+                          std::string* section) {
+  if (count)
+    section->append(reinterpret_cast<const char*>(values), count * sizeof(T));
+}
+
+// Returns true if |offsets| starts at zero, never decreases, and ends at
+// |pool_length|, as every offset table of the image must.
+bool ValidOffsets(const uint32* offsets, size_t count, size_t pool_length) {
+  if (count == 0 || offsets[0] != 0 || offsets[count - 1] != pool_length)
+    return false;
+  for (size_t i = 1; i < count; ++i) {
+    if (offsets[i] < offsets[i - 1])
+      return false;
+  }
+  return true;
+}
+
+// Returns true if every value of |values| is larger than the one before it,
+// as in a posting list.
+template <typename T>
+bool StrictlyIncreasing(const T* values, size_t count) {
+  for (size_t i = 1; i < count; ++i) {
+    if (values[i] <= values[i - 1])
+      return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+struct InMemoryURLIndexImage::Header {
+  uint32 magic;
+  uint32 version;
+  int64 timestamp;
+  int32 history_item_count;
+  uint32 word_count;
+  uint32 char_count;
+  uint32 row_count;
+  struct {
+    uint64 offset;
+    uint64 length;
+  } sections[kSectionCount];
+};
+
+struct InMemoryURLIndexImage::CharEntry {
+  uint32 uni_char;
+  uint32 begin;
+  uint32 count;
+};
+
+struct InMemoryURLIndexImage::RowEntry {
+  int64 history_id;
+  int64 last_visit;
+  int32 visit_count;
+  int32 typed_count;
+  uint32 url_offset;
+  uint32 url_length;
+  uint32 title_offset;
+  uint32 title_length;
+};
+
+const InMemoryURLIndexImage::Header* InMemoryURLIndexImage::header() const {
+  return reinterpret_cast<const Header*>(data_);
+}
+
+template <typename T>
+const T* InMemoryURLIndexImage::Section(int section) const {
+  return reinterpret_cast<const T*>(data_ + header()->sections[section].offset);
+}
+
+template <typename T>
+size_t InMemoryURLIndexImage::SectionLength(int section) const {
+  return header()->sections[section].length / sizeof(T);
+}
+
+InMemoryURLIndexImage::Contents::Contents()
+    : history_item_count(0) {
+}
+
+InMemoryURLIndexImage::Contents::~Contents() {}
+
+InMemoryURLIndexImage::InMemoryURLIndexImage()
+    : data_(NULL),
+      length_(0) {
+}
+
+InMemoryURLIndexImage::~InMemoryURLIndexImage() {
+  if (data_)
+    munmap(data_, length_);
+}
+
+// static
+bool InMemoryURLIndexImage::Write(const FilePath& path,
+                                  const Contents& contents) {
+  std::string sections[kSectionCount];
+  const size_t word_count = contents.words.size();
+  DCHECK_EQ(word_count, contents.word_history_ids.size());
+
+  uint32 offset = 0;
+  for (size_t i = 0; i < word_count; ++i) {
+    AppendToSection(offset, &sections[kWordOffsetsSection]);
+    const string16& word(contents.words[i]);
+    AppendArrayToSection(word.data(), word.length(),
+                         &sections[kWordCharsSection]);
+    offset += word.length();
+  }
+  AppendToSection(offset, &sections[kWordOffsetsSection]);
+
+  std::map<string16, int32> sorted_words;
+  for (size_t i = 0; i < word_count; ++i)
+    sorted_words[contents.words[i]] = i;
+  for (std::map<string16, int32>::const_iterator iter = sorted_words.begin();
+       iter != sorted_words.end(); ++iter)
+    AppendToSection(iter->second, &sections[kSortedWordsSection]);
+
+  offset = 0;
+  for (std::map<char16, std::vector<int> >::const_iterator iter =
+       contents.char_word_ids.begin(); iter != contents.char_word_ids.end();
+       ++iter) {
+    CharEntry entry = { iter->first, offset,
+                        static_cast<uint32>(iter->second.size()) };
+    AppendToSection(entry, &sections[kCharsSection]);
+    for (std::vector<int>::const_iterator word_iter = iter->second.begin();
+         word_iter != iter->second.end(); ++word_iter) {
+      AppendToSection(static_cast<int32>(*word_iter),
+                      &sections[kCharWordIDsSection]);
+    }
+    offset += iter->second.size();
+  }
+
+  offset = 0;
+  for (size_t i = 0; i < word_count; ++i) {
+    AppendToSection(offset, &sections[kWordHistoryOffsetsSection]);
+    const std::vector<URLID>& history_ids(contents.word_history_ids[i]);
+    AppendArrayToSection(history_ids.empty() ? NULL : &history_ids[0],
+                         history_ids.size(), &sections[kHistoryIDsSection]);
+    offset += history_ids.size();
+  }
+  AppendToSection(offset, &sections[kWordHistoryOffsetsSection]);
+
+  uint32 url_offset = 0;
+  uint32 title_offset = 0;
+  for (std::map<URLID, URLRow>::const_iterator iter = contents.rows.begin();
+       iter != contents.rows.end(); ++iter) {
+    const URLRow& row(iter->second);
+    const std::string& url(row.url().spec());
+    const string16& title(row.title());
+    RowEntry entry = { iter->first, row.last_visit().ToInternalValue(),
+                       row.visit_count(), row.typed_count(),
+                       url_offset, static_cast<uint32>(url.length()),
+                       title_offset, static_cast<uint32>(title.length()) };
+    AppendToSection(entry, &sections[kRowsSection]);
+    sections[kURLCharsSection].append(url);
+    AppendArrayToSection(title.data(), title.length(),
+                         &sections[kTitleCharsSection]);
+    url_offset += url.length();
+    title_offset += title.length();
+  }
+
+  Header image_header;
+  memset(&image_header, 0, sizeof(image_header));
+  image_header.magic = kImageMagic;
+  image_header.version = kImageVersion;
+  image_header.timestamp = contents.timestamp.ToInternalValue();
+  image_header.history_item_count = contents.history_item_count;
+  image_header.word_count = word_count;
+  image_header.char_count = contents.char_word_ids.size();
+  image_header.row_count = contents.rows.size();
+  size_t file_offset = AlignSection(sizeof(image_header));
+  for (int i = 0; i < kSectionCount; ++i) {
+    image_header.sections[i].offset = file_offset;
+    image_header.sections[i].length = sections[i].length();
+    file_offset = AlignSection(file_offset + sections[i].length());
+  }
+
+  // Write next to the old image and move the new one over it once complete,
+  // so that a crash never leaves a truncated image behind.
+  FilePath temp_path(path.value() + FILE_PATH_LITERAL(".new"));
+  file_util::ScopedFILE file(file_util::OpenFile(temp_path, "wb"));
+  if (!file.get())
+    return false;
+  bool written =
+      fwrite(&image_header, sizeof(image_header), 1, file.get()) == 1;
+  size_t written_length = sizeof(image_header);
+  const char kPadding[kSectionAlignment] = { 0 };
+  for (int i = 0; written && i < kSectionCount; ++i) {
+    size_t padding = image_header.sections[i].offset - written_length;
+    written = (padding == 0 ||
+               fwrite(kPadding, padding, 1, file.get()) == 1) &&
+              (sections[i].empty() ||
+               fwrite(sections[i].data(), sections[i].length(), 1,
+                      file.get()) == 1);
+    written_length = image_header.sections[i].offset + sections[i].length();
+  }
+  written = file_util::CloseFile(file.release()) && written;
+  if (!written || !file_util::ReplaceFile(temp_path, path)) {
+    file_util::Delete(temp_path, false);
+    return false;
+  }
+  return true;
+}
+
+// static
+InMemoryURLIndexImage* InMemoryURLIndexImage::Open(const FilePath& path) {
+  int fd = HANDLE_EINTR(open(path.value().c_str(), O_RDONLY));
+  if (fd < 0)
+    return NULL;
+  struct stat file_info;
+  void* data = MAP_FAILED;
+  if (fstat(fd, &file_info) == 0 &&
+      file_info.st_size >= static_cast<off_t>(sizeof(Header))) {
+    data = mmap(NULL, file_info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  }
+  HANDLE_EINTR(close(fd));
+  if (data == MAP_FAILED)
+    return NULL;
+
+  InMemoryURLIndexImage* image = new InMemoryURLIndexImage;
+  image->data_ = static_cast<uint8*>(data);
+  image->length_ = file_info.st_size;
+  if (!image->Validate()) {
+    LOG(WARNING) << "Ignoring invalid InMemoryURLIndex image "
+                 << path.value();
+    delete image;
+    return NULL;
+  }
+  return image;
+}
+
+base::Time InMemoryURLIndexImage::timestamp() const {
+  return base::Time::FromInternalValue(header()->timestamp);
+}
+
+int InMemoryURLIndexImage::history_item_count() const {
+  return header()->history_item_count;
+}
+
+size_t InMemoryURLIndexImage::word_count() const {
+  return header()->word_count;
+}
+
+string16 InMemoryURLIndexImage::GetWord(int word_id) const {
+  DCHECK_LT(static_cast<size_t>(word_id), word_count());
+  const uint32* offsets = Section<uint32>(kWordOffsetsSection);
+  return string16(Section<char16>(kWordCharsSection) + offsets[word_id],
+                  offsets[word_id + 1] - offsets[word_id]);
+}
+
+int InMemoryURLIndexImage::FindWord(const string16& word) const {
+  const uint32* offsets = Section<uint32>(kWordOffsetsSection);
+  const char16* chars = Section<char16>(kWordCharsSection);
+  const int32* sorted = Section<int32>(kSortedWordsSection);
+  size_t low = 0;
+  size_t high = word_count();
+  while (low < high) {
+    size_t middle = low + (high - low) / 2;
+    int32 word_id = sorted[middle];
+    const char16* begin = chars + offsets[word_id];
+    const char16* end = chars + offsets[word_id + 1];
+    if (std::lexicographical_compare(begin, end, word.begin(), word.end())) {
+      low = middle + 1;
+    } else if (std::lexicographical_compare(word.begin(), word.end(),
+                                            begin, end)) {
+      high = middle;
+    } else {
+      return word_id;
+    }
+  }
+  return -1;
+}
+
+void InMemoryURLIndexImage::GetChars(std::vector<char16>* chars) const {
+  const CharEntry* entries = Section<CharEntry>(kCharsSection);
+  for (size_t i = 0; i < header()->char_count; ++i)
+    chars->push_back(static_cast<char16>(entries[i].uni_char));
+}
+
+const int32* InMemoryURLIndexImage::WordIDsForChar(char16 uni_char,
+                                                   size_t* count) const {
+  const CharEntry* begin = Section<CharEntry>(kCharsSection);
+  const CharEntry* end = begin + header()->char_count;
+  size_t low = 0;
+  size_t high = end - begin;
+  while (low < high) {
+    size_t middle = low + (high - low) / 2;
+    if (begin[middle].uni_char < uni_char) {
+      low = middle + 1;
+    } else if (begin[middle].uni_char > uni_char) {
+      high = middle;
+    } else {
+      *count = begin[middle].count;
+      return Section<int32>(kCharWordIDsSection) + begin[middle].begin;
+    }
+  }
+  *count = 0;
+  return NULL;
+}
+
+const int64* InMemoryURLIndexImage::HistoryIDsForWord(int word_id,
+                                                      size_t* count) const {
+  DCHECK_LT(static_cast<size_t>(word_id), word_count());
+  const uint32* offsets = Section<uint32>(kWordHistoryOffsetsSection);
+  *count = offsets[word_id + 1] - offsets[word_id];
+  return Section<int64>(kHistoryIDsSection) + offsets[word_id];
+}
+
+bool InMemoryURLIndexImage::GetRow(URLID history_id, URLRow* row) const {
+  const RowEntry* entry = FindRow(history_id);
+  if (!entry)
+    return false;
+  RowFromEntry(*entry, row);
+  return true;
+}
+
+bool InMemoryURLIndexImage::HasRow(URLID history_id) const {
+  return FindRow(history_id) != NULL;
+}
+
+size_t InMemoryURLIndexImage::row_count() const {
+  return header()->row_count;
+}
+
+void InMemoryURLIndexImage::GetRowAt(size_t index, URLRow* row) const {
+  DCHECK_LT(index, row_count());
+  RowFromEntry(Section<RowEntry>(kRowsSection)[index], row);
+}
+
+bool InMemoryURLIndexImage::Validate() const {
+  const Header* image_header = header();
+  if (image_header->magic != kImageMagic ||
+      image_header->version != kImageVersion)
+    return false;
+  for (int i = 0; i < kSectionCount; ++i) {
+    uint64 offset = image_header->sections[i].offset;
+    uint64 length = image_header->sections[i].length;
+    if (offset % kSectionAlignment || offset < sizeof(Header) ||
+        offset > length_ || length > length_ - offset)
+      return false;
+  }
+
+  const size_t word_count = image_header->word_count;
+  const size_t char_count = image_header->char_count;
+  const size_t row_count = image_header->row_count;
+  if (SectionLength<uint32>(kWordOffsetsSection) != word_count + 1 ||
+      SectionLength<int32>(kSortedWordsSection) != word_count ||
+      SectionLength<CharEntry>(kCharsSection) != char_count ||
+      SectionLength<uint32>(kWordHistoryOffsetsSection) != word_count + 1 ||
+      SectionLength<RowEntry>(kRowsSection) != row_count)
+    return false;
+
+  if (!ValidOffsets(Section<uint32>(kWordOffsetsSection), word_count + 1,
+                    SectionLength<char16>(kWordCharsSection)) ||
+      !ValidOffsets(Section<uint32>(kWordHistoryOffsetsSection),
+                    word_count + 1, SectionLength<int64>(kHistoryIDsSection)))
+    return false;
+
+  // FindWord() needs the words in strictly increasing order, which also
+  // makes sure that no word ID is listed twice.
+  const uint32* word_offsets = Section<uint32>(kWordOffsetsSection);
+  const char16* word_chars = Section<char16>(kWordCharsSection);
+  const int32* sorted = Section<int32>(kSortedWordsSection);
+  for (size_t i = 0; i < word_count; ++i) {
+    if (sorted[i] < 0 || static_cast<size_t>(sorted[i]) >= word_count)
+      return false;
+    if (i > 0 &&
+        !std::lexicographical_compare(
+            word_chars + word_offsets[sorted[i - 1]],
+            word_chars + word_offsets[sorted[i - 1] + 1],
+            word_chars + word_offsets[sorted[i]],
+            word_chars + word_offsets[sorted[i] + 1]))
+      return false;
+  }
+
+  const size_t char_word_ids_length = SectionLength<int32>(kCharWordIDsSection);
+  const int32* char_word_ids = Section<int32>(kCharWordIDsSection);
+  const CharEntry* chars = Section<CharEntry>(kCharsSection);
+  for (size_t i = 0; i < char_count; ++i) {
+    if (chars[i].begin > char_word_ids_length ||
+        chars[i].count > char_word_ids_length - chars[i].begin)
+      return false;
+    if (i > 0 && chars[i].uni_char <= chars[i - 1].uni_char)
+      return false;
+    const int32* word_ids = char_word_ids + chars[i].begin;
+    if (!StrictlyIncreasing(word_ids, chars[i].count))
+      return false;
+    if (chars[i].count &&
+        (word_ids[0] < 0 ||
+         static_cast<size_t>(word_ids[chars[i].count - 1]) >= word_count))
+      return false;
+  }
+
+  const uint32* history_offsets = Section<uint32>(kWordHistoryOffsetsSection);
+  const int64* history_ids = Section<int64>(kHistoryIDsSection);
+  for (size_t i = 0; i < word_count; ++i) {
+    if (!StrictlyIncreasing(history_ids + history_offsets[i],
+                            history_offsets[i + 1] - history_offsets[i]))
+      return false;
+  }
+
+  const size_t url_chars_length = SectionLength<char>(kURLCharsSection);
+  const size_t title_chars_length = SectionLength<char16>(kTitleCharsSection);
+  const RowEntry* rows = Section<RowEntry>(kRowsSection);
+  for (size_t i = 0; i < row_count; ++i) {
+    if (i > 0 && rows[i].history_id <= rows[i - 1].history_id)
+      return false;
+    if (rows[i].url_offset > url_chars_length ||
+        rows[i].url_length > url_chars_length - rows[i].url_offset ||
+        rows[i].title_offset > title_chars_length ||
+        rows[i].title_length > title_chars_length - rows[i].title_offset)
+      return false;
+  }
+  return true;
+}
+
+const InMemoryURLIndexImage::RowEntry* InMemoryURLIndexImage::FindRow(
+    URLID history_id) const {
+  const RowEntry* rows = Section<RowEntry>(kRowsSection);
+  size_t low = 0;
+  size_t high = row_count();
+  while (low < high) {
+    size_t middle = low + (high - low) / 2;
+    if (rows[middle].history_id < history_id)
+      low = middle + 1;
+    else if (rows[middle].history_id > history_id)
+      high = middle;
+    else
+      return rows + middle;
+  }
+  return NULL;
+}
+
+void InMemoryURLIndexImage::RowFromEntry(const RowEntry& entry,
+                                         URLRow* row) const {
+  const char* url = Section<char>(kURLCharsSection) + entry.url_offset;
+  *row = URLRow(GURL(std::string(url, entry.url_length)), entry.history_id);
+  row->set_visit_count(entry.visit_count);
+  row->set_typed_count(entry.typed_count);
+  row->set_last_visit(base::Time::FromInternalValue(entry.last_visit));
+  row->set_title(string16(
+      Section<char16>(kTitleCharsSection) + entry.title_offset,
+      entry.title_length));
+}
+
+}  // namespace history
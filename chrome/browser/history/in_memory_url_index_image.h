@@ -0,0 +1,119 @@
+// Copyright (c) 2011 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef CHROME_BROWSER_HISTORY_IN_MEMORY_URL_INDEX_IMAGE_H_
+#define CHROME_BROWSER_HISTORY_IN_MEMORY_URL_INDEX_IMAGE_H_
+#pragma once
+
+#include <map>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/string16.h"
+#include "base/time.h"
+#include "chrome/browser/history/history_types.h"
+
+class FilePath;
+
+namespace history {
+
+// A read-only image of the InMemoryURLIndex in a flat, versioned file which
+// is memory mapped and searched in place, so that restoring the index at
+// startup costs a few validity checks instead of parsing and rebuilding every
+// container. Posting lists are handed out as pointers into the mapping.
+//
+// The file starts with a header giving the counts and the location of each
+// section. Sections are arrays of fixed size entries, aligned to eight bytes
+// and in native byte order; an image written by a different version, or one
+// that fails validation, is not opened.
+class InMemoryURLIndexImage {
+ public:
+  // Everything an image holds, as the index keeps it in memory. Word IDs are
+  // indexes into |words| and |word_history_ids|, and all posting lists are
+  // sorted.
+  struct Contents {
+    Contents();
+    ~Contents();
+
+    base::Time timestamp;
+    int history_item_count;
+    std::vector<string16> words;
+    std::map<char16, std::vector<int> > char_word_ids;
+    std::vector<std::vector<URLID> > word_history_ids;
+    std::map<URLID, URLRow> rows;
+  };
+
+  ~InMemoryURLIndexImage();
+
+  // Writes |contents| to a new image at |path|, replacing any existing file
+  // only once the new one is complete.
+  static bool Write(const FilePath& path, const Contents& contents);
+
+  // Maps the image at |path|. Returns NULL if there is none or if it is not
+  // a valid image of the current version.
+  static InMemoryURLIndexImage* Open(const FilePath& path);
+
+  base::Time timestamp() const;
+  int history_item_count() const;
+  size_t word_count() const;
+  size_t file_size() const { return length_; }
+
+  // Returns the word with |word_id|, which must be below word_count().
+  string16 GetWord(int word_id) const;
+
+  // Returns the ID of |word|, or -1 if the image does not have it.
+  int FindWord(const string16& word) const;
+
+  // Appends the characters having a posting list to |chars|, in order.
+  void GetChars(std::vector<char16>* chars) const;
+
+  // Return the sorted posting list of words containing |uni_char| and of the
+  // history items containing the word |word_id|, setting |count| to their
+  // length. The pointers stay valid for the life of the image.
+  const int32* WordIDsForChar(char16 uni_char, size_t* count) const;
+  const int64* HistoryIDsForWord(int word_id, size_t* count) const;
+
+  // Looks up the row of |history_id|, returning false if there is none.
+  bool GetRow(URLID history_id, URLRow* row) const;
+  bool HasRow(URLID history_id) const;
+
+  // Rows in order of their history IDs.
+  size_t row_count() const;
+  void GetRowAt(size_t index, URLRow* row) const;
+
+ private:
+  struct Header;
+  struct CharEntry;
+  struct RowEntry;
+
+  InMemoryURLIndexImage();
+
+  // Checks the header, the bounds of every section and offset table, that
+  // every word ID is below word_count(), and that the words, the posting
+  // lists, the characters and the rows are in strictly increasing order, so
+  // that the accessors need no checks of their own.
+  bool Validate() const;
+
+  const Header* header() const;
+
+  // Returns the start of section |section| as an array of T.
+  template <typename T>
+  const T* Section(int section) const;
+
+  // Returns the number of T in section |section|.
+  template <typename T>
+  size_t SectionLength(int section) const;
+
+  const RowEntry* FindRow(URLID history_id) const;
+  void RowFromEntry(const RowEntry& entry, URLRow* row) const;
+
+  uint8* data_;
+  size_t length_;
+
+  DISALLOW_COPY_AND_ASSIGN(InMemoryURLIndexImage);
+};
+
+}  // namespace history
+
+#endif  // CHROME_BROWSER_HISTORY_IN_MEMORY_URL_INDEX_IMAGE_H_
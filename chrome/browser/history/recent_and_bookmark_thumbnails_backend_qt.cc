@@ -12,6 +12,7 @@
 #include "base/string_util.h"
 #include "base/time.h"
 #include "chrome/browser/history/recent_and_bookmark_thumbnails_backend_qt.h"
+#include "chrome/browser/history/thumbnail_blob_store_qt.h"
 #include "chrome/browser/history/thumbnail_database_qt.h"
 #include "content/browser/browser_thread.h"
 #include "chrome/browser/history/history_marshaling.h"
@@ -20,14 +21,25 @@ using base::TimeTicks;
 
 namespace history {
 
-RecentAndBookmarkThumbnailsBackendQt::RecentAndBookmarkThumbnailsBackendQt() {
+// Queued thumbnails are written at most this long after they arrive.
+static const int kFlushDelayMs = 2000;
+
+// Queued thumbnails are written right away once there are this many, to
+// bound the memory held by the queue.
+static const size_t kMaxPendingThumbnails = 16;
+
+RecentAndBookmarkThumbnailsBackendQt::RecentAndBookmarkThumbnailsBackendQt(
+    scoped_refptr<ThumbnailBlobStore> blob_store)
+    : blob_store_(blob_store),
+      flush_scheduled_(false),
+      compaction_scheduled_(false) {
 
 }
 
 RecentAndBookmarkThumbnailsBackendQt::~RecentAndBookmarkThumbnailsBackendQt() {
   DLOG(INFO)<<__FUNCTION__;
   if (thumbnail_db_.get()) {
-    thumbnail_db_->CommitTransaction();
+    FlushPendingThumbnails();
     thumbnail_db_.reset();
   }
 }
@@ -44,9 +56,9 @@ void RecentAndBookmarkThumbnailsBackendQt::Init(const FilePath& path) {
     thumbnail_db_.reset();
   }
 
-  if (thumbnail_db_.get()) {
-    thumbnail_db_->BeginTransaction();
-  }
+  if (blob_store_.get() &&
+      !blob_store_->Init(FilePath(path.value() + FILE_PATH_LITERAL("-blobs"))))
+    LOG(WARNING) << "Could not initialize the thumbnail blob store.";
 }
 
 void RecentAndBookmarkThumbnailsBackendQt::Shutdown() {
@@ -62,31 +74,112 @@ void RecentAndBookmarkThumbnailsBackendQt::CleanUnusedThumbnails(std::vector<GUR
     DLOG(INFO)<<list_url[i].spec();
   }
   
+  if (!thumbnail_db_.get())
+    return;
+
+  // Count the queued thumbnails too.
+  FlushPendingThumbnails();
+
   int saved_count = thumbnail_db_->ThumbnailsCountExcludeBookmarked();
   DLOG(INFO)<<"num in DB: " << saved_count;
   if(saved_count < kRecThumbnailMaxNum)
     return;
   
   thumbnail_db_->CleanUnusedThumbnails(list_url);
+
+  std::set<std::string> urls;
+  if (blob_store_.get() && thumbnail_db_->GetThumbnailURLs(&urls))
+    blob_store_->RetainOnly(urls);
 }
 
 void RecentAndBookmarkThumbnailsBackendQt::SetPageThumbnail(const GURL& url,
-                        				const SkBitmap& thumbnail) {
+                        				const SkBitmap& thumbnail,
+                        				int64 sequence) {
   DLOG(INFO)<<__FUNCTION__;
   if (!thumbnail_db_.get())
     return;
 
-  //if(thumbnail_db_->IsThumbnailValid(url))
-  //  return;
+  scoped_refptr<RefCountedBytes> jpeg_data(new RefCountedBytes);
+  if (!ThumbnailDatabaseQt::EncodeThumbnail(thumbnail, &jpeg_data->data))
+    return;
+  SetPageThumbnailData(url, jpeg_data,
+                       ThumbnailBlobStore::ScaleForGrid(thumbnail), sequence);
+}
 
-  if(thumbnail_db_->HasThisPage(url)) {
-    thumbnail_db_->SetPageThumbnail(url, thumbnail);
-  }else{
-    bool default_bookmarked_state = false;
-    thumbnail_db_->InsertNewRow(url, default_bookmarked_state, thumbnail);
+void RecentAndBookmarkThumbnailsBackendQt::SetPageThumbnailData(
+    const GURL& url,
+    scoped_refptr<RefCountedBytes> jpeg_data,
+    const SkBitmap& grid_thumbnail,
+    int64 sequence) {
+  DLOG(INFO)<<__FUNCTION__;
+  if (!thumbnail_db_.get() || !jpeg_data.get() || jpeg_data->data.empty())
+    return;
+
+  ThumbnailSequences::iterator last = thumbnail_sequences_.find(url);
+  if (last != thumbnail_sequences_.end()) {
+    if (sequence < last->second)
+      return;  // A newer thumbnail of the page was set already.
+    last->second = sequence;
+  } else {
+    thumbnail_sequences_[url] = sequence;
+  }
+
+  PendingThumbnail& pending = pending_thumbnails_[url];
+  pending.jpeg_data = jpeg_data;
+  pending.grid_thumbnail = grid_thumbnail;
+
+  if (pending_thumbnails_.size() >= kMaxPendingThumbnails) {
+    FlushPendingThumbnails();
+    return;
+  }
+
+  if (!flush_scheduled_) {
+    flush_scheduled_ = true;
+    MessageLoop::current()->PostDelayedTask(FROM_HERE,
+        NewRunnableMethod(this,
+            &RecentAndBookmarkThumbnailsBackendQt::FlushPendingThumbnails),
+        kFlushDelayMs);
   }
 }
 
+void RecentAndBookmarkThumbnailsBackendQt::FlushPendingThumbnails() {
+  flush_scheduled_ = false;
+  if (!thumbnail_db_.get() || pending_thumbnails_.empty())
+    return;
+
+  TimeTicks beginning_time = TimeTicks::Now();
+
+  ThumbnailBlobStore::ThumbnailList grid_thumbnails;
+  thumbnail_db_->BeginTransaction();
+  for (PendingThumbnails::const_iterator it = pending_thumbnails_.begin();
+       it != pending_thumbnails_.end(); ++it) {
+    thumbnail_db_->SetPageThumbnailData(it->first,
+                                        it->second.jpeg_data->data);
+    if (!it->second.grid_thumbnail.isNull()) {
+      grid_thumbnails.push_back(
+          std::make_pair(it->first, it->second.grid_thumbnail));
+    }
+  }
+  thumbnail_db_->CommitTransaction();
+
+  if (blob_store_.get() && !grid_thumbnails.empty()) {
+    blob_store_->AddThumbnails(grid_thumbnails);
+    if (!compaction_scheduled_ && blob_store_->NeedsCompaction()) {
+      // Rewriting the file takes a while, let queued requests go first.
+      compaction_scheduled_ = true;
+      MessageLoop::current()->PostTask(FROM_HERE,
+          NewRunnableMethod(this,
+              &RecentAndBookmarkThumbnailsBackendQt::CompactBlobStore));
+    }
+  }
+
+  UMA_HISTOGRAM_COUNTS_100("History.RecentThumbnailsBatchSize",
+                           pending_thumbnails_.size());
+  UMA_HISTOGRAM_TIMES("History.RecentThumbnailsBatchWrite",
+                      TimeTicks::Now() - beginning_time);
+  pending_thumbnails_.clear();
+}
+
 void RecentAndBookmarkThumbnailsBackendQt::SetBookmarkedPage(
 						const GURL& url, 
 						bool bookmarked) {
@@ -120,6 +213,14 @@ void RecentAndBookmarkThumbnailsBackendQt::GetPageThumbnailDirectly(
     const GURL& page_url,
     scoped_refptr<RefCountedBytes>* data) {
   DLOG(INFO)<<__FUNCTION__;
+  // A thumbnail still waiting for its write is the newest one.
+  PendingThumbnails::const_iterator pending =
+      pending_thumbnails_.find(page_url);
+  if (pending != pending_thumbnails_.end()) {
+    *data = new RefCountedBytes(pending->second.jpeg_data->data);
+    return;
+  }
+
   if (thumbnail_db_.get()) {
     *data = new RefCountedBytes;
 
@@ -137,6 +238,17 @@ void RecentAndBookmarkThumbnailsBackendQt::GetPageThumbnailDirectly(
 }
 
 
+void RecentAndBookmarkThumbnailsBackendQt::CompactBlobStore() {
+  compaction_scheduled_ = false;
+  if (!blob_store_.get() || !blob_store_->NeedsCompaction())
+    return;
+
+  TimeTicks beginning_time = TimeTicks::Now();
+  blob_store_->Compact();
+  UMA_HISTOGRAM_TIMES("History.RecentThumbnailsCompaction",
+                      TimeTicks::Now() - beginning_time);
+}
+
 void RecentAndBookmarkThumbnailsBackendQt::ResetDatabase() {
   DLOG(INFO)<<__FUNCTION__;
 
@@ -6,12 +6,17 @@
 #define CHROME_BROWSER_HISTORY_RECENT_AND_BOOKMARK_THUMBNAILS_BACKEND_QT_H_
 #pragma once
 
+#include <map>
+#include <vector>
+
 #include "base/file_path.h"
 #include "base/memory/ref_counted.h"
 #include "base/scoped_ptr.h"
 #include "chrome/browser/history/history_types.h"
 #include "content/browser/cancelable_request.h"
 #include "chrome/browser/history/history_marshaling.h"
+#include "googleurl/src/gurl.h"
+#include "third_party/skia/include/core/SkBitmap.h"
 
 class FilePath;
 class GURL;
@@ -19,6 +24,7 @@ class SkBitmap;
 
 namespace history {
 
+class ThumbnailBlobStore;
 class ThumbnailDatabaseQt;
 
 // Service used by TopSites to have db interaction happen on the DB thread.  All
@@ -28,8 +34,13 @@ class RecentAndBookmarkThumbnailsBackendQt
     :   public base::RefCountedThreadSafe<RecentAndBookmarkThumbnailsBackendQt>, 
 	public CancelableRequestProvider {
  public:
-  RecentAndBookmarkThumbnailsBackendQt();
+  // Thumbnails are also kept decoded in |blob_store|, which the UI reads
+  // directly.
+  explicit RecentAndBookmarkThumbnailsBackendQt(
+      scoped_refptr<ThumbnailBlobStore> blob_store);
 
+  // Writes the queued thumbnails, so the last reference must be released on
+  // the DB thread.
   ~RecentAndBookmarkThumbnailsBackendQt();
 
   void Init(const FilePath& path);
@@ -37,16 +48,32 @@ class RecentAndBookmarkThumbnailsBackendQt
   // Schedules the db to be shutdown.
   void Shutdown();
 
-  // Sets the thumbnail.
+  // Sets the thumbnail, encoding it on the DB thread. |sequence| orders the
+  // thumbnails set for a page, see SetPageThumbnailData().
   void SetPageThumbnail(const GURL& url,
-                        const SkBitmap& thumbnail);
+                        const SkBitmap& thumbnail,
+                        int64 sequence);
+
+  // Sets the thumbnail from JPEG data encoded elsewhere, and the copy scaled
+  // for the grid with ThumbnailBlobStore::ScaleForGrid(). The write is queued
+  // and committed together with other pending thumbnails. Thumbnails encoded
+  // in parallel can arrive out of order, so one with a lower |sequence| than
+  // the last thumbnail set for |url| is dropped.
+  void SetPageThumbnailData(const GURL& url,
+                            scoped_refptr<RefCountedBytes> jpeg_data,
+                            const SkBitmap& grid_thumbnail,
+                            int64 sequence);
+
+  // Writes all queued thumbnails in one transaction.
+  void FlushPendingThumbnails();
 
   void GetPageThumbnail(scoped_refptr<GetPageThumbnailRequest> request,
                         const GURL& page_url);
 
   void SetBookmarkedPage(const GURL& url, bool bookmarked);
  
-  // 
+  // Drops the thumbnails of pages that are not bookmarked and not in
+  // |list_url| once the database holds more than kRecThumbnailMaxNum.
   void CleanUnusedThumbnails(std::vector<GURL> list_url);
 
   // Deletes the database and recreates it.
@@ -55,10 +82,34 @@ class RecentAndBookmarkThumbnailsBackendQt
  private:
   void GetPageThumbnailDirectly(const GURL& page_url, scoped_refptr<RefCountedBytes>* data);
 
+  // Drops dead records from the blob store.
+  void CompactBlobStore();
+
   FilePath db_path_;
 
   scoped_ptr<ThumbnailDatabaseQt> thumbnail_db_;
 
+  scoped_refptr<ThumbnailBlobStore> blob_store_;
+
+  // Thumbnails waiting for the next batched write. A newer thumbnail for the
+  // same page replaces the queued one.
+  struct PendingThumbnail {
+    scoped_refptr<RefCountedBytes> jpeg_data;
+    SkBitmap grid_thumbnail;
+  };
+  typedef std::map<GURL, PendingThumbnail> PendingThumbnails;
+  PendingThumbnails pending_thumbnails_;
+
+  // The sequence number of the last thumbnail set for each page.
+  typedef std::map<GURL, int64> ThumbnailSequences;
+  ThumbnailSequences thumbnail_sequences_;
+
+  // Whether a delayed FlushPendingThumbnails is posted.
+  bool flush_scheduled_;
+
+  // Whether a CompactBlobStore is posted.
+  bool compaction_scheduled_;
+
   DISALLOW_COPY_AND_ASSIGN(RecentAndBookmarkThumbnailsBackendQt);
 };
 
@@ -9,12 +9,14 @@
 #include "base/string_util.h"
 #include "base/task.h"
 #include "base/threading/thread.h"
+#include "base/threading/worker_pool.h"
 #include "base/file_path.h"
 #include "base/utf_string_conversions.h"
 #include "content/browser/cancelable_request.h"
 #include "chrome/browser/history/history.h"
 #include "chrome/browser/history/recent_and_bookmark_thumbnails_qt.h"
 #include "chrome/browser/history/recent_and_bookmark_thumbnails_backend_qt.h"
+#include "chrome/browser/history/thumbnail_database_qt.h"
 #include "chrome/browser/profiles/profile.h"
 #include "chrome/common/url_constants.h"
 #include "third_party/skia/include/core/SkBitmap.h"
@@ -25,10 +27,43 @@ namespace history {
 
 static const char* kRecThumbnailThreadName = "Chrome_RecThumbnailThread";
 
+// static
+void RecentAndBookmarkThumbnailsQt::EncodeThumbnailOnWorker(
+    RecentAndBookmarkThumbnailsQt* owner,
+    scoped_refptr<base::MessageLoopProxy> db_loop,
+    RecentAndBookmarkThumbnailsBackendQt* backend,
+    const GURL& url,
+    const SkBitmap& thumbnail,
+    int64 sequence) {
+  scoped_refptr<RefCountedBytes> jpeg_data(new RefCountedBytes);
+  if (ThumbnailDatabaseQt::EncodeThumbnail(thumbnail, &jpeg_data->data)) {
+    db_loop->PostTask(FROM_HERE,
+        NewRunnableMethod(backend,
+            &RecentAndBookmarkThumbnailsBackendQt::SetPageThumbnailData,
+            url, jpeg_data, ThumbnailBlobStore::ScaleForGrid(thumbnail),
+            sequence));
+  }
+  // The backend writes to the database when it is destroyed, so it must not
+  // be destroyed here.
+  db_loop->ReleaseSoon(FROM_HERE, backend);
+  owner->EncodeFinished();
+}
+
+void RecentAndBookmarkThumbnailsQt::EncodeFinished() {
+  base::AutoLock lock(encode_lock_);
+  DCHECK_GT(pending_encodes_, 0);
+  if (--pending_encodes_ == 0)
+    encodes_finished_.Broadcast();
+}
+
 RecentAndBookmarkThumbnailsQt::RecentAndBookmarkThumbnailsQt(Profile* profile)
     : thread_(new base::Thread(kRecThumbnailThreadName)),
+      next_thumbnail_sequence_(0),
+      pending_encodes_(0),
+      encodes_finished_(&encode_lock_),
       first_launch_(true),
-      profile_(profile) {
+      profile_(profile),
+      blob_store_(new ThumbnailBlobStore) {
   DLOG(INFO)<<__FUNCTION__;
   backend_ = NULL;
 }
@@ -46,7 +81,9 @@ void RecentAndBookmarkThumbnailsQt::UnloadBackend() {
 
   //Task* closing_task =
   //    NewRunnableMethod(backend_.get(), &RecentAndBookmarkThumbnailsBackendQt::Closing);
-  backend_ = NULL;
+  // The backend flushes to the database when it is destroyed, so the last
+  // reference must go away on the thumbnail thread.
+  thread_->message_loop()->ReleaseSoon(FROM_HERE, backend_.release());
   //ScheduleTask(PRIORITY_NORMAL, closing_task);
 }
 
@@ -60,6 +97,15 @@ void RecentAndBookmarkThumbnailsQt::Cleanup() {
   BookmarkModel* model = profile_->GetBookmarkModel();
   if (model)
     model->RemoveObserver(this);
+
+  // Wait for the encodes on the worker pool first: they hold references to
+  // the backend and post its writes to the thumbnail thread.
+  {
+    base::AutoLock lock(encode_lock_);
+    while (pending_encodes_ > 0)
+      encodes_finished_.Wait();
+  }
+
   // Unload the backend.
   UnloadBackend();
 
@@ -197,8 +243,39 @@ void RecentAndBookmarkThumbnailsQt::SetRecentPageThumbnail(
   if (!HistoryService::CanAddURL(page_url)) 
     return; 
 
-  ScheduleAndForget(PRIORITY_NORMAL, &RecentAndBookmarkThumbnailsBackendQt::SetPageThumbnail,
-                    page_url, thumbnail);
+  DCHECK(thread_) << "History service being called after cleanup";
+  LoadBackendIfNecessary();
+
+  // The bitmap is copied so that the worker owns its pixels.
+  SkBitmap thumbnail_copy;
+  if (!thumbnail.copyTo(&thumbnail_copy, SkBitmap::kARGB_8888_Config))
+    return;
+
+  // Thumbnails are encoded in parallel on the worker pool, so the encode of
+  // an older thumbnail of the page may finish last. The sequence number lets
+  // the backend keep the newest.
+  int64 sequence = next_thumbnail_sequence_++;
+  {
+    base::AutoLock lock(encode_lock_);
+    ++pending_encodes_;
+  }
+  // Released by the worker, on the thumbnail thread.
+  backend_->AddRef();
+  if (!base::WorkerPool::PostTask(FROM_HERE,
+          NewRunnableFunction(&EncodeThumbnailOnWorker, this,
+                              thread_->message_loop_proxy(), backend_.get(),
+                              page_url, thumbnail_copy, sequence),
+          false)) {
+    backend_->Release();
+    {
+      base::AutoLock lock(encode_lock_);
+      --pending_encodes_;
+    }
+    // Fall back to encoding on the thumbnail thread.
+    ScheduleAndForget(PRIORITY_NORMAL,
+                      &RecentAndBookmarkThumbnailsBackendQt::SetPageThumbnail,
+                      page_url, thumbnail_copy, sequence);
+  }
 }
 
 // Insert new row with thumbnail = null.
@@ -225,6 +302,11 @@ RecentAndBookmarkThumbnailsQt::Handle RecentAndBookmarkThumbnailsQt::GetRecentPa
                   new history::GetPageThumbnailRequest(callback), page_url);
 }
 
+scoped_refptr<ThumbnailBlobStore::Snapshot>
+RecentAndBookmarkThumbnailsQt::GetThumbnailSnapshot() {
+  return blob_store_->GetSnapshot();
+}
+
 void RecentAndBookmarkThumbnailsQt::ScheduleTask(SchedulePriority priority,
                                   Task* task) {
   // TODO(brettw): do prioritization.
@@ -256,7 +338,7 @@ void RecentAndBookmarkThumbnailsQt::LoadBackendIfNecessary() {
   if (!thread_ || backend_)
     return;  // Failed to init, or already started loading.
   scoped_refptr<RecentAndBookmarkThumbnailsBackendQt> backend(
-      new RecentAndBookmarkThumbnailsBackendQt());
+      new RecentAndBookmarkThumbnailsBackendQt(blob_store_));
   backend_.swap(backend);
   // Launch in Backend Thread.
   DLOG(INFO)<<__FUNCTION__<<"call init";
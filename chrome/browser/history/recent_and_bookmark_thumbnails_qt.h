@@ -15,6 +15,7 @@
 #include "base/gtest_prod_util.h"
 #include "base/memory/ref_counted.h"
 #include "base/memory/ref_counted_memory.h"
+#include "base/synchronization/condition_variable.h"
 #include "base/synchronization/lock.h"
 #include "base/time.h"
 #include "base/timer.h"
@@ -24,12 +25,14 @@
 #include "chrome/browser/sessions/tab_restore_service_observer.h"
 #include "chrome/browser/bookmarks/bookmark_model.h"
 #include "chrome/browser/bookmarks/bookmark_model_observer.h"
+#include "chrome/browser/history/thumbnail_blob_store_qt.h"
 
 class FilePath;
 class SkBitmap;
 class TabRestoreService;
 
 namespace base {
+class MessageLoopProxy;
 class Thread;
 }
 
@@ -68,6 +71,12 @@ class RecentAndBookmarkThumbnailsQt
                           CancelableRequestConsumerBase* consumer,
                           ThumbnailDataCallback* callback);
 
+  // Returns the decoded thumbnails as they are now, for showing a whole grid
+  // without a request per page. Pages missing from the snapshot, e.g. with a
+  // thumbnail still being written, can still be requested with
+  // GetRecentPageThumbnail(). May return NULL.
+  scoped_refptr<ThumbnailBlobStore::Snapshot> GetThumbnailSnapshot();
+
   // Update bookmark column in database. Or add a new row in database if the
   // item doesn't exist. Will set the thumbnail data when page load complete.
   void SetBookmarkPage(const GURL& url, bool bookmarked);
@@ -102,6 +111,19 @@ class RecentAndBookmarkThumbnailsQt
     PRIORITY_LOW,     // Low priority things like indexing or expiration.
   };
  private:
+  // Runs on a worker thread: encodes |thumbnail| and hands the JPEG data to
+  // |backend| on |db_loop|, then releases the reference to |backend| there.
+  static void EncodeThumbnailOnWorker(
+      RecentAndBookmarkThumbnailsQt* owner,
+      scoped_refptr<base::MessageLoopProxy> db_loop,
+      RecentAndBookmarkThumbnailsBackendQt* backend,
+      const GURL& url,
+      const SkBitmap& thumbnail,
+      int64 sequence);
+
+  // Called on a worker thread when an encode is done.
+  void EncodeFinished();
+
   void UnloadBackend();
 
   void Cleanup();
@@ -276,6 +298,16 @@ class RecentAndBookmarkThumbnailsQt
 
   // The thread used by the history service to run complicated operations
   base::Thread* thread_;
+
+  // Numbers the thumbnails handed to SetRecentPageThumbnail(), so that the
+  // backend can drop those whose encode finished after a newer one's.
+  int64 next_thumbnail_sequence_;
+
+  // The encodes running on the worker pool, which Cleanup() waits for before
+  // unloading the backend. Guarded by |encode_lock_|.
+  int pending_encodes_;
+  base::Lock encode_lock_;
+  base::ConditionVariable encodes_finished_;
   
   Profile* profile_;
 
@@ -287,6 +319,9 @@ class RecentAndBookmarkThumbnailsQt
 
   scoped_refptr<RecentAndBookmarkThumbnailsBackendQt> backend_;
 
+  // Written on the thumbnail thread, read here.
+  scoped_refptr<ThumbnailBlobStore> blob_store_;
+
   DISALLOW_COPY_AND_ASSIGN(RecentAndBookmarkThumbnailsQt);
 };
 
@@ -0,0 +1,393 @@
+// Copyright (c) 2011 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "chrome/browser/history/thumbnail_blob_store_qt.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "base/eintr_wrapper.h"
+#include "base/file_util.h"
+#include "base/logging.h"
+#include "googleurl/src/gurl.h"
+#include "skia/ext/image_operations.h"
+#include "third_party/skia/include/core/SkBitmap.h"
+
+namespace history {
+
+namespace {
+
+const uint32 kFileMagic = 0x53425452;  // 'RTBS'
+const uint32 kFileVersion = 1;
+const uint32 kRecordMagic = 0x43455254;  // 'TREC'
+
+struct FileHeader {
+  uint32 magic;
+  uint32 version;
+};
+
+// Followed by the URL, padded to a multiple of four bytes so the pixels stay
+// aligned, and |width| * |height| pixels. A record with no pixels removes
+// the URL.
+struct RecordHeader {
+  uint32 magic;
+  uint32 url_length;
+  int32 width;
+  int32 height;
+};
+
+// Largest dimension accepted when reading records back.
+const int kMaxDimension = 1024;
+
+// Dead records are compacted away once they take more than this and more
+// than the live records.
+const size_t kMinCompactionSize = 1024 * 1024;
+
+size_t PaddedLength(size_t length) {
+  return (length + 3) & ~static_cast<size_t>(3);
+}
+
+size_t PixelsSize(int width, int height) {
+  return static_cast<size_t>(width) * height * 4;
+}
+
+size_t RecordSize(size_t url_length, int width, int height) {
+  return sizeof(RecordHeader) + PaddedLength(url_length) +
+      PixelsSize(width, height);
+}
+
+bool WriteAll(FILE* file, const void* data, size_t length) {
+  return length == 0 || fwrite(data, 1, length, file) == length;
+}
+
+}  // namespace
+
+ThumbnailBlobStore::Snapshot::Snapshot()
+    : data_(NULL),
+      length_(0) {
+}
+
+ThumbnailBlobStore::Snapshot::~Snapshot() {
+  if (data_)
+    munmap(data_, length_);
+}
+
+bool ThumbnailBlobStore::Snapshot::Map(const FilePath& path, size_t length) {
+  DCHECK(!data_);
+  if (length == 0)
+    return true;
+
+  int fd = HANDLE_EINTR(open(path.value().c_str(), O_RDONLY));
+  if (fd < 0)
+    return false;
+  void* data = mmap(NULL, length, PROT_READ, MAP_SHARED, fd, 0);
+  // The mapping outlives the descriptor.
+  HANDLE_EINTR(close(fd));
+  if (data == MAP_FAILED) {
+    LOG(ERROR) << "Couldn't mmap " << path.value() << ", errno " << errno;
+    return false;
+  }
+
+  data_ = static_cast<uint8*>(data);
+  length_ = length;
+  return true;
+}
+
+const uint8* ThumbnailBlobStore::Snapshot::GetThumbnail(const GURL& url,
+                                                        int* width,
+                                                        int* height) const {
+  Index::const_iterator it = index_.find(url.spec());
+  if (it == index_.end())
+    return NULL;
+  *width = it->second.width;
+  *height = it->second.height;
+  return data_ + it->second.offset;
+}
+
+ThumbnailBlobStore::ThumbnailBlobStore()
+    : file_size_(0),
+      live_size_(0) {
+}
+
+ThumbnailBlobStore::~ThumbnailBlobStore() {
+}
+
+bool ThumbnailBlobStore::Init(const FilePath& path) {
+  path_ = path;
+  if (Load())
+    return true;
+
+  // Start over with an empty file if the old one is unusable.
+  LOG(WARNING) << "Recreating thumbnail blob store " << path.value();
+  FILE* file = file_util::OpenFile(path_, "wb");
+  if (!file)
+    return false;
+  FileHeader header = { kFileMagic, kFileVersion };
+  bool written = WriteAll(file, &header, sizeof(header));
+  file_util::CloseFile(file);
+  if (!written)
+    return false;
+
+  index_.clear();
+  file_size_ = sizeof(header);
+  live_size_ = 0;
+  return Publish();
+}
+
+bool ThumbnailBlobStore::Load() {
+  int64 file_size = 0;
+  if (!file_util::GetFileSize(path_, &file_size) ||
+      file_size < static_cast<int64>(sizeof(FileHeader)))
+    return false;
+
+  scoped_refptr<Snapshot> snapshot(new Snapshot);
+  if (!snapshot->Map(path_, static_cast<size_t>(file_size)))
+    return false;
+
+  const uint8* data = snapshot->data_;
+  const size_t length = snapshot->length_;
+  const FileHeader* file_header = reinterpret_cast<const FileHeader*>(data);
+  if (file_header->magic != kFileMagic || file_header->version != kFileVersion)
+    return false;
+
+  Snapshot::Index index;
+  size_t live_size = 0;
+  size_t offset = sizeof(FileHeader);
+  while (offset + sizeof(RecordHeader) <= length) {
+    const RecordHeader* record =
+        reinterpret_cast<const RecordHeader*>(data + offset);
+    if (record->magic != kRecordMagic ||
+        record->width < 0 || record->width > kMaxDimension ||
+        record->height < 0 || record->height > kMaxDimension)
+      break;
+    size_t record_size =
+        RecordSize(record->url_length, record->width, record->height);
+    if (record->url_length > length || record_size > length - offset)
+      break;
+
+    std::string url(reinterpret_cast<const char*>(record + 1),
+                    record->url_length);
+    Snapshot::Index::iterator old = index.find(url);
+    if (old != index.end()) {
+      live_size -= RecordSize(url.size(), old->second.width,
+                              old->second.height);
+      index.erase(old);
+    }
+    if (record->width > 0 && record->height > 0) {
+      Snapshot::Entry& entry = index[url];
+      entry.offset = offset + sizeof(RecordHeader) +
+          PaddedLength(record->url_length);
+      entry.width = record->width;
+      entry.height = record->height;
+      live_size += record_size;
+    }
+    offset += record_size;
+  }
+
+  index_ = index;
+  file_size_ = offset;
+  live_size_ = live_size;
+
+  if (offset != length) {
+    // Drop the partial record a crash left behind so appends follow the
+    // last good one.
+    LOG(WARNING) << "Truncating thumbnail blob store at " << offset;
+    snapshot = NULL;
+    if (HANDLE_EINTR(truncate(path_.value().c_str(), offset)) != 0)
+      return false;
+    return Publish();
+  }
+
+  snapshot->index_ = index_;
+  base::AutoLock lock(lock_);
+  snapshot_ = snapshot;
+  return true;
+}
+
+bool ThumbnailBlobStore::AppendRecord(FILE* file,
+                                      const std::string& url,
+                                      int width,
+                                      int height,
+                                      const uint8* pixels) {
+  RecordHeader header = { kRecordMagic, url.size(), width, height };
+  static const char kPadding[4] = { 0 };
+  size_t padding = PaddedLength(url.size()) - url.size();
+  if (!WriteAll(file, &header, sizeof(header)) ||
+      !WriteAll(file, url.data(), url.size()) ||
+      !WriteAll(file, kPadding, padding) ||
+      !WriteAll(file, pixels, PixelsSize(width, height)))
+    return false;
+
+  size_t record_size = RecordSize(url.size(), width, height);
+  Snapshot::Index::iterator old = index_.find(url);
+  if (old != index_.end()) {
+    live_size_ -= RecordSize(url.size(), old->second.width,
+                             old->second.height);
+    index_.erase(old);
+  }
+  if (width > 0 && height > 0) {
+    Snapshot::Entry& entry = index_[url];
+    entry.offset = file_size_ + sizeof(RecordHeader) +
+        PaddedLength(url.size());
+    entry.width = width;
+    entry.height = height;
+    live_size_ += record_size;
+  }
+  file_size_ += record_size;
+  return true;
+}
+
+bool ThumbnailBlobStore::AddThumbnails(const ThumbnailList& thumbnails) {
+  if (path_.empty() || thumbnails.empty())
+    return false;
+
+  FILE* file = file_util::OpenFile(path_, "ab");
+  if (!file)
+    return false;
+
+  bool written = true;
+  for (size_t i = 0; i < thumbnails.size() && written; ++i) {
+    const SkBitmap& bitmap = thumbnails[i].second;
+    if (bitmap.isNull() || bitmap.config() != SkBitmap::kARGB_8888_Config ||
+        bitmap.width() > kMaxDimension || bitmap.height() > kMaxDimension)
+      continue;
+
+    SkAutoLockPixels lock(bitmap);
+    if (bitmap.rowBytes() == static_cast<size_t>(bitmap.width()) * 4) {
+      written = AppendRecord(file, thumbnails[i].first.spec(),
+                             bitmap.width(), bitmap.height(),
+                             static_cast<const uint8*>(bitmap.getPixels()));
+    } else {
+      // Rows with padding are packed first.
+      std::vector<uint8> pixels(PixelsSize(bitmap.width(), bitmap.height()));
+      for (int y = 0; y < bitmap.height(); ++y) {
+        memcpy(&pixels[y * bitmap.width() * 4], bitmap.getAddr32(0, y),
+               bitmap.width() * 4);
+      }
+      written = AppendRecord(file, thumbnails[i].first.spec(),
+                             bitmap.width(), bitmap.height(), &pixels[0]);
+    }
+  }
+
+  if (!file_util::CloseFile(file))
+    written = false;
+  if (!written) {
+    // The file may end in a partial record now; reload to drop it.
+    Load();
+    return false;
+  }
+  return Publish();
+}
+
+bool ThumbnailBlobStore::RetainOnly(const std::set<std::string>& urls) {
+  std::vector<std::string> removed;
+  for (Snapshot::Index::const_iterator it = index_.begin();
+       it != index_.end(); ++it) {
+    if (urls.find(it->first) == urls.end())
+      removed.push_back(it->first);
+  }
+  if (removed.empty())
+    return true;
+
+  FILE* file = file_util::OpenFile(path_, "ab");
+  if (!file)
+    return false;
+  bool written = true;
+  for (size_t i = 0; i < removed.size() && written; ++i)
+    written = AppendRecord(file, removed[i], 0, 0, NULL);
+  if (!file_util::CloseFile(file))
+    written = false;
+  if (!written) {
+    Load();
+    return false;
+  }
+  return Publish();
+}
+
+bool ThumbnailBlobStore::NeedsCompaction() const {
+  size_t dead_size = file_size_ - sizeof(FileHeader) - live_size_;
+  return dead_size > kMinCompactionSize && dead_size > live_size_;
+}
+
+bool ThumbnailBlobStore::Compact() {
+  scoped_refptr<Snapshot> snapshot = GetSnapshot();
+  if (!snapshot.get())
+    return false;
+
+  // Write the live records to a new file and swap it in. Snapshots taken
+  // before keep mapping the old file until they are released.
+  FilePath compact_path(path_.value() + FILE_PATH_LITERAL("-compact"));
+  FILE* file = file_util::OpenFile(compact_path, "wb");
+  if (!file)
+    return false;
+
+  Snapshot::Index live_index;
+  live_index.swap(index_);
+  const size_t old_file_size = file_size_;
+  const size_t old_live_size = live_size_;
+  file_size_ = sizeof(FileHeader);
+  live_size_ = 0;
+
+  FileHeader header = { kFileMagic, kFileVersion };
+  bool written = WriteAll(file, &header, sizeof(header));
+  for (Snapshot::Index::const_iterator it = live_index.begin();
+       it != live_index.end() && written; ++it) {
+    written = AppendRecord(file, it->first, it->second.width,
+                           it->second.height,
+                           snapshot->data_ + it->second.offset);
+  }
+  if (!file_util::CloseFile(file))
+    written = false;
+
+  if (!written || !file_util::ReplaceFile(compact_path, path_)) {
+    file_util::Delete(compact_path, false);
+    index_.swap(live_index);
+    file_size_ = old_file_size;
+    live_size_ = old_live_size;
+    return false;
+  }
+
+  DLOG(INFO) << "Compacted thumbnail blob store from " << old_file_size
+             << " to " << file_size_ << " bytes";
+  return Publish();
+}
+
+bool ThumbnailBlobStore::Publish() {
+  scoped_refptr<Snapshot> snapshot(new Snapshot);
+  if (!snapshot->Map(path_, file_size_))
+    return false;
+  snapshot->index_ = index_;
+
+  base::AutoLock lock(lock_);
+  snapshot_ = snapshot;
+  return true;
+}
+
+scoped_refptr<ThumbnailBlobStore::Snapshot> ThumbnailBlobStore::GetSnapshot() {
+  base::AutoLock lock(lock_);
+  return snapshot_;
+}
+
+// static
+SkBitmap ThumbnailBlobStore::ScaleForGrid(const SkBitmap& thumbnail) {
+  if (thumbnail.isNull())
+    return SkBitmap();
+
+  SkBitmap scaled;
+  if (thumbnail.width() == kThumbnailWidth &&
+      thumbnail.height() == kThumbnailHeight) {
+    if (!thumbnail.copyTo(&scaled, SkBitmap::kARGB_8888_Config))
+      return SkBitmap();
+    return scaled;
+  }
+
+  return skia::ImageOperations::Resize(thumbnail,
+                                       skia::ImageOperations::RESIZE_GOOD,
+                                       kThumbnailWidth, kThumbnailHeight);
+}
+
+}  // namespace history
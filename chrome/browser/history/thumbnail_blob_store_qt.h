@@ -0,0 +1,143 @@
+// Copyright (c) 2011 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef CHROME_BROWSER_HISTORY_THUMBNAIL_BLOB_STORE_QT_H_
+#define CHROME_BROWSER_HISTORY_THUMBNAIL_BLOB_STORE_QT_H_
+#pragma once
+
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/file_path.h"
+#include "base/memory/ref_counted.h"
+#include "base/synchronization/lock.h"
+
+class GURL;
+class SkBitmap;
+
+namespace history {
+
+// Keeps the recent page thumbnails decoded and scaled to the size of the new
+// tab grid in a single append-only file, so the grid can show them straight
+// from a memory mapping instead of asking the thumbnail database for every
+// JPEG and decoding it.
+//
+// Each record holds the page URL and its pixels. A newer record for a URL
+// supersedes the older one, and an empty record removes the URL. The index
+// of live records is rebuilt by scanning the file when it is opened, and the
+// file is rewritten without the dead records once they make up most of it.
+//
+// All methods except GetSnapshot() must be called on the thumbnail database
+// thread.
+class ThumbnailBlobStore
+    : public base::RefCountedThreadSafe<ThumbnailBlobStore> {
+ public:
+  // Size the grid shows thumbnails at.
+  static const int kThumbnailWidth = 212;
+  static const int kThumbnailHeight = 132;
+
+  // An immutable view of the store at one point in time. The pixels it hands
+  // out live in the mapping and stay valid as long as the snapshot is
+  // referenced, even after the store moves on or is compacted.
+  class Snapshot : public base::RefCountedThreadSafe<Snapshot> {
+   public:
+    // Returns the pixels of the thumbnail for |url|, or NULL if there is
+    // none. The pixels are rows of |*width| 32 bit premultiplied ARGB values
+    // in native byte order, the layout of a kARGB_8888_Config SkBitmap.
+    const uint8* GetThumbnail(const GURL& url, int* width, int* height) const;
+
+    size_t thumbnail_count() const { return index_.size(); }
+
+   private:
+    friend class ThumbnailBlobStore;
+    friend class base::RefCountedThreadSafe<Snapshot>;
+
+    struct Entry {
+      size_t offset;
+      int width;
+      int height;
+    };
+    typedef std::map<std::string, Entry> Index;
+
+    Snapshot();
+    ~Snapshot();
+
+    // Maps the first |length| bytes of |path|.
+    bool Map(const FilePath& path, size_t length);
+
+    uint8* data_;
+    size_t length_;
+    Index index_;
+
+    DISALLOW_COPY_AND_ASSIGN(Snapshot);
+  };
+
+  typedef std::vector<std::pair<GURL, SkBitmap> > ThumbnailList;
+
+  ThumbnailBlobStore();
+
+  // Opens the store at |path|, creating it if needed. A record cut short by
+  // a crash is dropped.
+  bool Init(const FilePath& path);
+
+  // Appends |thumbnails|, which should already be scaled with ScaleForGrid(),
+  // and publishes a new snapshot once all of them are written.
+  bool AddThumbnails(const ThumbnailList& thumbnails);
+
+  // Removes the thumbnails of all URLs not in |urls|.
+  bool RetainOnly(const std::set<std::string>& urls);
+
+  // Whether dead records take up enough of the file to be worth a Compact().
+  bool NeedsCompaction() const;
+
+  // Rewrites the file with only the live records.
+  bool Compact();
+
+  // Returns the current snapshot. May be called on any thread; returns NULL
+  // before Init() succeeded.
+  scoped_refptr<Snapshot> GetSnapshot();
+
+  // Scales |thumbnail| to the grid size. Does not touch the store and may be
+  // called on any thread.
+  static SkBitmap ScaleForGrid(const SkBitmap& thumbnail);
+
+ private:
+  friend class base::RefCountedThreadSafe<ThumbnailBlobStore>;
+
+  ~ThumbnailBlobStore();
+
+  // Rebuilds |index_| from the file, truncating a partial last record.
+  bool Load();
+
+  // Appends one record at the end of |file|. An empty |pixels| writes a
+  // removal record.
+  bool AppendRecord(FILE* file, const std::string& url,
+                    int width, int height, const uint8* pixels);
+
+  // Maps the file as it is now and makes it the current snapshot.
+  bool Publish();
+
+  FilePath path_;
+
+  // Live records of the file, shared with new snapshots.
+  Snapshot::Index index_;
+
+  // Bytes in the file, and bytes of it taken by live records.
+  size_t file_size_;
+  size_t live_size_;
+
+  // Guards |snapshot_|, which readers take on other threads.
+  base::Lock lock_;
+  scoped_refptr<Snapshot> snapshot_;
+
+  DISALLOW_COPY_AND_ASSIGN(ThumbnailBlobStore);
+};
+
+}  // namespace history
+
+#endif  // CHROME_BROWSER_HISTORY_THUMBNAIL_BLOB_STORE_QT_H_
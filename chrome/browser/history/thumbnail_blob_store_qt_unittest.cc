@@ -0,0 +1,157 @@
+// Copyright (c) 2011 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <unistd.h>
+
+#include <set>
+#include <string>
+
+#include "base/file_path.h"
+#include "base/file_util.h"
+#include "base/memory/scoped_temp_dir.h"
+#include "chrome/browser/history/thumbnail_blob_store_qt.h"
+#include "googleurl/src/gurl.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "third_party/skia/include/core/SkBitmap.h"
+
+namespace history {
+
+namespace {
+
+const char kURL1[] = "http://www.google.com/";
+const char kURL2[] = "http://www.example.com/page.html";
+
+// Returns a grid sized thumbnail filled with |color|.
+SkBitmap MakeThumbnail(SkColor color) {
+  SkBitmap bitmap;
+  bitmap.setConfig(SkBitmap::kARGB_8888_Config,
+                   ThumbnailBlobStore::kThumbnailWidth,
+                   ThumbnailBlobStore::kThumbnailHeight);
+  bitmap.allocPixels();
+  bitmap.eraseColor(color);
+  return bitmap;
+}
+
+}  // namespace
+
+class ThumbnailBlobStoreTest : public testing::Test {
+ protected:
+  virtual void SetUp() {
+    ASSERT_TRUE(temp_dir_.CreateUniqueTempDir());
+    path_ = temp_dir_.path().AppendASCII("Thumbnails-blobs");
+  }
+
+  // Adds one thumbnail for |url| to |store|.
+  bool Add(ThumbnailBlobStore* store, const char* url, SkColor color) {
+    ThumbnailBlobStore::ThumbnailList list;
+    list.push_back(std::make_pair(GURL(url), MakeThumbnail(color)));
+    return store->AddThumbnails(list);
+  }
+
+  // Returns the first pixel of the thumbnail for |url|, or 0 if there is none.
+  uint32 FirstPixel(ThumbnailBlobStore* store, const char* url) {
+    scoped_refptr<ThumbnailBlobStore::Snapshot> snapshot =
+        store->GetSnapshot();
+    int width = 0;
+    int height = 0;
+    const uint8* pixels = snapshot->GetThumbnail(GURL(url), &width, &height);
+    if (!pixels)
+      return 0;
+    EXPECT_EQ(ThumbnailBlobStore::kThumbnailWidth, width);
+    EXPECT_EQ(ThumbnailBlobStore::kThumbnailHeight, height);
+    return *reinterpret_cast<const uint32*>(pixels);
+  }
+
+  ScopedTempDir temp_dir_;
+  FilePath path_;
+};
+
+TEST_F(ThumbnailBlobStoreTest, AddAndReplace) {
+  scoped_refptr<ThumbnailBlobStore> store(new ThumbnailBlobStore);
+  ASSERT_TRUE(store->Init(path_));
+  EXPECT_EQ(0U, store->GetSnapshot()->thumbnail_count());
+
+  ASSERT_TRUE(Add(store.get(), kURL1, SK_ColorRED));
+  scoped_refptr<ThumbnailBlobStore::Snapshot> old_snapshot =
+      store->GetSnapshot();
+  ASSERT_TRUE(Add(store.get(), kURL1, SK_ColorBLUE));
+
+  EXPECT_EQ(SK_ColorBLUE, FirstPixel(store.get(), kURL1));
+  EXPECT_EQ(0U, FirstPixel(store.get(), kURL2));
+  EXPECT_EQ(1U, store->GetSnapshot()->thumbnail_count());
+
+  // Older snapshots keep showing what they had.
+  int width, height;
+  const uint8* pixels =
+      old_snapshot->GetThumbnail(GURL(kURL1), &width, &height);
+  ASSERT_TRUE(pixels);
+  EXPECT_EQ(SK_ColorRED, *reinterpret_cast<const uint32*>(pixels));
+}
+
+TEST_F(ThumbnailBlobStoreTest, ReopenAndRetain) {
+  scoped_refptr<ThumbnailBlobStore> store(new ThumbnailBlobStore);
+  ASSERT_TRUE(store->Init(path_));
+  ASSERT_TRUE(Add(store.get(), kURL1, SK_ColorRED));
+  ASSERT_TRUE(Add(store.get(), kURL2, SK_ColorGREEN));
+
+  std::set<std::string> kept;
+  kept.insert(GURL(kURL2).spec());
+  ASSERT_TRUE(store->RetainOnly(kept));
+  store = NULL;
+
+  store = new ThumbnailBlobStore;
+  ASSERT_TRUE(store->Init(path_));
+  EXPECT_EQ(1U, store->GetSnapshot()->thumbnail_count());
+  EXPECT_EQ(0U, FirstPixel(store.get(), kURL1));
+  EXPECT_EQ(SK_ColorGREEN, FirstPixel(store.get(), kURL2));
+}
+
+TEST_F(ThumbnailBlobStoreTest, TruncatedRecord) {
+  scoped_refptr<ThumbnailBlobStore> store(new ThumbnailBlobStore);
+  ASSERT_TRUE(store->Init(path_));
+  ASSERT_TRUE(Add(store.get(), kURL1, SK_ColorRED));
+  ASSERT_TRUE(Add(store.get(), kURL2, SK_ColorGREEN));
+  store = NULL;
+
+  // Cut the last record short, as a crash during a write would.
+  int64 size = 0;
+  ASSERT_TRUE(file_util::GetFileSize(path_, &size));
+  ASSERT_EQ(0, truncate(path_.value().c_str(), size - 100));
+
+  store = new ThumbnailBlobStore;
+  ASSERT_TRUE(store->Init(path_));
+  EXPECT_EQ(SK_ColorRED, FirstPixel(store.get(), kURL1));
+  EXPECT_EQ(0U, FirstPixel(store.get(), kURL2));
+
+  // Appends continue after the last good record.
+  ASSERT_TRUE(Add(store.get(), kURL2, SK_ColorBLUE));
+  store = NULL;
+  store = new ThumbnailBlobStore;
+  ASSERT_TRUE(store->Init(path_));
+  EXPECT_EQ(SK_ColorBLUE, FirstPixel(store.get(), kURL2));
+}
+
+TEST_F(ThumbnailBlobStoreTest, Compact) {
+  scoped_refptr<ThumbnailBlobStore> store(new ThumbnailBlobStore);
+  ASSERT_TRUE(store->Init(path_));
+
+  // Rewrite the same page until the dead records dominate the file.
+  SkColor colors[] = { SK_ColorRED, SK_ColorGREEN, SK_ColorBLUE };
+  for (int i = 0; i < 30 && !store->NeedsCompaction(); ++i)
+    ASSERT_TRUE(Add(store.get(), kURL1, colors[i % arraysize(colors)]));
+  ASSERT_TRUE(store->NeedsCompaction());
+  SkColor last = static_cast<SkColor>(FirstPixel(store.get(), kURL1));
+
+  int64 before = 0;
+  ASSERT_TRUE(file_util::GetFileSize(path_, &before));
+  ASSERT_TRUE(store->Compact());
+  int64 after = 0;
+  ASSERT_TRUE(file_util::GetFileSize(path_, &after));
+
+  EXPECT_LT(after, before);
+  EXPECT_FALSE(store->NeedsCompaction());
+  EXPECT_EQ(last, FirstPixel(store.get(), kURL1));
+}
+
+}  // namespace history
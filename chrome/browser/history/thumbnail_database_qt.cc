@@ -136,26 +136,41 @@ bool ThumbnailDatabaseQt::DeleteThumbnail(const std::string url) {
   return statement.Run();
 }
 
-void ThumbnailDatabaseQt::CleanUnusedThumbnails(std::vector<GURL> list_url) {
+void ThumbnailDatabaseQt::CleanUnusedThumbnails(
+    const std::vector<GURL>& list_url) {
   DLOG(INFO)<<__FUNCTION__;
-  sql::Statement statement(db_.GetCachedStatement(SQL_FROM_HERE,
-      "SELECT url FROM rec_thumbnails WHERE bookmarked=0"));
+  // Let sqlite compute the set difference in one statement instead of
+  // walking every row. The list is short (the recently closed tabs), so it
+  // fits comfortably in the bound parameter limit.
+  std::string sql("DELETE FROM rec_thumbnails WHERE bookmarked=0");
+  if (!list_url.empty()) {
+    sql.append(" AND url NOT IN (");
+    for (size_t i = 0; i < list_url.size(); i++)
+      sql.append(i == 0 ? "?" : ",?");
+    sql.append(")");
+  }
+
+  sql::Statement statement(db_.GetUniqueStatement(sql.c_str()));
   if (!statement)
     return;
-  
-  int list_count = list_url.size();
-  while (statement.Step()) {
-    bool found = false;
-    std::string url_str = statement.ColumnString(0);
-    for(int i=0; i<list_count; i++) {
-	if(url_str == list_url[i].spec()) {
-	   found = true;
-           break;
-        } 
-    }
-    if(!found)
-      DeleteThumbnail(url_str);
-  }
+
+  for (size_t i = 0; i < list_url.size(); i++)
+    statement.BindString(static_cast<int>(i), list_url[i].spec());
+
+  if (!statement.Run())
+    NOTREACHED() << db_.GetErrorMessage();
+}
+
+bool ThumbnailDatabaseQt::GetThumbnailURLs(std::set<std::string>* urls) {
+  DLOG(INFO)<<__FUNCTION__;
+  sql::Statement statement(db_.GetCachedStatement(SQL_FROM_HERE,
+      "SELECT url FROM rec_thumbnails WHERE valid=1"));
+  if (!statement)
+    return false;
+
+  while (statement.Step())
+    urls->insert(statement.ColumnString(0));
+  return statement.Succeeded();
 }
 
 int ThumbnailDatabaseQt::ThumbnailsCountExcludeBookmarked() {
@@ -233,37 +248,72 @@ bool ThumbnailDatabaseQt::UpdateBookmarkedColumn(const GURL& url, bool bookmarke
 bool ThumbnailDatabaseQt::SetPageThumbnail(const GURL& url,
 					const SkBitmap& thumbnail) {
   DLOG(INFO)<<__FUNCTION__;
-  if (!thumbnail.isNull()) {
-      sql::Statement statement(db_.GetCachedStatement(SQL_FROM_HERE,
-	 "UPDATE rec_thumbnails SET data = ?, valid = ? WHERE url = ?"));
-      if (!statement)
-        return false;
-
-      // We use 90 quality (out of 100) which is pretty high, because
-      // we're very sensitive to artifacts for these small sized,
-      // highly detailed images.
-      std::vector<unsigned char> jpeg_data;
-      SkAutoLockPixels thumbnail_lock(thumbnail);
-      bool encoded = gfx::JPEGCodec::Encode(
-          reinterpret_cast<unsigned char*>(thumbnail.getAddr32(0, 0)),
-          gfx::JPEGCodec::FORMAT_SkBitmap, thumbnail.width(),
-          thumbnail.height(),
-          static_cast<int>(thumbnail.rowBytes()), 90,
-          &jpeg_data);
-
-      if (encoded) {
-        statement.BindBlob(0, &jpeg_data[0],
-                           static_cast<int>(jpeg_data.size()));
-	statement.BindBool(1, true);
-	statement.BindString(2, url.spec());
-        if (!statement.Run()) {
-          NOTREACHED() << db_.GetErrorMessage();
-          return false;
-        }
-	return true;
-      }
-      return false;
-  } 
+  if (thumbnail.isNull())
+    return false;
+
+  sql::Statement statement(db_.GetCachedStatement(SQL_FROM_HERE,
+      "UPDATE rec_thumbnails SET data = ?, valid = ? WHERE url = ?"));
+  if (!statement)
+    return false;
+
+  std::vector<unsigned char> jpeg_data;
+  if (!EncodeThumbnail(thumbnail, &jpeg_data))
+    return false;
+
+  statement.BindBlob(0, &jpeg_data[0],
+                     static_cast<int>(jpeg_data.size()));
+  statement.BindBool(1, true);
+  statement.BindString(2, url.spec());
+  if (!statement.Run()) {
+    NOTREACHED() << db_.GetErrorMessage();
+    return false;
+  }
+  return true;
+}
+
+bool ThumbnailDatabaseQt::SetPageThumbnailData(
+    const GURL& url,
+    const std::vector<unsigned char>& jpeg_data) {
+  DLOG(INFO)<<__FUNCTION__;
+  if (jpeg_data.empty())
+    return false;
+
+  sql::Statement statement(db_.GetCachedStatement(SQL_FROM_HERE,
+      "INSERT OR REPLACE INTO rec_thumbnails "
+      "(url, bookmarked, valid, data) "
+      "VALUES (?,"
+      "COALESCE((SELECT bookmarked FROM rec_thumbnails WHERE url=?), 0),"
+      "1,?)"));
+  if (!statement)
+    return false;
+
+  statement.BindString(0, url.spec());
+  statement.BindString(1, url.spec());
+  statement.BindBlob(2, &jpeg_data[0], static_cast<int>(jpeg_data.size()));
+  if (!statement.Run()) {
+    NOTREACHED() << db_.GetErrorMessage();
+    return false;
+  }
+  return true;
+}
+
+// static
+bool ThumbnailDatabaseQt::EncodeThumbnail(
+    const SkBitmap& thumbnail,
+    std::vector<unsigned char>* jpeg_data) {
+  if (thumbnail.isNull())
+    return false;
+
+  // We use 90 quality (out of 100) which is pretty high, because
+  // we're very sensitive to artifacts for these small sized,
+  // highly detailed images.
+  SkAutoLockPixels thumbnail_lock(thumbnail);
+  return gfx::JPEGCodec::Encode(
+      reinterpret_cast<unsigned char*>(thumbnail.getAddr32(0, 0)),
+      gfx::JPEGCodec::FORMAT_SkBitmap, thumbnail.width(),
+      thumbnail.height(),
+      static_cast<int>(thumbnail.rowBytes()), 90,
+      jpeg_data);
 }
 
 bool ThumbnailDatabaseQt::InsertNewRow(
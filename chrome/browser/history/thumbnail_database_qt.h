@@ -6,6 +6,8 @@
 #define CHROME_BROWSER_HISTORY_THUMBNAIL_DATABASE_QT_H_
 #pragma once
 
+#include <set>
+#include <string>
 #include <vector>
 
 #include "app/sql/connection.h"
@@ -63,6 +65,18 @@ class ThumbnailDatabaseQt {
   bool SetPageThumbnail(const GURL& url,
                         const SkBitmap& thumbnail);
 
+  // Stores already encoded JPEG data as the thumbnail for the given URL,
+  // adding a row for it if needed. The bookmarked flag of an existing row is
+  // kept. This is a single statement, so callers can batch many of them in
+  // one transaction.
+  bool SetPageThumbnailData(const GURL& url,
+                            const std::vector<unsigned char>& jpeg_data);
+
+  // Encodes |thumbnail| the way it is stored in the database. Does not touch
+  // the database and may be called on any thread.
+  static bool EncodeThumbnail(const SkBitmap& thumbnail,
+                              std::vector<unsigned char>* jpeg_data);
+
   // Retrieves thumbnail data for the given URL, returning true on success,
   // false if there is no such thumbnail or there was some other error.
   bool GetPageThumbnail(const GURL& url, std::vector<unsigned char>* data);
@@ -81,7 +95,12 @@ class ThumbnailDatabaseQt {
   // Get thumbnails count expcept bookmared page.
   int ThumbnailsCountExcludeBookmarked();
 
-  void CleanUnusedThumbnails(std::vector<GURL> list_url);
+  // Deletes the thumbnails of all pages that are neither bookmarked nor in
+  // |list_url|.
+  void CleanUnusedThumbnails(const std::vector<GURL>& list_url);
+
+  // Fills |urls| with the pages that have a valid thumbnail.
+  bool GetThumbnailURLs(std::set<std::string>* urls);
 
 
   // Called by the to delete all old thumbnails and make a clean table.
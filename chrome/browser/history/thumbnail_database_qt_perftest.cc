@@ -0,0 +1,186 @@
+// Copyright (c) 2011 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <vector>
+
+#include "base/atomic_ref_count.h"
+#include "base/basictypes.h"
+#include "base/file_path.h"
+#include "base/memory/scoped_temp_dir.h"
+#include "base/perftimer.h"
+#include "base/string_util.h"
+#include "base/synchronization/waitable_event.h"
+#include "base/task.h"
+#include "base/threading/worker_pool.h"
+#include "chrome/browser/history/thumbnail_database_qt.h"
+#include "googleurl/src/gurl.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "third_party/skia/include/core/SkBitmap.h"
+
+using history::ThumbnailDatabaseQt;
+
+namespace {
+
+const int kThumbnailCount = 1000;
+
+// Size of the thumbnails shown in the recent pages grid.
+const int kThumbnailWidth = 212;
+const int kThumbnailHeight = 132;
+
+// Pages kept by the cleanup, like the recently closed tabs.
+const int kKeptCount = 8;
+
+// Thumbnails written per transaction by the batched path; matches the
+// backend's kMaxPendingThumbnails.
+const int kBatchSize = 16;
+
+GURL TestURL(int i) {
+  return GURL(StringPrintf("http://www.example.com/page/%d.html", i));
+}
+
+// Fills a thumbnail with a gradient so that it does not compress to nothing.
+void MakeThumbnail(int seed, SkBitmap* bitmap) {
+  bitmap->setConfig(SkBitmap::kARGB_8888_Config,
+                    kThumbnailWidth, kThumbnailHeight);
+  bitmap->allocPixels();
+  SkAutoLockPixels lock(*bitmap);
+  for (int y = 0; y < kThumbnailHeight; ++y) {
+    for (int x = 0; x < kThumbnailWidth; ++x) {
+      *bitmap->getAddr32(x, y) =
+          SkColorSetARGB(255, (x + seed) & 0xff, (y * 2) & 0xff,
+                         (x * y + seed) & 0xff);
+    }
+  }
+}
+
+// Encodes one thumbnail on a worker thread and signals |done| after the last
+// one of the batch.
+void EncodeOnWorker(const SkBitmap* bitmap,
+                    std::vector<unsigned char>* jpeg_data,
+                    base::AtomicRefCount* remaining,
+                    base::WaitableEvent* done) {
+  EXPECT_TRUE(ThumbnailDatabaseQt::EncodeThumbnail(*bitmap, jpeg_data));
+  if (!base::AtomicRefCountDec(remaining))
+    done->Signal();
+}
+
+class ThumbnailDatabaseQtPerfTest : public testing::Test {
+ protected:
+  virtual void SetUp() {
+    ASSERT_TRUE(temp_dir_.CreateUniqueTempDir());
+    bitmaps_.resize(kThumbnailCount);
+    for (int i = 0; i < kThumbnailCount; ++i)
+      MakeThumbnail(i, &bitmaps_[i]);
+  }
+
+  FilePath DatabasePath(const char* name) {
+    return temp_dir_.path().AppendASCII(name);
+  }
+
+  ScopedTempDir temp_dir_;
+  std::vector<SkBitmap> bitmaps_;
+};
+
+}  // namespace
+
+// Encoding: one thread, as the thumbnail thread did, against the worker pool.
+TEST_F(ThumbnailDatabaseQtPerfTest, Encode) {
+  std::vector<std::vector<unsigned char> > serial(kThumbnailCount);
+  PerfTimer serial_timer;
+  for (int i = 0; i < kThumbnailCount; ++i)
+    ASSERT_TRUE(ThumbnailDatabaseQt::EncodeThumbnail(bitmaps_[i], &serial[i]));
+  double serial_seconds = serial_timer.Elapsed().InSecondsF();
+
+  std::vector<std::vector<unsigned char> > parallel(kThumbnailCount);
+  base::AtomicRefCount remaining = kThumbnailCount;
+  base::WaitableEvent done(false, false);
+  PerfTimer parallel_timer;
+  for (int i = 0; i < kThumbnailCount; ++i) {
+    ASSERT_TRUE(base::WorkerPool::PostTask(FROM_HERE,
+        NewRunnableFunction(&EncodeOnWorker, &bitmaps_[i], &parallel[i],
+                            &remaining, &done),
+        false));
+  }
+  done.Wait();
+  double parallel_seconds = parallel_timer.Elapsed().InSecondsF();
+
+  for (int i = 0; i < kThumbnailCount; ++i)
+    EXPECT_EQ(serial[i], parallel[i]);
+
+  LogPerfResult("Thumbnail_encode_serial",
+                kThumbnailCount / serial_seconds, "thumbnails/s");
+  LogPerfResult("Thumbnail_encode_worker_pool",
+                kThumbnailCount / parallel_seconds, "thumbnails/s");
+}
+
+// Writing: a lookup, an insert and an update committed per thumbnail, against
+// one upsert per thumbnail committed in batches.
+TEST_F(ThumbnailDatabaseQtPerfTest, Write) {
+  std::vector<std::vector<unsigned char> > jpeg_data(kThumbnailCount);
+  for (int i = 0; i < kThumbnailCount; ++i)
+    ASSERT_TRUE(ThumbnailDatabaseQt::EncodeThumbnail(bitmaps_[i],
+                                                     &jpeg_data[i]));
+
+  ThumbnailDatabaseQt row_db;
+  ASSERT_TRUE(row_db.Init(DatabasePath("row")));
+  PerfTimer row_timer;
+  for (int i = 0; i < kThumbnailCount; ++i) {
+    GURL url = TestURL(i);
+    row_db.BeginTransaction();
+    if (!row_db.HasThisPage(url))
+      ASSERT_TRUE(row_db.InsertNewRow(url, false));
+    ASSERT_TRUE(row_db.SetPageThumbnailData(url, jpeg_data[i]));
+    row_db.CommitTransaction();
+  }
+  double row_seconds = row_timer.Elapsed().InSecondsF();
+
+  ThumbnailDatabaseQt batch_db;
+  ASSERT_TRUE(batch_db.Init(DatabasePath("batch")));
+  PerfTimer batch_timer;
+  for (int i = 0; i < kThumbnailCount; i += kBatchSize) {
+    batch_db.BeginTransaction();
+    for (int j = i; j < i + kBatchSize && j < kThumbnailCount; ++j)
+      ASSERT_TRUE(batch_db.SetPageThumbnailData(TestURL(j), jpeg_data[j]));
+    batch_db.CommitTransaction();
+  }
+  double batch_seconds = batch_timer.Elapsed().InSecondsF();
+
+  EXPECT_EQ(kThumbnailCount, row_db.ThumbnailsCountExcludeBookmarked());
+  EXPECT_EQ(kThumbnailCount, batch_db.ThumbnailsCountExcludeBookmarked());
+
+  LogPerfResult("Thumbnail_write_per_row",
+                kThumbnailCount / row_seconds, "thumbnails/s");
+  LogPerfResult("Thumbnail_write_batched",
+                kThumbnailCount / batch_seconds, "thumbnails/s");
+}
+
+// Cleanup of a full table down to the recently closed pages.
+TEST_F(ThumbnailDatabaseQtPerfTest, Clean) {
+  std::vector<unsigned char> jpeg_data;
+  ASSERT_TRUE(ThumbnailDatabaseQt::EncodeThumbnail(bitmaps_[0], &jpeg_data));
+
+  ThumbnailDatabaseQt db;
+  ASSERT_TRUE(db.Init(DatabasePath("clean")));
+  db.BeginTransaction();
+  for (int i = 0; i < kThumbnailCount; ++i)
+    ASSERT_TRUE(db.SetPageThumbnailData(TestURL(i), jpeg_data));
+  // A bookmarked page survives the cleanup whether it is listed or not.
+  ASSERT_TRUE(db.UpdateBookmarkedColumn(TestURL(kThumbnailCount - 1), true));
+  db.CommitTransaction();
+
+  std::vector<GURL> kept;
+  for (int i = 0; i < kKeptCount; ++i)
+    kept.push_back(TestURL(i * 7));
+
+  PerfTimer timer;
+  db.CleanUnusedThumbnails(kept);
+  double seconds = timer.Elapsed().InSecondsF();
+
+  EXPECT_EQ(kKeptCount, db.ThumbnailsCountExcludeBookmarked());
+  EXPECT_TRUE(db.IsBookmarkedPage(TestURL(kThumbnailCount - 1)));
+  for (int i = 0; i < kKeptCount; ++i)
+    EXPECT_TRUE(db.IsThumbnailValid(kept[i]));
+
+  LogPerfResult("Thumbnail_clean", seconds * 1000, "ms");
+}
@@ -10,6 +10,7 @@
 #include "base/debug/leak_tracker.h"
 #include "base/logging.h"
 #include "base/metrics/field_trial.h"
+#include "base/path_service.h"
 #include "base/stl_util-inl.h"
 #include "base/string_number_conversions.h"
 #include "base/string_split.h"
@@ -17,6 +18,7 @@
 #include "base/threading/thread_restrictions.h"
 #include "chrome/browser/browser_process.h"
 #include "chrome/browser/extensions/extension_event_router_forwarder.h"
+#include "chrome/browser/net/cert_verifier_cache_persister.h"
 #include "chrome/browser/net/chrome_network_delegate.h"
 #include "chrome/browser/net/chrome_net_log.h"
 #include "chrome/browser/net/chrome_url_request_context.h"
@@ -26,6 +28,7 @@
 #include "chrome/browser/net/pref_proxy_config_service.h"
 #include "chrome/browser/net/proxy_service_factory.h"
 #include "chrome/browser/prefs/pref_service.h"
+#include "chrome/common/chrome_paths.h"
 #include "chrome/common/chrome_switches.h"
 #include "chrome/common/net/raw_host_resolver_proc.h"
 #include "chrome/common/net/url_fetcher.h"
@@ -35,6 +38,7 @@
 #include "content/browser/in_process_webkit/indexed_db_key_utility_client.h"
 #include "net/base/cert_verifier.h"
 #include "net/base/cookie_monster.h"
+#include "net/base/dns_config.h"
 #include "net/base/dnsrr_resolver.h"
 #include "net/base/host_cache.h"
 #include "net/base/host_resolver.h"
@@ -141,6 +145,42 @@ net::HostResolver* CreateGlobalHostResolver(net::NetLog* net_log) {
   net::HostResolver* global_host_resolver =
       net::CreateSystemHostResolver(parallelism, resolver_proc.get(), net_log);
 
+  // Serve expired host cache entries while they are refreshed, if requested
+  // from the command-line.
+  if (command_line.HasSwitch(switches::kHostResolverMaxStaleAge)) {
+    std::string s =
+        command_line.GetSwitchValueASCII(switches::kHostResolverMaxStaleAge);
+    int seconds;
+    net::HostResolverImpl* host_resolver_impl =
+        global_host_resolver->GetAsHostResolverImpl();
+    if (!base::StringToInt(s, &seconds) || seconds <= 0) {
+      LOG(ERROR) << "Invalid switch for host resolver max stale age: " << s;
+    } else if (host_resolver_impl) {
+      host_resolver_impl->set_max_stale_age(
+          base::TimeDelta::FromSeconds(seconds));
+    }
+  }
+
+  // Use the built-in DNS resolver if requested from the command-line.
+  if (command_line.HasSwitch(switches::kEnableAsyncDns)) {
+    net::HostResolverImpl* host_resolver_impl =
+        global_host_resolver->GetAsHostResolverImpl();
+    net::DnsConfig dns_config;
+    bool read_config;
+    {
+      // resolv.conf is a small local file, read once at startup.
+      base::ThreadRestrictions::ScopedAllowIO allow_io;
+      read_config = net::ReadSystemDnsConfig(&dns_config);
+    }
+    if (!read_config) {
+      LOG(ERROR) << "Cannot read the DNS settings of the system";
+    } else if (host_resolver_impl) {
+      host_resolver_impl->SetDnsConfig(
+          dns_config,
+          !command_line.HasSwitch(switches::kDisableAsyncDnsFallback));
+    }
+  }
+
   // Determine if we should disable IPv6 support.
   if (!command_line.HasSwitch(switches::kEnableIPv6)) {
     if (command_line.HasSwitch(switches::kDisableIPv6)) {
@@ -314,6 +354,15 @@ IOThread::IOThread(
   pref_proxy_config_tracker_ = new PrefProxyConfigTracker(local_state);
   ChromeNetworkDelegate::InitializeReferrersEnabled(&system_enable_referrers_,
                                                     local_state);
+
+  const CommandLine& command_line = *CommandLine::ForCurrentProcess();
+  if (command_line.HasSwitch(switches::kEnablePersistentCertVerifierCache)) {
+    FilePath user_data_dir;
+    if (PathService::Get(chrome::DIR_USER_DATA, &user_data_dir)) {
+      cert_verifier_cache_path_ =
+          user_data_dir.Append(FILE_PATH_LITERAL("Certificate Verifications"));
+    }
+  }
 }
 
 IOThread::~IOThread() {
@@ -340,6 +389,7 @@ void IOThread::InitNetworkPredictor(
     size_t max_speculative_parallel_resolves,
     const chrome_common_net::UrlList& startup_urls,
     ListValue* referral_list,
+    ListValue* host_cache_list,
     bool preconnect_enabled) {
   DCHECK(BrowserThread::CurrentlyOn(BrowserThread::UI));
   message_loop()->PostTask(
@@ -349,7 +399,7 @@ void IOThread::InitNetworkPredictor(
           &IOThread::InitNetworkPredictorOnIOThread,
           prefetching_enabled, max_dns_queue_delay,
           max_speculative_parallel_resolves,
-          startup_urls, referral_list, preconnect_enabled));
+          startup_urls, referral_list, host_cache_list, preconnect_enabled));
 }
 
 void IOThread::RegisterURLRequestContextGetter(
@@ -400,6 +450,8 @@ net::URLRequestContextGetter* IOThread::system_url_request_context_getter() {
 void IOThread::ClearNetworkingHistory() {
   DCHECK(BrowserThread::CurrentlyOn(BrowserThread::IO));
   ClearHostCache();
+  // The saved verification results tell which hosts were visited.
+  globals_->cert_verifier->ClearCache();
   // Discard acrued data used to speculate in the future.
   chrome_browser_net::DiscardInitialNavigationHistory();
   if (predictor_)
@@ -438,6 +490,10 @@ void IOThread::Init() {
   globals_->host_resolver.reset(
       CreateGlobalHostResolver(net_log_));
   globals_->cert_verifier.reset(new net::CertVerifier);
+  if (!cert_verifier_cache_path_.empty()) {
+    cert_verifier_cache_persister_ = new CertVerifierCachePersister(
+        globals_->cert_verifier.get(), cert_verifier_cache_path_);
+  }
   globals_->dnsrr_resolver.reset(new net::DnsRRResolver);
   // TODO(willchan): Use the real SSLConfigService.
   globals_->ssl_config_service =
@@ -531,6 +587,12 @@ void IOThread::CleanUp() {
 
   system_proxy_config_service_.reset();
 
+  // Must be done before the CertVerifier is destroyed.
+  if (cert_verifier_cache_persister_) {
+    cert_verifier_cache_persister_->Shutdown();
+    cert_verifier_cache_persister_ = NULL;
+  }
+
   delete globals_;
   globals_ = NULL;
 
@@ -590,6 +652,7 @@ void IOThread::InitNetworkPredictorOnIOThread(
     size_t max_speculative_parallel_resolves,
     const chrome_common_net::UrlList& startup_urls,
     ListValue* referral_list,
+    ListValue* host_cache_list,
     bool preconnect_enabled) {
   DCHECK(BrowserThread::CurrentlyOn(BrowserThread::IO));
   CHECK(!predictor_);
@@ -607,7 +670,8 @@ void IOThread::InitNetworkPredictorOnIOThread(
   DCHECK(!speculative_interceptor_);
   speculative_interceptor_ = new chrome_browser_net::ConnectInterceptor;
 
-  FinalizePredictorInitialization(predictor_, startup_urls, referral_list);
+  FinalizePredictorInitialization(predictor_, startup_urls, referral_list,
+                                  host_cache_list);
 }
 
 void IOThread::ChangedToOnTheRecordOnIOThread() {
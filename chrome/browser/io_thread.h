@@ -9,6 +9,7 @@
 #include <list>
 #include <string>
 #include "base/basictypes.h"
+#include "base/file_path.h"
 #include "base/memory/ref_counted.h"
 #include "base/memory/scoped_ptr.h"
 #include "chrome/browser/browser_process_sub_thread.h"
@@ -16,6 +17,7 @@
 #include "chrome/common/net/predictor_common.h"
 #include "net/base/network_change_notifier.h"
 
+class CertVerifierCachePersister;
 class ChromeNetLog;
 class ChromeURLRequestContextGetter;
 class ExtensionEventRouterForwarder;
@@ -99,6 +101,7 @@ class IOThread : public BrowserProcessSubThread {
                             size_t max_speculative_parallel_resolves,
                             const chrome_common_net::UrlList& startup_urls,
                             ListValue* referral_list,
+                            ListValue* host_cache_list,
                             bool preconnect_enabled);
 
   // Registers |url_request_context_getter| into the IO thread.  During
@@ -151,6 +154,7 @@ class IOThread : public BrowserProcessSubThread {
       size_t max_speculative_parallel_resolves,
       const chrome_common_net::UrlList& startup_urls,
       ListValue* referral_list,
+      ListValue* host_cache_list,
       bool preconnect_enabled);
 
   void ChangedToOnTheRecordOnIOThread();
@@ -192,6 +196,10 @@ class IOThread : public BrowserProcessSubThread {
   std::string auth_delegate_whitelist_;
   std::string gssapi_library_name_;
 
+  // The file in which the certificate verification results are saved, or
+  // empty if they aren't.
+  FilePath cert_verifier_cache_path_;
+
   // These member variables are initialized by a task posted to the IO thread,
   // which gets posted by calling certain member functions of IOThread.
 
@@ -204,6 +212,8 @@ class IOThread : public BrowserProcessSubThread {
 
   scoped_ptr<net::ProxyConfigService> system_proxy_config_service_;
 
+  scoped_refptr<CertVerifierCachePersister> cert_verifier_cache_persister_;
+
   scoped_refptr<PrefProxyConfigTracker> pref_proxy_config_tracker_;
 
   scoped_refptr<net::URLRequestContextGetter>
@@ -25,6 +25,10 @@
 #include "grit/generated_resources.h"
 #include "ui/base/l10n/l10n_util.h"
 
+#if defined(TOOLKIT_MEEGOTOUCH)
+#include "content/browser/renderer_host/backing_store_x.h"
+#endif
+
 #if defined(OS_LINUX)
 #include "content/browser/zygote_host_linux.h"
 #include "content/browser/renderer_host/render_sandbox_host_linux.h"
@@ -225,6 +229,15 @@ void MemoryDetails::CollectChildInfoOnUIThread() {
           title = l10n_util::GetStringUTF16(IDS_DEFAULT_TAB_TITLE);
         process.titles.push_back(title);
 
+#if defined(TOOLKIT_MEEGOTOUCH) && defined(TILED_BACKING_STORE)
+        BackingStoreX* backing_store = static_cast<BackingStoreX*>(
+            BackingStoreManager::Lookup(contents->render_view_host()));
+        if (backing_store) {
+          process.tile_memory.push_back(
+              std::make_pair(title, backing_store->TilesMemorySize()));
+        }
+#endif
+
         // We need to check the pending entry as well as the virtual_url to
         // see if it's an about:memory URL (we don't want to count these in the
         // total memory usage of the browser).
@@ -6,6 +6,7 @@
 #define CHROME_BROWSER_MEMORY_DETAILS_H_
 #pragma once
 
+#include <utility>
 #include <vector>
 
 #include "base/memory/ref_counted.h"
@@ -42,6 +43,9 @@ struct ProcessMemoryInformation {
   ChildProcessInfo::RendererProcessType renderer_type;
   // A collection of titles used, i.e. for a tab it'll show all the page titles.
   std::vector<string16> titles;
+  // For renderers with tiled backing stores, the title of each tab paired with
+  // the bytes used by its tiles in the browser.
+  std::vector<std::pair<string16, size_t> > tile_memory;
 };
 
 typedef std::vector<ProcessMemoryInformation> ProcessMemoryInformationList;
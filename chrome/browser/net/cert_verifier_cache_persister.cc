@@ -0,0 +1,92 @@
+// Copyright (c) 2011 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "chrome/browser/net/cert_verifier_cache_persister.h"
+
+#include "base/file_util.h"
+#include "base/message_loop.h"
+#include "content/browser/browser_thread.h"
+
+CertVerifierCachePersister::CertVerifierCachePersister(
+    net::CertVerifier* cert_verifier, const FilePath& state_file)
+    : ALLOW_THIS_IN_INITIALIZER_LIST(save_coalescer_(this)),
+      cert_verifier_(cert_verifier),
+      state_file_(state_file) {
+  DCHECK(BrowserThread::CurrentlyOn(BrowserThread::IO));
+  cert_verifier_->SetDelegate(this);
+
+  Task* task = NewRunnableMethod(this, &CertVerifierCachePersister::Load);
+  BrowserThread::PostDelayedTask(BrowserThread::FILE, FROM_HERE, task, 1000);
+}
+
+CertVerifierCachePersister::~CertVerifierCachePersister() {
+  DCHECK(!cert_verifier_);
+}
+
+void CertVerifierCachePersister::Shutdown() {
+  DCHECK(BrowserThread::CurrentlyOn(BrowserThread::IO));
+  if (!cert_verifier_)
+    return;
+
+  if (!save_coalescer_.empty()) {
+    save_coalescer_.RevokeAll();
+    Save();
+  }
+  cert_verifier_->SetDelegate(NULL);
+  cert_verifier_ = NULL;
+}
+
+void CertVerifierCachePersister::Load() {
+  DCHECK(BrowserThread::CurrentlyOn(BrowserThread::FILE));
+
+  std::string state;
+  if (!file_util::ReadFileToString(state_file_, &state))
+    return;
+
+  BrowserThread::PostTask(BrowserThread::IO, FROM_HERE,
+      NewRunnableMethod(this,
+                        &CertVerifierCachePersister::CompleteLoad,
+                        state));
+}
+
+void CertVerifierCachePersister::CompleteLoad(const std::string& state) {
+  DCHECK(BrowserThread::CurrentlyOn(BrowserThread::IO));
+
+  if (!cert_verifier_)
+    return;
+  if (!cert_verifier_->LoadCache(state))
+    LOG(ERROR) << "Failed to deserialize the certificate verifier cache";
+}
+
+void CertVerifierCachePersister::CacheIsDirty(
+    net::CertVerifier* cert_verifier) {
+  DCHECK(BrowserThread::CurrentlyOn(BrowserThread::IO));
+  DCHECK(cert_verifier == cert_verifier_);
+
+  if (!save_coalescer_.empty())
+    return;
+
+  Task* task = save_coalescer_.NewRunnableMethod(
+      &CertVerifierCachePersister::Save);
+  MessageLoop::current()->PostDelayedTask(FROM_HERE, task, 10000);
+}
+
+void CertVerifierCachePersister::Save() {
+  DCHECK(BrowserThread::CurrentlyOn(BrowserThread::IO));
+
+  std::string state;
+  if (!cert_verifier_->SerializeCache(&state))
+    return;
+
+  BrowserThread::PostTask(BrowserThread::FILE, FROM_HERE,
+      NewRunnableMethod(this,
+                        &CertVerifierCachePersister::CompleteSave,
+                        state));
+}
+
+void CertVerifierCachePersister::CompleteSave(const std::string& state) {
+  DCHECK(BrowserThread::CurrentlyOn(BrowserThread::FILE));
+
+  file_util::WriteFile(state_file_, state.data(), state.size());
+}
@@ -0,0 +1,64 @@
+// Copyright (c) 2011 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// CertVerifierCachePersister saves the certificate verification results
+// cached by a CertVerifier to disk, and loads them back at startup, so that
+// the first connection to an HTTPS host after a restart doesn't have to wait
+// for the certificate to be verified again.
+//
+// Like TransportSecurityPersister, it doesn't delay startup for the load: the
+// cache is read on the file thread a little while after startup, and the
+// CertVerifier runs without it until then.  Changes to the cache are
+// coalesced and written on the file thread.
+
+#ifndef CHROME_BROWSER_NET_CERT_VERIFIER_CACHE_PERSISTER_H_
+#define CHROME_BROWSER_NET_CERT_VERIFIER_CACHE_PERSISTER_H_
+#pragma once
+
+#include <string>
+
+#include "base/file_path.h"
+#include "base/memory/ref_counted.h"
+#include "base/task.h"
+#include "net/base/cert_verifier.h"
+
+class CertVerifierCachePersister
+    : public base::RefCountedThreadSafe<CertVerifierCachePersister>,
+      public net::CertVerifier::Delegate {
+ public:
+  // Must be called on the IO thread.  |cert_verifier| must outlive the
+  // persister, or until Shutdown() is called.
+  CertVerifierCachePersister(net::CertVerifier* cert_verifier,
+                             const FilePath& state_file);
+
+  // Saves the pending changes and detaches from the CertVerifier.  Must be
+  // called on the IO thread before the CertVerifier is destroyed.
+  void Shutdown();
+
+  // net::CertVerifier::Delegate methods:
+  virtual void CacheIsDirty(net::CertVerifier* cert_verifier);
+
+ private:
+  friend class base::RefCountedThreadSafe<CertVerifierCachePersister>;
+
+  virtual ~CertVerifierCachePersister();
+
+  void Load();
+  void CompleteLoad(const std::string& state);
+
+  void Save();
+  void CompleteSave(const std::string& state);
+
+  // Used on the IO thread to coalesce writes to disk.
+  ScopedRunnableMethodFactory<CertVerifierCachePersister> save_coalescer_;
+
+  net::CertVerifier* cert_verifier_;  // IO thread only.
+
+  // The path to the file in which we store the serialised cache.
+  const FilePath state_file_;
+
+  DISALLOW_COPY_AND_ASSIGN(CertVerifierCachePersister);
+};
+
+#endif  // CHROME_BROWSER_NET_CERT_VERIFIER_CACHE_PERSISTER_H_
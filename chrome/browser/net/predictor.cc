@@ -18,8 +18,10 @@
 #include "content/browser/browser_thread.h"
 #include "net/base/address_list.h"
 #include "net/base/completion_callback.h"
+#include "net/base/host_cache.h"
 #include "net/base/host_port_pair.h"
 #include "net/base/host_resolver.h"
+#include "net/base/host_resolver_impl.h"
 #include "net/base/net_errors.h"
 #include "net/base/net_log.h"
 
@@ -52,6 +54,11 @@ const TimeDelta Predictor::kDurationBetweenTrimmingIncrements =
     TimeDelta::FromSeconds(15);
 // static
 const size_t Predictor::kUrlsTrimmedPerIncrement = 5u;
+// static
+const size_t Predictor::kMaxPersistedHostCacheEntries = 50u;
+// static
+const TimeDelta Predictor::kRestoredHostCacheMaxStaleAge =
+    TimeDelta::FromMinutes(10);
 
 class Predictor::LookupRequest {
  public:
@@ -741,6 +748,30 @@ void Predictor::DeserializeReferrersThenDelete(ListValue* referral_list) {
     delete referral_list;
 }
 
+void Predictor::SerializeHostCache(ListValue* host_cache_list) {
+  DCHECK(BrowserThread::CurrentlyOn(BrowserThread::IO));
+  host_cache_list->Clear();
+  net::HostResolverImpl* host_resolver_impl =
+      host_resolver_->GetAsHostResolverImpl();
+  if (!host_resolver_impl || !host_resolver_impl->cache())
+    return;
+  host_resolver_impl->cache()->Serialize(kMaxPersistedHostCacheEntries,
+                                         base::TimeTicks::Now(),
+                                         host_cache_list);
+}
+
+void Predictor::DeserializeHostCacheThenDelete(ListValue* host_cache_list) {
+  DCHECK(BrowserThread::CurrentlyOn(BrowserThread::IO));
+  net::HostResolverImpl* host_resolver_impl =
+      host_resolver_->GetAsHostResolverImpl();
+  if (host_resolver_impl && host_resolver_impl->cache()) {
+    host_resolver_impl->cache()->Restore(*host_cache_list,
+                                         base::TimeTicks::Now(),
+                                         kRestoredHostCacheMaxStaleAge);
+  }
+  delete host_cache_list;
+}
+
 
 //------------------------------------------------------------------------------
 // Helper functions
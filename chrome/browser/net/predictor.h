@@ -122,6 +122,13 @@ class Predictor : public base::RefCountedThreadSafe<Predictor> {
 
   void DeserializeReferrersThenDelete(ListValue* referral_list);
 
+  // Construct a ListValue object that contains the entries of the host cache
+  // that were resolved last, so that they can be persisted in a pref.
+  void SerializeHostCache(ListValue* host_cache_list);
+
+  // Add the entries saved by SerializeHostCache() to the host cache.
+  void DeserializeHostCacheThenDelete(ListValue* host_cache_list);
+
   // For unit test code only.
   size_t max_concurrent_dns_lookups() const {
     return max_concurrent_dns_lookups_;
@@ -204,6 +211,12 @@ class Predictor : public base::RefCountedThreadSafe<Predictor> {
   // Number of referring URLs processed in an incremental trimming.
   static const size_t kUrlsTrimmedPerIncrement;
 
+  // Number of host cache entries saved for the next startup.
+  static const size_t kMaxPersistedHostCacheEntries;
+  // How long after startup the saved entries can be used while they are
+  // resolved again, even if they expired.
+  static const base::TimeDelta kRestoredHostCacheMaxStaleAge;
+
   ~Predictor();
 
   // Perform actual resolution or preconnection to subresources now.  This is
@@ -147,6 +147,7 @@ void DiscardInitialNavigationHistory() {
 void RegisterUserPrefs(PrefService* user_prefs) {
   user_prefs->RegisterListPref(prefs::kDnsPrefetchingStartupList);
   user_prefs->RegisterListPref(prefs::kDnsPrefetchingHostReferralList);
+  user_prefs->RegisterListPref(prefs::kDnsPrefetchingHostCacheList);
 }
 
 // When enabled, we use the following instance to service all requests in the
@@ -410,6 +411,10 @@ static void InitNetworkPredictor(TimeDelta max_dns_queue_delay,
       static_cast<ListValue*>(user_prefs->GetList(
           prefs::kDnsPrefetchingHostReferralList)->DeepCopy());
 
+  ListValue* host_cache_list =
+      static_cast<ListValue*>(user_prefs->GetList(
+          prefs::kDnsPrefetchingHostCacheList)->DeepCopy());
+
   // Remove obsolete preferences from local state if necessary.
   int current_version =
       local_state->GetInteger(prefs::kMultipleProfilePrefMigration);
@@ -424,17 +429,22 @@ static void InitNetworkPredictor(TimeDelta max_dns_queue_delay,
 
   g_browser_process->io_thread()->InitNetworkPredictor(
       prefetching_enabled, max_dns_queue_delay, max_parallel_resolves, urls,
-      referral_list, preconnect_enabled);
+      referral_list, host_cache_list, preconnect_enabled);
 }
 
 void FinalizePredictorInitialization(
     Predictor* global_predictor,
     const UrlList& startup_urls,
-    ListValue* referral_list) {
+    ListValue* referral_list,
+    ListValue* host_cache_list) {
   DCHECK(BrowserThread::CurrentlyOn(BrowserThread::IO));
   g_predictor = global_predictor;
   g_initial_observer = new InitialObserver();
 
+  // Restore the host cache before prefetching, so that the hostnames that
+  // were resolved last time don't need to wait for the network.
+  g_predictor->DeserializeHostCacheThenDelete(host_cache_list);
+
   // Prefetch these hostnames on startup.
   DnsPrefetchMotivatedList(startup_urls,
                            UrlInfo::STARTUP_LIST_MOTIVATED);
@@ -455,6 +465,7 @@ void FreePredictorResources() {
 static void SaveDnsPrefetchStateForNextStartupAndTrimOnIOThread(
     ListValue* startup_list,
     ListValue* referral_list,
+    ListValue* host_cache_list,
     base::WaitableEvent* completion) {
   DCHECK(BrowserThread::CurrentlyOn(BrowserThread::IO));
 
@@ -470,6 +481,7 @@ static void SaveDnsPrefetchStateForNextStartupAndTrimOnIOThread(
   // enough to do any regular trimming of referrers.
   g_predictor->TrimReferrersNow();
   g_predictor->SerializeReferrers(referral_list);
+  g_predictor->SerializeHostCache(host_cache_list);
 
   completion->Signal();
 }
@@ -485,12 +497,15 @@ void SavePredictorStateForNextStartupAndTrim(PrefService* prefs) {
   ListPrefUpdate update_startup_list(prefs, prefs::kDnsPrefetchingStartupList);
   ListPrefUpdate update_referral_list(prefs,
                                       prefs::kDnsPrefetchingHostReferralList);
+  ListPrefUpdate update_host_cache_list(prefs,
+                                        prefs::kDnsPrefetchingHostCacheList);
   bool posted = BrowserThread::PostTask(
       BrowserThread::IO,
       FROM_HERE,
       NewRunnableFunction(SaveDnsPrefetchStateForNextStartupAndTrimOnIOThread,
           update_startup_list.Get(),
           update_referral_list.Get(),
+          update_host_cache_list.Get(),
           &completion));
 
   // TODO(jar): Synchronous waiting for the IO thread is a potential source
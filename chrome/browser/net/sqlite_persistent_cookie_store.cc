@@ -4,7 +4,11 @@
 
 #include "chrome/browser/net/sqlite_persistent_cookie_store.h"
 
-#include <list>
+#include <algorithm>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
 
 #include "app/sql/meta_table.h"
 #include "app/sql/statement.h"
@@ -16,30 +20,58 @@
 #include "base/memory/ref_counted.h"
 #include "base/memory/scoped_ptr.h"
 #include "base/metrics/histogram.h"
+#include "base/stl_util-inl.h"
 #include "base/string_util.h"
 #include "base/threading/thread.h"
 #include "base/threading/thread_restrictions.h"
+#include "base/time.h"
 #include "chrome/browser/diagnostics/sqlite_diagnostics.h"
 #include "content/browser/browser_thread.h"
 #include "googleurl/src/gurl.h"
 
 using base::Time;
+using base::TimeDelta;
+using base::TimeTicks;
+
+namespace {
+
+// Default least change in a cookie's last access time that is written to the
+// database.
+const int kDefaultAccessTimeGranularityMinutes = 30;
+
+}  // namespace
 
 // This class is designed to be shared between any calling threads and the
-// database thread.  It batches operations and commits them on a timer.
+// database thread.  It batches operations and commits them on a timer.  Only
+// the last operation batched for a cookie is written, and all of a batch is
+// written in one transaction.
 class SQLitePersistentCookieStore::Backend
     : public base::RefCountedThreadSafe<SQLitePersistentCookieStore::Backend> {
  public:
   explicit Backend(const FilePath& path)
       : path_(path),
         db_(NULL),
-        num_pending_(0),
-        clear_local_state_on_exit_(false) {
+        access_time_granularity_(
+            TimeDelta::FromMinutes(kDefaultAccessTimeGranularityMinutes)),
+        clear_local_state_on_exit_(false),
+        bytes_written_(0),
+        load_started_(false),
+        load_done_(false),
+        last_loaded_creation_utc_(kint64min),
+        host_keys_loaded_(false) {
   }
 
   // Creates or load the SQLite database.
   bool Load(std::vector<net::CookieMonster::CanonicalCookie*>* cookies);
 
+  // Loads the cookies of |key| ahead of the others, which are loaded on the
+  // DB thread meanwhile. See net::CookieMonster::PersistentCookieStore.
+  bool LoadCookiesForKey(
+      const std::string& key,
+      std::vector<net::CookieMonster::CanonicalCookie*>* cookies);
+  void LoadRemainingCookies(
+      std::vector<net::CookieMonster::CanonicalCookie*>* cookies);
+
   // Batch a cookie addition.
   void AddCookie(const net::CookieMonster::CanonicalCookie& cc);
 
@@ -58,18 +90,39 @@ class SQLitePersistentCookieStore::Backend
 
   void SetClearLocalStateOnExit(bool clear_local_state);
 
+  void SetAccessTimeGranularity(TimeDelta granularity);
+
  private:
   friend class base::RefCountedThreadSafe<SQLitePersistentCookieStore::Backend>;
 
   // You should call Close() before destructing this object.
   ~Backend() {
     DCHECK(!db_.get()) << "Close should have already been called.";
-    DCHECK(num_pending_ == 0 && pending_.empty());
+    DCHECK(pending_.empty());
+    DCHECK(loaded_cookies_.empty());
   }
 
+  // Creates or opens the database and brings it up to date.
+  bool InitializeDatabase();
+
   // Database upgrade statements.
   bool EnsureDatabaseVersion();
 
+  // Opens the database and starts loading cookies by key on the DB thread.
+  // Returns false if the database could not be opened.
+  bool BeginLoadLocked();
+
+  // Loads the next chunk of cookies in creation order into
+  // |loaded_cookies_|, setting |load_done_| after the last one.
+  void LoadChunkLocked();
+
+  // LoadChunkLocked() run on the DB thread until the load is done.
+  void LoadNextChunk();
+
+  // Reads the distinct host keys of the cookies table into |host_keys_|.
+  // Returns false on failure.
+  bool LoadHostKeysLocked();
+
   class PendingOperation {
    public:
     typedef enum {
@@ -91,11 +144,15 @@ class SQLitePersistentCookieStore::Backend
   };
 
  private:
-  // Batch a cookie operation (add or delete)
+  // Batch a cookie operation (add, access time update or delete), replacing
+  // the one batched for the same cookie if any.
   void BatchOperation(PendingOperation::OperationType op,
                       const net::CookieMonster::CanonicalCookie& cc);
   // Commit our pending operations to the database.
   void Commit();
+  // Adds |bytes| to the bytes written and records the rate they were written
+  // at about once a minute.
+  void RecordBytesWritten(int64 bytes);
   // Close() executed on the background thread.
   void InternalBackgroundClose();
 
@@ -103,14 +160,49 @@ class SQLitePersistentCookieStore::Backend
   scoped_ptr<sql::Connection> db_;
   sql::MetaTable meta_table_;
 
-  typedef std::list<PendingOperation*> PendingOperationsList;
-  PendingOperationsList pending_;
-  PendingOperationsList::size_type num_pending_;
+  // Pending operations by the creation time of their cookie, which is the
+  // primary key of the cookies table.
+  typedef std::map<int64, PendingOperation*> PendingOperationsMap;
+  PendingOperationsMap pending_;
+  // Last access times the database has or will have once |pending_| is
+  // committed, by creation time, for the cookies added or updated since the
+  // database was opened. Updates closer than |access_time_granularity_| to
+  // them are dropped.
+  typedef std::map<int64, int64> AccessTimeMap;
+  AccessTimeMap access_times_;
+  TimeDelta access_time_granularity_;
   // True if the persistent store should be deleted upon destruction.
   bool clear_local_state_on_exit_;
-  // Guard |pending_|, |num_pending_| and |clear_local_state_on_exit_|.
+  // Guard |pending_|, |access_times_|, |access_time_granularity_| and
+  // |clear_local_state_on_exit_|.
   base::Lock lock_;
 
+  // Bytes of cookie data written since |bytes_written_start_|. Only used on
+  // the DB thread.
+  int64 bytes_written_;
+  TimeTicks bytes_written_start_;
+
+  // Cookies loaded on the DB thread and not handed out yet, by key.
+  typedef std::map<std::string,
+      std::vector<net::CookieMonster::CanonicalCookie*> > KeyedCookies;
+  KeyedCookies loaded_cookies_;
+  // Keys handed out before the load was done, whose cookies the DB thread
+  // must no longer load.
+  std::set<std::string> keys_handed_out_;
+  bool load_started_;
+  bool load_done_;
+  // Creation time of the last cookie loaded on the DB thread.
+  int64 last_loaded_creation_utc_;
+  // The host keys of the database by key, read on the first request for the
+  // cookies of a key, so that the cookies of a key can be looked up through
+  // the host_key index. Only kept until the load is done.
+  typedef std::map<std::string, std::vector<std::string> > HostKeysByKey;
+  HostKeysByKey host_keys_;
+  bool host_keys_loaded_;
+  // Guards the loading state above, and |db_| while loading by key, as the
+  // database is then read on both the calling and the DB thread.
+  base::Lock load_lock_;
+
   DISALLOW_COPY_AND_ASSIGN(Backend);
 };
 
@@ -147,13 +239,55 @@ bool InitTable(sql::Connection* db) {
   // Try to create the index every time. Older versions did not have this index,
   // so we want those people to get it. Ignore errors, since it may exist.
   db->Execute("CREATE INDEX cookie_times ON cookies (creation_utc)");
+  // Used to look up the cookies of a key while the rest are still loading.
+  db->Execute("CREATE INDEX cookie_host_keys ON cookies (host_key)");
   return true;
 }
 
+// Columns read by MakeCookieFromStatement().
+#define COOKIE_COLUMNS "creation_utc, host_key, name, value, path, " \
+    "expires_utc, secure, httponly, last_access_utc"
+
+// Builds the cookie in the current row of |smt|, which selects
+// COOKIE_COLUMNS.
+net::CookieMonster::CanonicalCookie* MakeCookieFromStatement(
+    const sql::Statement& smt) {
+  net::CookieMonster::CanonicalCookie* cc =
+      new net::CookieMonster::CanonicalCookie(
+          // The "source" URL is not used with persisted cookies.
+          GURL(),                                         // Source
+          smt.ColumnString(2),                            // name
+          smt.ColumnString(3),                            // value
+          smt.ColumnString(1),                            // domain
+          smt.ColumnString(4),                            // path
+          Time::FromInternalValue(smt.ColumnInt64(0)),    // creation_utc
+          Time::FromInternalValue(smt.ColumnInt64(5)),    // expires_utc
+          Time::FromInternalValue(smt.ColumnInt64(8)),    // last_access_utc
+          smt.ColumnInt(6) != 0,                          // secure
+          smt.ColumnInt(7) != 0,                          // httponly
+          true);                                          // has_expires
+  DLOG_IF(WARNING,
+          cc->CreationDate() > Time::Now()) << L"CreationDate too recent";
+  return cc;
+}
+
+// Orders cookies by creation time, the order of the cookies table.
+bool CookieCreatedEarlier(const net::CookieMonster::CanonicalCookie* a,
+                          const net::CookieMonster::CanonicalCookie* b) {
+  return a->CreationDate() < b->CreationDate();
+}
+
+// Number of cookies the DB thread loads per task, so that a request for the
+// cookies of a key does not wait long for it.
+const int kCookiesPerChunk = 512;
+
+// Least number of cookies of other keys handed out with those of a key once
+// the load is done.
+const size_t kCookiesPerBatch = 512;
+
 }  // namespace
 
-bool SQLitePersistentCookieStore::Backend::Load(
-    std::vector<net::CookieMonster::CanonicalCookie*>* cookies) {
+bool SQLitePersistentCookieStore::Backend::InitializeDatabase() {
   // This function should be called only once per instance.
   DCHECK(!db_.get());
 
@@ -183,41 +317,194 @@ bool SQLitePersistentCookieStore::Backend::Load(
     return false;
   }
 
+  return true;
+}
+
+bool SQLitePersistentCookieStore::Backend::Load(
+    std::vector<net::CookieMonster::CanonicalCookie*>* cookies) {
+  if (!InitializeDatabase())
+    return false;
+
   db_->Preload();
 
   // Slurp all the cookies into the out-vector.
   sql::Statement smt(db_->GetUniqueStatement(
-      "SELECT creation_utc, host_key, name, value, path, expires_utc, secure, "
-      "httponly, last_access_utc FROM cookies"));
+      "SELECT " COOKIE_COLUMNS " FROM cookies"));
   if (!smt) {
     NOTREACHED() << "select statement prep failed";
     db_.reset();
     return false;
   }
 
+  while (smt.Step())
+    cookies->push_back(MakeCookieFromStatement(smt));
+
+  return true;
+}
+
+bool SQLitePersistentCookieStore::Backend::LoadCookiesForKey(
+    const std::string& key,
+    std::vector<net::CookieMonster::CanonicalCookie*>* cookies) {
+  base::AutoLock locked(load_lock_);
+  if (!BeginLoadLocked())
+    return true;
+
+  if (!load_done_) {
+    // Read the cookies of |key| now rather than wait for the DB thread to
+    // get to them. A suffix match on host_key cannot use an index, so the
+    // host keys are listed once from the index, and the cookies of each
+    // host key of |key| are then looked up by exact match.
+    if (!host_keys_loaded_ && !LoadHostKeysLocked())
+      return false;
+    sql::Statement smt(db_->GetCachedStatement(SQL_FROM_HERE,
+        "SELECT " COOKIE_COLUMNS " FROM cookies WHERE host_key = ?"));
+    if (!smt) {
+      NOTREACHED() << "select statement prep failed";
+      return false;
+    }
+    size_t first_cookie = cookies->size();
+    HostKeysByKey::iterator host_keys = host_keys_.find(key);
+    if (host_keys != host_keys_.end()) {
+      for (size_t i = 0; i < host_keys->second.size(); ++i) {
+        smt.Reset();
+        smt.BindString(0, host_keys->second[i]);
+        while (smt.Step())
+          cookies->push_back(MakeCookieFromStatement(smt));
+      }
+      host_keys_.erase(host_keys);
+    }
+    std::sort(cookies->begin() + first_cookie, cookies->end(),
+              CookieCreatedEarlier);
+
+    // Whatever the DB thread has loaded of |key| is in |cookies| as well.
+    KeyedCookies::iterator it = loaded_cookies_.find(key);
+    if (it != loaded_cookies_.end()) {
+      STLDeleteElements(&it->second);
+      loaded_cookies_.erase(it);
+    }
+    keys_handed_out_.insert(key);
+    return false;
+  }
+
+  KeyedCookies::iterator it = loaded_cookies_.find(key);
+  if (it != loaded_cookies_.end()) {
+    cookies->insert(cookies->end(), it->second.begin(), it->second.end());
+    loaded_cookies_.erase(it);
+  }
+
+  // Hand over some other keys too, so that the rest of the cookies reach the
+  // cookie monster a batch at a time.
+  size_t num_handed_out = 0;
+  while (!loaded_cookies_.empty() && num_handed_out < kCookiesPerBatch) {
+    it = loaded_cookies_.begin();
+    cookies->insert(cookies->end(), it->second.begin(), it->second.end());
+    num_handed_out += it->second.size();
+    loaded_cookies_.erase(it);
+  }
+  return loaded_cookies_.empty();
+}
+
+void SQLitePersistentCookieStore::Backend::LoadRemainingCookies(
+    std::vector<net::CookieMonster::CanonicalCookie*>* cookies) {
+  base::AutoLock locked(load_lock_);
+  if (!BeginLoadLocked())
+    return;
+
+  while (!load_done_)
+    LoadChunkLocked();
+
+  for (KeyedCookies::iterator it = loaded_cookies_.begin();
+       it != loaded_cookies_.end(); ++it)
+    cookies->insert(cookies->end(), it->second.begin(), it->second.end());
+  loaded_cookies_.clear();
+}
+
+bool SQLitePersistentCookieStore::Backend::BeginLoadLocked() {
+  load_lock_.AssertAcquired();
+  if (load_started_)
+    return db_.get() != NULL;
+  load_started_ = true;
+
+  if (!InitializeDatabase()) {
+    load_done_ = true;
+    return false;
+  }
+
+  BrowserThread::PostTask(
+      BrowserThread::DB, FROM_HERE,
+      NewRunnableMethod(this, &Backend::LoadNextChunk));
+  return true;
+}
+
+void SQLitePersistentCookieStore::Backend::LoadChunkLocked() {
+  load_lock_.AssertAcquired();
+  DCHECK(!load_done_);
+
+  sql::Statement smt(db_->GetCachedStatement(SQL_FROM_HERE,
+      "SELECT " COOKIE_COLUMNS " FROM cookies WHERE creation_utc > ? "
+      "ORDER BY creation_utc LIMIT ?"));
+  if (!smt) {
+    NOTREACHED() << "select statement prep failed";
+    load_done_ = true;
+    return;
+  }
+  smt.BindInt64(0, last_loaded_creation_utc_);
+  smt.BindInt(1, kCookiesPerChunk);
+
+  int num_loaded = 0;
   while (smt.Step()) {
+    ++num_loaded;
     scoped_ptr<net::CookieMonster::CanonicalCookie> cc(
-        new net::CookieMonster::CanonicalCookie(
-            // The "source" URL is not used with persisted cookies.
-            GURL(),                                         // Source
-            smt.ColumnString(2),                            // name
-            smt.ColumnString(3),                            // value
-            smt.ColumnString(1),                            // domain
-            smt.ColumnString(4),                            // path
-            Time::FromInternalValue(smt.ColumnInt64(0)),    // creation_utc
-            Time::FromInternalValue(smt.ColumnInt64(5)),    // expires_utc
-            Time::FromInternalValue(smt.ColumnInt64(8)),    // last_access_utc
-            smt.ColumnInt(6) != 0,                          // secure
-            smt.ColumnInt(7) != 0,                          // httponly
-            true));                                         // has_expires
-    DLOG_IF(WARNING,
-            cc->CreationDate() > Time::Now()) << L"CreationDate too recent";
-    cookies->push_back(cc.release());
+        MakeCookieFromStatement(smt));
+    last_loaded_creation_utc_ = cc->CreationDate().ToInternalValue();
+    std::string key(
+        net::CookieMonster::GetEffectiveDomainKey(cc->Domain()));
+    if (keys_handed_out_.find(key) == keys_handed_out_.end())
+      loaded_cookies_[key].push_back(cc.release());
   }
 
+  if (num_loaded < kCookiesPerChunk) {
+    load_done_ = true;
+    keys_handed_out_.clear();
+    host_keys_.clear();
+  }
+}
+
+bool SQLitePersistentCookieStore::Backend::LoadHostKeysLocked() {
+  load_lock_.AssertAcquired();
+  DCHECK(!host_keys_loaded_);
+
+  // This only reads the host_key index, not the cookies.
+  sql::Statement smt(db_->GetUniqueStatement(
+      "SELECT DISTINCT host_key FROM cookies"));
+  if (!smt) {
+    NOTREACHED() << "select statement prep failed";
+    return false;
+  }
+  while (smt.Step()) {
+    std::string host_key = smt.ColumnString(0);
+    host_keys_[net::CookieMonster::GetEffectiveDomainKey(host_key)].push_back(
+        host_key);
+  }
+  host_keys_loaded_ = true;
   return true;
 }
 
+void SQLitePersistentCookieStore::Backend::LoadNextChunk() {
+  DCHECK(BrowserThread::CurrentlyOn(BrowserThread::DB));
+  base::AutoLock locked(load_lock_);
+  // Maybe we are already Close()'ed.
+  if (!db_.get() || load_done_)
+    return;
+
+  LoadChunkLocked();
+  if (!load_done_) {
+    BrowserThread::PostTask(
+        BrowserThread::DB, FROM_HERE,
+        NewRunnableMethod(this, &Backend::LoadNextChunk));
+  }
+}
+
 bool SQLitePersistentCookieStore::Backend::EnsureDatabaseVersion() {
   // Version check.
   if (!meta_table_.Init(
@@ -316,16 +603,51 @@ void SQLitePersistentCookieStore::Backend::BatchOperation(
   static const size_t kCommitAfterBatchSize = 512;
   DCHECK(!BrowserThread::CurrentlyOn(BrowserThread::DB));
 
-  // We do a full copy of the cookie here, and hopefully just here.
-  scoped_ptr<PendingOperation> po(new PendingOperation(op, cc));
+  const int64 creation_utc = cc.CreationDate().ToInternalValue();
+  const int64 last_access_utc = cc.LastAccessDate().ToInternalValue();
 
-  PendingOperationsList::size_type num_pending;
+  PendingOperationsMap::size_type num_pending;
+  bool added;
   {
     base::AutoLock locked(lock_);
-    pending_.push_back(po.release());
-    num_pending = ++num_pending_;
+    PendingOperationsMap::iterator it = pending_.find(creation_utc);
+    if (op == PendingOperation::COOKIE_UPDATEACCESS) {
+      if (it != pending_.end()) {
+        // An access time update of a cookie about to be deleted is moot, and
+        // one of a cookie about to be added is written along with it.
+        if (it->second->op() == PendingOperation::COOKIE_DELETE)
+          return;
+        if (it->second->op() == PendingOperation::COOKIE_ADD)
+          op = PendingOperation::COOKIE_ADD;
+      } else {
+        AccessTimeMap::const_iterator access = access_times_.find(creation_utc);
+        if (access != access_times_.end() &&
+            last_access_utc - access->second <
+                access_time_granularity_.ToInternalValue()) {
+          return;
+        }
+      }
+    }
+
+    if (op == PendingOperation::COOKIE_DELETE)
+      access_times_.erase(creation_utc);
+    else
+      access_times_[creation_utc] = last_access_utc;
+
+    // We do a full copy of the cookie here, and hopefully just here.
+    added = it == pending_.end();
+    if (added) {
+      pending_.insert(PendingOperationsMap::value_type(
+          creation_utc, new PendingOperation(op, cc)));
+    } else {
+      delete it->second;
+      it->second = new PendingOperation(op, cc);
+    }
+    num_pending = pending_.size();
   }
 
+  if (!added)
+    return;
   if (num_pending == 1) {
     // We've gotten our first entry for this batch, fire off the timer.
     BrowserThread::PostDelayedTask(
@@ -342,19 +664,25 @@ void SQLitePersistentCookieStore::Backend::BatchOperation(
 void SQLitePersistentCookieStore::Backend::Commit() {
   DCHECK(BrowserThread::CurrentlyOn(BrowserThread::DB));
 
-  PendingOperationsList ops;
+  PendingOperationsMap ops;
   {
     base::AutoLock locked(lock_);
     pending_.swap(ops);
-    num_pending_ = 0;
   }
+  // Free the cookies once they are committed to the database.
+  STLValueDeleter<PendingOperationsMap> ops_deleter(&ops);
+
+  // The database may still be loading on another thread.
+  base::AutoLock locked(load_lock_);
 
   // Maybe an old timer fired or we are already Close()'ed.
   if (!db_.get() || ops.empty())
     return;
 
+  // Replace rather than insert, as the add of a cookie may have replaced its
+  // pending delete.
   sql::Statement add_smt(db_->GetCachedStatement(SQL_FROM_HERE,
-      "INSERT INTO cookies (creation_utc, host_key, name, value, path, "
+      "INSERT OR REPLACE INTO cookies (creation_utc, host_key, name, value, path, "
       "expires_utc, secure, httponly, last_access_utc) "
       "VALUES (?,?,?,?,?,?,?,?,?)"));
   if (!add_smt) {
@@ -381,12 +709,15 @@ void SQLitePersistentCookieStore::Backend::Commit() {
     NOTREACHED();
     return;
   }
-  for (PendingOperationsList::iterator it = ops.begin();
+  int64 bytes_written = 0;
+  for (PendingOperationsMap::const_iterator it = ops.begin();
        it != ops.end(); ++it) {
-    // Free the cookies as we commit them to the database.
-    scoped_ptr<PendingOperation> po(*it);
+    const PendingOperation* po = it->second;
     switch (po->op()) {
       case PendingOperation::COOKIE_ADD:
+        bytes_written += 4 * sizeof(int64) + 2 * sizeof(int) +
+            po->cc().Domain().size() + po->cc().Name().size() +
+            po->cc().Value().size() + po->cc().Path().size();
         add_smt.Reset();
         add_smt.BindInt64(0, po->cc().CreationDate().ToInternalValue());
         add_smt.BindString(1, po->cc().Domain());
@@ -402,6 +733,7 @@ void SQLitePersistentCookieStore::Backend::Commit() {
         break;
 
       case PendingOperation::COOKIE_UPDATEACCESS:
+        bytes_written += 2 * sizeof(int64);
         update_access_smt.Reset();
         update_access_smt.BindInt64(0,
             po->cc().LastAccessDate().ToInternalValue());
@@ -412,6 +744,7 @@ void SQLitePersistentCookieStore::Backend::Commit() {
         break;
 
       case PendingOperation::COOKIE_DELETE:
+        bytes_written += sizeof(int64);
         del_smt.Reset();
         del_smt.BindInt64(0, po->cc().CreationDate().ToInternalValue());
         if (!del_smt.Run())
@@ -426,6 +759,28 @@ void SQLitePersistentCookieStore::Backend::Commit() {
   bool succeeded = transaction.Commit();
   UMA_HISTOGRAM_ENUMERATION("Cookie.BackingStoreUpdateResults",
                             succeeded ? 0 : 1, 2);
+  if (succeeded)
+    RecordBytesWritten(bytes_written);
+}
+
+void SQLitePersistentCookieStore::Backend::RecordBytesWritten(int64 bytes) {
+  DCHECK(BrowserThread::CurrentlyOn(BrowserThread::DB));
+  const TimeTicks now = TimeTicks::Now();
+  if (bytes_written_start_.is_null())
+    bytes_written_start_ = now;
+  bytes_written_ += bytes;
+
+  // The rate counts the bytes of the cookies written, not the pages SQLite
+  // rewrites for them, so it tracks how hard the store drives the disk
+  // rather than measuring it.
+  const TimeDelta elapsed = now - bytes_written_start_;
+  if (elapsed < TimeDelta::FromMinutes(1))
+    return;
+  UMA_HISTOGRAM_CUSTOM_COUNTS("Cookie.BackingStoreBytesWrittenPerMinute",
+      static_cast<int>(bytes_written_ * 60 / elapsed.InSeconds()),
+      1, 10 * 1024 * 1024, 50);
+  bytes_written_ = 0;
+  bytes_written_start_ = now;
 }
 
 void SQLitePersistentCookieStore::Backend::Flush(Task* completion_task) {
@@ -456,7 +811,12 @@ void SQLitePersistentCookieStore::Backend::InternalBackgroundClose() {
   // Commit any pending operations
   Commit();
 
+  base::AutoLock locked(load_lock_);
   db_.reset();
+  for (KeyedCookies::iterator it = loaded_cookies_.begin();
+       it != loaded_cookies_.end(); ++it)
+    STLDeleteElements(&it->second);
+  loaded_cookies_.clear();
 
   if (clear_local_state_on_exit_)
     file_util::Delete(path_, false);
@@ -467,6 +827,13 @@ void SQLitePersistentCookieStore::Backend::SetClearLocalStateOnExit(
   base::AutoLock locked(lock_);
   clear_local_state_on_exit_ = clear_local_state;
 }
+
+void SQLitePersistentCookieStore::Backend::SetAccessTimeGranularity(
+    TimeDelta granularity) {
+  base::AutoLock locked(lock_);
+  access_time_granularity_ = granularity;
+}
+
 SQLitePersistentCookieStore::SQLitePersistentCookieStore(const FilePath& path)
     : backend_(new Backend(path)) {
 }
@@ -485,6 +852,21 @@ bool SQLitePersistentCookieStore::Load(
   return backend_->Load(cookies);
 }
 
+bool SQLitePersistentCookieStore::SupportsLoadCookiesForKey() const {
+  return true;
+}
+
+bool SQLitePersistentCookieStore::LoadCookiesForKey(
+    const std::string& key,
+    std::vector<net::CookieMonster::CanonicalCookie*>* cookies) {
+  return backend_->LoadCookiesForKey(key, cookies);
+}
+
+void SQLitePersistentCookieStore::LoadRemainingCookies(
+    std::vector<net::CookieMonster::CanonicalCookie*>* cookies) {
+  backend_->LoadRemainingCookies(cookies);
+}
+
 void SQLitePersistentCookieStore::AddCookie(
     const net::CookieMonster::CanonicalCookie& cc) {
   if (backend_.get())
@@ -509,6 +891,12 @@ void SQLitePersistentCookieStore::SetClearLocalStateOnExit(
     backend_->SetClearLocalStateOnExit(clear_local_state);
 }
 
+void SQLitePersistentCookieStore::SetAccessTimeGranularity(
+    base::TimeDelta granularity) {
+  if (backend_.get())
+    backend_->SetAccessTimeGranularity(granularity);
+}
+
 void SQLitePersistentCookieStore::Flush(Task* completion_task) {
   if (backend_.get())
     backend_->Flush(completion_task);
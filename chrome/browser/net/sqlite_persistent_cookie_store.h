@@ -12,6 +12,7 @@
 #include <vector>
 
 #include "base/memory/ref_counted.h"
+#include "base/time.h"
 #include "net/base/cookie_monster.h"
 
 class FilePath;
@@ -26,6 +27,12 @@ class SQLitePersistentCookieStore
   virtual ~SQLitePersistentCookieStore();
 
   virtual bool Load(std::vector<net::CookieMonster::CanonicalCookie*>* cookies);
+  virtual bool SupportsLoadCookiesForKey() const;
+  virtual bool LoadCookiesForKey(
+      const std::string& key,
+      std::vector<net::CookieMonster::CanonicalCookie*>* cookies);
+  virtual void LoadRemainingCookies(
+      std::vector<net::CookieMonster::CanonicalCookie*>* cookies);
 
   virtual void AddCookie(const net::CookieMonster::CanonicalCookie& cc);
   virtual void UpdateCookieAccessTime(
@@ -36,6 +43,11 @@ class SQLitePersistentCookieStore
 
   virtual void Flush(Task* completion_task);
 
+  // Sets the least change in the last access time of a cookie that is worth
+  // writing to the database. Smaller changes are dropped, except when the
+  // cookie is written anyway.
+  void SetAccessTimeGranularity(base::TimeDelta granularity);
+
  private:
   class Backend;
 
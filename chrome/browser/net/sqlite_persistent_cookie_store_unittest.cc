@@ -112,6 +112,99 @@ TEST_F(SQLitePersistentCookieStoreTest, TestPersistance) {
   ASSERT_EQ(0U, cookies.size());
 }
 
+// Test that the cookies of a key can be loaded ahead of the others.
+TEST_F(SQLitePersistentCookieStoreTest, TestLoadCookiesForKey) {
+  base::Time t = base::Time::Now();
+  const char* domains[] = { "www.example.com", ".example.com", "other.com" };
+  for (size_t i = 0; i < arraysize(domains); ++i) {
+    base::Time creation = t + base::TimeDelta::FromMicroseconds(i + 1);
+    store_->AddCookie(
+        net::CookieMonster::CanonicalCookie(GURL(), "A", "B", domains[i], "/",
+                                            creation, creation, creation,
+                                            false, false, true));
+  }
+  store_ = NULL;
+  scoped_refptr<ThreadTestHelper> helper(
+      new ThreadTestHelper(BrowserThread::DB));
+  // Make sure we wait until the destructor has run.
+  ASSERT_TRUE(helper->Run());
+  store_ = new SQLitePersistentCookieStore(
+      temp_dir_.path().Append(chrome::kCookieFilename));
+  ASSERT_TRUE(store_->SupportsLoadCookiesForKey());
+
+  std::vector<net::CookieMonster::CanonicalCookie*> cookies;
+  EXPECT_FALSE(store_->LoadCookiesForKey("example.com", &cookies));
+  ASSERT_EQ(2U, cookies.size());
+  EXPECT_EQ("www.example.com", cookies[0]->Domain());
+  EXPECT_EQ(".example.com", cookies[1]->Domain());
+  STLDeleteContainerPointers(cookies.begin(), cookies.end());
+  cookies.clear();
+
+  // The rest comes without the cookies handed out already.
+  store_->LoadRemainingCookies(&cookies);
+  ASSERT_EQ(2U, cookies.size());
+  for (size_t i = 0; i < cookies.size(); ++i)
+    EXPECT_EQ(std::string::npos, cookies[i]->Domain().find("example.com"));
+  STLDeleteContainerPointers(cookies.begin(), cookies.end());
+}
+
+// Test that only the last operation batched for a cookie is written, and that
+// small access time updates are dropped.
+TEST_F(SQLitePersistentCookieStoreTest, TestCoalesceOperations) {
+  store_->SetAccessTimeGranularity(base::TimeDelta::FromMinutes(10));
+  base::Time t = base::Time::Now() + base::TimeDelta::FromSeconds(1);
+  base::Time later = t + base::TimeDelta::FromMinutes(1);
+  base::Time much_later = t + base::TimeDelta::FromHours(1);
+
+  // Added, touched and deleted within one batch: nothing is written.
+  store_->AddCookie(
+      net::CookieMonster::CanonicalCookie(GURL(), "C", "D", "foo.bar", "/",
+                                          t, t, t, false, false, true));
+  store_->UpdateCookieAccessTime(
+      net::CookieMonster::CanonicalCookie(GURL(), "C", "D", "foo.bar", "/",
+                                          t, t, later, false, false, true));
+  store_->DeleteCookie(
+      net::CookieMonster::CanonicalCookie(GURL(), "C", "D", "foo.bar", "/",
+                                          t, t, later, false, false, true));
+
+  // Added and touched within one batch: added with the last access time.
+  base::Time creation = t + base::TimeDelta::FromMicroseconds(1);
+  store_->AddCookie(
+      net::CookieMonster::CanonicalCookie(GURL(), "E", "F", "foo.bar", "/",
+                                          creation, creation, creation,
+                                          false, false, true));
+  store_->UpdateCookieAccessTime(
+      net::CookieMonster::CanonicalCookie(GURL(), "E", "F", "foo.bar", "/",
+                                          creation, creation, much_later,
+                                          false, false, true));
+  store_->Flush(NULL);
+  scoped_refptr<ThreadTestHelper> helper(
+      new ThreadTestHelper(BrowserThread::DB));
+  ASSERT_TRUE(helper->Run());
+
+  // A touch closer than the granularity to the last one written is dropped.
+  store_->UpdateCookieAccessTime(
+      net::CookieMonster::CanonicalCookie(GURL(), "E", "F", "foo.bar", "/",
+                                          creation, creation,
+                                          much_later + (later - t),
+                                          false, false, true));
+  store_ = NULL;
+  // Make sure we wait until the destructor has run.
+  ASSERT_TRUE(helper->Run());
+  store_ = new SQLitePersistentCookieStore(
+      temp_dir_.path().Append(chrome::kCookieFilename));
+
+  std::vector<net::CookieMonster::CanonicalCookie*> cookies;
+  ASSERT_TRUE(store_->Load(&cookies));
+  ASSERT_EQ(2U, cookies.size());
+  for (size_t i = 0; i < cookies.size(); ++i) {
+    EXPECT_NE("C", cookies[i]->Name());
+    if (cookies[i]->Name() == "E")
+      EXPECT_TRUE(much_later == cookies[i]->LastAccessDate());
+  }
+  STLDeleteContainerPointers(cookies.begin(), cookies.end());
+}
+
 // Test that we can force the database to be written by calling Flush().
 TEST_F(SQLitePersistentCookieStoreTest, TestFlush) {
   // File timestamps don't work well on all platforms, so we'll determine
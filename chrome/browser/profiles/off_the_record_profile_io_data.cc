@@ -16,6 +16,7 @@
 #include "chrome/common/url_constants.h"
 #include "content/browser/browser_thread.h"
 #include "content/browser/resource_context.h"
+#include "net/base/cert_verifier.h"
 #include "net/ftp/ftp_network_layer.h"
 #include "net/http/http_cache.h"
 #include "webkit/database/database_tracker.h"
@@ -137,8 +138,8 @@ void OffTheRecordProfileIOData::LazyInitializeInternal(
 
   main_context->set_host_resolver(
       io_thread_globals->host_resolver.get());
-  main_context->set_cert_verifier(
-      io_thread_globals->cert_verifier.get());
+  cert_verifier_.reset(new net::CertVerifier);
+  main_context->set_cert_verifier(cert_verifier_.get());
   main_context->set_dnsrr_resolver(
       io_thread_globals->dnsrr_resolver.get());
   main_context->set_http_auth_handler_factory(
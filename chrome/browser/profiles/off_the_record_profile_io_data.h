@@ -17,6 +17,10 @@ class ChromeURLRequestContext;
 class ChromeURLRequestContextGetter;
 class Profile;
 
+namespace net {
+class CertVerifier;
+}  // namespace net
+
 // OffTheRecordProfile owns a OffTheRecordProfileIOData::Handle, which holds a
 // reference to the OffTheRecordProfileIOData. OffTheRecordProfileIOData is
 // intended to own all the objects owned by OffTheRecordProfile which live on
@@ -98,6 +102,9 @@ class OffTheRecordProfileIOData : public ProfileIOData {
           scoped_refptr<ChromeURLRequestContext> main_context,
           const std::string& app_id) const;
 
+  // Incognito verifies certificates on its own, so that its verification
+  // results stay out of the cache that the IOThread saves to disk.
+  mutable scoped_ptr<net::CertVerifier> cert_verifier_;
   mutable scoped_ptr<net::HttpTransactionFactory> main_http_factory_;
 
   // One HttpTransactionFactory per isolated app.
@@ -655,16 +655,17 @@ void RenderWidgetHostViewQt::UpdateContentsSize(const gfx::Size& size)
   }
 }
 
-void RenderWidgetHostViewQt::PaintTileAck(unsigned int seq, unsigned int tag, const gfx::Rect& rect, const gfx::Rect& pixmap_rect)
+void RenderWidgetHostViewQt::PaintTileAck(
+    unsigned int seq, unsigned int tag,
+    const std::vector<gfx::Rect>& rects,
+    const std::vector<gfx::Rect>& pixmap_rects)
  {
-  QRect qrect(rect.x(), rect.y(), rect.width(), rect.height());
-  QRect qpixmap_rect(pixmap_rect.x(), pixmap_rect.y(), pixmap_rect.width(), pixmap_rect.height());
   BackingStoreX* backing_store = static_cast<BackingStoreX*>(
       host_->GetBackingStore(false));
 #if defined(TILED_BACKING_STORE)
   if (backing_store)
   {
-    backing_store->PaintTilesAck(seq, tag, qrect, qpixmap_rect);
+    backing_store->PaintTilesAck(seq, tag, rects, pixmap_rects);
   }
 #endif
 }
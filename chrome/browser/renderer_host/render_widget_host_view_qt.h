@@ -110,7 +110,9 @@ class RenderWidgetHostViewQt : public RenderWidgetHostView,
   virtual void DidBackingStoreScale();
   virtual void DidBackingStorePaint(const gfx::Rect& rect);
 
-  virtual void PaintTileAck(unsigned int seq, unsigned int tag, const gfx::Rect& rect, const gfx::Rect& pixmap_rect);
+  virtual void PaintTileAck(unsigned int seq, unsigned int tag,
+                            const std::vector<gfx::Rect>& rects,
+                            const std::vector<gfx::Rect>& pixmap_rects);
 
   virtual void ScenePosChanged();
 
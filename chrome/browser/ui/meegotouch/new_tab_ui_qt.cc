@@ -104,6 +104,8 @@ public:
   {
     imageList_.clear();
     favList_.clear();
+    // images above may point into the snapshots, drop them first
+    imageSnapshots_.clear();
   }
 
   virtual QImage requestImage(const QString& id,
@@ -116,9 +118,14 @@ public:
       if (finded != -1) {
         int index = id.size() - finded - 1;
         //DLOG(INFO) <<"thumbnail query map id: " << id.right(index).toStdString();
-        QImage& image = imageList_[id.right(index)];
+        QString key = id.right(index);
+        QImage& image = imageList_[key];
         if (!image.isNull()) {
           *size = image.size();
+          // don't let a mapped image outlive its entry in |imageSnapshots_|,
+          // copying is still much cheaper than decoding
+          if (imageSnapshots_.contains(key))
+            return image.copy();
           return image;
         }
       }
@@ -140,11 +147,24 @@ public:
     }
   }
 
+  // Add a thumbnail pointing into |snapshot|, which is kept alive until the
+  // thumbnail is replaced, so a snapshot is unmapped once none of its
+  // thumbnails is shown
+  void addMappedImage(const QString& id, const QImage& image,
+                      scoped_refptr<history::ThumbnailBlobStore::Snapshot> snapshot)
+  {
+    DLOG(INFO) <<"add mapped id: " << id.toStdString();
+    imageList_.insert(id, image);
+    imageSnapshots_.insert(id, snapshot);
+  }
+
   void addImage(const QString& type, const QString& id, const QImage &image)
   {
     if(type.contains("thumbnail")) {
     DLOG(INFO) <<"add map id: " << id.toStdString();
       imageList_.insert(id, image);
+      // the previous image may be the last one in its snapshot
+      imageSnapshots_.remove(id);
     }else{
       favList_.insert(id,image);
     }
@@ -154,6 +174,9 @@ private:
   QHash<QString, QImage> imageList_;
   QHash<QString, QImage> favList_;
   QImage blankImage_;
+  // the snapshot each mapped thumbnail in |imageList_| points into
+  QHash<QString, scoped_refptr<history::ThumbnailBlobStore::Snapshot> >
+      imageSnapshots_;
 };
 
 class ThumbnailEntry
@@ -175,6 +198,9 @@ public:
  
          history::RecentAndBookmarkThumbnailsQt * recentThumbnails =
                                        ts->GetRecentAndBookmarkThumbnails();
+         if(recentThumbnails && showMappedThumbnail(recentThumbnails))
+           return;
+
          if(recentThumbnails) {
            recentThumbnails->GetRecentPageThumbnail(url, &consumer_,
                            NewCallback(static_cast<ThumbnailEntry*>(this),
@@ -197,6 +223,30 @@ public:
         handleThumbnailData(jpeg_data);
   };
 
+  // Show the decoded thumbnail straight from the mapped blob store, without
+  // a request to the thumbnail thread or a JPEG decode.
+  bool showMappedThumbnail(history::RecentAndBookmarkThumbnailsQt* recentThumbnails) {
+    scoped_refptr<history::ThumbnailBlobStore::Snapshot> snapshot =
+        recentThumbnails->GetThumbnailSnapshot();
+    if (!snapshot.get())
+      return false;
+
+    int width = 0;
+    int height = 0;
+    const uint8* pixels = snapshot->GetThumbnail(url_, &width, &height);
+    if (!pixels)
+      return false;
+
+    // QImage wraps the mapped pixels read-only, no copy is made
+    QImage image(pixels, width, height, width * 4,
+                 QImage::Format_ARGB32_Premultiplied);
+    model_->beginReset();
+    imageProvider_->addMappedImage(QString::fromStdString(url_.spec()), image,
+                                   snapshot);
+    model_->endReset();
+    return true;
+  }
+
   void handleThumbnailData(scoped_refptr<RefCountedBytes> jpeg_data) {
     model_->beginReset();
     if (jpeg_data.get()) {
@@ -163,6 +163,10 @@ const char kDisableAcceleratedVideo[]       = "disable-accelerated-video";
 // Disables the alternate window station for the renderer.
 const char kDisableAltWinstation[]          = "disable-winsta";
 
+// With --enable-async-dns, don't give the host names that the built-in DNS
+// resolver fails to resolve to the system resolver.
+const char kDisableAsyncDnsFallback[]       = "disable-async-dns-fallback";
+
 // Replaces the audio IPC layer for <audio> and <video> with a mock audio
 // device, useful when using remote desktop or machines without sound cards.
 // This is temporary until we fix the underlying problem.
@@ -360,9 +364,17 @@ const char kEnableAccelerated2dCanvas[]     = "enable-accelerated-2d-canvas";
 // Enables the hardware acceleration of plugins.
 const char kEnableAcceleratedPlugins[]      = "enable-accelerated-plugins";
 
+// Lets the socket pools give more connections to hosts that are slow to connect
+// to, and keep a connection open to the hosts that are preconnected.
+const char kEnableAdaptiveSocketPools[]     = "enable-adaptive-socket-pools";
+
 // Enables AeroPeek for each tab. (This switch only works on Windows 7).
 const char kEnableAeroPeekTabs[]            = "enable-aero-peek-tabs";
 
+// Resolves host names by sending DNS queries to the name servers of the system
+// from the IO thread, instead of calling getaddrinfo() on worker threads.
+const char kEnableAsyncDns[]                = "enable-async-dns";
+
 // Enable the inclusion of non-standard ports when generating the Kerberos SPN
 // in response to a Negotiate challenge. See HttpAuthHandlerNegotiate::CreateSPN
 // for more background.
@@ -467,6 +479,11 @@ const char kEnableResourceContentSettings[] =
 // Enable panels (always on-top docked pop-up windows).
 const char kEnablePanels[]                  = "enable-panels";
 
+// Saves the certificate verification results to disk, so that they can be
+// used after a restart.
+const char kEnablePersistentCertVerifierCache[] =
+    "enable-persistent-cert-verifier-cache";
+
 // Enable speculative TCP/IP preconnection.
 const char kEnablePreconnect[]              = "enable-preconnect";
 
@@ -596,6 +613,10 @@ const char kHomePage[]                      = "homepage";
 // proxy connection, and the endpoint host in a SOCKS proxy connection).
 const char kHostRules[]                     = "host-rules";
 
+// Serves host resolves from cache entries that expired less than this many
+// seconds ago, while they are resolved again in the background.
+const char kHostResolverMaxStaleAge[]       = "host-resolver-max-stale-age";
+
 // The maximum number of concurrent host resolve requests (i.e. DNS) to allow.
 const char kHostResolverParallelism[]       = "host-resolver-parallelism";
 
@@ -64,6 +64,7 @@ extern const char kDiagnostics[];
 extern const char kDisableAcceleratedLayers[];
 extern const char kDisableAcceleratedVideo[];
 extern const char kDisableAltWinstation[];
+extern const char kDisableAsyncDnsFallback[];
 extern const char kDisableAuthNegotiateCnameLookup[];
 extern const char kDisableBackgroundMode[];
 extern const char kDisableBackgroundNetworking[];
@@ -113,7 +114,9 @@ extern const char kDomAutomationController[];
 extern const char kDumpHistogramsOnExit[];
 extern const char kEnableAccelerated2dCanvas[];
 extern const char kEnableAcceleratedPlugins[];
+extern const char kEnableAdaptiveSocketPools[];
 extern const char kEnableAeroPeekTabs[];
+extern const char kEnableAsyncDns[];
 extern const char kEnableAuthNegotiatePort[];
 extern const char kEnableClientSidePhishingInterstitial[];
 extern const char kEnableClearServerData[];
@@ -139,6 +142,7 @@ extern const char kEnableMemoryInfo[];
 extern const char kEnableNaCl[];
 extern const char kEnableNaClDebug[];
 extern const char kEnablePanels[];
+extern const char kEnablePersistentCertVerifierCache[];
 extern const char kEnablePreconnect[];
 extern const char kEnablePrintPreview[];
 extern const char kEnableRemoting[];
@@ -174,6 +178,7 @@ extern const char kHelpShort[];
 extern const char kHideIcons[];
 extern const char kHomePage[];
 extern const char kHostRules[];
+extern const char kHostResolverMaxStaleAge[];
 extern const char kHostResolverParallelism[];
 extern const char kHostResolverRules[];
 extern const char kIgnoreGpuBlacklist[];
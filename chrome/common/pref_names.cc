@@ -243,6 +243,11 @@ const char kDnsHostReferralList[] = "HostReferralList";
 const char kDnsPrefetchingHostReferralList[] =
     "dns_prefetching.host_referral_list";
 
+// The host cache entries that were resolved last during the previous session,
+// restored to the host cache on startup.
+const char kDnsPrefetchingHostCacheList[] =
+    "dns_prefetching.host_cache_list";
+
 // Disables the SPDY protocol.
 const char kDisableSpdy[] = "spdy.disabled";
 
@@ -84,6 +84,7 @@ extern const char kDnsStartupPrefetchList[];  // OBSOLETE
 extern const char kDnsPrefetchingStartupList[];
 extern const char kDnsHostReferralList[];  // OBSOLETE
 extern const char kDnsPrefetchingHostReferralList[];
+extern const char kDnsPrefetchingHostCacheList[];
 extern const char kDisableSpdy[];
 extern const char kDisabledSchemes[];
 extern const char kInstantConfirmDialogShown[];
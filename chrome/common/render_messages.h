@@ -355,12 +355,24 @@ IPC_MESSAGE_ROUTED1(ViewMsg_SetFSPluginWinSize,
 IPC_MESSAGE_ROUTED1(ViewMsg_ResetPlugin,
                     gfx::PluginWindowHandle /* id */)
 
+// Tells the renderer about a new tile buffer slot. The renderer maps the
+// buffer once and keeps it mapped until ViewMsg_DestroyTileBuffer.
+IPC_MESSAGE_ROUTED2(ViewMsg_CreateTileBuffer,
+                    int /* slot_id */,
+                    TransportDIB::Handle /* dib_handle */)
+
+IPC_MESSAGE_ROUTED1(ViewMsg_DestroyTileBuffer,
+                    int /* slot_id */)
+
+// Paints a batch of tiles in one pass. The pixmaps of all tiles share the
+// buffer in |slot_id| as an atlas laid out by layoutTileAtlas().
 IPC_MESSAGE_ROUTED5(ViewMsg_PaintTile,
-                    TransportDIB::Handle /* dib_handle */,
+                    int /* tile buffer slot_id */,
                     unsigned int /* seq */,
                     unsigned int /* tag */,
-                    gfx::Rect /* tiles rect*/,
-                    gfx::Rect /* pixmap rect, top left point is not scaled */)
+                    std::vector<gfx::Rect> /* tile rects */,
+                    std::vector<gfx::Rect> /* pixmap rects, top left point
+                                              is not scaled */)
 
 IPC_MESSAGE_ROUTED2(ViewMsg_SetVisibleRect,
                     gfx::Rect /* cached tiles rect */,
@@ -372,11 +384,12 @@ IPC_MESSAGE_ROUTED1(ViewMsg_SetScaleFactor,
 IPC_MESSAGE_ROUTED1(ViewHostMsg_DidContentsSizeChanged,
                     gfx::Size)
 
+// Sent once all tiles of a ViewMsg_PaintTile batch are painted.
 IPC_MESSAGE_ROUTED4(ViewHostMsg_PaintTile_ACK,
                     unsigned int /* seq */,
                     unsigned int /* tag */,
-                    gfx::Rect /* painted rect */,
-                    gfx::Rect /* pixmap rect */)
+                    std::vector<gfx::Rect> /* painted rects */,
+                    std::vector<gfx::Rect> /* pixmap rects */)
 
 IPC_MESSAGE_ROUTED1(ViewHostMsg_SetScrollPosition, gfx::Point)
 
@@ -30,6 +30,8 @@
 
 #include "render_tiling.h"
 
+#include <algorithm>
+
 static int tilingInvalidateStep() 
 {
     static const int invalidateStep = 100;
@@ -48,3 +50,17 @@ float flatScaleByStep(float scale)
     int flat = (int)(scale * invalidateStep);
     return ((float)flat) / invalidateStep;
 }
+
+gfx::Size layoutTileAtlas(const std::vector<gfx::Rect>& pixmap_rects,
+                          std::vector<int>* offsets)
+{
+    int width = 0;
+    int height = 0;
+    offsets->clear();
+    for (size_t i = 0; i < pixmap_rects.size(); i++) {
+        offsets->push_back(height);
+        width = std::max(width, pixmap_rects[i].width());
+        height += pixmap_rects[i].height();
+    }
+    return gfx::Size(width, height);
+}
@@ -31,8 +31,18 @@
 #ifndef CHROME_COMMON_RENDER_TILING_H__
 #define CHROME_COMMON_RENDER_TILING_H__
 
+#include <vector>
+
+#include "ui/gfx/rect.h"
+
 int floorByStep(int point);
 
 float flatScaleByStep(float scale);
 
+// Lay out the tile pixmaps of one batched tile paint in a shared atlas. The
+// pixmaps are stacked top to bottom in order; |offsets| receives the row of
+// each pixmap in the atlas. Returns the size of the atlas.
+gfx::Size layoutTileAtlas(const std::vector<gfx::Rect>& pixmap_rects,
+                          std::vector<int>* offsets);
+
 #endif
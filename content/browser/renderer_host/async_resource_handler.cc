@@ -42,6 +42,19 @@ const int kInitialReadBufSize = 32768;
 // The maximum size of the shared memory buffer. (512 kilobytes).
 const int kMaxReadBufSize = 524288;
 
+// Returns the size of the first buffer to use for a response body of
+// |content_length| bytes that is read from the cache. Bodies of unknown
+// length start with the usual buffer and grow from there.
+int GetCachedReadBufSize(int64 content_length) {
+  if (content_length < 0)
+    return kInitialReadBufSize;
+
+  int buffer_size = kInitialReadBufSize;
+  while (buffer_size < content_length && buffer_size < kMaxReadBufSize)
+    buffer_size *= 2;
+  return buffer_size;
+}
+
 }  // namespace
 
 // Our version of IOBuffer that uses shared memory.
@@ -123,6 +136,15 @@ bool AsyncResourceHandler::OnResponseStarted(int request_id,
   LoadTimingObserver::PopulateTimingInfo(request, response);
   DevToolsNetLogObserver::PopulateResponseInfo(request, response);
 
+  // The disk cache reads the body straight into the shared memory buffer that
+  // we send to the renderer, and it can fill a buffer as big as the body right
+  // away. Start with such a buffer instead of growing it over several round
+  // trips with the renderer.
+  if (request->was_cached()) {
+    next_buffer_size_ =
+        GetCachedReadBufSize(response->response_head.content_length);
+  }
+
   ResourceDispatcherHostRequestInfo* info = rdh_->InfoForRequest(request);
   if (info->resource_type() == ResourceType::MAIN_FRAME) {
     GURL request_url(request->url());
@@ -162,7 +184,8 @@ bool AsyncResourceHandler::OnWillRead(int request_id, net::IOBuffer** buf,
                                       int* buf_size, int min_size) {
   DCHECK_EQ(-1, min_size);
 
-  if (g_spare_read_buffer) {
+  if (g_spare_read_buffer &&
+      g_spare_read_buffer->buffer_size() >= next_buffer_size_) {
     DCHECK(!read_buffer_);
     read_buffer_.swap(&g_spare_read_buffer);
     DCHECK(read_buffer_->data());
@@ -52,7 +52,8 @@ class AsyncResourceHandler : public ResourceHandler {
   // OnWillRead() call.  We exponentially grow the size of the buffer allocated
   // when our owner fills our buffers. On the first OnWillRead() call, we
   // allocate a buffer of 32k and double it in OnReadCompleted() if the buffer
-  // was filled, up to a maximum size of 512k.
+  // was filled, up to a maximum size of 512k. Responses served from the cache
+  // start with a buffer big enough for the whole body, up to the same limit.
   int next_buffer_size_;
 
   DISALLOW_COPY_AND_ASSIGN(AsyncResourceHandler);
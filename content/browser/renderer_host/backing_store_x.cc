@@ -27,7 +27,9 @@
 #include "base/compiler_specific.h"
 #include "base/logging.h"
 #include "base/metrics/histogram.h"
+#include "base/metrics/stats_counters.h"
 #include "base/time.h"
+#include "base/timer.h"
 #include "content/browser/renderer_host/render_process_host.h"
 #include "skia/ext/platform_canvas.h"
 #include "third_party/skia/include/core/SkBitmap.h"
@@ -37,9 +39,69 @@
 #include "ui/gfx/surface/transport_dib.h"
 
 #if defined(TILED_BACKING_STORE)
+#include <math.h>
+
+#include <QMultiMap>
+#include <QTransform>
+
 #include "chrome/common/render_tiling.h"
 #endif
 
+#if defined(TILED_BACKING_STORE)
+// Number of idle tile buffers kept for reuse. Each holds the atlas of a
+// whole batch of tiles, so a few cover the requests in flight.
+static const size_t kMaxFreeTileBuffers = 4;
+
+// Maximum number of tile paint requests in flight. Further tiles are held
+// back until an ack arrives so a fling cannot flood the render.
+static const int kMaxPendingTileRequests = 2;
+
+// Tile paint requests not acked within this many milliseconds are given up,
+// so that a lost ack does not hold back the deferred tiles forever.
+static const int kTilePaintRequestTimeoutMs = 2000;
+
+// Maximum number of tiles outside the visible rect painted in one request.
+static const int kMaxTilesPerPaintRequest = 4;
+
+// How far ahead in seconds the scroll path is predicted from the velocity.
+static const qreal kPrefetchLookahead = 0.5;
+
+// Number of power of two pyramid levels below the current scale that are
+// kept up to date, and the smallest level scale (2^-3).
+static const int kPyramidLevels = 2;
+static const int kMinPyramidExponent = -3;
+
+// Scale of the pyramid level |exponent|
+static float PyramidScale(int exponent)
+{
+  return ldexpf(1.0f, exponent);
+}
+
+// Exponent of the largest power of two strictly below |scale|
+static int PyramidTopExponent(float scale)
+{
+  return static_cast<int>(ceilf(log2f(scale))) - 1;
+}
+
+// Map |rect| in coordinates at scale |from| to coordinates at scale |to|
+static QRectF MapBetweenScales(const QRectF& rect, float from, float to)
+{
+  qreal factor = to / from;
+  return QRectF(rect.x() * factor, rect.y() * factor,
+                rect.width() * factor, rect.height() * factor);
+}
+
+// Largest integer rect inside |rect|
+static QRect InnerRect(const QRectF& rect)
+{
+  int left = static_cast<int>(ceil(rect.left()));
+  int top = static_cast<int>(ceil(rect.top()));
+  int right = static_cast<int>(floor(rect.right()));
+  int bottom = static_cast<int>(floor(rect.bottom()));
+  return QRect(QPoint(left, top), QPoint(right - 1, bottom - 1));
+}
+#endif
+
 // Assume that somewhere along the line, someone will do width * height * 4
 // with signed numbers. If the maximum value is 2**31, then 2**31 / 4 =
 // 2**29 and floor(sqrt(2**29)) = 23170.
@@ -107,7 +169,11 @@ BackingStoreX::BackingStoreX(RenderWidgetHost* widget,
   tiles_paint_tag_ = 1;
   contents_scale_ = 1.0;
   pending_scaling_ = false;
+  front_scale_ = 1.0;
   frozen_ = false;
+  tiles_shown_ = 0;
+  tiles_shown_unpainted_ = 0;
+  tile_buffer_pool_.reset(new TileBufferPool(this, kMaxFreeTileBuffers));
 #endif
 }
 
@@ -135,7 +201,10 @@ BackingStoreX::~BackingStoreX() {
   XFreePixmap(display_, pixmap_);
   XFreeGC(display_, static_cast<GC>(pixmap_gc_));
 #else
-  
+  // Tell the render to unmap the tile buffers while we can still call back
+  // into TileBufferCreated/Destroyed.
+  tile_buffer_pool_.reset();
+  ClearPyramid();
 #endif
 }
 
@@ -746,6 +815,11 @@ void BackingStoreX::QPainterShowRect(QPainter *painter, QRectF &rect) {
   TileIndex first = GetTileIndexFrom(dirty_rect.topLeft());
   TileIndex last = GetTileIndexFrom(dirty_rect.bottomRight());
 
+  // the counters look their names up when built, so build them once
+  base::StatsCounter shown_counter("TiledBackingStore.TilesShown");
+  base::StatsCounter unpainted_counter(
+      "TiledBackingStore.TilesShownUnpainted");
+
   for (int x = first.x(); x <= last.x(); x++)
   {
     for (int y = first.y(); y <= last.y(); y++)
@@ -753,18 +827,24 @@ void BackingStoreX::QPainterShowRect(QPainter *painter, QRectF &rect) {
       TileIndex index(x, y);
       // Always use front tiles map
       scoped_refptr<Tile> tile = tiles_map_.value(index);
+      tiles_shown_++;
+      shown_counter.Increment();
+      if (!tile.get() || tile->PrevRect() != tile->Rect())
+      {
+        tiles_shown_unpainted_++;
+        unpainted_counter.Increment();
+
+        // fill what is not painted yet from the lower resolution copies
+        QRect rect(x * kTileSize.width(), y * kTileSize.height(),
+                   kTileSize.width(), kTileSize.height());
+        PaintFromPyramid(painter, rect.intersected(dirty_rect), front_scale_);
+      }
+
       if (tile.get())
       {
         DLOG(INFO) << "Paint Tile " << x << " " << y;
         tile->QPainterShowRect(painter, dirty_rect);
       }
-      else
-      {
-        DLOG(INFO) << "Paint Checker " << x << " " << y;
-        QRect rect(x * kTileSize.width(), y * kTileSize.height(),
-                   kTileSize.width(), kTileSize.height());
-        paintTileBackground(painter, rect, dirty_rect);
-      }
     }
   }
 
@@ -816,7 +896,8 @@ BackingStoreX::Tile::Tile(const TileIndex& index, const QRect& rect):
     index_(index),
     curr_rect_(rect),
     paint_request_(false),
-    pixmap_(NULL)
+    pixmap_(NULL),
+    cache_id_(TileCache::kInvalidTileId)
 {
   DLOG(INFO) << "Tile create for " << this << " " << "[" << index_.x() << ", " << index_.y() << "]";
   pixmap_ = new QPixmap(kTileSize.width(), kTileSize.height());
@@ -825,9 +906,16 @@ BackingStoreX::Tile::Tile(const TileIndex& index, const QRect& rect):
 BackingStoreX::Tile::~Tile()
 {
   DLOG(INFO) << "Tile delete for " << this << " " << "[" << index_.x() << ", " << index_.y() << "]";
+  if (cache_id_ != TileCache::kInvalidTileId)
+    TileCache::GetInstance()->RemoveTile(cache_id_);
   delete pixmap_;
 }
 
+size_t BackingStoreX::Tile::MemorySize()
+{
+  return pixmap_->width() * pixmap_->height() * 4;
+}
+
 // check whether we need send paint request to rendering process
 // when prev_rect is not equal to curr_rect_
 bool BackingStoreX::Tile::NeedPaintRequest()
@@ -844,11 +932,11 @@ void BackingStoreX::Tile::QPainterShowRect(QPainter* painter,
 {
   DCHECK(pixmap_);
 
-  if (curr_rect_ != prev_rect_) {
-    DLOG(INFO) << "paint checker in Tile::QPainterShowRect: " << index_.x() << ", " << index_.y();
-    paintTileBackground(painter, curr_rect_, rect);
-  }
+  if (cache_id_ != TileCache::kInvalidTileId)
+    TileCache::GetInstance()->TouchTile(cache_id_);
 
+  // BackingStoreX has painted the pyramid or checkers below if
+  // curr_rect_ != prev_rect_.
   // to paint previous pixmap content, this can
   // help user see many checkers unnecessarily
   QRect target = rect.intersected(prev_rect_);
@@ -928,11 +1016,30 @@ QRect BackingStoreX::GetCachedRect()
                     grect.y() - dy,
                     grect.width() + 2 * dx,
                     grect.height() + 2 * dy);
+
+  // Stretch the cached rect towards where a fling is heading
+  QPoint ahead = GetPredictedScrollOffset(QSize(grect.width(), grect.height()));
+  cached_rect = cached_rect.united(cached_rect.translated(ahead));
+
   return cached_rect.intersected(ContentsRect());
 }
 
+QPoint BackingStoreX::GetPredictedScrollOffset(const QSize& visible_size)
+{
+  qreal dx = scroll_velocity_.x() * kPrefetchLookahead;
+  qreal dy = scroll_velocity_.y() * kPrefetchLookahead;
+  dx = qBound(qreal(-visible_size.width()), dx, qreal(visible_size.width()));
+  dy = qBound(qreal(-visible_size.height()), dy, qreal(visible_size.height()));
+  return QPoint(static_cast<int>(dx), static_cast<int>(dy));
+}
+
 void BackingStoreX::AdjustTiles(bool recreate, bool least_request, const gfx::Rect &update_rect)
 {
+  // make room for new requests before deciding which tiles to defer; this
+  // also runs while frozen, so that the paint timer stops once the requests
+  // in flight are acked or expired
+  ExpireTilesPaintRequests();
+
   if (frozen_)
     return;
 
@@ -940,6 +1047,12 @@ void BackingStoreX::AdjustTiles(bool recreate, bool least_request, const gfx::Re
 
   QRect cached_rect = GetCachedRect();
 
+  // contents are laid out again, the pyramid is stale
+  if (recreate)
+    ClearPyramid();
+  else
+    PrunePyramid(cached_rect, flatScaleByStep(contents_scale_));
+
   DLOG(INFO) << "TiledBackingStore::AdjustTiles cached_rect"
              << " " << cached_rect.x()
              << " " << cached_rect.y()
@@ -1006,6 +1119,8 @@ void BackingStoreX::AdjustTiles(bool recreate, bool least_request, const gfx::Re
   // Create tiles
   QVector<scoped_refptr<Tile> > visible_tiles;
   QVector<scoped_refptr<Tile> > other_tiles;
+  QSet<TileIndex> deferred_tiles = deferred_tiles_;
+  deferred_tiles_.clear();
   DLOG(INFO) << "Cached tiles index " << first.x() << " " << first.y()
              << " " << last.x() << " " << last.y();
   QRect qupdate(update_rect.x(),
@@ -1041,15 +1156,14 @@ void BackingStoreX::AdjustTiles(bool recreate, bool least_request, const gfx::Re
         }
       } else if (recreate ||
           //(!recreate && tile->PrevRect() != tile->Rect())) {
-          (!recreate && tile->NeedPaintRequest())) {
+          (!recreate && tile->NeedPaintRequest()) ||
+          deferred_tiles.contains(index)) {
         // recreate is true to trigger to send all tiles request
         // or is not true and has a new rect change for the tile
         // then need paint request
-        // paint request is sent if needed
-        // we have to set whether the request is sent for this case.
-        // If we don't do that, for flick, a pixel change causes paint operation
-        // so it will send request again and again 
-        tile->SetPaintRequest(true);
+        // or the request was held back last time
+        // PaintTilesRequest marks the tile as requested so that, for flick,
+        // a pixel change doesn't send the request again and again
         if (visible_qrect.intersects(tile->Rect())) {
           visible_tiles.append(tile);
         } else {
@@ -1067,62 +1181,97 @@ void BackingStoreX::AdjustTiles(bool recreate, bool least_request, const gfx::Re
 
   if (other_tiles.isEmpty())
     return;
-    
-  // paint other tiles one by one
-  unsigned size = other_tiles.size();
-  for (unsigned n = 0; n < size; ++n)
+
+  // order other tiles by distance to where the visible rect is predicted
+  // to be, so tiles along the scroll path are requested first
+  QPoint predicted_center =
+      visible_qrect.translated(
+          GetPredictedScrollOffset(visible_qrect.size())).center();
+  QMultiMap<int, scoped_refptr<Tile> > ordered_tiles;
+  for (int n = 0; n < other_tiles.size(); ++n)
+  {
+    int distance =
+        (other_tiles[n]->Rect().center() - predicted_center).manhattanLength();
+    ordered_tiles.insert(distance, other_tiles[n]);
+  }
+
+  // paint other tiles in batches, nearest first
+  QVector<scoped_refptr<Tile> > batch;
+  QMultiMap<int, scoped_refptr<Tile> >::iterator it = ordered_tiles.begin();
+  for (; it != ordered_tiles.end(); ++it)
   {
-    QVector<scoped_refptr<Tile> > tile;
-    tile.append(other_tiles[n]);
-    PaintTilesRequest(tile);
+    if (tiles_paint_map_.size() >= kMaxPendingTileRequests)
+    {
+      // picked up again by AdjustTiles once an ack arrives
+      deferred_tiles_.insert(it.value()->Index());
+      continue;
+    }
+    batch.append(it.value());
+    if (batch.size() == kMaxTilesPerPaintRequest)
+    {
+      PaintTilesRequest(batch);
+      batch.clear();
+    }
   }
+  if (!batch.isEmpty())
+    PaintTilesRequest(batch);
 }
 
 void BackingStoreX::PaintTilesAck(unsigned int seq,
                                   unsigned int tag,
-                                  const QRect& rect,
-                                  const QRect& pixmap_rect)
+                                  const std::vector<gfx::Rect>& rects,
+                                  const std::vector<gfx::Rect>& pixmap_rects)
 {
   if (pending_scaling_ && seq == tiles_map_seq_)
   {
     //This is the first update for new tiles
     //swap to front
-    tiles_map_.clear();
-    tiles_map_ = scaling_tiles_map_;
-    scaling_tiles_map_.clear();
-    pending_scaling_ = false;
-    render_widget_host_->view()->DidBackingStoreScale();
+    SwapScalingTiles();
   }
 
   if (seq < tiles_map_seq_)
   {
     //discard old tile paint
-    TilePaintRequest request = tiles_paint_map_.value(tag);
-    if (request.tiles.size() == 0)
-      return;
-    delete tiles_paint_map_[tag].dib;
-    tiles_paint_map_.remove(tag);
+    DropTilesPaintRequest(tag);
     return;
   }
   
   LOG(INFO) << "TiledBackingStore::paintTileAck " << tag
-            << " " << rect.x() << " " << rect.y() << " " << rect.width() << " " << rect.height()
-            << " " << pixmap_rect.x() << " " << pixmap_rect.y()
-            << " " << pixmap_rect.width() << " " << pixmap_rect.height();
+            << " " << rects.size() << " tiles";
 
   const TilePaintRequest request = tiles_paint_map_.value(tag);
   if (request.tiles.size() == 0)
     return;
 
+  // an empty ack means the render could not paint the tiles
+  if (rects.empty())
+  {
+    DropTilesPaintRequest(tag);
+    return;
+  }
+
+  if (static_cast<size_t>(request.tiles.size()) != rects.size() ||
+      rects.size() != pixmap_rects.size())
+  {
+    NOTREACHED() << "Tile paint ack does not match request " << tag;
+    DropTilesPaintRequest(tag);
+    return;
+  }
+
   Pixmap pixmap;
 
-  const int width = rect.width();
-  const int height = rect.height();
+  // all tiles of the request come back in one atlas
+  std::vector<int> offsets;
+  gfx::Size atlas_size = layoutTileAtlas(pixmap_rects, &offsets);
+  const int width = atlas_size.width();
+  const int height = atlas_size.height();
 
-  TransportDIB* dib = request.dib;
+  TransportDIB* dib = tile_buffer_pool_->GetBuffer(request.slot_id);
   if (!dib)
+  {
+    DropTilesPaintRequest(tag);
     return;
-
+  }
 
   if (shared_memory_support_ == ui::SHARED_MEMORY_PIXMAP) {
     XShmSegmentInfo shminfo = {0};
@@ -1222,9 +1371,18 @@ void BackingStoreX::PaintTilesAck(unsigned int seq,
     counter++;
 #endif
 
+  QRect painted_rect;
   for (int i = 0; i < request.tiles.size(); i++)
   {
+    QRect rect(rects[i].x(), rects[i].y(),
+               rects[i].width(), rects[i].height());
+    // position of the atlas, as if it were the pixmap of this tile alone
+    QRect pixmap_rect(pixmap_rects[i].x(), pixmap_rects[i].y() - offsets[i],
+                      width, height);
     request.tiles[i]->PaintToBackingStore(qpixmap, pixmap_rect, rect);
+    UpdatePyramid(qpixmap, pixmap_rect, rect,
+                  flatScaleByStep(contents_scale_));
+    painted_rect = painted_rect.united(rect);
   }
   
   // In the case of shared memory, we wait for the composite to complete so that
@@ -1233,20 +1391,321 @@ void BackingStoreX::PaintTilesAck(unsigned int seq,
   if (shared_memory_support_ != ui::SHARED_MEMORY_NONE)
     XSync(display_, False);
 
-  delete tiles_paint_map_[tag].dib;
+  tile_buffer_pool_->Release(request.slot_id);
   tiles_paint_map_.remove(tag);
   XFreePixmap(display_, pixmap);
 
-  gfx::Rect grect(rect.x(), rect.y(), rect.width(), rect.height());
+  if (!deferred_tiles_.isEmpty())
+    AdjustTiles();
+
+  gfx::Rect grect(painted_rect.x(), painted_rect.y(),
+                  painted_rect.width(), painted_rect.height());
   render_widget_host_->view()->DidBackingStorePaint(grect);
 }
 
+void BackingStoreX::DropTilesPaintRequest(unsigned int tag)
+{
+  if (!ReleaseTilesPaintRequest(tag))
+    return;
+  if (!deferred_tiles_.isEmpty())
+    AdjustTiles();
+}
+
+bool BackingStoreX::ReleaseTilesPaintRequest(unsigned int tag)
+{
+  TilePaintRequest request = tiles_paint_map_.take(tag);
+  if (request.tiles.size() == 0)
+    return false;
+  tile_buffer_pool_->Release(request.slot_id);
+
+  // let the next AdjustTiles request the tiles again
+  for (int i = 0; i < request.tiles.size(); i++)
+    request.tiles[i]->SetPaintRequest(false);
+  return true;
+}
+
+void BackingStoreX::ExpireTilesPaintRequests()
+{
+  // The render handles paint requests in order, so a released buffer is
+  // only reused by a request it paints after the expired one; a late ack
+  // finds no request and is ignored.
+  base::TimeTicks expire_time = base::TimeTicks::Now() -
+      base::TimeDelta::FromMilliseconds(kTilePaintRequestTimeoutMs);
+  QList<unsigned int> expired;
+  TilePaintMap::const_iterator it = tiles_paint_map_.constBegin();
+  for (; it != tiles_paint_map_.constEnd(); ++it)
+  {
+    if (it.value().seq < tiles_map_seq_ ||
+        it.value().request_time < expire_time)
+      expired.append(it.key());
+  }
+  for (int i = 0; i < expired.size(); i++)
+    ReleaseTilesPaintRequest(expired[i]);
+}
+
+void BackingStoreX::OnTilesPaintRequestTimeout()
+{
+  if (tiles_paint_map_.isEmpty())
+    return;
+  AdjustTiles();
+  // wait for the requests still in flight
+  if (!tiles_paint_map_.isEmpty() && !tiles_paint_timer_.IsRunning())
+    StartTilesPaintTimer();
+}
+
+void BackingStoreX::StartTilesPaintTimer()
+{
+  tiles_paint_timer_.Start(
+      base::TimeDelta::FromMilliseconds(kTilePaintRequestTimeoutMs),
+      this, &BackingStoreX::OnTilesPaintRequestTimeout);
+}
+
 void BackingStoreX::SetContentsScale(float scale)
 {
   contents_scale_ = scale;
   pending_scaling_ = true;
   tiles_map_seq_++;
   AdjustTiles();
+
+  // If the pyramid can stand in for the whole visible rect, show the new
+  // scale right away and let the tiles fill in behind it
+  gfx::Rect visible = render_widget_host_->view()->GetVisibleRect();
+  QRect visible_rect(visible.x(), visible.y(),
+                     visible.width(), visible.height());
+  if (pending_scaling_ && !frozen_ &&
+      PyramidCovers(visible_rect.intersected(ContentsRect()),
+                    flatScaleByStep(contents_scale_)))
+    SwapScalingTiles();
+}
+
+void BackingStoreX::SwapScalingTiles()
+{
+  tiles_map_.clear();
+  tiles_map_ = scaling_tiles_map_;
+  scaling_tiles_map_.clear();
+  pending_scaling_ = false;
+  front_scale_ = flatScaleByStep(contents_scale_);
+  render_widget_host_->view()->DidBackingStoreScale();
+}
+
+void BackingStoreX::UpdatePyramid(const QPixmap& bitmap,
+                                  const QRect& bitmap_rect,
+                                  const QRect& rect,
+                                  float scale)
+{
+  // Only the top level is downscaled from the tile. Each level below is
+  // downscaled from the level above, which has a quarter of the pixels.
+  int top = PyramidTopExponent(scale);
+  if (top < kMinPyramidExponent)
+    return;
+  PaintIntoPyramidLevel(top, bitmap, bitmap_rect, rect, scale);
+  pyramid_[top].painted +=
+      InnerRect(MapBetweenScales(rect, scale, PyramidScale(top)));
+
+  for (int exponent = top - 1;
+       exponent > top - kPyramidLevels && exponent >= kMinPyramidExponent;
+       exponent--)
+  {
+    float upper_scale = PyramidScale(exponent + 1);
+    QRect upper_rect =
+        MapBetweenScales(rect, scale, upper_scale).toAlignedRect();
+    const PyramidLevel& upper = pyramid_[exponent + 1];
+
+    // Collect the sources first: creating tiles below may evict tiles of the
+    // upper level. QPixmap is implicitly shared, so this copies no pixels.
+    QList<QPair<QRect, QPixmap> > sources;
+    TileIndex first = GetTileIndexFrom(upper_rect.topLeft());
+    TileIndex last = GetTileIndexFrom(upper_rect.bottomRight());
+    for (int x = first.x(); x <= last.x(); x++)
+    {
+      for (int y = first.y(); y <= last.y(); y++)
+      {
+        QHash<TileIndex, PyramidTile>::const_iterator tile =
+            upper.tiles.constFind(TileIndex(x, y));
+        if (tile == upper.tiles.constEnd())
+          continue;
+        QRect tile_rect(x * kTileSize.width(), y * kTileSize.height(),
+                        kTileSize.width(), kTileSize.height());
+        sources.append(qMakePair(tile_rect, tile.value().pixmap));
+      }
+    }
+    for (int i = 0; i < sources.size(); i++)
+    {
+      const QRect& tile_rect = sources[i].first;
+      PaintIntoPyramidLevel(exponent, sources[i].second, tile_rect,
+                            upper_rect.intersected(tile_rect), upper_scale);
+    }
+
+    // edges are blended with pixels outside |rect|, don't trust them
+    pyramid_[exponent].painted +=
+        InnerRect(MapBetweenScales(rect, scale, PyramidScale(exponent)));
+  }
+}
+
+void BackingStoreX::PaintIntoPyramidLevel(int exponent,
+                                          const QPixmap& bitmap,
+                                          const QRect& bitmap_rect,
+                                          const QRect& rect,
+                                          float scale)
+{
+  QRectF source(rect.x() - bitmap_rect.x(),
+                rect.y() - bitmap_rect.y(),
+                rect.width(),
+                rect.height());
+  QRectF target = MapBetweenScales(rect, scale, PyramidScale(exponent));
+
+  TileIndex first = GetTileIndexFrom(target.toAlignedRect().topLeft());
+  TileIndex last = GetTileIndexFrom(target.toAlignedRect().bottomRight());
+  for (int x = first.x(); x <= last.x(); x++)
+  {
+    for (int y = first.y(); y <= last.y(); y++)
+    {
+      TileIndex index(x, y);
+      if (!pyramid_[exponent].tiles.contains(index))
+      {
+        // account the tile against the browser wide tile budget first, this
+        // may evict other tiles of this level
+        int cache_id = TileCache::GetInstance()->AddTile(
+            this, kTileSize.width() * kTileSize.height() * 4);
+        PyramidTile tile;
+        tile.pixmap = QPixmap(kTileSize);
+        tile.cache_id = cache_id;
+        pyramid_[exponent].tiles.insert(index, tile);
+      }
+      PyramidTile& tile = pyramid_[exponent].tiles[index];
+      TileCache::GetInstance()->TouchTile(tile.cache_id);
+      QPainter painter(&tile.pixmap);
+      painter.setRenderHint(QPainter::SmoothPixmapTransform);
+      painter.drawPixmap(target.translated(-x * kTileSize.width(),
+                                           -y * kTileSize.height()),
+                         bitmap, source);
+    }
+  }
+}
+
+void BackingStoreX::PaintFromPyramid(QPainter* painter,
+                                     const QRect& rect,
+                                     float scale)
+{
+  if (rect.isEmpty())
+    return;
+
+  QRegion remaining(rect);
+  Pyramid::iterator it = pyramid_.end();
+  while (it != pyramid_.begin() && !remaining.isEmpty())
+  {
+    // from the finest level to the coarsest one
+    --it;
+    float level_scale = PyramidScale(it.key());
+    PyramidLevel& level = it.value();
+
+    QTransform to_level = QTransform::fromScale(level_scale / scale,
+                                                level_scale / scale);
+    QTransform from_level = to_level.inverted();
+    QRegion covered = from_level.map(level.painted) & remaining;
+    if (covered.isEmpty())
+      continue;
+
+    painter->save();
+    painter->setClipRegion(covered, Qt::IntersectClip);
+    painter->setRenderHint(QPainter::SmoothPixmapTransform);
+    QRect level_rect = to_level.mapRect(covered.boundingRect());
+    TileIndex first = GetTileIndexFrom(level_rect.topLeft());
+    TileIndex last = GetTileIndexFrom(level_rect.bottomRight());
+    for (int x = first.x(); x <= last.x(); x++)
+    {
+      for (int y = first.y(); y <= last.y(); y++)
+      {
+        QHash<TileIndex, PyramidTile>::const_iterator tile =
+            level.tiles.constFind(TileIndex(x, y));
+        if (tile == level.tiles.constEnd())
+          continue;
+        TileCache::GetInstance()->TouchTile(tile.value().cache_id);
+        QRectF tile_rect(x * kTileSize.width(), y * kTileSize.height(),
+                         kTileSize.width(), kTileSize.height());
+        painter->drawPixmap(MapBetweenScales(tile_rect, level_scale, scale),
+                            tile.value().pixmap,
+                            QRectF(QPointF(0, 0), kTileSize));
+      }
+    }
+    painter->restore();
+
+    remaining -= covered;
+  }
+
+  QVector<QRect> checkers = remaining.rects();
+  for (int i = 0; i < checkers.size(); i++)
+    paintTileBackground(painter, checkers[i], rect);
+}
+
+bool BackingStoreX::PyramidCovers(const QRect& rect, float scale)
+{
+  QRegion remaining(rect);
+  for (Pyramid::iterator it = pyramid_.begin(); it != pyramid_.end(); ++it)
+  {
+    QTransform from_level = QTransform::fromScale(
+        scale / PyramidScale(it.key()), scale / PyramidScale(it.key()));
+    remaining -= from_level.map(it.value().painted);
+  }
+  return remaining.isEmpty();
+}
+
+// static
+bool BackingStoreX::KeepsPyramidLevel(int exponent, float scale)
+{
+  // UpdatePyramid() paints the top level and the kPyramidLevels - 1 below it
+  int top = PyramidTopExponent(scale);
+  return exponent <= top + 1 && exponent > top - kPyramidLevels;
+}
+
+void BackingStoreX::PrunePyramid(const QRect& rect, float scale)
+{
+  Pyramid::iterator it = pyramid_.begin();
+  while (it != pyramid_.end())
+  {
+    if (!KeepsPyramidLevel(it.key(), scale))
+    {
+      RemovePyramidTiles(it.value());
+      it = pyramid_.erase(it);
+      continue;
+    }
+
+    float level_scale = PyramidScale(it.key());
+    QRect level_rect =
+        MapBetweenScales(rect, scale, level_scale).toAlignedRect();
+    PyramidLevel& level = it.value();
+    QHash<TileIndex, PyramidTile>::iterator tile = level.tiles.begin();
+    while (tile != level.tiles.end())
+    {
+      QRect tile_rect(tile.key().x() * kTileSize.width(),
+                      tile.key().y() * kTileSize.height(),
+                      kTileSize.width(), kTileSize.height());
+      if (!level_rect.intersects(tile_rect))
+      {
+        TileCache::GetInstance()->RemoveTile(tile.value().cache_id);
+        level.painted -= tile_rect;
+        tile = level.tiles.erase(tile);
+        continue;
+      }
+      ++tile;
+    }
+    ++it;
+  }
+}
+
+void BackingStoreX::RemovePyramidTiles(const PyramidLevel& level)
+{
+  QHash<TileIndex, PyramidTile>::const_iterator tile =
+      level.tiles.constBegin();
+  for (; tile != level.tiles.constEnd(); ++tile)
+    TileCache::GetInstance()->RemoveTile(tile.value().cache_id);
+}
+
+void BackingStoreX::ClearPyramid()
+{
+  for (Pyramid::iterator it = pyramid_.begin(); it != pyramid_.end(); ++it)
+    RemovePyramidTiles(it.value());
+  pyramid_.clear();
 }
 
 void BackingStoreX::SetFrozen(bool frozen)
@@ -1258,16 +1717,58 @@ void BackingStoreX::SetFrozen(bool frozen)
   frozen_ = frozen;
 }
 
+void BackingStoreX::SetScrollVelocity(const QPointF& velocity)
+{
+  scroll_velocity_ = velocity;
+}
+
 void BackingStoreX::PaintTilesRequest(QVector<scoped_refptr<Tile> >& tiles)
 {
-  QRect rect;
-  for (unsigned i = 0; i < tiles.size(); i++)
+  std::vector<gfx::Rect> rects;
+  std::vector<gfx::Rect> pixmap_rects;
+  for (int i = 0; i < tiles.size(); i++)
   {
-    rect = rect.united(tiles[i]->Rect());
+    tiles[i]->SetPaintRequest(true);
+    QRect rect = tiles[i]->Rect();
+    rects.push_back(gfx::Rect(rect.x(), rect.y(), rect.width(), rect.height()));
+    pixmap_rects.push_back(GetTilePixmapRect(rect));
     DLOG(INFO) << "PaintTilesRequest for " << tiles[i]->Index().x() << " " << tiles[i]->Index().y();
   }
 
+  // the render paints all tiles of the request into one atlas
+  std::vector<int> offsets;
+  gfx::Size atlas_size = layoutTileAtlas(pixmap_rects, &offsets);
+
+  TilePaintRequest request;
+  request.slot_id = tile_buffer_pool_->Acquire(
+      atlas_size.width() * atlas_size.height() * 4);
+  if (request.slot_id == TileBufferPool::kInvalidSlot)
+  {
+    // let the next AdjustTiles retry these tiles
+    for (int i = 0; i < tiles.size(); i++)
+      tiles[i]->SetPaintRequest(false);
+    return;
+  }
+  
+  request.tiles = tiles;
+  request.seq = tiles_map_seq_;
+  request.request_time = base::TimeTicks::Now();
+
+  tiles_paint_map_.insert(tiles_paint_tag_, request);
+  if (!tiles_paint_timer_.IsRunning())
+    StartTilesPaintTimer();
+
+  render_widget_host_->PaintTile(request.slot_id,
+                                 tiles_map_seq_,
+                                 tiles_paint_tag_,
+                                 rects,
+                                 pixmap_rects);
+
+  tiles_paint_tag_++;
+}
 
+gfx::Rect BackingStoreX::GetTilePixmapRect(const QRect& rect)
+{
   //the top left point of pixmap_rect is in the content coordinate system
   //but the width and height of pixmap_rect is scaled so it's in the browser UI
   //scaled coordinate system. When returning pixmaps from render, the top left 
@@ -1284,23 +1785,64 @@ void BackingStoreX::PaintTilesRequest(QVector<scoped_refptr<Tile> >& tiles)
   pixmap_rect.set_y(floorY);
   pixmap_rect.set_width(rect.width() + incX + 2);
   pixmap_rect.set_height(rect.height() + incY + 2);
+  return pixmap_rect;
+}
 
-  TilePaintRequest request;
-  request.dib = TransportDIB::Create(pixmap_rect.width() * pixmap_rect.height() * 4, tiles_paint_tag_);
-  DCHECK(request.dib);
-  
-  request.tiles = tiles;
+size_t BackingStoreX::TilesMemorySize()
+{
+  // includes the pyramid tiles
+  return TileCache::GetInstance()->MemorySizeForClient(this);
+}
 
-  tiles_paint_map_.insert(tiles_paint_tag_, request);
-  gfx::Rect grect(rect.x(), rect.y(), rect.width(), rect.height());
+bool BackingStoreX::IsTileClientVisible()
+{
+  return !render_widget_host_->is_hidden();
+}
 
-  render_widget_host_->PaintTile(request.dib->handle(),
-                                 tiles_map_seq_,
-                                 tiles_paint_tag_,
-                                 grect,
-                                 pixmap_rect);
+void BackingStoreX::EvictTile(int tile_id)
+{
+  TilesMap* maps[] = { &tiles_map_, &scaling_tiles_map_ };
+  for (size_t i = 0; i < arraysize(maps); i++)
+  {
+    for (TilesMap::iterator itr = maps[i]->begin(); itr != maps[i]->end(); ++itr)
+    {
+      if (itr.value()->CacheId() == tile_id)
+      {
+        // the cache has already forgotten the tile
+        itr.value()->SetCacheId(TileCache::kInvalidTileId);
+        maps[i]->erase(itr);
+        return;
+      }
+    }
+  }
 
-  tiles_paint_tag_++;
+  for (Pyramid::iterator it = pyramid_.begin(); it != pyramid_.end(); ++it)
+  {
+    PyramidLevel& level = it.value();
+    QHash<TileIndex, PyramidTile>::iterator tile = level.tiles.begin();
+    for (; tile != level.tiles.end(); ++tile)
+    {
+      if (tile.value().cache_id == tile_id)
+      {
+        level.painted -= QRect(tile.key().x() * kTileSize.width(),
+                               tile.key().y() * kTileSize.height(),
+                               kTileSize.width(), kTileSize.height());
+        level.tiles.erase(tile);
+        return;
+      }
+    }
+  }
+}
+
+void BackingStoreX::TileBufferCreated(int slot_id,
+                                      TransportDIB::Handle handle)
+{
+  render_widget_host_->CreateTileBuffer(slot_id, handle);
+}
+
+void BackingStoreX::TileBufferDestroyed(int slot_id)
+{
+  render_widget_host_->DestroyTileBuffer(slot_id);
 }
 
 BackingStoreX::TilesMap& BackingStoreX::GetWorkingTilesMap()
@@ -1322,8 +1864,12 @@ scoped_refptr<BackingStoreX::Tile> BackingStoreX::GetTileAt(const TileIndex& ind
 
 scoped_refptr<BackingStoreX::Tile> BackingStoreX::CreateTileAt(const TileIndex& index)
 {
-  GetWorkingTilesMap().insert(index, new Tile(index, GetTileRectAt(index)));
-  return GetTileAt(index);
+  scoped_refptr<Tile> tile = new Tile(index, GetTileRectAt(index));
+  GetWorkingTilesMap().insert(index, tile);
+  // account the tile against the browser wide tile budget, this may evict
+  // least recently used tiles of this or other backing stores
+  tile->SetCacheId(TileCache::GetInstance()->AddTile(this, tile->MemorySize()));
+  return tile;
 }
 
 void BackingStoreX::DeleteTileAt(const TileIndex& index)
@@ -6,19 +6,29 @@
 #define CONTENT_BROWSER_RENDERER_HOST_BACKING_STORE_X_H_
 #pragma once
 
+#include <vector>
+
 #if defined(TOOLKIT_MEEGOTOUCH)
 #include <QPainter>
 #include <QPixmap>
 #include <QRectF>
 #include <QHash>
+#include <QMap>
 #include <QPair>
+#include <QPointF>
+#include <QRegion>
+#include <QSet>
 #endif
 
 #include "base/basictypes.h"
 #include "build/build_config.h"
 #include "base/memory/ref_counted.h"
 #include "base/scoped_ptr.h"
+#include "base/time.h"
+#include "base/timer.h"
 #include "content/browser/renderer_host/backing_store.h"
+#include "content/browser/renderer_host/tile_buffer_pool.h"
+#include "content/browser/renderer_host/tile_cache.h"
 #include "ui/base/x/x11_util.h"
 
 namespace gfx {
@@ -31,7 +41,12 @@ class SkBitmap;
 
 #define TILED_BACKING_STORE
 
-class BackingStoreX : public BackingStore {
+class BackingStoreX : public BackingStore
+#if defined(TILED_BACKING_STORE)
+                    , public TileBufferPool::Delegate
+                    , public TileCache::Client
+#endif
+{
  public:
   // Create a backing store on the X server. The visual is an Xlib Visual
   // describing the format of the target window and the depth is the color
@@ -81,8 +96,11 @@ class BackingStoreX : public BackingStore {
                    bool least_request = false,
                    const gfx::Rect &update_rect = gfx::Rect(0, 0, 0, 0));
 
-  // Handle tiles painting tiles ack from render
-  void PaintTilesAck(unsigned int seq, unsigned int tag, const QRect& rect, const QRect& pixmap_rect);
+  // Handle tiles painting tiles ack from render, with one painted rect and
+  // one pixmap rect per tile of the request
+  void PaintTilesAck(unsigned int seq, unsigned int tag,
+                     const std::vector<gfx::Rect>& rects,
+                     const std::vector<gfx::Rect>& pixmap_rects);
 
   // Set content scale
   void SetContentsScale(float);
@@ -90,8 +108,32 @@ class BackingStoreX : public BackingStore {
   // Set frozen
   void SetFrozen(bool);
 
+  // Set kinetic scrolling velocity in pixels per second, used to request
+  // tiles along the predicted scroll path first
+  void SetScrollVelocity(const QPointF& velocity);
+
+  // Tiles drawn to screen, and those of them that were not painted yet
+  // and showed checkers instead
+  int tiles_shown() const { return tiles_shown_; }
+  int tiles_shown_unpainted() const { return tiles_shown_unpainted_; }
+
   // Mapped contents rect
   QRect ContentsRect();
+
+  // Bytes used by the tiles of this backing store
+  size_t TilesMemorySize();
+
+  // Whether the pyramid level |exponent| is kept at |scale|: the levels
+  // updated at that scale and the one above them, which helps zooming out
+  static bool KeepsPyramidLevel(int exponent, float scale);
+
+  // TileBufferPool::Delegate implementation.
+  virtual void TileBufferCreated(int slot_id, TransportDIB::Handle handle);
+  virtual void TileBufferDestroyed(int slot_id);
+
+  // TileCache::Client implementation.
+  virtual bool IsTileClientVisible();
+  virtual void EvictTile(int tile_id);
 #endif
   
   // BackingStore implementation.
@@ -183,6 +225,13 @@ private:
     bool NeedPaintRequest();
 
     QPixmap* Pixmap() {return pixmap_;}
+
+    // id of the tile in the browser wide TileCache
+    int CacheId() { return cache_id_; }
+    void SetCacheId(int id) { cache_id_ = id; }
+
+    // bytes used by the tile pixmap
+    size_t MemorySize();
     
    private:
     friend class base::RefCounted<Tile>;
@@ -198,6 +247,8 @@ private:
     bool paint_request_;
 
     QPixmap* pixmap_;
+
+    int cache_id_;
   };
 
 private:
@@ -205,15 +256,50 @@ private:
   TilesMap tiles_map_;
   TilesMap scaling_tiles_map_;
   unsigned int tiles_map_seq_;
+
+  // Low resolution copies of the painted contents at fixed power of two
+  // scales, keyed by the exponent of the scale. They survive scale changes
+  // and are drawn scaled wherever tiles at the current scale are not painted
+  // yet, e.g. right after a pinch zoom. Their tiles are accounted in the
+  // TileCache like the tiles at the current scale.
+  struct PyramidTile {
+    PyramidTile() : cache_id(TileCache::kInvalidTileId) {}
+    QPixmap pixmap;
+    // id of the tile in the browser wide TileCache
+    int cache_id;
+  };
+  struct PyramidLevel {
+    QHash<TileIndex, PyramidTile> tiles;
+    // painted area in the coordinates of the level
+    QRegion painted;
+  };
+  typedef QMap<int, PyramidLevel> Pyramid;
+  Pyramid pyramid_;
+
+  // scale of the tiles in |tiles_map_|, which lags behind |contents_scale_|
+  // while scaling is pending
+  float front_scale_;
   
   struct TilePaintRequest {
-    TransportDIB* dib;
+    TilePaintRequest() : slot_id(TileBufferPool::kInvalidSlot), seq(0) {}
+    // slot in |tile_buffer_pool_| the render paints into
+    int slot_id;
+    // |tiles_map_seq_| when the request was sent
+    unsigned int seq;
+    base::TimeTicks request_time;
     QVector<scoped_refptr<Tile> > tiles;
   };
   typedef QHash<unsigned int, TilePaintRequest > TilePaintMap;
   TilePaintMap tiles_paint_map_;
   unsigned int tiles_paint_tag_;
 
+  // gives up on requests whose ack does not arrive in time
+  base::OneShotTimer<BackingStoreX> tiles_paint_timer_;
+
+  // shared memory buffers for tile paint requests; they stay mapped in both
+  // processes and are recycled between requests
+  scoped_ptr<TileBufferPool> tile_buffer_pool_;
+
   float contents_scale_;
 
   QRect cached_tiles_rect_;
@@ -222,6 +308,16 @@ private:
   bool pending_scaling_;
 
   bool frozen_;
+
+  // scroll velocity of the view in pixels per second
+  QPointF scroll_velocity_;
+
+  // tiles that need a paint request but were held back because too many
+  // requests were outstanding
+  QSet<TileIndex> deferred_tiles_;
+
+  int tiles_shown_;
+  int tiles_shown_unpainted_;
   
 private:
   friend class Tile;
@@ -229,6 +325,23 @@ private:
   // Send tile painting request to render
   void PaintTilesRequest(QVector<scoped_refptr<Tile> >& tiles);
 
+  // Forget the paint request |tag| without painting its tiles, releasing its
+  // buffer so that the tiles can be requested again
+  void DropTilesPaintRequest(unsigned int tag);
+
+  // As above without requesting the deferred tiles; returns false if there
+  // is no request |tag|
+  bool ReleaseTilesPaintRequest(unsigned int tag);
+
+  // Drop the requests made before the last scale change and those not acked
+  // in time, so that they no longer count against the pending request limit
+  void ExpireTilesPaintRequests();
+  void OnTilesPaintRequestTimeout();
+  void StartTilesPaintTimer();
+
+  // Pixmap rect the render paints |rect| into, see PaintTilesRequest
+  gfx::Rect GetTilePixmapRect(const QRect& rect);
+
   TilesMap& GetWorkingTilesMap();
   scoped_refptr<Tile> GetTileAt(const TileIndex& pos);
   scoped_refptr<Tile> CreateTileAt(const TileIndex& pos);
@@ -241,6 +354,40 @@ private:
   TileIndex GetTileIndexFrom(const QPoint& point);
 
   QRect GetCachedRect();
+
+  // Offset the visible rect is expected to move by soon at the current
+  // scroll velocity, bounded by |visible_size|
+  QPoint GetPredictedScrollOffset(const QSize& visible_size);
+
+  // Make the tiles at the new scale the front tiles
+  void SwapScalingTiles();
+
+  // Downscale |rect| of |bitmap|, painted at |scale|, into the pyramid levels
+  // below |scale|
+  void UpdatePyramid(const QPixmap& bitmap, const QRect& bitmap_rect,
+                     const QRect& rect, float scale);
+
+  // Downscale |rect| of |bitmap|, painted at |scale|, into the pyramid level
+  // |exponent|, creating its tiles as needed
+  void PaintIntoPyramidLevel(int exponent, const QPixmap& bitmap,
+                             const QRect& bitmap_rect, const QRect& rect,
+                             float scale);
+
+  // Paint |rect|, in coordinates at |scale|, from the pyramid, and checkers
+  // where the pyramid has nothing either
+  void PaintFromPyramid(QPainter* painter, const QRect& rect, float scale);
+
+  // Whether the pyramid can fill all of |rect| at |scale|
+  bool PyramidCovers(const QRect& rect, float scale);
+
+  // Drop pyramid levels far from |scale| and level tiles outside |rect|
+  void PrunePyramid(const QRect& rect, float scale);
+
+  // Stop accounting the tiles of |level| in the TileCache
+  void RemovePyramidTiles(const PyramidLevel& level);
+
+  // Drop all pyramid levels
+  void ClearPyramid();
 #endif
 
   DISALLOW_COPY_AND_ASSIGN(BackingStoreX);
@@ -0,0 +1,24 @@
+// Copyright (c) 2011 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "content/browser/renderer_host/backing_store_x.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+// The pyramid keeps the levels it paints, the top one below the scale and
+// the one under it, plus the level above them.
+TEST(BackingStoreXTest, KeepsPyramidLevel) {
+  // At 1.0 the top level is 2^-1.
+  EXPECT_FALSE(BackingStoreX::KeepsPyramidLevel(1, 1.0f));
+  EXPECT_TRUE(BackingStoreX::KeepsPyramidLevel(0, 1.0f));
+  EXPECT_TRUE(BackingStoreX::KeepsPyramidLevel(-1, 1.0f));
+  EXPECT_TRUE(BackingStoreX::KeepsPyramidLevel(-2, 1.0f));
+  EXPECT_FALSE(BackingStoreX::KeepsPyramidLevel(-3, 1.0f));
+
+  // At 3.0 the top level is 2^1.
+  EXPECT_FALSE(BackingStoreX::KeepsPyramidLevel(3, 3.0f));
+  EXPECT_TRUE(BackingStoreX::KeepsPyramidLevel(2, 3.0f));
+  EXPECT_TRUE(BackingStoreX::KeepsPyramidLevel(1, 3.0f));
+  EXPECT_TRUE(BackingStoreX::KeepsPyramidLevel(0, 3.0f));
+  EXPECT_FALSE(BackingStoreX::KeepsPyramidLevel(-1, 3.0f));
+}
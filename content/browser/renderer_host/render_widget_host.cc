@@ -442,12 +442,22 @@ void RenderWidgetHost::PaintAtSize(TransportDIB::Handle dib_handle,
                                page_size, desired_size));
 }
 
-void RenderWidgetHost::PaintTile(TransportDIB::Handle dib_handle,
+void RenderWidgetHost::CreateTileBuffer(int slot_id,
+                                        TransportDIB::Handle dib_handle) {
+  Send(new ViewMsg_CreateTileBuffer(routing_id_, slot_id, dib_handle));
+}
+
+void RenderWidgetHost::DestroyTileBuffer(int slot_id) {
+  Send(new ViewMsg_DestroyTileBuffer(routing_id_, slot_id));
+}
+
+void RenderWidgetHost::PaintTile(int slot_id,
                                  unsigned int seq,
                                  unsigned int tag,
-                                 const gfx::Rect& rect,
-                                 const gfx::Rect& pixmap_rect) {
-  Send(new ViewMsg_PaintTile(routing_id_, dib_handle, seq, tag, rect, pixmap_rect));
+                                 const std::vector<gfx::Rect>& rects,
+                                 const std::vector<gfx::Rect>& pixmap_rects) {
+  Send(new ViewMsg_PaintTile(routing_id_, slot_id, seq, tag,
+                             rects, pixmap_rects));
 }
 
 BackingStore* RenderWidgetHost::GetBackingStore(bool force_create) {
@@ -1011,9 +1021,12 @@ void RenderWidgetHost::OnMsgPaintAtSizeAck(int tag, const gfx::Size& size) {
       Details<PaintAtSizeAckDetails>(&details));
 }
 
-void RenderWidgetHost::OnMsgPaintTileAck(unsigned int seq, unsigned int tag, const gfx::Rect& rect, const gfx::Rect& pixmap_rect) {
+void RenderWidgetHost::OnMsgPaintTileAck(
+    unsigned int seq, unsigned int tag,
+    const std::vector<gfx::Rect>& rects,
+    const std::vector<gfx::Rect>& pixmap_rects) {
   if (view_) {
-    view_->PaintTileAck(seq, tag, rect, pixmap_rect);
+    view_->PaintTileAck(seq, tag, rects, pixmap_rects);
   }
 }
 
@@ -150,6 +150,7 @@ class RenderWidgetHost : public IPC::Channel::Listener,
   RenderProcessHost* process() const { return process_; }
   int routing_id() const { return routing_id_; }
   bool renderer_accessible() { return renderer_accessible_; }
+  bool is_hidden() const { return is_hidden_; }
 
   // Returns the property bag for this widget, where callers can add extra data
   // they may wish to associate with it. Returns a pointer rather than a
@@ -420,11 +421,14 @@ class RenderWidgetHost : public IPC::Channel::Listener,
 
   /////////////////////////////////////////////////
   // for tiled backing store
-  void PaintTile(TransportDIB::Handle dib_handle,
+  void CreateTileBuffer(int slot_id, TransportDIB::Handle dib_handle);
+  void DestroyTileBuffer(int slot_id);
+
+  void PaintTile(int slot_id,
                  unsigned int seq,
                  unsigned int tag,
-                 const gfx::Rect& rect,
-                 const gfx::Rect& pixmap_rect);
+                 const std::vector<gfx::Rect>& rects,
+                 const std::vector<gfx::Rect>& pixmap_rects);
 
   void SetVisibleRect(const gfx::Rect& cached_tiles_rect,
                       const gfx::Rect& visible_contents_rect);
@@ -535,7 +539,9 @@ class RenderWidgetHost : public IPC::Channel::Listener,
   virtual void OnMsgBlur();
 
   // for tiled backing store
-  void OnMsgPaintTileAck(unsigned int seq, unsigned int tag, const gfx::Rect& rect, const gfx::Rect& pixmap_rect);
+  void OnMsgPaintTileAck(unsigned int seq, unsigned int tag,
+                         const std::vector<gfx::Rect>& rects,
+                         const std::vector<gfx::Rect>& pixmap_rects);
   void OnMsgDidContentsSizeChanged(const gfx::Size& size);
   void OnSetScrollPosition(const gfx::Point& pos);
   void OnMsgCreateVideoWidget(unsigned int video_id, const gfx::Size& size);
@@ -619,7 +619,10 @@ void RWHVQtWidget::paint(QPainter *painter, const QStyleOptionGraphicsItem *opti
 
 #if defined(TILED_BACKING_STORE)
   if (backing_store)
+  {
+    backing_store->SetScrollVelocity(GetScrollVelocity());
     backing_store->AdjustTiles();
+  }
 #endif
 
   QRectF paint_rect = exposed_rect;
@@ -2240,6 +2243,18 @@ void RWHVQtWidget::DidBecomeSelected()
   }
 }
 
+QPointF RWHVQtWidget::GetScrollVelocity()
+{
+  QGraphicsObject* viewport_item = GetViewportItem();
+  if (!viewport_item)
+    return QPointF();
+
+  // Flickable reports velocities in pixels per second, positive when the
+  // contents move towards their bottom right
+  return QPointF(viewport_item->property("horizontalVelocity").toReal(),
+                 viewport_item->property("verticalVelocity").toReal());
+}
+
 QRect RWHVQtWidget::GetVisibleRect()
 {
   QGraphicsObject* webview_item = GetWebViewItem();
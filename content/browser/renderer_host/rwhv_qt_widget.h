@@ -68,6 +68,8 @@ class RWHVQtWidget : public QGraphicsWidget
   bool eventEmulatePinch(QEvent *event);
   void UnFrozen();
   QRect GetVisibleRect();
+  // Kinetic scrolling velocity of the flickable in pixels per second
+  QPointF GetScrollVelocity();
   QRect GetViewPortRectInScene();
   void WasHidden();
   void DidBecomeSelected();
@@ -0,0 +1,122 @@
+// Copyright (c) 2011 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "content/browser/renderer_host/tile_buffer_pool.h"
+
+#include "base/logging.h"
+
+namespace {
+
+// Buffer sizes are rounded up to this granularity. Paint requests for the same
+// tile vary by a few rows and columns depending on the scroll offset, and
+// rounding lets those requests share a buffer.
+const size_t kBufferGranularity = 64 * 1024;
+
+size_t RoundUpBufferSize(size_t size) {
+  return (size + kBufferGranularity - 1) / kBufferGranularity *
+      kBufferGranularity;
+}
+
+}  // namespace
+
+TileBufferPool::TileBufferPool(Delegate* delegate, size_t max_free_slots)
+    : delegate_(delegate),
+      max_free_slots_(max_free_slots),
+      free_slots_(0),
+      memory_size_(0),
+      next_slot_id_(kInvalidSlot + 1) {
+}
+
+TileBufferPool::~TileBufferPool() {
+  Clear();
+}
+
+int TileBufferPool::Acquire(size_t size) {
+  // Pick the smallest idle buffer that is large enough.
+  SlotMap::iterator best = slots_.end();
+  for (SlotMap::iterator it = slots_.begin(); it != slots_.end(); ++it) {
+    if (it->second.in_use || it->second.dib->size() < size)
+      continue;
+    if (best == slots_.end() ||
+        it->second.dib->size() < best->second.dib->size())
+      best = it;
+  }
+
+  if (best != slots_.end()) {
+    best->second.in_use = true;
+    free_slots_--;
+    return best->first;
+  }
+
+  const int slot_id = next_slot_id_++;
+  const size_t buffer_size = RoundUpBufferSize(size);
+  TransportDIB* dib = TransportDIB::Create(buffer_size, slot_id);
+  if (!dib) {
+    LOG(ERROR) << "Failed to allocate a " << buffer_size << " byte tile buffer";
+    return kInvalidSlot;
+  }
+
+  Slot& slot = slots_[slot_id];
+  slot.dib = dib;
+  slot.in_use = true;
+  memory_size_ += dib->size();
+
+  if (delegate_)
+    delegate_->TileBufferCreated(slot_id, dib->handle());
+  return slot_id;
+}
+
+void TileBufferPool::Release(int slot_id) {
+  SlotMap::iterator it = slots_.find(slot_id);
+  if (it == slots_.end()) {
+    NOTREACHED() << "Releasing unknown tile buffer " << slot_id;
+    return;
+  }
+  DCHECK(it->second.in_use);
+  if (!it->second.in_use)
+    return;
+
+  it->second.in_use = false;
+  free_slots_++;
+  TrimFreeSlots();
+}
+
+TransportDIB* TileBufferPool::GetBuffer(int slot_id) const {
+  SlotMap::const_iterator it = slots_.find(slot_id);
+  return it == slots_.end() ? NULL : it->second.dib;
+}
+
+void TileBufferPool::Clear() {
+  while (!slots_.empty())
+    DestroySlot(slots_.begin());
+  DCHECK_EQ(0U, free_slots_);
+  DCHECK_EQ(0U, memory_size_);
+}
+
+void TileBufferPool::DestroySlot(SlotMap::iterator it) {
+  const int slot_id = it->first;
+  if (!it->second.in_use)
+    free_slots_--;
+  memory_size_ -= it->second.dib->size();
+  delete it->second.dib;
+  slots_.erase(it);
+
+  if (delegate_)
+    delegate_->TileBufferDestroyed(slot_id);
+}
+
+void TileBufferPool::TrimFreeSlots() {
+  while (free_slots_ > max_free_slots_) {
+    SlotMap::iterator smallest = slots_.end();
+    for (SlotMap::iterator it = slots_.begin(); it != slots_.end(); ++it) {
+      if (it->second.in_use)
+        continue;
+      if (smallest == slots_.end() ||
+          it->second.dib->size() < smallest->second.dib->size())
+        smallest = it;
+    }
+    DCHECK(smallest != slots_.end());
+    DestroySlot(smallest);
+  }
+}
@@ -0,0 +1,93 @@
+// Copyright (c) 2011 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef CONTENT_BROWSER_RENDERER_HOST_TILE_BUFFER_POOL_H_
+#define CONTENT_BROWSER_RENDERER_HOST_TILE_BUFFER_POOL_H_
+#pragma once
+
+#include <map>
+
+#include "base/basictypes.h"
+#include "ui/gfx/surface/transport_dib.h"
+
+// TileBufferPool keeps a small set of shared memory buffers alive for the
+// tiled backing store so that painting a tile does not cost a shared memory
+// create/attach/detach cycle in both processes.
+//
+// Every buffer lives in a numbered slot. The renderer is told about a slot
+// once, when it is created, and keeps its own mapping of the buffer until the
+// slot is destroyed; paint requests then only carry the slot id. Released
+// slots are recycled for later requests of the same or a smaller size.
+class TileBufferPool {
+ public:
+  // Receives slot lifetime notifications so that the peer process can map and
+  // unmap the buffers.
+  class Delegate {
+   public:
+    virtual ~Delegate() {}
+
+    // A new slot backed by |handle| was created.
+    virtual void TileBufferCreated(int slot_id,
+                                   TransportDIB::Handle handle) = 0;
+
+    // The slot was destroyed and its id will not be used again.
+    virtual void TileBufferDestroyed(int slot_id) = 0;
+  };
+
+  enum {
+    // Returned by Acquire() when no buffer could be allocated.
+    kInvalidSlot = 0,
+  };
+
+  // |max_free_slots| is the number of idle buffers kept around for reuse.
+  TileBufferPool(Delegate* delegate, size_t max_free_slots);
+  ~TileBufferPool();
+
+  // Returns a slot whose buffer holds at least |size| bytes, creating one if
+  // no idle slot is large enough. The slot stays busy until Release().
+  int Acquire(size_t size);
+
+  // Returns |slot_id| to the pool. Idle slots beyond |max_free_slots| are
+  // destroyed, smallest first.
+  void Release(int slot_id);
+
+  // Returns the buffer backing |slot_id|, or NULL for an unknown slot.
+  TransportDIB* GetBuffer(int slot_id) const;
+
+  // Destroys all slots, busy or not.
+  void Clear();
+
+  size_t slot_count() const { return slots_.size(); }
+  size_t free_slot_count() const { return free_slots_; }
+
+  // Total bytes of shared memory held by the pool.
+  size_t memory_size() const { return memory_size_; }
+
+ private:
+  struct Slot {
+    Slot() : dib(NULL), in_use(false) {}
+
+    TransportDIB* dib;
+    bool in_use;
+  };
+  typedef std::map<int, Slot> SlotMap;
+
+  // Frees the buffer in |it| and notifies the delegate.
+  void DestroySlot(SlotMap::iterator it);
+
+  // Destroys idle slots until at most |max_free_slots_| remain.
+  void TrimFreeSlots();
+
+  Delegate* delegate_;
+  const size_t max_free_slots_;
+
+  SlotMap slots_;
+  size_t free_slots_;
+  size_t memory_size_;
+  int next_slot_id_;
+
+  DISALLOW_COPY_AND_ASSIGN(TileBufferPool);
+};
+
+#endif  // CONTENT_BROWSER_RENDERER_HOST_TILE_BUFFER_POOL_H_
@@ -0,0 +1,144 @@
+// Copyright (c) 2011 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <algorithm>
+#include <map>
+
+#include "base/basictypes.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/perftimer.h"
+#include "base/stl_util-inl.h"
+#include "content/browser/renderer_host/tile_buffer_pool.h"
+#include "skia/ext/platform_canvas.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "ui/gfx/surface/transport_dib.h"
+
+namespace {
+
+// Geometry of the simulated page: a long article on a tablet sized view,
+// scrolled from top to bottom with the tiled backing store's 512x512 tiles
+// and the same vertical cache multiplier.
+const int kTileSize = 512;
+const int kViewWidth = 1024;
+const int kViewHeight = 600;
+const int kPageHeight = 40000;
+const int kScrollStep = 48;
+const int kCachedMargin = kViewHeight * 3 / 2;
+
+// Bytes for a tile paint request: the tile plus the two pixel border the
+// backing store adds for scaling.
+const size_t kTileBytes = (kTileSize + 2) * (kTileSize + 2) * 4;
+
+// Plays the renderer side of the pool: maps a buffer when its slot is created
+// and keeps the mapping until the slot is destroyed.
+class RendererMappings : public TileBufferPool::Delegate {
+ public:
+  RendererMappings() {}
+  virtual ~RendererMappings() {
+    STLDeleteValues(&buffers_);
+  }
+
+  virtual void TileBufferCreated(int slot_id, TransportDIB::Handle handle) {
+    buffers_[slot_id] = TransportDIB::Map(handle);
+  }
+
+  virtual void TileBufferDestroyed(int slot_id) {
+    delete buffers_[slot_id];
+    buffers_.erase(slot_id);
+  }
+
+  TransportDIB* Get(int slot_id) { return buffers_[slot_id]; }
+
+ private:
+  std::map<int, TransportDIB*> buffers_;
+
+  DISALLOW_COPY_AND_ASSIGN(RendererMappings);
+};
+
+// Stands in for WebKit painting a tile into the shared buffer.
+void PaintTile(TransportDIB* dib) {
+  scoped_ptr<skia::PlatformCanvas> canvas(
+      dib->GetPlatformCanvas(kTileSize + 2, kTileSize + 2));
+  ASSERT_TRUE(canvas.get());
+  canvas->drawARGB(255, 0x40, 0x80, 0xc0);
+}
+
+// Walks the page from top to bottom and calls |paint| once for every tile
+// that enters the cached rect. Returns the number of tiles painted.
+template <typename PaintFunction>
+int ScrollPage(PaintFunction paint) {
+  const int columns = (kViewWidth + kTileSize - 1) / kTileSize;
+  int next_row = 0;
+  int tiles = 0;
+  for (int y = 0; y + kViewHeight <= kPageHeight; y += kScrollStep) {
+    const int cached_bottom = std::min(kPageHeight,
+                                       y + kViewHeight + kCachedMargin);
+    const int last_row = (cached_bottom - 1) / kTileSize;
+    for (; next_row <= last_row; ++next_row) {
+      for (int column = 0; column < columns; ++column) {
+        paint();
+        ++tiles;
+      }
+    }
+  }
+  return tiles;
+}
+
+class PooledPaint {
+ public:
+  PooledPaint(TileBufferPool* pool, RendererMappings* mappings)
+      : pool_(pool), mappings_(mappings) {}
+
+  void operator()() {
+    int slot_id = pool_->Acquire(kTileBytes);
+    ASSERT_NE(static_cast<int>(TileBufferPool::kInvalidSlot), slot_id);
+    PaintTile(mappings_->Get(slot_id));
+    pool_->Release(slot_id);
+  }
+
+ private:
+  TileBufferPool* pool_;
+  RendererMappings* mappings_;
+};
+
+class UnpooledPaint {
+ public:
+  UnpooledPaint() : sequence_(0) {}
+
+  void operator()() {
+    // What the backing store did before pooling: a fresh buffer per request,
+    // mapped and unmapped by the renderer around each paint.
+    scoped_ptr<TransportDIB> dib(
+        TransportDIB::Create(kTileBytes, sequence_++));
+    ASSERT_TRUE(dib.get());
+    scoped_ptr<TransportDIB> mapped(TransportDIB::Map(dib->handle()));
+    ASSERT_TRUE(mapped.get());
+    PaintTile(mapped.get());
+  }
+
+ private:
+  uint32 sequence_;
+};
+
+}  // namespace
+
+TEST(TileBufferPoolPerfTest, ScrollLongPage) {
+  PerfTimer unpooled_timer;
+  int unpooled_tiles = ScrollPage(UnpooledPaint());
+  double unpooled_seconds = unpooled_timer.Elapsed().InSecondsF();
+
+  RendererMappings mappings;
+  TileBufferPool pool(&mappings, 8);
+  PerfTimer pooled_timer;
+  int pooled_tiles = ScrollPage(PooledPaint(&pool, &mappings));
+  double pooled_seconds = pooled_timer.Elapsed().InSecondsF();
+
+  ASSERT_EQ(unpooled_tiles, pooled_tiles);
+  EXPECT_EQ(1U, pool.slot_count());
+
+  LogPerfResult("Tile_paint_unpooled", unpooled_tiles / unpooled_seconds,
+                "tiles/s");
+  LogPerfResult("Tile_paint_pooled", pooled_tiles / pooled_seconds,
+                "tiles/s");
+}
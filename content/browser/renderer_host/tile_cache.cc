@@ -0,0 +1,115 @@
+// Copyright (c) 2011 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "content/browser/renderer_host/tile_cache.h"
+
+#include <algorithm>
+
+#include "base/command_line.h"
+#include "base/logging.h"
+#include "base/memory/singleton.h"
+#include "base/string_number_conversions.h"
+#include "base/sys_info.h"
+#include "content/common/content_switches.h"
+
+namespace {
+
+// Without --tile-cache-size, tiles may use this fraction of physical memory,
+// e.g. 64MB on a 1GB tablet.
+const int kPhysicalMemoryDivisor = 16;
+
+// Lower bound for the default budget, enough for the cached rect of one tab.
+const int kMinBudgetMB = 24;
+
+size_t DefaultBudget() {
+  const CommandLine& command_line = *CommandLine::ForCurrentProcess();
+  int budget_mb = 0;
+  if (!command_line.HasSwitch(switches::kTileCacheSize) ||
+      !base::StringToInt(
+          command_line.GetSwitchValueASCII(switches::kTileCacheSize),
+          &budget_mb) ||
+      budget_mb <= 0) {
+    budget_mb = std::max(kMinBudgetMB,
+        base::SysInfo::AmountOfPhysicalMemoryMB() / kPhysicalMemoryDivisor);
+  }
+  return static_cast<size_t>(budget_mb) * 1024 * 1024;
+}
+
+}  // namespace
+
+// static
+TileCache* TileCache::GetInstance() {
+  return Singleton<TileCache>::get();
+}
+
+TileCache::TileCache()
+    : tiles_(TileList::NO_AUTO_EVICT),
+      budget_(DefaultBudget()),
+      memory_size_(0),
+      next_tile_id_(kInvalidTileId + 1) {
+}
+
+TileCache::TileCache(size_t budget)
+    : tiles_(TileList::NO_AUTO_EVICT),
+      budget_(budget),
+      memory_size_(0),
+      next_tile_id_(kInvalidTileId + 1) {
+}
+
+TileCache::~TileCache() {
+}
+
+int TileCache::AddTile(Client* client, size_t bytes) {
+  DCHECK(client);
+  const int tile_id = next_tile_id_++;
+  Entry entry = { client, bytes };
+  tiles_.Put(tile_id, entry);
+  memory_size_ += bytes;
+
+  if (memory_size_ > budget_)
+    EvictTiles(false, tile_id);
+  if (memory_size_ > budget_)
+    EvictTiles(true, tile_id);
+  return tile_id;
+}
+
+void TileCache::TouchTile(int tile_id) {
+  tiles_.Get(tile_id);
+}
+
+void TileCache::RemoveTile(int tile_id) {
+  TileList::iterator it = tiles_.Peek(tile_id);
+  if (it == tiles_.end())
+    return;
+  memory_size_ -= it->second.bytes;
+  tiles_.Erase(it);
+}
+
+size_t TileCache::MemorySizeForClient(const Client* client) {
+  size_t size = 0;
+  for (TileList::iterator it = tiles_.begin(); it != tiles_.end(); ++it) {
+    if (it->second.client == client)
+      size += it->second.bytes;
+  }
+  return size;
+}
+
+void TileCache::EvictTiles(bool visible, int keep_tile_id) {
+  TileList::reverse_iterator it = tiles_.rbegin();
+  while (memory_size_ > budget_ && it != tiles_.rend()) {
+    Entry entry = it->second;
+    const int tile_id = it->first;
+    if (tile_id == keep_tile_id ||
+        entry.client->IsTileClientVisible() != visible) {
+      ++it;
+      continue;
+    }
+
+    // Forget the tile before the client drops it so that the RemoveTile()
+    // from the tile's destructor does not invalidate |it|.
+    memory_size_ -= entry.bytes;
+    it = tiles_.Erase(it);
+    entry.client->EvictTile(tile_id);
+  }
+}
@@ -0,0 +1,88 @@
+// Copyright (c) 2011 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef CONTENT_BROWSER_RENDERER_HOST_TILE_CACHE_H_
+#define CONTENT_BROWSER_RENDERER_HOST_TILE_CACHE_H_
+#pragma once
+
+#include "base/basictypes.h"
+#include "content/common/mru_cache.h"
+
+template <typename T> struct DefaultSingletonTraits;
+
+// TileCache accounts the memory of the tiles of every tiled backing store in
+// the browser against a single budget. When a new tile pushes the total over
+// the budget, the least recently used tiles are evicted, across all backing
+// stores. Tiles of visible backing stores are only evicted once no tiles of
+// hidden ones are left.
+//
+// The budget defaults to a share of physical memory and can be set with
+// --tile-cache-size (in megabytes). All methods must be called on the UI
+// thread.
+class TileCache {
+ public:
+  // Implemented by the owners of the tiles.
+  class Client {
+   public:
+    virtual ~Client() {}
+
+    // Returns true if the client's tiles are currently on screen.
+    virtual bool IsTileClientVisible() = 0;
+
+    // Drops the tile |tile_id|. The cache has already forgotten about it, so
+    // the client does not need to call RemoveTile().
+    virtual void EvictTile(int tile_id) = 0;
+  };
+
+  // Returned by AddTile() for tiles that are not tracked.
+  enum { kInvalidTileId = 0 };
+
+  // Returns the browser-wide cache.
+  static TileCache* GetInstance();
+
+  // Creates a cache with a budget of |budget| bytes. Used by tests; everything
+  // else should share GetInstance().
+  explicit TileCache(size_t budget);
+  ~TileCache();
+
+  // Starts accounting |bytes| for a new tile of |client|, evicting older tiles
+  // if the budget is exceeded. Returns the id of the new tile.
+  int AddTile(Client* client, size_t bytes);
+
+  // Marks |tile_id| as the most recently used tile.
+  void TouchTile(int tile_id);
+
+  // Stops accounting |tile_id|. Unknown ids are ignored.
+  void RemoveTile(int tile_id);
+
+  // Bytes used by all tiles, and by the tiles of |client|.
+  size_t memory_size() const { return memory_size_; }
+  size_t MemorySizeForClient(const Client* client);
+
+  size_t budget() const { return budget_; }
+
+ private:
+  friend struct DefaultSingletonTraits<TileCache>;
+
+  struct Entry {
+    Client* client;
+    size_t bytes;
+  };
+  typedef MRUCache<int, Entry> TileList;
+
+  TileCache();
+
+  // Evicts tiles until the cache fits its budget. |visible| selects whether
+  // tiles of visible clients may be evicted. |keep_tile_id| is never evicted.
+  void EvictTiles(bool visible, int keep_tile_id);
+
+  TileList tiles_;
+  size_t budget_;
+  size_t memory_size_;
+  int next_tile_id_;
+
+  DISALLOW_COPY_AND_ASSIGN(TileCache);
+};
+
+#endif  // CONTENT_BROWSER_RENDERER_HOST_TILE_CACHE_H_
@@ -0,0 +1,100 @@
+// Copyright (c) 2011 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <set>
+
+#include "content/browser/renderer_host/tile_cache.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace {
+
+const size_t kTileBytes = 1024;
+
+// Records the tiles the cache asks it to drop.
+class TestClient : public TileCache::Client {
+ public:
+  explicit TestClient(bool visible) : visible_(visible) {}
+
+  virtual bool IsTileClientVisible() { return visible_; }
+  virtual void EvictTile(int tile_id) { evicted_.insert(tile_id); }
+
+  bool WasEvicted(int tile_id) const { return evicted_.count(tile_id) > 0; }
+  size_t evicted_count() const { return evicted_.size(); }
+
+ private:
+  bool visible_;
+  std::set<int> evicted_;
+};
+
+}  // namespace
+
+TEST(TileCacheTest, AccountsMemoryPerClient) {
+  TileCache cache(10 * kTileBytes);
+  TestClient first(true);
+  TestClient second(false);
+
+  int tile = cache.AddTile(&first, kTileBytes);
+  cache.AddTile(&first, kTileBytes);
+  cache.AddTile(&second, kTileBytes);
+
+  EXPECT_EQ(3 * kTileBytes, cache.memory_size());
+  EXPECT_EQ(2 * kTileBytes, cache.MemorySizeForClient(&first));
+  EXPECT_EQ(kTileBytes, cache.MemorySizeForClient(&second));
+
+  cache.RemoveTile(tile);
+  EXPECT_EQ(kTileBytes, cache.MemorySizeForClient(&first));
+
+  // Removing an unknown tile is harmless.
+  cache.RemoveTile(tile);
+  EXPECT_EQ(2 * kTileBytes, cache.memory_size());
+}
+
+TEST(TileCacheTest, EvictsLeastRecentlyUsed) {
+  TileCache cache(3 * kTileBytes);
+  TestClient client(false);
+
+  int oldest = cache.AddTile(&client, kTileBytes);
+  int middle = cache.AddTile(&client, kTileBytes);
+  int newest = cache.AddTile(&client, kTileBytes);
+
+  // Touching the oldest tile makes |middle| the next to go.
+  cache.TouchTile(oldest);
+  int added = cache.AddTile(&client, kTileBytes);
+
+  EXPECT_EQ(1U, client.evicted_count());
+  EXPECT_TRUE(client.WasEvicted(middle));
+  EXPECT_FALSE(client.WasEvicted(oldest));
+  EXPECT_FALSE(client.WasEvicted(newest));
+  EXPECT_FALSE(client.WasEvicted(added));
+  EXPECT_EQ(3 * kTileBytes, cache.memory_size());
+}
+
+TEST(TileCacheTest, EvictsVisibleTilesLast) {
+  TileCache cache(3 * kTileBytes);
+  TestClient visible(true);
+  TestClient hidden(false);
+
+  int visible_tile = cache.AddTile(&visible, kTileBytes);
+  int hidden_tile = cache.AddTile(&hidden, kTileBytes);
+  cache.AddTile(&visible, kTileBytes);
+
+  // The visible tile is older, but the hidden one goes first.
+  cache.AddTile(&visible, kTileBytes);
+  EXPECT_TRUE(hidden.WasEvicted(hidden_tile));
+  EXPECT_EQ(0U, visible.evicted_count());
+
+  // With no hidden tiles left, the visible ones are evicted in LRU order.
+  cache.AddTile(&visible, kTileBytes);
+  EXPECT_TRUE(visible.WasEvicted(visible_tile));
+  EXPECT_EQ(3 * kTileBytes, cache.memory_size());
+}
+
+TEST(TileCacheTest, NeverEvictsNewTile) {
+  TileCache cache(kTileBytes);
+  TestClient client(true);
+
+  int tile = cache.AddTile(&client, 2 * kTileBytes);
+  EXPECT_FALSE(client.WasEvicted(tile));
+  EXPECT_EQ(2 * kTileBytes, cache.memory_size());
+}
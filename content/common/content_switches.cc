@@ -345,6 +345,9 @@ const char kSingleProcess[]                 = "single-process";
 // Runs the security test for the renderer sandbox.
 const char kTestSandbox[]                   = "test-sandbox";
 
+// Memory budget in megabytes shared by the tiles of all tiled backing stores.
+const char kTileCacheSize[]                 = "tile-cache-size";
+
 // Grant unlimited quota to store files to this process.
 // Used for testing Pepper's FileRef/FileIO/FileSystem implementations.
 // DO NOT USE FOR OTHER PURPOSES.
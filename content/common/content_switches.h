@@ -109,6 +109,7 @@ extern const char kShowPaintRects[];
 extern const char kSimpleDataSource[];
 extern const char kSingleProcess[];
 extern const char kTestSandbox[];
+extern const char kTileCacheSize[];
 extern const char kUnlimitedQuotaForFiles[];
 extern const char kUnlimitedQuotaForIndexedDB[];
 extern const char kUserAgent[];
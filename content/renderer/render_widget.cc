@@ -9,6 +9,7 @@
 #include "base/memory/scoped_ptr.h"
 #include "base/message_loop.h"
 #include "base/metrics/histogram.h"
+#include "base/stl_util-inl.h"
 #include "build/build_config.h"
 #include "content/common/content_switches.h"
 #include "content/common/view_messages.h"
@@ -120,6 +121,7 @@ RenderWidget::~RenderWidget() {
     RenderProcess::current()->ReleaseTransportDIB(current_paint_buf_);
     current_paint_buf_ = NULL;
   }
+  STLDeleteValues(&tile_buffers_);
   RenderProcess::current()->ReleaseProcess();
 }
 
@@ -216,6 +218,8 @@ bool RenderWidget::OnMessageReceived(const IPC::Message& message) {
     IPC_MESSAGE_HANDLER(ViewMsg_QueryEditorSelection, OnQueryEditorSelection)
     IPC_MESSAGE_HANDLER(ViewMsg_QueryEditorSurroundingText, OnQueryEditorSurroundingText)
     IPC_MESSAGE_HANDLER(ViewMsg_SetPreferredSize, OnSetPreferredSize)
+    IPC_MESSAGE_HANDLER(ViewMsg_CreateTileBuffer, OnMsgCreateTileBuffer)
+    IPC_MESSAGE_HANDLER(ViewMsg_DestroyTileBuffer, OnMsgDestroyTileBuffer)
     IPC_MESSAGE_HANDLER(ViewMsg_PaintTile, OnMsgPaintTile)
     IPC_MESSAGE_HANDLER(ViewMsg_QueryElementAreaAt, OnQueryElementAreaAt);
     IPC_MESSAGE_HANDLER(ViewMsg_SetFSPluginWinSize, OnSetFSPluginWinSize);
@@ -1178,64 +1182,131 @@ void RenderWidget::OnImeConfirmComposition(const string16& text) {
     webwidget_->confirmComposition(text);
 }
 
-void RenderWidget::OnMsgPaintTile(const TransportDIB::Handle& dib_handle,
+void RenderWidget::OnMsgCreateTileBuffer(
+    int slot_id,
+    const TransportDIB::Handle& dib_handle) {
+  DCHECK(tile_buffers_.find(slot_id) == tile_buffers_.end());
+  if (!TransportDIB::is_valid_handle(dib_handle))
+    return;
+
+  // Keep the buffer mapped until the browser destroys the slot.
+  TransportDIB* dib = TransportDIB::Map(dib_handle);
+  if (!dib) {
+    LOG(ERROR) << "Failed to map tile buffer " << slot_id;
+    return;
+  }
+  delete tile_buffers_[slot_id];
+  tile_buffers_[slot_id] = dib;
+}
+
+void RenderWidget::OnMsgDestroyTileBuffer(int slot_id) {
+  TileBufferMap::iterator it = tile_buffers_.find(slot_id);
+  if (it == tile_buffers_.end())
+    return;
+  delete it->second;
+  tile_buffers_.erase(it);
+}
+
+void RenderWidget::OnMsgPaintTile(int slot_id,
                                   unsigned int seq,
                                   unsigned int tag,
-                                  const gfx::Rect& rect,
-                                  const gfx::Rect& pixmap_rect) {
+                                  const std::vector<gfx::Rect>& rects,
+                                  const std::vector<gfx::Rect>& pixmap_rects) {
   DLOG(INFO) << "RenderWidget::OnMsgPaintTile " << tag
-             << " " << rect.x() << " " << rect.y() << " " << rect.width() << " " << rect.height();
+             << " " << rects.size() << " tiles";
   
   if (seq >= seq_)
     seq_ = seq;
 
-  if (!webwidget_ || dib_handle == TransportDIB::DefaultHandleValue())
-    return;
+  // Always ack, so that the browser releases the tile buffer and requests
+  // the tiles again. An empty ack tells it the tiles were not painted.
+  std::vector<gfx::Rect> origin_bounds;
+  std::vector<gfx::Rect> scaled_bounds;
+  if (!PaintTiles(slot_id, rects, pixmap_rects,
+                  &origin_bounds, &scaled_bounds)) {
+    origin_bounds.clear();
+    scaled_bounds.clear();
+  }
 
-  // Map the given DIB ID into this process, and unmap it at the end
-  // of this function.
-  scoped_ptr<TransportDIB> paint_tile_buffer(TransportDIB::Map(dib_handle));
+  Send(new ViewHostMsg_PaintTile_ACK(routing_id_, seq_, tag,
+                                     origin_bounds, scaled_bounds));
+}
 
-  //DCHECK(paint_tile_buffer.get());
-  if (!paint_tile_buffer.get())
-    return;
+bool RenderWidget::PaintTiles(int slot_id,
+                              const std::vector<gfx::Rect>& rects,
+                              const std::vector<gfx::Rect>& pixmap_rects,
+                              std::vector<gfx::Rect>* origin_bounds,
+                              std::vector<gfx::Rect>* scaled_bounds) {
+  if (!webwidget_)
+    return false;
+
+  if (rects.size() != pixmap_rects.size() || rects.empty()) {
+    NOTREACHED();
+    return false;
+  }
+
+  TileBufferMap::iterator buffer = tile_buffers_.find(slot_id);
+  if (buffer == tile_buffers_.end())
+    return false;
+  TransportDIB* paint_tile_buffer = buffer->second;
+
+  std::vector<int> offsets;
+  gfx::Size atlas_size = layoutTileAtlas(pixmap_rects, &offsets);
 
-  gfx::Rect origin_bounds(rect);
-  gfx::Rect update(rect.x() / x_scale_, rect.y() / y_scale_,
-                   rect.width() / x_scale_ + 2, rect.height() / y_scale_ + 2);
-  gfx::Rect bounds = pixmap_rect;
+  // Pooled buffers may be larger than the request, never smaller.
+  if (paint_tile_buffer->size() <
+      static_cast<size_t>(atlas_size.width() * atlas_size.height() * 4)) {
+    NOTREACHED();
+    return false;
+  }
 
   scoped_ptr<skia::PlatformCanvas> canvas(
-      paint_tile_buffer->GetPlatformCanvas(bounds.width(),
-                                           bounds.height()));
+      paint_tile_buffer->GetPlatformCanvas(atlas_size.width(),
+                                           atlas_size.height()));
   if (!canvas.get()) {
     NOTREACHED();
-    return;
+    return false;
   }
 
-  // Reset bounds to what we actually received, but they should be the
-  // same.
-  DCHECK_EQ(bounds.width(), canvas->getDevice()->width());
-  DCHECK_EQ(bounds.height(), canvas->getDevice()->height());
-  bounds.set_width(canvas->getDevice()->width());
-  bounds.set_height(canvas->getDevice()->height());
-  origin_bounds.set_width(canvas->getDevice()->width());
-  origin_bounds.set_height(canvas->getDevice()->height());
-
-
+  // Lay out once for the whole batch.
   webwidget_->layout();
 
-  // Paint Tile
-  PaintRect(update, bounds.origin(), canvas.get());
+  origin_bounds->resize(rects.size());
+  scaled_bounds->resize(rects.size());
+  for (size_t i = 0; i < rects.size(); ++i) {
+    const gfx::Rect& rect = rects[i];
+    const gfx::Rect& bounds = pixmap_rects[i];
+    gfx::Rect update(rect.x() / x_scale_, rect.y() / y_scale_,
+                     rect.width() / x_scale_ + 2,
+                     rect.height() / y_scale_ + 2);
+
+    // Paint the tile into its slot of the atlas, without touching the
+    // neighbouring slots.
+    canvas->save();
+    SkRect slot;
+    slot.set(0, SkIntToScalar(offsets[i]),
+             SkIntToScalar(bounds.width()),
+             SkIntToScalar(offsets[i] + bounds.height()));
+    canvas->clipRect(slot);
+    canvas->translate(0, SkIntToScalar(offsets[i]));
+    PaintRect(update, bounds.origin(), canvas.get());
+    canvas->restore();
+
+    (*origin_bounds)[i] = gfx::Rect(rect.origin(), bounds.size());
+    (*scaled_bounds)[i] = gfx::Rect(bounds.x() * x_scale_,
+                                    bounds.y() * y_scale_,
+                                    bounds.width(),
+                                    bounds.height());
+  }
 
 #if defined(TILED_BACKING_STORE_DEBUG)
     static int counter = 0;
     QString file_name = QString("/home/meego/tmp/render_update_")
                         + QString::number(counter)
                         + QString("_")
-                        + QString::number(rect.x())
+                        + QString::number(rects[0].x())
                         + QString("_")
-                        + QString::number(rect.y())
+                        + QString::number(rects[0].y())
                         + QString(".png");
     SkBitmap bitmap = canvas->getTopPlatformDevice().accessBitmap(true);
     QImage image = SkBitmap2Image(bitmap);
@@ -1247,10 +1318,7 @@ void RenderWidget::OnMsgPaintTile(const TransportDIB::Handle& dib_handle,
       counter++;  
 #endif
 
-    gfx::Rect scaled_bounds = bounds;
-    scaled_bounds.set_x(bounds.x() * x_scale_);
-    scaled_bounds.set_y(bounds.y() * y_scale_);
-    Send(new ViewHostMsg_PaintTile_ACK(routing_id_, seq_, tag, origin_bounds, scaled_bounds));
+  return true;
 }
 
 // This message causes the renderer to render an image of the
@@ -6,6 +6,7 @@
 #define CONTENT_RENDERER_RENDER_WIDGET_H_
 #pragma once
 
+#include <map>
 #include <vector>
 
 #include "base/basictypes.h"
@@ -220,11 +221,21 @@ class RenderWidget : public IPC::Channel::Listener,
   void OnQueryEditorCursorPosition(int* cursor_position);
   void OnQueryEditorSelection(std::string* selection);
   void OnQueryEditorSurroundingText(std::string* surrounding_text);
-  void OnMsgPaintTile(const TransportDIB::Handle& dib_handle,
+  void OnMsgCreateTileBuffer(int slot_id,
+                             const TransportDIB::Handle& dib_handle);
+  void OnMsgDestroyTileBuffer(int slot_id);
+  void OnMsgPaintTile(int slot_id,
                       unsigned int seq,
                       unsigned int tag,
-                      const gfx::Rect& rect,
-                      const gfx::Rect& pixmap_rect);
+                      const std::vector<gfx::Rect>& rects,
+                      const std::vector<gfx::Rect>& pixmap_rects);
+  // Paints |rects| into the tile buffer |slot_id| for OnMsgPaintTile and
+  // fills in the bounds to ack. Returns false if nothing could be painted.
+  bool PaintTiles(int slot_id,
+                  const std::vector<gfx::Rect>& rects,
+                  const std::vector<gfx::Rect>& pixmap_rects,
+                  std::vector<gfx::Rect>* origin_bounds,
+                  std::vector<gfx::Rect>* scaled_bounds);
   void OnSetPreferredSize(const gfx::Size& size);
   void OnQueryElementAreaAt(const gfx::Point& pos,
                                         const gfx::Size& size,
@@ -345,6 +356,12 @@ class RenderWidget : public IPC::Channel::Listener,
   double y_scale_;
   unsigned int seq_;
 
+  // Tile buffers shared with the browser's tiled backing store, keyed by slot
+  // id. They stay mapped between ViewMsg_CreateTileBuffer and
+  // ViewMsg_DestroyTileBuffer so painting a tile does not map/unmap memory.
+  typedef std::map<int, TransportDIB*> TileBufferMap;
+  TileBufferMap tile_buffers_;
+
   // The TransportDIB that is being used to transfer an image to the browser.
   TransportDIB* current_paint_buf_;
 
@@ -4,11 +4,17 @@
 
 #include "net/base/cert_verifier.h"
 
+#include "base/base64.h"
 #include "base/compiler_specific.h"
+#include "base/json/json_reader.h"
+#include "base/json/json_writer.h"
 #include "base/message_loop.h"
+#include "base/sha1.h"
 #include "base/stl_util-inl.h"
 #include "base/synchronization/lock.h"
 #include "base/threading/worker_pool.h"
+#include "base/values.h"
+#include "crypto/sha2.h"
 #include "net/base/net_errors.h"
 #include "net/base/x509_certificate.h"
 
@@ -73,6 +79,75 @@ class DefaultTimeService : public CertVerifier::TimeService {
   virtual base::Time Now() { return base::Time::Now(); }
 };
 
+std::string FingerprintToString(const SHA1Fingerprint& fingerprint) {
+  return std::string(reinterpret_cast<const char*>(fingerprint.data),
+                     sizeof(fingerprint.data));
+}
+
+// Converts |cached_result| to the form written by
+// CertVerifier::SerializeCache().
+DictionaryValue* CachedResultToValue(
+    const CachedCertVerifyResult& cached_result) {
+  const CertVerifyResult& result = cached_result.result;
+  DictionaryValue* value = new DictionaryValue;
+  value->SetInteger("error", cached_result.error);
+  value->SetDouble("expiry", cached_result.expiry.ToDoubleT());
+  value->SetInteger("cert_status", result.cert_status);
+  value->SetBoolean("has_md5", result.has_md5);
+  value->SetBoolean("has_md2", result.has_md2);
+  value->SetBoolean("has_md4", result.has_md4);
+  value->SetBoolean("has_md5_ca", result.has_md5_ca);
+  value->SetBoolean("has_md2_ca", result.has_md2_ca);
+  value->SetBoolean("is_issued_by_known_root", result.is_issued_by_known_root);
+
+  ListValue* hashes = new ListValue;
+  for (std::vector<SHA1Fingerprint>::const_iterator
+       i = result.public_key_hashes.begin();
+       i != result.public_key_hashes.end(); ++i) {
+    std::string b64;
+    base::Base64Encode(FingerprintToString(*i), &b64);
+    hashes->Append(new StringValue(b64));
+  }
+  value->Set("public_key_hashes", hashes);
+  return value;
+}
+
+// The inverse of CachedResultToValue().
+bool ValueToCachedResult(DictionaryValue* value,
+                         CachedCertVerifyResult* cached_result) {
+  CertVerifyResult* result = &cached_result->result;
+  double expiry;
+  ListValue* hashes;
+  if (!value->GetInteger("error", &cached_result->error) ||
+      !value->GetDouble("expiry", &expiry) ||
+      !value->GetInteger("cert_status", &result->cert_status) ||
+      !value->GetBoolean("has_md5", &result->has_md5) ||
+      !value->GetBoolean("has_md2", &result->has_md2) ||
+      !value->GetBoolean("has_md4", &result->has_md4) ||
+      !value->GetBoolean("has_md5_ca", &result->has_md5_ca) ||
+      !value->GetBoolean("has_md2_ca", &result->has_md2_ca) ||
+      !value->GetBoolean("is_issued_by_known_root",
+                         &result->is_issued_by_known_root) ||
+      !value->GetList("public_key_hashes", &hashes)) {
+    return false;
+  }
+  cached_result->expiry = base::Time::FromDoubleT(expiry);
+
+  for (size_t i = 0; i < hashes->GetSize(); ++i) {
+    std::string b64;
+    std::string hash_str;
+    if (!hashes->GetString(i, &b64) ||
+        !base::Base64Decode(b64, &hash_str) ||
+        hash_str.size() != base::SHA1_LENGTH) {
+      return false;
+    }
+    SHA1Fingerprint hash;
+    memcpy(hash.data, hash_str.data(), sizeof(hash.data));
+    result->public_key_hashes.push_back(hash);
+  }
+  return true;
+}
+
 }  // namespace
 
 CachedCertVerifyResult::CachedCertVerifyResult() : error(ERR_FAILED) {
@@ -283,16 +358,20 @@ class CertVerifierJob {
 
 CertVerifier::CertVerifier()
     : time_service_(new DefaultTimeService),
+      delegate_(NULL),
       requests_(0),
-      cache_hits_(0),
+      memory_cache_hits_(0),
+      disk_cache_hits_(0),
       inflight_joins_(0) {
   CertDatabase::AddObserver(this);
 }
 
 CertVerifier::CertVerifier(TimeService* time_service)
     : time_service_(time_service),
+      delegate_(NULL),
       requests_(0),
-      cache_hits_(0),
+      memory_cache_hits_(0),
+      disk_cache_hits_(0),
       inflight_joins_(0) {
   CertDatabase::AddObserver(this);
 }
@@ -318,13 +397,14 @@ int CertVerifier::Verify(X509Certificate* cert,
 
   requests_++;
 
-  const RequestParams key = {cert->fingerprint(), hostname, flags};
+  const RequestParams key = GetRequestParams(cert, hostname, flags);
+  const base::Time current_time(time_service_->Now());
   // First check the cache.
-  std::map<RequestParams, CachedCertVerifyResult>::iterator i;
+  CacheMap::iterator i;
   i = cache_.find(key);
   if (i != cache_.end()) {
-    if (!i->second.HasExpired(time_service_->Now())) {
-      cache_hits_++;
+    if (!i->second.HasExpired(current_time)) {
+      memory_cache_hits_++;
       *out_req = NULL;
       *verify_result = i->second.result;
       return i->second.error;
@@ -333,6 +413,23 @@ int CertVerifier::Verify(X509Certificate* cert,
     cache_.erase(i);
   }
 
+  // Then check the results loaded from disk.
+  if (!loaded_cache_.empty()) {
+    std::map<std::string, CachedCertVerifyResult>::iterator l;
+    l = loaded_cache_.find(HashRequestParams(key));
+    if (l != loaded_cache_.end()) {
+      CachedCertVerifyResult cached_result = l->second;
+      loaded_cache_.erase(l);
+      if (!cached_result.HasExpired(current_time)) {
+        disk_cache_hits_++;
+        AddToCache(key, cached_result, current_time);
+        *out_req = NULL;
+        *verify_result = cached_result.result;
+        return cached_result.error;
+      }
+    }
+  }
+
   // No cache hit. See if an identical request is currently in flight.
   CertVerifierJob* job;
   std::map<RequestParams, CertVerifierJob*>::const_iterator j;
@@ -375,7 +472,9 @@ void CertVerifier::ClearCache() {
   DCHECK(CalledOnValidThread());
 
   cache_.clear();
+  loaded_cache_.clear();
   // Leaves inflight_ alone.
+  DirtyNotify();
 }
 
 size_t CertVerifier::GetCacheSize() const {
@@ -384,6 +483,100 @@ size_t CertVerifier::GetCacheSize() const {
   return cache_.size();
 }
 
+void CertVerifier::SetDelegate(Delegate* delegate) {
+  DCHECK(CalledOnValidThread());
+
+  delegate_ = delegate;
+}
+
+bool CertVerifier::SerializeCache(std::string* output) {
+  DCHECK(CalledOnValidThread());
+
+  const base::Time current_time(time_service_->Now());
+  DictionaryValue toplevel;
+  for (CacheMap::const_iterator i = cache_.begin(); i != cache_.end(); ++i) {
+    if (i->second.HasExpired(current_time))
+      continue;
+    std::string b64;
+    base::Base64Encode(HashRequestParams(i->first), &b64);
+    toplevel.SetWithoutPathExpansion(b64, CachedResultToValue(i->second));
+  }
+  // Keep the loaded results which haven't been used yet, up to the size of
+  // the cache.
+  for (std::map<std::string, CachedCertVerifyResult>::const_iterator
+       i = loaded_cache_.begin();
+       i != loaded_cache_.end() && toplevel.size() < kMaxCacheEntries; ++i) {
+    if (i->second.HasExpired(current_time))
+      continue;
+    std::string b64;
+    base::Base64Encode(i->first, &b64);
+    if (!toplevel.HasKey(b64))
+      toplevel.SetWithoutPathExpansion(b64, CachedResultToValue(i->second));
+  }
+
+  base::JSONWriter::Write(&toplevel, false /* no pretty print */, output);
+  return true;
+}
+
+bool CertVerifier::LoadCache(const std::string& input) {
+  DCHECK(CalledOnValidThread());
+
+  scoped_ptr<Value> value(
+      base::JSONReader::Read(input, false /* do not allow trailing commas */));
+  if (!value.get() || !value->IsType(Value::TYPE_DICTIONARY))
+    return false;
+
+  DictionaryValue* dict_value = static_cast<DictionaryValue*>(value.get());
+  const base::Time current_time(time_service_->Now());
+  // Results expire kTTLSecs after they are verified, so anything expiring
+  // later than that was saved with a clock which was off.
+  const base::Time max_expiry =
+      current_time + base::TimeDelta::FromSeconds(kTTLSecs);
+
+  for (DictionaryValue::key_iterator i = dict_value->begin_keys();
+       i != dict_value->end_keys() &&
+       loaded_cache_.size() < kMaxCacheEntries; ++i) {
+    DictionaryValue* result_value;
+    std::string hash;
+    CachedCertVerifyResult cached_result;
+    if (!dict_value->GetDictionaryWithoutPathExpansion(*i, &result_value) ||
+        !base::Base64Decode(*i, &hash) ||
+        hash.size() != crypto::SHA256_LENGTH ||
+        !ValueToCachedResult(result_value, &cached_result)) {
+      continue;
+    }
+    if (cached_result.HasExpired(current_time) ||
+        cached_result.expiry > max_expiry) {
+      continue;
+    }
+    loaded_cache_.insert(std::make_pair(hash, cached_result));
+  }
+  return true;
+}
+
+// static
+CertVerifier::RequestParams CertVerifier::GetRequestParams(
+    X509Certificate* cert,
+    const std::string& hostname,
+    int flags) {
+  // The intermediate certificates can change the result of the verification,
+  // so they are part of the key too.
+  RequestParams params;
+  params.cert_fingerprint = cert->CalculateChainFingerprint();
+  params.hostname = hostname;
+  params.flags = flags;
+  return params;
+}
+
+// static
+std::string CertVerifier::HashRequestParams(const RequestParams& params) {
+  std::string input = FingerprintToString(params.cert_fingerprint);
+  input.append(reinterpret_cast<const char*>(&params.flags),
+               sizeof(params.flags));
+  input.append(params.hostname);
+  return crypto::SHA256HashString(input);
+}
+
 // HandleResult is called by CertVerifierWorker on the origin message loop.
 // It deletes CertVerifierJob.
 void CertVerifier::HandleResult(X509Certificate* cert,
@@ -401,13 +594,31 @@ void CertVerifier::HandleResult(X509Certificate* cert,
   uint32 ttl = kTTLSecs;
   cached_result.expiry = current_time + base::TimeDelta::FromSeconds(ttl);
 
-  const RequestParams key = {cert->fingerprint(), hostname, flags};
+  const RequestParams key = GetRequestParams(cert, hostname, flags);
+  AddToCache(key, cached_result, current_time);
+  DirtyNotify();
+
+  std::map<RequestParams, CertVerifierJob*>::iterator j;
+  j = inflight_.find(key);
+  if (j == inflight_.end()) {
+    NOTREACHED();
+    return;
+  }
+  CertVerifierJob* job = j->second;
+  inflight_.erase(j);
+
+  job->HandleResult(cached_result);
+  delete job;
+}
 
+void CertVerifier::AddToCache(const RequestParams& key,
+                              const CachedCertVerifyResult& result,
+                              base::Time current_time) {
   DCHECK_GE(kMaxCacheEntries, 1u);
   DCHECK_LE(cache_.size(), kMaxCacheEntries);
   if (cache_.size() == kMaxCacheEntries) {
     // Need to remove an element of the cache.
-    std::map<RequestParams, CachedCertVerifyResult>::iterator i, cur;
+    CacheMap::iterator i, cur;
     for (i = cache_.begin(); i != cache_.end(); ) {
       cur = i++;
       if (cur->second.HasExpired(current_time))
@@ -420,19 +631,12 @@ void CertVerifier::HandleResult(X509Certificate* cert,
     cache_.erase(cache_.begin());
   }
 
-  cache_.insert(std::make_pair(key, cached_result));
-
-  std::map<RequestParams, CertVerifierJob*>::iterator j;
-  j = inflight_.find(key);
-  if (j == inflight_.end()) {
-    NOTREACHED();
-    return;
-  }
-  CertVerifierJob* job = j->second;
-  inflight_.erase(j);
+  cache_[key] = result;
+}
 
-  job->HandleResult(cached_result);
-  delete job;
+void CertVerifier::DirtyNotify() {
+  if (delegate_)
+    delegate_->CacheIsDirty(this);
 }
 
 void CertVerifier::OnCertTrustChanged(const X509Certificate* cert) {
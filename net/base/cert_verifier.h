@@ -62,6 +62,17 @@ class CertVerifier : public base::NonThreadSafe,
     virtual base::Time Now() = 0;
   };
 
+  // The delegate is notified when the verification result cache changes, so
+  // that it can save the cache with SerializeCache().
+  class Delegate {
+   public:
+    // This function may not block, and must not reenter the CertVerifier.
+    virtual void CacheIsDirty(CertVerifier* verifier) = 0;
+
+   protected:
+    virtual ~Delegate() {}
+  };
+
   CertVerifier();
 
   // Used by unit tests to mock the current time.  Takes ownership of
@@ -113,8 +124,27 @@ class CertVerifier : public base::NonThreadSafe,
 
   size_t GetCacheSize() const;
 
+  // |delegate| may be NULL.
+  void SetDelegate(Delegate* delegate);
+
+  // Writes the verification results which have not expired to |output|, as
+  // JSON.  The hostnames are hashed, so that they can't be read back from the
+  // output.
+  bool SerializeCache(std::string* output);
+
+  // Adds the verification results of |input|, as written by
+  // SerializeCache(), to the cache.  They don't replace the results which are
+  // already cached.  Returns false if |input| can't be parsed.
+  bool LoadCache(const std::string& input);
+
   uint64 requests() const { return requests_; }
-  uint64 cache_hits() const { return cache_hits_; }
+  uint64 cache_hits() const {
+    return memory_cache_hits_ + disk_cache_hits_;
+  }
+  // The cache hits on results which were verified by this CertVerifier.
+  uint64 memory_cache_hits() const { return memory_cache_hits_; }
+  // The cache hits on results which were added by LoadCache().
+  uint64 disk_cache_hits() const { return disk_cache_hits_; }
   uint64 inflight_joins() const { return inflight_joins_; }
 
  private:
@@ -145,23 +175,47 @@ class CertVerifier : public base::NonThreadSafe,
       return hostname < other.hostname;
     }
 
+    // The fingerprint of the certificate and of its intermediate
+    // certificates.
     SHA1Fingerprint cert_fingerprint;
     std::string hostname;
     int flags;
   };
 
+  typedef std::map<RequestParams, CachedCertVerifyResult> CacheMap;
+
+  static RequestParams GetRequestParams(X509Certificate* cert,
+                                        const std::string& hostname,
+                                        int flags);
+
+  // Returns the key of |params| in |loaded_cache_|.
+  static std::string HashRequestParams(const RequestParams& params);
+
   void HandleResult(X509Certificate* cert,
                     const std::string& hostname,
                     int flags,
                     int error,
                     const CertVerifyResult& verify_result);
 
+  // Adds |result| to |cache_|, evicting an entry if the cache is full.
+  void AddToCache(const RequestParams& key,
+                  const CachedCertVerifyResult& result,
+                  base::Time current_time);
+
+  // If we have a delegate, lets it know that the cache changed.
+  void DirtyNotify();
+
   // CertDatabase::Observer methods:
   virtual void OnCertTrustChanged(const X509Certificate* cert);
 
   // cache_ maps from a request to a cached result. The cached result may
   // have expired and the size of |cache_| must be <= kMaxCacheEntries.
-  std::map<RequestParams, CachedCertVerifyResult> cache_;
+  CacheMap cache_;
+
+  // loaded_cache_ holds the results added by LoadCache() which haven't been
+  // used yet, keyed by HashRequestParams().  A result moves to |cache_| when
+  // it is used.  The size of |loaded_cache_| must be <= kMaxCacheEntries.
+  std::map<std::string, CachedCertVerifyResult> loaded_cache_;
 
   // inflight_ maps from a request to an active verification which is taking
   // place.
@@ -169,8 +223,11 @@ class CertVerifier : public base::NonThreadSafe,
 
   scoped_ptr<TimeService> time_service_;
 
+  Delegate* delegate_;
+
   uint64 requests_;
-  uint64 cache_hits_;
+  uint64 memory_cache_hits_;
+  uint64 disk_cache_hits_;
   uint64 inflight_joins_;
 
   DISALLOW_COPY_AND_ASSIGN(CertVerifier);
@@ -279,4 +279,121 @@ TEST_F(CertVerifierTest, CancelRequestThenQuit) {
   // Destroy |verifier| by going out of scope.
 }
 
+class TestCacheDelegate : public CertVerifier::Delegate {
+ public:
+  TestCacheDelegate() : dirty_count_(0) {}
+
+  // CertVerifier::Delegate methods:
+  virtual void CacheIsDirty(CertVerifier* verifier) { dirty_count_++; }
+
+  int dirty_count() const { return dirty_count_; }
+
+ private:
+  int dirty_count_;
+};
+
+// Tests that the results saved by one verifier are cache hits for another.
+TEST_F(CertVerifierTest, SaveAndLoadCache) {
+  base::Time current_time = base::Time::Now();
+  TestTimeService* time_service = new TestTimeService;
+  time_service->set_current_time(current_time);
+  CertVerifier verifier(time_service);
+  TestCacheDelegate delegate;
+  verifier.SetDelegate(&delegate);
+
+  FilePath certs_dir = GetTestCertsDirectory();
+  scoped_refptr<X509Certificate> google_cert(
+      ImportCertFromFile(certs_dir, "google.single.der"));
+  ASSERT_NE(static_cast<X509Certificate*>(NULL), google_cert);
+
+  int error;
+  CertVerifyResult verify_result;
+  TestCompletionCallback callback;
+  CertVerifier::RequestHandle request_handle;
+
+  error = verifier.Verify(google_cert, "www.example.com", 0, &verify_result,
+                          &callback, &request_handle);
+  ASSERT_EQ(ERR_IO_PENDING, error);
+  error = callback.WaitForResult();
+  ASSERT_TRUE(IsCertificateError(error));
+  EXPECT_EQ(1, delegate.dirty_count());
+
+  std::string state;
+  ASSERT_TRUE(verifier.SerializeCache(&state));
+  // The hostname is not saved in the clear.
+  EXPECT_EQ(std::string::npos, state.find("www.example.com"));
+
+  TestTimeService* time_service2 = new TestTimeService;
+  time_service2->set_current_time(current_time);
+  CertVerifier verifier2(time_service2);
+  ASSERT_TRUE(verifier2.LoadCache(state));
+
+  CertVerifyResult verify_result2;
+  int error2 = verifier2.Verify(google_cert, "www.example.com", 0,
+                                &verify_result2, &callback, &request_handle);
+  // Synchronous completion.
+  EXPECT_EQ(error, error2);
+  EXPECT_TRUE(request_handle == NULL);
+  EXPECT_EQ(verify_result.cert_status, verify_result2.cert_status);
+  EXPECT_EQ(1u, verifier2.disk_cache_hits());
+  EXPECT_EQ(0u, verifier2.memory_cache_hits());
+
+  // The result is now in the memory cache.
+  error2 = verifier2.Verify(google_cert, "www.example.com", 0,
+                            &verify_result2, &callback, &request_handle);
+  EXPECT_EQ(error, error2);
+  EXPECT_EQ(1u, verifier2.disk_cache_hits());
+  EXPECT_EQ(1u, verifier2.memory_cache_hits());
+  EXPECT_EQ(2u, verifier2.cache_hits());
+
+  // Other hostnames are not cache hits.
+  error2 = verifier2.Verify(google_cert, "www.example.org", 0,
+                            &verify_result2, &callback, &request_handle);
+  ASSERT_EQ(ERR_IO_PENDING, error2);
+  callback.WaitForResult();
+  EXPECT_EQ(2u, verifier2.cache_hits());
+
+  verifier.ClearCache();
+  EXPECT_EQ(2, delegate.dirty_count());
+  verifier.SetDelegate(NULL);
+}
+
+// Tests that expired results are not loaded.
+TEST_F(CertVerifierTest, LoadExpiredCache) {
+  base::Time current_time = base::Time::Now();
+  TestTimeService* time_service = new TestTimeService;
+  time_service->set_current_time(current_time);
+  CertVerifier verifier(time_service);
+
+  FilePath certs_dir = GetTestCertsDirectory();
+  scoped_refptr<X509Certificate> google_cert(
+      ImportCertFromFile(certs_dir, "google.single.der"));
+  ASSERT_NE(static_cast<X509Certificate*>(NULL), google_cert);
+
+  CertVerifyResult verify_result;
+  TestCompletionCallback callback;
+  CertVerifier::RequestHandle request_handle;
+
+  int error = verifier.Verify(google_cert, "www.example.com", 0,
+                              &verify_result, &callback, &request_handle);
+  ASSERT_EQ(ERR_IO_PENDING, error);
+  callback.WaitForResult();
+
+  std::string state;
+  ASSERT_TRUE(verifier.SerializeCache(&state));
+
+  TestTimeService* time_service2 = new TestTimeService;
+  time_service2->set_current_time(current_time +
+                                  base::TimeDelta::FromHours(1));
+  CertVerifier verifier2(time_service2);
+  ASSERT_TRUE(verifier2.LoadCache(state));
+  EXPECT_FALSE(verifier2.LoadCache("not json"));
+
+  error = verifier2.Verify(google_cert, "www.example.com", 0, &verify_result,
+                           &callback, &request_handle);
+  ASSERT_EQ(ERR_IO_PENDING, error);
+  callback.WaitForResult();
+  EXPECT_EQ(0u, verifier2.cache_hits());
+}
+
 }  // namespace net
@@ -82,6 +82,9 @@ namespace {
 // will update it again.
 const int kDefaultAccessUpdateThresholdSeconds = 60;
 
+// Number of hosts and domains whose keys GetKey() remembers.
+const size_t kMaxKeyCacheSize = 1000;
+
 // Comparator to sort cookies from highest creation date to lowest
 // creation date.
 struct OrderByCreationTimeDesc {
@@ -387,6 +390,7 @@ bool CookieMonster::enable_file_scheme_ = false;
 
 CookieMonster::CookieMonster(PersistentCookieStore* store, Delegate* delegate)
     : initialized_(false),
+      loaded_(true),
       expiry_and_key_scheme_(expiry_and_key_default_),
       store_(store),
       last_access_threshold_(
@@ -402,6 +406,7 @@ CookieMonster::CookieMonster(PersistentCookieStore* store,
                              Delegate* delegate,
                              int last_access_threshold_milliseconds)
     : initialized_(false),
+      loaded_(true),
       expiry_and_key_scheme_(expiry_and_key_default_),
       store_(store),
       last_access_threshold_(base::TimeDelta::FromMilliseconds(
@@ -535,6 +540,18 @@ bool CookieMonster::DomainIsHostOnly(const std::string& domain_string) {
   return (domain_string.empty() || domain_string[0] != '.');
 }
 
+// static
+std::string CookieMonster::GetEffectiveDomainKey(const std::string& domain) {
+  std::string effective_domain(
+      RegistryControlledDomainService::GetDomainAndRegistry(domain));
+  if (effective_domain.empty())
+    effective_domain = domain;
+
+  if (!effective_domain.empty() && effective_domain[0] == '.')
+    return effective_domain.substr(1);
+  return effective_domain;
+}
+
 bool CookieMonster::SetCookieWithDetails(
     const GURL& url, const std::string& name, const std::string& value,
     const std::string& domain, const std::string& path,
@@ -567,6 +584,7 @@ bool CookieMonster::SetCookieWithDetails(
 CookieList CookieMonster::GetAllCookies() {
   base::AutoLock autolock(lock_);
   InitIfNecessary();
+  LoadAllCookiesIfNecessary();
 
   // This function is being called to scrape the cookie list for management UI
   // or similar.  We shouldn't show expired cookies in this list since it will
@@ -624,8 +642,10 @@ CookieList CookieMonster::GetAllCookiesForURL(const GURL& url) {
 
 int CookieMonster::DeleteAll(bool sync_to_store) {
   base::AutoLock autolock(lock_);
-  if (sync_to_store)
+  if (sync_to_store) {
     InitIfNecessary();
+    LoadAllCookiesIfNecessary();
+  }
 
   int num_deleted = 0;
   for (CookieMap::iterator it = cookies_.begin(); it != cookies_.end();) {
@@ -645,6 +665,7 @@ int CookieMonster::DeleteAllCreatedBetween(const Time& delete_begin,
                                            bool sync_to_store) {
   base::AutoLock autolock(lock_);
   InitIfNecessary();
+  LoadAllCookiesIfNecessary();
 
   int num_deleted = 0;
   for (CookieMap::iterator it = cookies_.begin(); it != cookies_.end();) {
@@ -680,8 +701,11 @@ int CookieMonster::DeleteAllForHost(const GURL& url) {
   // We store host cookies in the store by their canonical host name;
   // domain cookies are stored with a leading ".".  So this is a pretty
   // simple lookup and per-cookie delete.
+  const std::string key(GetKey(host));
+  LoadCookiesForKeyIfNecessary(key);
+
   int num_deleted = 0;
-  for (CookieMapItPair its = cookies_.equal_range(GetKey(host));
+  for (CookieMapItPair its = cookies_.equal_range(key);
        its.first != its.second;) {
     CookieMap::iterator curit = its.first;
     ++its.first;
@@ -702,7 +726,10 @@ bool CookieMonster::DeleteCanonicalCookie(const CanonicalCookie& cookie) {
   base::AutoLock autolock(lock_);
   InitIfNecessary();
 
-  for (CookieMapItPair its = cookies_.equal_range(GetKey(cookie.Domain()));
+  const std::string key(GetKey(cookie.Domain()));
+  LoadCookiesForKeyIfNecessary(key);
+
+  for (CookieMapItPair its = cookies_.equal_range(key);
        its.first != its.second; ++its.first) {
     // The creation date acts as our unique index...
     if (its.first->second->CreationDate() == cookie.CreationDate()) {
@@ -782,17 +809,28 @@ std::string CookieMonster::GetCookiesWithOptions(const GURL& url,
   FindCookiesForHostAndDomain(url, options, true, &cookies);
   std::sort(cookies.begin(), cookies.end(), CookieSorter);
 
+  // Size the line up front so that building it allocates once.
+  size_t cookie_line_length = 0;
+  for (std::vector<CanonicalCookie*>::const_iterator it = cookies.begin();
+       it != cookies.end(); ++it) {
+    cookie_line_length +=
+        (*it)->Name().length() + (*it)->Value().length() + 3;
+  }
+
   std::string cookie_line;
+  cookie_line.reserve(cookie_line_length);
   for (std::vector<CanonicalCookie*>::const_iterator it = cookies.begin();
        it != cookies.end(); ++it) {
     if (it != cookies.begin())
-      cookie_line += "; ";
+      cookie_line.append("; ");
     // In Mozilla if you set a cookie like AAAA, it will have an empty token
     // and a value of AAAA.  When it sends the cookie back, it will send AAAA,
     // so we need to avoid sending =AAAA for a blank token value.
-    if (!(*it)->Name().empty())
-      cookie_line += (*it)->Name() + "=";
-    cookie_line += (*it)->Value();
+    if (!(*it)->Name().empty()) {
+      cookie_line.append((*it)->Name());
+      cookie_line.push_back('=');
+    }
+    cookie_line.append((*it)->Value());
   }
 
   histogram_time_get_->AddTime(TimeTicks::Now() - start_time);
@@ -860,6 +898,14 @@ bool CookieMonster::SetCookieWithCreationTime(const GURL& url,
 void CookieMonster::InitStore() {
   DCHECK(store_) << "Store must exist to initialize";
 
+  // Stores which can load by key leave the cookies there until they are
+  // needed, so that startup does not wait for all of them.
+  if (expiry_and_key_scheme_ == EKS_KEEP_RECENT_AND_PURGE_ETLDP1 &&
+      store_->SupportsLoadCookiesForKey()) {
+    loaded_ = false;
+    return;
+  }
+
   TimeTicks beginning_time(TimeTicks::Now());
 
   // Initialize the store and sync in any saved persistent cookies.  We don't
@@ -871,24 +917,93 @@ void CookieMonster::InitStore() {
   cookies.reserve(kMaxCookies);
   store_->Load(&cookies);
 
+  std::set<std::string> keys;
+  ImportCookies(cookies, &keys);
+  imported_creation_times_.clear();
+
+  // After importing cookies from the PersistentCookieStore, verify that
+  // none of our other constraints are violated.
+  //
+  // In particular, the backing store might have given us duplicate cookies.
+  EnsureCookiesMapIsValid();
+
+  histogram_time_load_->AddTime(TimeTicks::Now() - beginning_time);
+}
+
+void CookieMonster::LoadCookiesForKeyIfNecessary(const std::string& key) {
+  lock_.AssertAcquired();
+
+  if (loaded_ || !loaded_keys_.insert(key).second)
+    return;
+
+  TimeTicks beginning_time(TimeTicks::Now());
+
+  std::vector<CanonicalCookie*> cookies;
+  const bool all_loaded = store_->LoadCookiesForKey(key, &cookies);
+
+  // The store may have handed over the cookies of other keys with those of
+  // |key|; check each of them for duplicates as InitStore() does.
+  std::set<std::string> keys;
+  ImportCookies(cookies, &keys);
+  int num_duplicates_trimmed = 0;
+  for (std::set<std::string>::const_iterator it = keys.begin();
+       it != keys.end(); ++it) {
+    CookieMapItPair its = cookies_.equal_range(*it);
+    num_duplicates_trimmed +=
+        TrimDuplicateCookiesForKey(*it, its.first, its.second);
+  }
+  histogram_cookie_deletion_cause_->Add(num_duplicates_trimmed);
+
+  if (all_loaded) {
+    loaded_ = true;
+    loaded_keys_.clear();
+    imported_creation_times_.clear();
+  }
+
+  histogram_time_load_key_->AddTime(TimeTicks::Now() - beginning_time);
+}
+
+void CookieMonster::LoadAllCookiesIfNecessary() {
+  lock_.AssertAcquired();
+
+  if (loaded_)
+    return;
+
+  TimeTicks beginning_time(TimeTicks::Now());
+
+  std::vector<CanonicalCookie*> cookies;
+  store_->LoadRemainingCookies(&cookies);
+
+  std::set<std::string> keys;
+  ImportCookies(cookies, &keys);
+  EnsureCookiesMapIsValid();
+
+  loaded_ = true;
+  loaded_keys_.clear();
+  imported_creation_times_.clear();
+
+  histogram_time_load_->AddTime(TimeTicks::Now() - beginning_time);
+}
+
+void CookieMonster::ImportCookies(const std::vector<CanonicalCookie*>& cookies,
+                                  std::set<std::string>* keys) {
+  lock_.AssertAcquired();
+
   // Avoid ever letting cookies with duplicate creation times into the store;
   // that way we don't have to worry about what sections of code are safe
   // to call while it's in that state.
-  std::set<int64> creation_times;
-
-  // Presumably later than any access time in the store.
-  Time earliest_access_time;
-
   for (std::vector<CanonicalCookie*>::const_iterator it = cookies.begin();
        it != cookies.end(); ++it) {
     int64 cookie_creation_time = (*it)->CreationDate().ToInternalValue();
 
-    if (creation_times.insert(cookie_creation_time).second) {
-      InternalInsertCookie(GetKey((*it)->Domain()), *it, false);
+    if (imported_creation_times_.insert(cookie_creation_time).second) {
+      const std::string key(GetKey((*it)->Domain()));
+      InternalInsertCookie(key, *it, false);
+      keys->insert(key);
       const Time cookie_access_time((*it)->LastAccessDate());
-      if (earliest_access_time.is_null() ||
-          cookie_access_time < earliest_access_time)
-        earliest_access_time = cookie_access_time;
+      if (earliest_access_time_.is_null() ||
+          cookie_access_time < earliest_access_time_)
+        earliest_access_time_ = cookie_access_time;
     } else {
       LOG(ERROR) << base::StringPrintf("Found cookies with duplicate creation "
                                        "times in backing store: "
@@ -901,15 +1016,6 @@ void CookieMonster::InitStore() {
       delete (*it);
     }
   }
-  earliest_access_time_= earliest_access_time;
-
-  // After importing cookies from the PersistentCookieStore, verify that
-  // none of our other constraints are violated.
-  //
-  // In particular, the backing store might have given us duplicate cookies.
-  EnsureCookiesMapIsValid();
-
-  histogram_time_load_->AddTime(TimeTicks::Now() - beginning_time);
 }
 
 void CookieMonster::EnsureCookiesMapIsValid() {
@@ -922,7 +1028,7 @@ void CookieMonster::EnsureCookiesMapIsValid() {
   while (prev_range_end != cookies_.end()) {
     CookieMap::iterator cur_range_begin = prev_range_end;
     const std::string key = cur_range_begin->first;  // Keep a copy.
-    CookieMap::iterator cur_range_end = cookies_.upper_bound(key);
+    CookieMap::iterator cur_range_end = cookies_.equal_range(key).second;
     prev_range_end = cur_range_end;
 
     // Ensure no equivalent cookies for this host.
@@ -1046,9 +1152,12 @@ void CookieMonster::FindCookiesForHostAndDomain(
   // want to collect statistics whenever the browser's being used.
   RecordPeriodicStats(current_time);
 
-  if (expiry_and_key_scheme_ == EKS_DISCARD_RECENT_AND_PURGE_DOMAIN) {
-    // Can just dispatch to FindCookiesForKey
-    const std::string key(GetKey(url.host()));
+  std::string key(GetKey(url.host()));
+  LoadCookiesForKeyIfNecessary(key);
+
+  if (expiry_and_key_scheme_ == EKS_KEEP_RECENT_AND_PURGE_ETLDP1) {
+    // Host and domain cookies all live under the eTLD+1 of the host, so can
+    // just dispatch to FindCookiesForKey.
     FindCookiesForKey(key, url, options, current_time,
                       update_access_time, cookies);
   } else {
@@ -1056,7 +1165,6 @@ void CookieMonster::FindCookiesForHostAndDomain(
     // cookies for us.
 
     // Query for the full host, For example: 'a.c.blah.com'.
-    std::string key(GetKey(url.host()));
     FindCookiesForKey(key, url, options, current_time, update_access_time,
                       cookies);
 
@@ -1093,6 +1201,7 @@ void CookieMonster::FindCookiesForKey(
 
   const std::string scheme(url.scheme());
   const std::string host(url.host());
+  const std::string url_path(url.path());
   bool secure = url.SchemeIsSecure();
 
   for (CookieMapItPair its = cookies_.equal_range(key);
@@ -1120,7 +1229,7 @@ void CookieMonster::FindCookiesForKey(
         && !cc->IsDomainMatch(scheme, host))
       continue;
 
-    if (!cc->IsOnPath(url.path()))
+    if (!cc->IsOnPath(url_path))
       continue;
 
     // Add this cookie to the set of matching cookies.  Update the access
@@ -1231,6 +1340,7 @@ bool CookieMonster::SetCanonicalCookie(scoped_ptr<CanonicalCookie>* cc,
                                        const Time& creation_time,
                                        const CookieOptions& options) {
   const std::string key(GetKey((*cc)->Domain()));
+  LoadCookiesForKeyIfNecessary(key);
   bool already_expired = (*cc)->IsExpired(creation_time);
   if (DeleteAnyEquivalentCookie(key, **cc, options.exclude_httponly(),
                                 already_expired)) {
@@ -1357,8 +1467,9 @@ int CookieMonster::GarbageCollect(const Time& current,
 
   // Collect garbage for everything.  With firefox style we want to
   // preserve cookies touched in kSafeFromGlobalPurgeDays, otherwise
-  // not.
-  if (cookies_.size() > kMaxCookies &&
+  // not.  This waits until all the cookies of the store are imported, as
+  // only then is the total known.
+  if (loaded_ && cookies_.size() > kMaxCookies &&
       (expiry_and_key_scheme_ == EKS_DISCARD_RECENT_AND_PURGE_DOMAIN ||
        earliest_access_time_ <
        Time::Now() - TimeDelta::FromDays(kSafeFromGlobalPurgeDays))) {
@@ -1468,14 +1579,15 @@ std::string CookieMonster::GetKey(const std::string& domain) const {
   if (expiry_and_key_scheme_ == EKS_DISCARD_RECENT_AND_PURGE_DOMAIN)
     return domain;
 
-  std::string effective_domain(
-      RegistryControlledDomainService::GetDomainAndRegistry(domain));
-  if (effective_domain.empty())
-    effective_domain = domain;
+  KeyCache::const_iterator it = key_cache_.find(domain);
+  if (it != key_cache_.end())
+    return it->second;
 
-  if (!effective_domain.empty() && effective_domain[0] == '.')
-    return effective_domain.substr(1);
-  return effective_domain;
+  if (key_cache_.size() >= kMaxKeyCacheSize)
+    key_cache_.clear();
+  const std::string key(GetEffectiveDomainKey(domain));
+  key_cache_.insert(KeyCache::value_type(domain, key));
+  return key;
 }
 
 bool CookieMonster::HasCookieableScheme(const GURL& url) {
@@ -1514,6 +1626,13 @@ void CookieMonster::RecordPeriodicStats(const base::Time& current_time) {
     return;
   }
 
+  // While the cookies are loaded by key, |cookies_| holds only those of the
+  // keys used so far, and the counts would be too low. Loading the rest just
+  // for the statistics would defeat loading by key, so wait until something
+  // needs all of them.
+  if (!loaded_)
+    return;
+
   // See InitializeHistograms() for details.
   histogram_count_->Add(cookies_.size());
 
@@ -1619,6 +1738,10 @@ void CookieMonster::InitializeHistograms() {
   histogram_time_load_ = base::Histogram::FactoryTimeGet("Cookie.TimeLoad",
       base::TimeDelta::FromMilliseconds(1), base::TimeDelta::FromMinutes(1),
       50, base::Histogram::kUmaTargetedHistogramFlag);
+  histogram_time_load_key_ = base::Histogram::FactoryTimeGet(
+      "Cookie.TimeLoadKey",
+      base::TimeDelta::FromMilliseconds(1), base::TimeDelta::FromMinutes(1),
+      50, base::Histogram::kUmaTargetedHistogramFlag);
 }
 
 
@@ -1682,6 +1805,22 @@ static inline bool SeekBackPast(std::string::const_iterator* it,
   return *it == end;
 }
 
+bool CookieMonster::PersistentCookieStore::SupportsLoadCookiesForKey() const {
+  return false;
+}
+
+bool CookieMonster::PersistentCookieStore::LoadCookiesForKey(
+    const std::string& key,
+    std::vector<CookieMonster::CanonicalCookie*>* cookies) {
+  NOTREACHED();
+  return true;
+}
+
+void CookieMonster::PersistentCookieStore::LoadRemainingCookies(
+    std::vector<CookieMonster::CanonicalCookie*>* cookies) {
+  NOTREACHED();
+}
+
 const char CookieMonster::ParsedCookie::kTerminator[] = "\n\r\0";
 const int CookieMonster::ParsedCookie::kTerminatorLen =
     sizeof(kTerminator) - 1;
@@ -2046,7 +2185,8 @@ bool CookieMonster::CanonicalCookie::IsOnPath(
   // Make sure the cookie path is a prefix of the url path.  If the
   // url path is shorter than the cookie path, then the cookie path
   // can't be a prefix.
-  if (url_path.find(path_) != 0)
+  if (url_path.length() < path_.length() ||
+      url_path.compare(0, path_.length(), path_) != 0)
     return false;
 
   // Now we know that url_path is >= cookie_path, and that cookie_path
@@ -9,12 +9,14 @@
 #pragma once
 
 #include <map>
+#include <set>
 #include <string>
 #include <utility>
 #include <vector>
 
 #include "base/basictypes.h"
 #include "base/gtest_prod_util.h"
+#include "base/hash_tables.h"
 #include "base/memory/ref_counted.h"
 #include "base/memory/scoped_ptr.h"
 #include "base/synchronization/lock.h"
@@ -86,16 +88,12 @@ class CookieMonster : public CookieStore {
   // then the key is just the domain of the cookie.  Eventually, this
   // option will be removed.
 
-  // NOTE(deanm):
-  // I benchmarked hash_multimap vs multimap.  We're going to be query-heavy
-  // so it would seem like hashing would help.  However they were very
-  // close, with multimap being a tiny bit faster.  I think this is because
-  // our map is at max around 1000 entries, and the additional complexity
-  // for the hashing might not overcome the O(log(1000)) for querying
-  // a multimap.  Also, multimap is standard, another reason to use it.
-  // TODO(rdsmith): This benchmark should be re-done now that we're allowing
-  // subtantially more entries in the map.
-  typedef std::multimap<std::string, CanonicalCookie*> CookieMap;
+  // The map used to be a std::multimap, which was about as fast as a hash
+  // table when it held at most around 1000 entries.  Now that it holds
+  // several times that, every lookup pays for a walk down a deep tree of
+  // string compares, so it is hashed; cookies of one key are still adjacent,
+  // which equal_range() relies on, but keys are in no particular order.
+  typedef base::hash_multimap<std::string, CanonicalCookie*> CookieMap;
   typedef std::pair<CookieMap::iterator, CookieMap::iterator> CookieMapItPair;
 
   // The key and expiry scheme to be used by the monster.
@@ -130,6 +128,11 @@ class CookieMonster : public CookieStore {
   // i.e. it doesn't begin with a leading '.' character.
   static bool DomainIsHostOnly(const std::string& domain_string);
 
+  // Returns the CookieMap key of |domain| under the default
+  // EKS_KEEP_RECENT_AND_PURGE_ETLDP1 scheme, for stores that load cookies
+  // by key.
+  static std::string GetEffectiveDomainKey(const std::string& domain);
+
   // Sets a cookie given explicit user-provided cookie attributes. The cookie
   // name, value, domain, etc. are each provided as separate strings. This
   // function expects each attribute to be well-formed. It will check for
@@ -353,10 +356,27 @@ class CookieMonster : public CookieStore {
     }
   }
 
-  // Initializes the backing store and reads existing cookies from it.
+  // Initializes the backing store and reads existing cookies from it, or,
+  // if the store can load cookies by key, leaves that to
+  // LoadCookiesForKeyIfNecessary() and LoadAllCookiesIfNecessary().
   // Should only be called by InitIfNecessary().
   void InitStore();
 
+  // Imports the cookies for CookieMap key |key| from the store unless they
+  // are in |cookies_| already. Must be called before looking at the cookies
+  // of a key.
+  void LoadCookiesForKeyIfNecessary(const std::string& key);
+
+  // Imports all the cookies from the store not imported yet. Must be called
+  // before looking at the cookies of more than one key.
+  void LoadAllCookiesIfNecessary();
+
+  // Inserts |cookies| read from the store into |cookies_|, taking ownership
+  // of them, and adds their keys to |keys|. Cookies with the creation time of
+  // one imported before are dropped.
+  void ImportCookies(const std::vector<CanonicalCookie*>& cookies,
+                     std::set<std::string>* keys);
+
   // Checks that |cookies_| matches our invariants, and tries to repair any
   // inconsistencies. (In other words, it does not have duplicate cookies).
   void EnsureCookiesMapIsValid();
@@ -456,7 +476,8 @@ class CookieMonster : public CookieStore {
   // Statistics support
 
   // This function should be called repeatedly, and will record
-  // statistics if a sufficient time period has passed.
+  // statistics if a sufficient time period has passed and all the cookies
+  // are loaded.
   void RecordPeriodicStats(const base::Time& current_time);
 
   // Initialize the above variables; should only be called from
@@ -480,13 +501,27 @@ class CookieMonster : public CookieStore {
   base::Histogram* histogram_cookie_deletion_cause_;
   base::Histogram* histogram_time_get_;
   base::Histogram* histogram_time_load_;
+  base::Histogram* histogram_time_load_key_;
 
   CookieMap cookies_;
 
+  // Keys GetKey() computed for the hosts and domains seen lately, so that
+  // hot hosts skip the registry lookup.  Emptied once it grows past
+  // kMaxKeyCacheSize.
+  typedef base::hash_map<std::string, std::string> KeyCache;
+  mutable KeyCache key_cache_;
+
   // Indicates whether the cookie store has been initialized. This happens
   // lazily in InitStoreIfNecessary().
   bool initialized_;
 
+  // Indicates whether every cookie of the store is in |cookies_|. Until then
+  // |loaded_keys_| holds the keys whose cookies are, and
+  // |imported_creation_times_| the creation times of all cookies imported.
+  bool loaded_;
+  std::set<std::string> loaded_keys_;
+  std::set<int64> imported_creation_times_;
+
   // Indicates whether this cookie monster uses the new effective domain
   // key scheme or not.
   ExpiryAndKeyScheme expiry_and_key_scheme_;
@@ -779,6 +814,25 @@ class CookieMonster::PersistentCookieStore
   // called only once at startup.
   virtual bool Load(std::vector<CookieMonster::CanonicalCookie*>* cookies) = 0;
 
+  // Stores that can load the cookies of one CookieMap key ahead of the rest
+  // return true here. Load() is then not called; the cookie monster asks for
+  // each key with LoadCookiesForKey() as it is first needed, while the store
+  // loads the others in the background.
+  virtual bool SupportsLoadCookiesForKey() const;
+
+  // Appends the cookies whose key, as given by GetEffectiveDomainKey(), is
+  // |key| to |cookies|, possibly followed by cookies of other keys that have
+  // been loaded in the background. No cookie is returned twice. Returns true
+  // once every cookie of the store has been returned.
+  virtual bool LoadCookiesForKey(
+      const std::string& key,
+      std::vector<CookieMonster::CanonicalCookie*>* cookies);
+
+  // Appends all the cookies not returned yet to |cookies|, waiting for the
+  // background load to finish.
+  virtual void LoadRemainingCookies(
+      std::vector<CookieMonster::CanonicalCookie*>* cookies);
+
   virtual void AddCookie(const CanonicalCookie& cc) = 0;
   virtual void UpdateCookieAccessTime(const CanonicalCookie& cc) = 0;
   virtual void DeleteCookie(const CanonicalCookie& cc) = 0;
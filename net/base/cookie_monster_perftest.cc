@@ -234,6 +234,66 @@ TEST(CookieMonsterTest, TestImport) {
   EXPECT_EQ("domain_1.com", cm->GetKey("www.Domain_1.com"));
 }
 
+// Times the first query after startup against a large store, once with the
+// whole store imported up front and once with only the key in use.
+TEST(CookieMonsterTest, TestColdStart) {
+  const struct TestCase {
+    const char* name;
+    bool load_by_key;
+  } test_cases[] = {
+    { "Cookie_monster_cold_start_full_load", false },
+    { "Cookie_monster_cold_start_load_by_key", true },
+  };
+  for (size_t ci = 0; ci < ARRAYSIZE_UNSAFE(test_cases); ++ci) {
+    scoped_refptr<MockPersistentCookieStore> store(
+        new MockPersistentCookieStore);
+    store->set_load_by_key(test_cases[ci].load_by_key);
+    std::vector<CookieMonster::CanonicalCookie*> initial_cookies;
+    int64 time_tick(base::Time::Now().ToInternalValue());
+    for (int domain_num = 0; domain_num < 300; domain_num++) {
+      std::string domain_name(base::StringPrintf(".domain_%d.com", domain_num));
+      std::string gurl("www" + domain_name);
+      for (int cookie_num = 0; cookie_num < 50; cookie_num++) {
+        std::string cookie_line(base::StringPrintf("Cookie_%d=1; Path=/",
+                                                   cookie_num));
+        AddCookieToList(gurl, cookie_line,
+                        base::Time::FromInternalValue(time_tick++),
+                        &initial_cookies);
+      }
+    }
+    store->SetLoadExpectation(true, initial_cookies);
+
+    scoped_refptr<CookieMonster> cm(new CookieMonster(store, NULL));
+    GURL gurl("http://www.domain_150.com/");
+    PerfTimeLogger timer(test_cases[ci].name);
+    EXPECT_FALSE(cm->GetCookies(gurl).empty());
+    timer.Done();
+
+    // Everything else still comes in when it is asked for.
+    EXPECT_EQ(300U * 50U, cm->GetAllCookies().size());
+  }
+}
+
+// Times building the cookie line for a busy host of a full cookie monster,
+// which is what every request to that host pays for.
+TEST(CookieMonsterTest, TestQueryHotDomain) {
+  scoped_refptr<CookieMonster> cm(new CookieMonster(NULL, NULL));
+  for (int domain_num = 0; domain_num < 300; domain_num++) {
+    GURL gurl(base::StringPrintf("http://www.domain_%d.com/", domain_num));
+    for (int cookie_num = 0; cookie_num < 10; cookie_num++) {
+      EXPECT_TRUE(cm->SetCookie(gurl, base::StringPrintf(
+          "Cookie_%d=1; Path=/; Domain=.domain_%d.com",
+          cookie_num, domain_num)));
+    }
+  }
+
+  GURL gurl("http://www.domain_150.com/a/b/c.html");
+  PerfTimeLogger timer("Cookie_monster_query_hot_domain");
+  for (int i = 0; i < kNumCookies; i++)
+    EXPECT_FALSE(cm->GetCookies(gurl).empty());
+  timer.Done();
+}
+
 TEST(CookieMonsterTest, TestGetKey) {
   scoped_refptr<CookieMonster> cm(new CookieMonster(NULL, NULL));
   PerfTimeLogger timer("Cookie_monster_get_key");
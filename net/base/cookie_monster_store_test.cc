@@ -13,7 +13,8 @@
 namespace net {
 
 MockPersistentCookieStore::MockPersistentCookieStore()
-    : load_return_value_(true) {
+    : load_return_value_(true),
+      load_by_key_(false) {
 }
 
 MockPersistentCookieStore::~MockPersistentCookieStore() {}
@@ -33,6 +34,33 @@ bool MockPersistentCookieStore::Load(
   return ok;
 }
 
+bool MockPersistentCookieStore::SupportsLoadCookiesForKey() const {
+  return load_by_key_;
+}
+
+bool MockPersistentCookieStore::LoadCookiesForKey(
+    const std::string& key,
+    std::vector<CookieMonster::CanonicalCookie*>* out_cookies) {
+  loaded_keys_.push_back(key);
+  std::vector<CookieMonster::CanonicalCookie*> others;
+  for (std::vector<CookieMonster::CanonicalCookie*>::const_iterator it =
+           load_result_.begin(); it != load_result_.end(); ++it) {
+    if (CookieMonster::GetEffectiveDomainKey((*it)->Domain()) == key)
+      out_cookies->push_back(*it);
+    else
+      others.push_back(*it);
+  }
+  load_result_.swap(others);
+  return load_result_.empty();
+}
+
+void MockPersistentCookieStore::LoadRemainingCookies(
+    std::vector<CookieMonster::CanonicalCookie*>* out_cookies) {
+  out_cookies->insert(out_cookies->end(), load_result_.begin(),
+                      load_result_.end());
+  load_result_.clear();
+}
+
 void MockPersistentCookieStore::AddCookie(
     const CookieMonster::CanonicalCookie& cookie) {
   commands_.push_back(
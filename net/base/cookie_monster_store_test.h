@@ -35,6 +35,8 @@ struct CookieStoreCommand {
 // Implementation of PersistentCookieStore that captures the
 // received commands and saves them to a list.
 // The result of calls to Load() can be configured using SetLoadExpectation().
+// After set_load_by_key(true) the same cookies are handed out by
+// LoadCookiesForKey() and LoadRemainingCookies() instead.
 class MockPersistentCookieStore
     : public CookieMonster::PersistentCookieStore {
  public:
@@ -47,13 +49,27 @@ class MockPersistentCookieStore
       bool return_value,
       const std::vector<CookieMonster::CanonicalCookie*>& result);
 
+  void set_load_by_key(bool load_by_key) { load_by_key_ = load_by_key; }
+
   const CommandList& commands() const {
     return commands_;
   }
 
+  // Keys passed to LoadCookiesForKey(), in order.
+  const std::vector<std::string>& loaded_keys() const { return loaded_keys_; }
+
   virtual bool Load(
       std::vector<CookieMonster::CanonicalCookie*>* out_cookies);
 
+  virtual bool SupportsLoadCookiesForKey() const;
+
+  virtual bool LoadCookiesForKey(
+      const std::string& key,
+      std::vector<CookieMonster::CanonicalCookie*>* out_cookies);
+
+  virtual void LoadRemainingCookies(
+      std::vector<CookieMonster::CanonicalCookie*>* out_cookies);
+
   virtual void AddCookie(const CookieMonster::CanonicalCookie& cookie);
 
   virtual void UpdateCookieAccessTime(
@@ -74,6 +90,9 @@ class MockPersistentCookieStore
   bool load_return_value_;
   std::vector<CookieMonster::CanonicalCookie*> load_result_;
 
+  bool load_by_key_;
+  std::vector<std::string> loaded_keys_;
+
   DISALLOW_COPY_AND_ASSIGN(MockPersistentCookieStore);
 };
 
@@ -1515,6 +1515,38 @@ TEST(CookieMonsterTest, DontImportDuplicateCreationTimes) {
   EXPECT_NE(name1, name2);
 }
 
+// Tests that a store which loads by key is only asked for the keys in use,
+// and that cookies set on a key before it is used replace the stored ones.
+TEST(CookieMonsterTest, LoadCookiesByKey) {
+  GURL url_google("http://www.google.com/");
+  GURL url_example("http://www.example.com/");
+
+  scoped_refptr<MockPersistentCookieStore> store(
+      new MockPersistentCookieStore);
+  store->set_load_by_key(true);
+
+  Time now(Time::Now());
+  std::vector<CookieMonster::CanonicalCookie*> initial_cookies;
+  AddCookieToList("www.google.com", "X=1; path=/", now, &initial_cookies);
+  AddCookieToList("www.example.com", "Y=1; path=/",
+                  now - TimeDelta::FromDays(1), &initial_cookies);
+  store->SetLoadExpectation(true, initial_cookies);
+
+  scoped_refptr<CookieMonster> cm(new CookieMonster(store, NULL));
+
+  EXPECT_EQ("X=1", cm->GetCookies(url_google));
+  ASSERT_EQ(1U, store->loaded_keys().size());
+  EXPECT_EQ("google.com", store->loaded_keys()[0]);
+
+  EXPECT_TRUE(cm->SetCookie(url_example, "Y=2; path=/"));
+  ASSERT_EQ(2U, store->loaded_keys().size());
+  EXPECT_EQ("example.com", store->loaded_keys()[1]);
+  EXPECT_EQ("Y=2", cm->GetCookies(url_example));
+
+  EXPECT_EQ(2U, cm->GetAllCookies().size());
+  EXPECT_EQ(2U, store->loaded_keys().size());
+}
+
 TEST(CookieMonsterTest, Delegate) {
   GURL url_google(kUrlGoogle);
 
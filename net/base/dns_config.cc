@@ -0,0 +1,156 @@
+// Copyright (c) 2011 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/base/dns_config.h"
+
+#include <algorithm>
+
+#include "base/file_path.h"
+#include "base/file_util.h"
+#include "base/string_number_conversions.h"
+#include "base/string_split.h"
+#include "base/string_util.h"
+#include "net/base/net_util.h"
+
+namespace net {
+
+namespace {
+
+// The defaults of glibc.
+const int kDefaultNdots = 1;
+const int kDefaultTimeoutSeconds = 5;
+const int kDefaultAttempts = 2;
+
+// The limits of glibc.
+const size_t kMaxNameservers = 3;
+const int kMaxNdots = 15;
+const int kMaxTimeoutSeconds = 30;
+const int kMaxAttempts = 5;
+
+const int kDnsPort = 53;
+
+// Parses |option|, which has the form "name:value", into |value| if it is a
+// number not over |max|.
+bool ParseOptionValue(const std::string& option, const char* name, int max,
+                      int* value) {
+  std::string prefix = std::string(name) + ":";
+  if (!StartsWithASCII(option, prefix, true))
+    return false;
+  int number;
+  if (!base::StringToInt(option.substr(prefix.size()), &number) || number < 0)
+    return false;
+  *value = std::min(number, max);
+  return true;
+}
+
+}  // namespace
+
+DnsConfig::DnsConfig()
+    : ndots(kDefaultNdots),
+      timeout(base::TimeDelta::FromSeconds(kDefaultTimeoutSeconds)),
+      attempts(kDefaultAttempts) {
+}
+
+DnsConfig::~DnsConfig() {
+}
+
+bool DnsConfig::IsValid() const {
+  return !nameservers.empty();
+}
+
+bool ParseResolvConf(const std::string& contents, DnsConfig* config) {
+  *config = DnsConfig();
+
+  std::vector<std::string> lines;
+  base::SplitString(contents, '\n', &lines);
+  for (size_t i = 0; i < lines.size(); ++i) {
+    std::string line = lines[i];
+    size_t comment = line.find_first_of("#;");
+    if (comment != std::string::npos)
+      line.erase(comment);
+
+    std::vector<std::string> words;
+    base::SplitStringAlongWhitespace(line, &words);
+    if (words.empty())
+      continue;
+
+    if (words[0] == "nameserver") {
+      IPAddressNumber address;
+      if (words.size() > 1 &&
+          config->nameservers.size() < kMaxNameservers &&
+          ParseIPLiteralToNumber(words[1], &address)) {
+        config->nameservers.push_back(IPEndPoint(address, kDnsPort));
+      }
+    } else if (words[0] == "domain") {
+      // The last of the "domain" and "search" lines wins.
+      config->search.assign(words.begin() + 1,
+                            words.begin() + std::min<size_t>(words.size(), 2));
+    } else if (words[0] == "search") {
+      config->search.assign(words.begin() + 1, words.end());
+    } else if (words[0] == "options") {
+      for (size_t j = 1; j < words.size(); ++j) {
+        int seconds;
+        if (ParseOptionValue(words[j], "timeout", kMaxTimeoutSeconds,
+                             &seconds)) {
+          config->timeout = base::TimeDelta::FromSeconds(std::max(seconds, 1));
+          continue;
+        }
+        if (ParseOptionValue(words[j], "attempts", kMaxAttempts,
+                             &config->attempts)) {
+          config->attempts = std::max(config->attempts, 1);
+          continue;
+        }
+        ParseOptionValue(words[j], "ndots", kMaxNdots, &config->ndots);
+      }
+    }
+  }
+  return config->IsValid();
+}
+
+void ParseHosts(const std::string& contents, DnsHosts* hosts) {
+  hosts->clear();
+
+  std::vector<std::string> lines;
+  base::SplitString(contents, '\n', &lines);
+  for (size_t i = 0; i < lines.size(); ++i) {
+    std::string line = lines[i];
+    size_t comment = line.find('#');
+    if (comment != std::string::npos)
+      line.erase(comment);
+
+    std::vector<std::string> words;
+    base::SplitStringAlongWhitespace(line, &words);
+    IPAddressNumber address;
+    if (words.size() < 2 || !ParseIPLiteralToNumber(words[0], &address))
+      continue;
+    for (size_t j = 1; j < words.size(); ++j) {
+      std::vector<IPAddressNumber>& addresses =
+          (*hosts)[StringToLowerASCII(words[j])];
+      if (std::find(addresses.begin(), addresses.end(), address) ==
+          addresses.end())
+        addresses.push_back(address);
+    }
+  }
+}
+
+bool ReadSystemDnsConfig(DnsConfig* config) {
+#if defined(OS_POSIX)
+  std::string contents;
+  if (!file_util::ReadFileToString(FilePath("/etc/resolv.conf"), &contents))
+    return false;
+  if (!ParseResolvConf(contents, config))
+    return false;
+  // A missing hosts file only means there are no entries.
+  contents.clear();
+  file_util::ReadFileToString(FilePath("/etc/hosts"), &contents);
+  ParseHosts(contents, &config->hosts);
+  return true;
+#else
+  // The settings of the Windows resolver live in the registry, and are not
+  // supported yet.
+  return false;
+#endif
+}
+
+}  // namespace net
@@ -0,0 +1,66 @@
+// Copyright (c) 2011 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_BASE_DNS_CONFIG_H_
+#define NET_BASE_DNS_CONFIG_H_
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "base/time.h"
+#include "net/base/ip_endpoint.h"
+#include "net/base/net_util.h"
+
+namespace net {
+
+// The entries of a hosts file: the addresses of each lower case host name, in
+// the order of the file.
+typedef std::map<std::string, std::vector<IPAddressNumber> > DnsHosts;
+
+// The settings used by the built-in DNS resolver, as found in resolv.conf.
+struct DnsConfig {
+  DnsConfig();
+  ~DnsConfig();
+
+  // Returns true if there is at least one name server to query.
+  bool IsValid() const;
+
+  // The name servers, in the order they are tried.
+  std::vector<IPEndPoint> nameservers;
+
+  // The suffixes to append to names that have fewer than |ndots| dots.
+  std::vector<std::string> search;
+
+  // Names with at least |ndots| dots are tried as is before the search list.
+  int ndots;
+
+  // The time to wait for an answer from a name server, which is doubled on
+  // each round of retransmissions.
+  base::TimeDelta timeout;
+
+  // The number of times each name server is tried.
+  int attempts;
+
+  // The names of the hosts file, which are looked up before the name servers
+  // are queried.
+  DnsHosts hosts;
+};
+
+// Parses the contents of a resolv.conf file into |config|. Unknown or
+// malformed lines are ignored. Returns false if no name server was found.
+bool ParseResolvConf(const std::string& contents, DnsConfig* config);
+
+// Parses the contents of a hosts file into |hosts|. Lines with an invalid
+// address are ignored.
+void ParseHosts(const std::string& contents, DnsHosts* hosts);
+
+// Reads the settings of the system resolver into |config|. This does blocking
+// file IO. Returns false if the settings cannot be read or are not supported.
+bool ReadSystemDnsConfig(DnsConfig* config);
+
+}  // namespace net
+
+#endif  // NET_BASE_DNS_CONFIG_H_
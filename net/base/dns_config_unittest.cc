@@ -0,0 +1,96 @@
+// Copyright (c) 2011 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/base/dns_config.h"
+
+#include "net/base/net_util.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace net {
+
+namespace {
+
+IPEndPoint Nameserver(const std::string& ip_literal) {
+  IPAddressNumber address;
+  EXPECT_TRUE(ParseIPLiteralToNumber(ip_literal, &address));
+  return IPEndPoint(address, 53);
+}
+
+}  // namespace
+
+TEST(DnsConfigTest, ParseResolvConf) {
+  const char kResolvConf[] =
+      "# Generated by NetworkManager\n"
+      "domain corp.example.com\n"
+      "search example.com example.net  ; the last line wins\n"
+      "nameserver 192.168.1.1\n"
+      "nameserver   fe80::1\n"
+      "nameserver not.an.address\n"
+      "options rotate timeout:2 attempts:3 ndots:2\n";
+  DnsConfig config;
+  ASSERT_TRUE(ParseResolvConf(kResolvConf, &config));
+  ASSERT_EQ(2u, config.nameservers.size());
+  EXPECT_TRUE(Nameserver("192.168.1.1") == config.nameservers[0]);
+  EXPECT_TRUE(Nameserver("fe80::1") == config.nameservers[1]);
+  ASSERT_EQ(2u, config.search.size());
+  EXPECT_EQ("example.com", config.search[0]);
+  EXPECT_EQ("example.net", config.search[1]);
+  EXPECT_EQ(2, config.timeout.InSeconds());
+  EXPECT_EQ(3, config.attempts);
+  EXPECT_EQ(2, config.ndots);
+}
+
+TEST(DnsConfigTest, ParseHosts) {
+  const char kHosts[] =
+      "127.0.0.1\tlocalhost localhost.localdomain\n"
+      "::1 localhost ip6-localhost  # loopback\n"
+      "# 192.168.1.1 commented.out\n"
+      "192.168.1.2 Printer.Example.com\n"
+      "not.an.address bogus\n"
+      "192.168.1.3\n"
+      "127.0.0.1 localhost\n";
+  DnsHosts hosts;
+  ParseHosts(kHosts, &hosts);
+  EXPECT_EQ(4u, hosts.size());
+
+  IPAddressNumber loopback;
+  ASSERT_TRUE(ParseIPLiteralToNumber("127.0.0.1", &loopback));
+  IPAddressNumber loopback6;
+  ASSERT_TRUE(ParseIPLiteralToNumber("::1", &loopback6));
+  const std::vector<IPAddressNumber>& localhost = hosts["localhost"];
+  ASSERT_EQ(2u, localhost.size());
+  EXPECT_TRUE(loopback == localhost[0]);
+  EXPECT_TRUE(loopback6 == localhost[1]);
+  EXPECT_EQ(1u, hosts["localhost.localdomain"].size());
+  EXPECT_EQ(1u, hosts["ip6-localhost"].size());
+  EXPECT_EQ(1u, hosts["printer.example.com"].size());
+  EXPECT_TRUE(hosts.find("commented.out") == hosts.end());
+  EXPECT_TRUE(hosts.find("bogus") == hosts.end());
+}
+
+TEST(DnsConfigTest, ParseResolvConfDefaults) {
+  DnsConfig config;
+  ASSERT_TRUE(ParseResolvConf("nameserver 10.0.0.1\n"
+                              "search example.com\n"
+                              "domain a.example.com b.example.com\n"
+                              "options timeout:0 attempts:100\n", &config));
+  ASSERT_EQ(1u, config.search.size());
+  EXPECT_EQ("a.example.com", config.search[0]);
+  EXPECT_EQ(1, config.timeout.InSeconds());
+  EXPECT_EQ(5, config.attempts);
+  EXPECT_EQ(1, config.ndots);
+
+  // Only the first three name servers are used.
+  ASSERT_TRUE(ParseResolvConf("nameserver 10.0.0.1\n"
+                              "nameserver 10.0.0.2\n"
+                              "nameserver 10.0.0.3\n"
+                              "nameserver 10.0.0.4\n", &config));
+  EXPECT_EQ(3u, config.nameservers.size());
+  EXPECT_TRUE(config.search.empty());
+
+  EXPECT_FALSE(ParseResolvConf("search example.com\n", &config));
+  EXPECT_FALSE(config.IsValid());
+}
+
+}  // namespace net
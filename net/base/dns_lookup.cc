@@ -0,0 +1,158 @@
+// Copyright (c) 2011 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/base/dns_lookup.h"
+
+#include <algorithm>
+
+#include "base/logging.h"
+#include "net/base/dns_transaction.h"
+#include "net/base/dns_util.h"
+#include "net/base/net_errors.h"
+
+namespace net {
+
+namespace {
+
+// Appends |address| to |list|.
+void AppendAddress(const IPAddressNumber& address, AddressList* list) {
+  AddressList single(address, 0, false);
+  if (!list->head())
+    *list = single;
+  else
+    list->Append(single.head());
+}
+
+}  // namespace
+
+DnsLookup::DnsLookup(const DnsConfig& config,
+                     const std::string& hostname,
+                     AddressFamily address_family,
+                     NetLog* net_log)
+    : config_(config),
+      address_family_(address_family),
+      net_log_(net_log),
+      next_name_(0),
+      ipv4_result_(OK),
+      ipv6_result_(OK),
+      pending_transactions_(0),
+      ALLOW_THIS_IN_INITIALIZER_LIST(
+          ipv4_callback_(this, &DnsLookup::OnIPv4TransactionComplete)),
+      ALLOW_THIS_IN_INITIALIZER_LIST(
+          ipv6_callback_(this, &DnsLookup::OnIPv6TransactionComplete)),
+      user_callback_(NULL) {
+  // A name with a trailing dot is fully qualified. Otherwise, the search list
+  // comes first for names with fewer than |ndots| dots.
+  if (!hostname.empty() && hostname[hostname.size() - 1] == '.') {
+    names_.push_back(TrimEndingDot(hostname));
+    return;
+  }
+  int dots = std::count(hostname.begin(), hostname.end(), '.');
+  if (dots >= config_.ndots)
+    names_.push_back(hostname);
+  for (size_t i = 0; i < config_.search.size(); ++i)
+    names_.push_back(hostname + "." + TrimEndingDot(config_.search[i]));
+  if (dots < config_.ndots)
+    names_.push_back(hostname);
+}
+
+DnsLookup::~DnsLookup() {
+}
+
+int DnsLookup::Start(CompletionCallback* callback) {
+  DCHECK(!user_callback_);
+  int rv = StartNextName();
+  if (rv == ERR_IO_PENDING)
+    user_callback_ = callback;
+  return rv;
+}
+
+int DnsLookup::StartNextName() {
+  for (;;) {
+    DCHECK_EQ(0, pending_transactions_);
+    if (next_name_ == names_.size())
+      return ERR_NAME_NOT_RESOLVED;
+    const std::string& name = names_[next_name_++];
+
+    ipv4_result_ = ipv6_result_ = ERR_NAME_NOT_RESOLVED;
+    if (address_family_ != ADDRESS_FAMILY_IPV6) {
+      ipv4_transaction_.reset(
+          new DnsTransaction(config_, name, kDNS_A, net_log_));
+      ipv4_result_ = ipv4_transaction_->Start(&ipv4_callback_);
+      if (ipv4_result_ == ERR_IO_PENDING)
+        ++pending_transactions_;
+    }
+    if (address_family_ != ADDRESS_FAMILY_IPV4) {
+      ipv6_transaction_.reset(
+          new DnsTransaction(config_, name, kDNS_AAAA, net_log_));
+      ipv6_result_ = ipv6_transaction_->Start(&ipv6_callback_);
+      if (ipv6_result_ == ERR_IO_PENDING)
+        ++pending_transactions_;
+    }
+    if (pending_transactions_)
+      return ERR_IO_PENDING;
+
+    int rv = OnNameComplete();
+    if (rv != ERR_NAME_NOT_RESOLVED)
+      return rv;
+  }
+}
+
+void DnsLookup::OnIPv4TransactionComplete(int result) {
+  ipv4_result_ = result;
+  OnTransactionComplete(result);
+}
+
+void DnsLookup::OnIPv6TransactionComplete(int result) {
+  ipv6_result_ = result;
+  OnTransactionComplete(result);
+}
+
+void DnsLookup::OnTransactionComplete(int result) {
+  DCHECK_GT(pending_transactions_, 0);
+  if (--pending_transactions_)
+    return;
+
+  int rv = OnNameComplete();
+  if (rv == ERR_NAME_NOT_RESOLVED)
+    rv = StartNextName();
+  if (rv == ERR_IO_PENDING)
+    return;
+
+  CompletionCallback* callback = user_callback_;
+  user_callback_ = NULL;
+  callback->Run(rv);
+}
+
+int DnsLookup::OnNameComplete() {
+  addresses_.Reset();
+  if (ipv4_result_ == OK) {
+    const std::vector<IPAddressNumber>& found = ipv4_transaction_->addresses();
+    for (size_t i = 0; i < found.size(); ++i)
+      AppendAddress(found[i], &addresses_);
+  }
+  if (ipv6_result_ == OK) {
+    const std::vector<IPAddressNumber>& found = ipv6_transaction_->addresses();
+    for (size_t i = 0; i < found.size(); ++i)
+      AppendAddress(found[i], &addresses_);
+  }
+  ipv4_transaction_.reset();
+  ipv6_transaction_.reset();
+
+  if (addresses_.head())
+    return OK;
+  // The name has no address of either family: try the next one. Any other
+  // error of a transaction fails the lookup, as getaddrinfo() does.
+  if (address_family_ != ADDRESS_FAMILY_IPV6 &&
+      ipv4_result_ != ERR_NAME_NOT_RESOLVED) {
+    return ipv4_result_;
+  }
+  if (address_family_ != ADDRESS_FAMILY_IPV4 &&
+      ipv6_result_ != ERR_NAME_NOT_RESOLVED) {
+    return ipv6_result_;
+  }
+  return ERR_NAME_NOT_RESOLVED;
+}
+
+}  // namespace net
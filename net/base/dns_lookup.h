@@ -0,0 +1,79 @@
+// Copyright (c) 2011 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_BASE_DNS_LOOKUP_H_
+#define NET_BASE_DNS_LOOKUP_H_
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "base/memory/scoped_ptr.h"
+#include "net/base/address_family.h"
+#include "net/base/address_list.h"
+#include "net/base/completion_callback.h"
+#include "net/base/dns_config.h"
+
+namespace net {
+
+class DnsTransaction;
+class NetLog;
+
+// Resolves a host name to a list of addresses with DnsTransactions, the way
+// getaddrinfo() does with the system resolver: the names of the search list
+// are tried in turn, and both the IPv4 and the IPv6 addresses are queried, in
+// parallel, unless the address family is restricted. Must be used on a thread
+// with an IO message loop.
+class DnsLookup {
+ public:
+  DnsLookup(const DnsConfig& config,
+            const std::string& hostname,
+            AddressFamily address_family,
+            NetLog* net_log);
+  ~DnsLookup();
+
+  // Starts the lookup. Returns OK, an error, or ERR_IO_PENDING, in which case
+  // |callback| is called with the result later on. Deleting the lookup
+  // cancels it.
+  int Start(CompletionCallback* callback);
+
+  // The addresses found, with the IPv4 addresses first, and a port of zero.
+  const AddressList& addresses() const { return addresses_; }
+
+ private:
+  // Starts the transactions for the next name to try.
+  int StartNextName();
+
+  void OnTransactionComplete(int result);
+  void OnIPv4TransactionComplete(int result);
+  void OnIPv6TransactionComplete(int result);
+
+  // Called when the transactions for a name are done.
+  int OnNameComplete();
+
+  const DnsConfig config_;
+  const AddressFamily address_family_;
+  NetLog* net_log_;
+
+  std::vector<std::string> names_;  // The names to try, in order.
+  size_t next_name_;
+
+  scoped_ptr<DnsTransaction> ipv4_transaction_;
+  scoped_ptr<DnsTransaction> ipv6_transaction_;
+  int ipv4_result_;
+  int ipv6_result_;
+  int pending_transactions_;
+
+  AddressList addresses_;
+
+  CompletionCallbackImpl<DnsLookup> ipv4_callback_;
+  CompletionCallbackImpl<DnsLookup> ipv6_callback_;
+  CompletionCallback* user_callback_;
+
+  DISALLOW_COPY_AND_ASSIGN(DnsLookup);
+};
+
+}  // namespace net
+
+#endif  // NET_BASE_DNS_LOOKUP_H_
@@ -0,0 +1,63 @@
+// Copyright (c) 2011 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/base/dns_query.h"
+
+#include <string.h>
+
+#include "base/logging.h"
+#include "base/rand_util.h"
+
+namespace net {
+
+namespace {
+
+// Flags of the header: a standard query, with recursion desired.
+const uint16 kFlagRD = 0x0100;
+
+// The class of all the queries: Internet.
+const uint16 kClassIN = 1;
+
+// Writes |value| at |out| in network order, and returns the next position.
+char* WriteUint16(uint16 value, char* out) {
+  out[0] = static_cast<char>(value >> 8);
+  out[1] = static_cast<char>(value & 0xff);
+  return out + 2;
+}
+
+}  // namespace
+
+DnsQuery::DnsQuery(const std::string& qname, uint16 qtype)
+    : id_(static_cast<uint16>(base::RandInt(0, kuint16max))),
+      qname_(qname),
+      qtype_(qtype) {
+  DCHECK(!qname.empty());
+  io_buffer_ = new IOBufferWithSize(kHeaderSize + qname.size() + 4);
+
+  // The header: ID, flags and the count of each section.
+  char* out = io_buffer_->data();
+  out = WriteUint16(id_, out);
+  out = WriteUint16(kFlagRD, out);
+  out = WriteUint16(1, out);  // QDCOUNT.
+  out = WriteUint16(0, out);  // ANCOUNT.
+  out = WriteUint16(0, out);  // NSCOUNT.
+  out = WriteUint16(0, out);  // ARCOUNT.
+
+  // The question.
+  memcpy(out, qname.data(), qname.size());
+  out += qname.size();
+  out = WriteUint16(qtype, out);
+  out = WriteUint16(kClassIN, out);
+  DCHECK_EQ(io_buffer_->data() + io_buffer_->size(), out);
+}
+
+DnsQuery::~DnsQuery() {
+}
+
+base::StringPiece DnsQuery::question() const {
+  return base::StringPiece(io_buffer_->data() + kHeaderSize,
+                           io_buffer_->size() - kHeaderSize);
+}
+
+}  // namespace net
@@ -0,0 +1,52 @@
+// Copyright (c) 2011 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_BASE_DNS_QUERY_H_
+#define NET_BASE_DNS_QUERY_H_
+#pragma once
+
+#include <string>
+
+#include "base/basictypes.h"
+#include "base/memory/ref_counted.h"
+#include "base/string_piece.h"
+#include "net/base/io_buffer.h"
+
+namespace net {
+
+// Represents an on-the-wire DNS query message, asking for the records of type
+// |qtype| of a single name, with recursion desired.
+class DnsQuery {
+ public:
+  // Size of the header of a DNS message.
+  static const int kHeaderSize = 12;
+
+  // Constructs a query for |qname|, which must be in DNS format (see
+  // DNSDomainFromDot), with a random ID.
+  DnsQuery(const std::string& qname, uint16 qtype);
+  ~DnsQuery();
+
+  uint16 id() const { return id_; }
+  const std::string& qname() const { return qname_; }
+  uint16 qtype() const { return qtype_; }
+
+  // Returns the question section of the message, which a response to this
+  // query has to repeat.
+  base::StringPiece question() const;
+
+  // Returns the message to send.
+  IOBufferWithSize* io_buffer() const { return io_buffer_; }
+
+ private:
+  uint16 id_;
+  std::string qname_;
+  uint16 qtype_;
+  scoped_refptr<IOBufferWithSize> io_buffer_;
+
+  DISALLOW_COPY_AND_ASSIGN(DnsQuery);
+};
+
+}  // namespace net
+
+#endif  // NET_BASE_DNS_QUERY_H_
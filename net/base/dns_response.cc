@@ -0,0 +1,213 @@
+// Copyright (c) 2011 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/base/dns_response.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+
+#include "base/logging.h"
+#include "base/string_util.h"
+#include "net/base/dns_query.h"
+#include "net/base/dns_util.h"
+#include "net/base/net_errors.h"
+
+namespace net {
+
+namespace {
+
+// Flags of the header.
+const uint16 kFlagQR = 0x8000;  // The message is a response.
+const uint16 kFlagTC = 0x0200;  // The message is truncated.
+const uint16 kOpcodeMask = 0x7800;
+const uint16 kRcodeMask = 0x000f;
+
+// Response codes.
+const uint16 kRcodeNoError = 0;
+const uint16 kRcodeNameError = 3;
+
+const uint16 kClassIN = 1;
+
+// A label with the two high bits set is a pointer to the rest of the name.
+const uint8 kLabelPointer = 0xc0;
+
+// The longest name allowed, in DNS format.
+const size_t kMaxNameLength = 255;
+
+// Reads the fields of a DNS message in order, failing on any read past the
+// end of the message.
+class DnsMessageReader {
+ public:
+  DnsMessageReader(const char* message, int length, int offset)
+      : message_(reinterpret_cast<const uint8*>(message)),
+        length_(length),
+        offset_(offset) {
+  }
+
+  int offset() const { return offset_; }
+
+  bool Skip(int n) {
+    if (n < 0 || n > length_ - offset_)
+      return false;
+    offset_ += n;
+    return true;
+  }
+
+  bool ReadUint16(uint16* value) {
+    if (length_ - offset_ < 2)
+      return false;
+    *value = (message_[offset_] << 8) | message_[offset_ + 1];
+    offset_ += 2;
+    return true;
+  }
+
+  bool ReadUint32(uint32* value) {
+    uint16 high, low;
+    if (!ReadUint16(&high) || !ReadUint16(&low))
+      return false;
+    *value = (static_cast<uint32>(high) << 16) | low;
+    return true;
+  }
+
+  // Reads a name, following compression pointers, and stores it in |dotted|
+  // in lower case dotted form.
+  bool ReadName(std::string* dotted) {
+    dotted->clear();
+    int pos = offset_;
+    int end = -1;  // Where the name ends, once a pointer is followed.
+    size_t name_length = 0;
+    for (int jumps = 0; ; ) {
+      if (pos >= length_)
+        return false;
+      uint8 label_length = message_[pos];
+      if ((label_length & kLabelPointer) == kLabelPointer) {
+        // Pointers only go backwards, so a loop needs many of them.
+        if (pos + 1 >= length_ || ++jumps > length_ / 2)
+          return false;
+        if (end < 0)
+          end = pos + 2;
+        pos = ((label_length & ~kLabelPointer) << 8) | message_[pos + 1];
+        continue;
+      }
+      if (label_length & kLabelPointer)
+        return false;  // Reserved label types.
+
+      name_length += label_length + 1;
+      if (name_length > kMaxNameLength || pos + 1 + label_length > length_)
+        return false;
+      if (!label_length)
+        break;
+
+      if (!dotted->empty())
+        dotted->push_back('.');
+      dotted->append(reinterpret_cast<const char*>(message_ + pos + 1),
+                     label_length);
+      pos += 1 + label_length;
+    }
+    offset_ = end < 0 ? pos + 1 : end;
+    StringToLowerASCII(dotted);
+    return true;
+  }
+
+ private:
+  const uint8* message_;
+  int length_;
+  int offset_;
+
+  DISALLOW_COPY_AND_ASSIGN(DnsMessageReader);
+};
+
+}  // namespace
+
+DnsResponse::DnsResponse()
+    : io_buffer_(new IOBufferWithSize(kMaxSize)) {
+}
+
+DnsResponse::~DnsResponse() {
+}
+
+int DnsResponse::Parse(int nbytes,
+                       const DnsQuery& query,
+                       std::vector<IPAddressNumber>* addresses,
+                       base::TimeDelta* ttl) const {
+  DCHECK(addresses->empty());
+  if (nbytes < DnsQuery::kHeaderSize || nbytes > io_buffer_->size())
+    return ERR_DNS_MALFORMED_RESPONSE;
+
+  const char* message = io_buffer_->data();
+  DnsMessageReader reader(message, nbytes, 0);
+  uint16 id, flags, qdcount, ancount;
+  reader.ReadUint16(&id);
+  reader.ReadUint16(&flags);
+  reader.ReadUint16(&qdcount);
+  reader.ReadUint16(&ancount);
+  reader.Skip(4);  // NSCOUNT and ARCOUNT.
+
+  if (id != query.id() || !(flags & kFlagQR) || (flags & kOpcodeMask) ||
+      qdcount != 1) {
+    return ERR_DNS_MALFORMED_RESPONSE;
+  }
+
+  // The question has to be the one we asked. Only the case of the name may
+  // change.
+  base::StringPiece question = query.question();
+  if (!reader.Skip(question.size()) ||
+      base::strncasecmp(message + DnsQuery::kHeaderSize, question.data(),
+                        question.size()) != 0) {
+    return ERR_DNS_MALFORMED_RESPONSE;
+  }
+
+  if (flags & kFlagTC)
+    return ERR_DNS_SERVER_REQUIRES_TCP;
+  uint16 rcode = flags & kRcodeMask;
+  if (rcode == kRcodeNameError)
+    return ERR_NAME_NOT_RESOLVED;
+  if (rcode != kRcodeNoError)
+    return ERR_DNS_SERVER_FAILED;
+
+  // Collect the records for the name, following the CNAME records, which
+  // come before the records of their target.
+  std::string name = StringToLowerASCII(DNSDomainToString(query.qname()));
+  size_t address_size = query.qtype() == kDNS_AAAA ? kIPv6AddressSize :
+                                                     kIPv4AddressSize;
+  uint32 min_ttl = kuint32max;
+  for (uint16 i = 0; i < ancount; ++i) {
+    std::string owner;
+    uint16 type, klass, rdlength;
+    uint32 record_ttl;
+    if (!reader.ReadName(&owner) || !reader.ReadUint16(&type) ||
+        !reader.ReadUint16(&klass) || !reader.ReadUint32(&record_ttl) ||
+        !reader.ReadUint16(&rdlength)) {
+      return ERR_DNS_MALFORMED_RESPONSE;
+    }
+    int rdata = reader.offset();
+    if (!reader.Skip(rdlength))
+      return ERR_DNS_MALFORMED_RESPONSE;
+    if (owner != name || klass != kClassIN)
+      continue;
+
+    if (type == kDNS_CNAME) {
+      DnsMessageReader cname_reader(message, rdata + rdlength, rdata);
+      if (!cname_reader.ReadName(&name))
+        return ERR_DNS_MALFORMED_RESPONSE;
+    } else if (type == query.qtype()) {
+      if (rdlength != address_size)
+        return ERR_DNS_MALFORMED_RESPONSE;
+      const uint8* address = reinterpret_cast<const uint8*>(message + rdata);
+      addresses->push_back(IPAddressNumber(address, address + rdlength));
+    } else {
+      continue;
+    }
+    min_ttl = std::min(min_ttl, record_ttl);
+  }
+
+  if (addresses->empty())
+    return ERR_NAME_NOT_RESOLVED;
+  *ttl = base::TimeDelta::FromSeconds(min_ttl);
+  return OK;
+}
+
+}  // namespace net
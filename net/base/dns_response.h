@@ -0,0 +1,56 @@
+// Copyright (c) 2011 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_BASE_DNS_RESPONSE_H_
+#define NET_BASE_DNS_RESPONSE_H_
+#pragma once
+
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/memory/ref_counted.h"
+#include "base/time.h"
+#include "net/base/io_buffer.h"
+#include "net/base/net_util.h"
+
+namespace net {
+
+class DnsQuery;
+
+// Represents an on-the-wire DNS response message, as received over UDP.
+class DnsResponse {
+ public:
+  // The largest message that can be received over UDP without EDNS0.
+  static const int kMaxSize = 512;
+
+  DnsResponse();
+  ~DnsResponse();
+
+  // Returns the buffer to read the message into.
+  IOBufferWithSize* io_buffer() const { return io_buffer_; }
+
+  // Parses the first |nbytes| of the buffer as the response to |query|. On
+  // success, returns OK and fills |addresses| with the records of the type of
+  // |query| found for the name queried (following CNAME records), and |ttl|
+  // with the lowest TTL of the records that were used. Otherwise, returns:
+  //   ERR_DNS_MALFORMED_RESPONSE if the message is not a valid response to
+  //     |query|, as happens with stray or spoofed messages.
+  //   ERR_NAME_NOT_RESOLVED if the name does not exist, or has no records of
+  //     that type.
+  //   ERR_DNS_SERVER_REQUIRES_TCP if the response is truncated.
+  //   ERR_DNS_SERVER_FAILED if the server reported an error.
+  int Parse(int nbytes,
+            const DnsQuery& query,
+            std::vector<IPAddressNumber>* addresses,
+            base::TimeDelta* ttl) const;
+
+ private:
+  scoped_refptr<IOBufferWithSize> io_buffer_;
+
+  DISALLOW_COPY_AND_ASSIGN(DnsResponse);
+};
+
+}  // namespace net
+
+#endif  // NET_BASE_DNS_RESPONSE_H_
@@ -0,0 +1,159 @@
+// Copyright (c) 2011 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/base/dns_response.h"
+
+#include <string.h>
+
+#include "base/basictypes.h"
+#include "net/base/dns_query.h"
+#include "net/base/dns_util.h"
+#include "net/base/net_errors.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace net {
+
+namespace {
+
+// "www.example.com" in DNS format.
+const char kQname[] = "\003www\007example\003com";
+
+// Flags of a response to a recursive query, and those of the errors.
+const uint16 kFlagsOK = 0x8180;
+const uint16 kFlagsTruncated = 0x8380;
+const uint16 kFlagsNameError = 0x8183;
+const uint16 kFlagsServerFailure = 0x8182;
+
+// A CNAME record for www.example.com pointing at host.example.com, followed
+// by the A record of host.example.com. The names are compressed.
+const uint8 kCnameAnswers[] = {
+  0xc0, 0x0c, 0x00, 0x05, 0x00, 0x01, 0x00, 0x00, 0x01, 0x2c,
+  0x00, 0x07, 0x04, 'h', 'o', 's', 't', 0xc0, 0x10,
+  0xc0, 0x2d, 0x00, 0x01, 0x00, 0x01, 0x00, 0x00, 0x00, 0x3c,
+  0x00, 0x04, 0x0a, 0x00, 0x00, 0x01,
+};
+
+// Writes a response to |query| into |response|, with |answers| holding
+// |ancount| records, and returns its size.
+int WriteResponse(const DnsQuery& query, uint16 flags, uint16 ancount,
+                  const uint8* answers, size_t answers_size,
+                  DnsResponse* response) {
+  IOBufferWithSize* query_buffer = query.io_buffer();
+  char* out = response->io_buffer()->data();
+  memcpy(out, query_buffer->data(), query_buffer->size());
+  out[2] = static_cast<char>(flags >> 8);
+  out[3] = static_cast<char>(flags & 0xff);
+  out[6] = static_cast<char>(ancount >> 8);
+  out[7] = static_cast<char>(ancount & 0xff);
+  memcpy(out + query_buffer->size(), answers, answers_size);
+  return query_buffer->size() + answers_size;
+}
+
+}  // namespace
+
+TEST(DnsResponseTest, FollowsCname) {
+  DnsQuery query(std::string(kQname, sizeof(kQname)), kDNS_A);
+  DnsResponse response;
+  int size = WriteResponse(query, kFlagsOK, 2, kCnameAnswers,
+                           sizeof(kCnameAnswers), &response);
+
+  std::vector<IPAddressNumber> addresses;
+  base::TimeDelta ttl;
+  ASSERT_EQ(OK, response.Parse(size, query, &addresses, &ttl));
+  IPAddressNumber expected;
+  ASSERT_TRUE(ParseIPLiteralToNumber("10.0.0.1", &expected));
+  ASSERT_EQ(1u, addresses.size());
+  EXPECT_TRUE(expected == addresses[0]);
+  EXPECT_EQ(60, ttl.InSeconds());
+
+  // The same answers don't hold any IPv6 address.
+  DnsQuery ipv6_query(std::string(kQname, sizeof(kQname)), kDNS_AAAA);
+  size = WriteResponse(ipv6_query, kFlagsOK, 2, kCnameAnswers,
+                       sizeof(kCnameAnswers), &response);
+  addresses.clear();
+  EXPECT_EQ(ERR_NAME_NOT_RESOLVED,
+            response.Parse(size, ipv6_query, &addresses, &ttl));
+}
+
+TEST(DnsResponseTest, RejectsMismatchedResponses) {
+  DnsQuery query(std::string(kQname, sizeof(kQname)), kDNS_A);
+  DnsResponse response;
+  std::vector<IPAddressNumber> addresses;
+  base::TimeDelta ttl;
+
+  // Too short for a header.
+  EXPECT_EQ(ERR_DNS_MALFORMED_RESPONSE,
+            response.Parse(DnsQuery::kHeaderSize - 1, query, &addresses,
+                           &ttl));
+
+  // A different ID.
+  int size = WriteResponse(query, kFlagsOK, 2, kCnameAnswers,
+                           sizeof(kCnameAnswers), &response);
+  response.io_buffer()->data()[0] ^= 1;
+  EXPECT_EQ(ERR_DNS_MALFORMED_RESPONSE,
+            response.Parse(size, query, &addresses, &ttl));
+
+  // Not a response.
+  size = WriteResponse(query, kFlagsOK & 0x7fff, 2, kCnameAnswers,
+                       sizeof(kCnameAnswers), &response);
+  EXPECT_EQ(ERR_DNS_MALFORMED_RESPONSE,
+            response.Parse(size, query, &addresses, &ttl));
+
+  // A different question.
+  size = WriteResponse(query, kFlagsOK, 2, kCnameAnswers,
+                       sizeof(kCnameAnswers), &response);
+  response.io_buffer()->data()[DnsQuery::kHeaderSize + 1] = 'x';
+  EXPECT_EQ(ERR_DNS_MALFORMED_RESPONSE,
+            response.Parse(size, query, &addresses, &ttl));
+
+  // The answers are cut short.
+  size = WriteResponse(query, kFlagsOK, 2, kCnameAnswers,
+                       sizeof(kCnameAnswers), &response);
+  EXPECT_EQ(ERR_DNS_MALFORMED_RESPONSE,
+            response.Parse(size - 1, query, &addresses, &ttl));
+  EXPECT_TRUE(addresses.empty());
+}
+
+TEST(DnsResponseTest, RejectsPointerLoops) {
+  DnsQuery query(std::string(kQname, sizeof(kQname)), kDNS_A);
+  DnsResponse response;
+
+  // The owner of the record points at itself.
+  static const uint8 kLoop[] = {
+    0xc0, 0x21, 0x00, 0x01, 0x00, 0x01, 0x00, 0x00, 0x00, 0x3c,
+    0x00, 0x04, 0x0a, 0x00, 0x00, 0x01,
+  };
+  int size = WriteResponse(query, kFlagsOK, 1, kLoop, sizeof(kLoop),
+                           &response);
+  std::vector<IPAddressNumber> addresses;
+  base::TimeDelta ttl;
+  EXPECT_EQ(ERR_DNS_MALFORMED_RESPONSE,
+            response.Parse(size, query, &addresses, &ttl));
+}
+
+TEST(DnsResponseTest, Errors) {
+  DnsQuery query(std::string(kQname, sizeof(kQname)), kDNS_A);
+  DnsResponse response;
+  std::vector<IPAddressNumber> addresses;
+  base::TimeDelta ttl;
+
+  int size = WriteResponse(query, kFlagsTruncated, 0, NULL, 0, &response);
+  EXPECT_EQ(ERR_DNS_SERVER_REQUIRES_TCP,
+            response.Parse(size, query, &addresses, &ttl));
+
+  size = WriteResponse(query, kFlagsNameError, 0, NULL, 0, &response);
+  EXPECT_EQ(ERR_NAME_NOT_RESOLVED,
+            response.Parse(size, query, &addresses, &ttl));
+
+  size = WriteResponse(query, kFlagsServerFailure, 0, NULL, 0, &response);
+  EXPECT_EQ(ERR_DNS_SERVER_FAILED,
+            response.Parse(size, query, &addresses, &ttl));
+
+  // No answer at all.
+  size = WriteResponse(query, kFlagsOK, 0, NULL, 0, &response);
+  EXPECT_EQ(ERR_NAME_NOT_RESOLVED,
+            response.Parse(size, query, &addresses, &ttl));
+}
+
+}  // namespace net
@@ -0,0 +1,153 @@
+// Copyright (c) 2011 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/base/dns_test_util.h"
+
+#include "base/logging.h"
+#include "base/string_util.h"
+#include "net/base/dns_query.h"
+#include "net/base/dns_util.h"
+#include "net/base/net_errors.h"
+
+namespace net {
+
+namespace {
+
+const int kMaxMessageSize = 512;
+
+// Flags of the responses: a response to a recursive query, with recursion
+// available, and the same with a name error.
+const uint16 kFlagsOK = 0x8180;
+const uint16 kFlagsNameError = 0x8183;
+
+void AppendUint16(uint16 value, std::string* out) {
+  out->push_back(static_cast<char>(value >> 8));
+  out->push_back(static_cast<char>(value & 0xff));
+}
+
+}  // namespace
+
+TestDnsServer::TestDnsServer()
+    : socket_(NULL, NetLog::Source()),
+      read_buffer_(new IOBufferWithSize(kMaxMessageSize)),
+      queries_to_drop_(0),
+      send_stray_messages_(false),
+      query_count_(0),
+      ALLOW_THIS_IN_INITIALIZER_LIST(
+          read_callback_(this, &TestDnsServer::OnReadComplete)),
+      ALLOW_THIS_IN_INITIALIZER_LIST(
+          send_callback_(this, &TestDnsServer::OnSendComplete)) {
+}
+
+TestDnsServer::~TestDnsServer() {
+  socket_.Close();
+}
+
+bool TestDnsServer::Start() {
+  IPAddressNumber loopback;
+  if (!ParseIPLiteralToNumber("127.0.0.1", &loopback) ||
+      socket_.Listen(IPEndPoint(loopback, 0)) != OK ||
+      socket_.GetLocalAddress(&address_) != OK) {
+    return false;
+  }
+  Receive();
+  return true;
+}
+
+void TestDnsServer::AddAddress(const std::string& hostname,
+                               const std::string& ip_literal) {
+  IPAddressNumber address;
+  CHECK(ParseIPLiteralToNumber(ip_literal, &address));
+  addresses_.insert(std::make_pair(StringToLowerASCII(hostname), address));
+}
+
+void TestDnsServer::Receive() {
+  for (;;) {
+    int rv = socket_.RecvFrom(read_buffer_, read_buffer_->size(),
+                              &client_address_, &read_callback_);
+    if (rv < 0)
+      return;
+    HandleQuery(rv);
+  }
+}
+
+void TestDnsServer::OnReadComplete(int result) {
+  if (result < 0)
+    return;
+  HandleQuery(result);
+  Receive();
+}
+
+void TestDnsServer::HandleQuery(int size) {
+  ++query_count_;
+  if (queries_to_drop_ > 0) {
+    --queries_to_drop_;
+  } else {
+    std::string response = BuildResponse(read_buffer_->data(), size);
+    if (send_stray_messages_ && !response.empty()) {
+      std::string stray = response;
+      stray[0] ^= 0x5a;  // Another ID.
+      Send(stray);
+    }
+    if (!response.empty())
+      Send(response);
+  }
+}
+
+void TestDnsServer::Send(const std::string& message) {
+  scoped_refptr<StringIOBuffer> buffer(new StringIOBuffer(message));
+  // Datagrams to the loopback interface are sent right away.
+  int rv = socket_.SendTo(buffer, message.size(), client_address_,
+                          &send_callback_);
+  DCHECK_EQ(static_cast<int>(message.size()), rv);
+}
+
+void TestDnsServer::OnSendComplete(int result) {
+  NOTREACHED();
+}
+
+std::string TestDnsServer::BuildResponse(const char* query, int size) const {
+  // Find the end of the name, which is not compressed in a query.
+  int pos = DnsQuery::kHeaderSize;
+  while (pos < size && query[pos])
+    pos += 1 + static_cast<uint8>(query[pos]);
+  if (pos + 5 > size)
+    return std::string();
+  std::string qname(query + DnsQuery::kHeaderSize,
+                    pos + 1 - DnsQuery::kHeaderSize);
+  uint16 qtype = (static_cast<uint8>(query[pos + 1]) << 8) |
+                 static_cast<uint8>(query[pos + 2]);
+  std::string hostname = StringToLowerASCII(DNSDomainToString(qname));
+
+  std::string answers;
+  uint16 ancount = 0;
+  std::pair<AddressMap::const_iterator, AddressMap::const_iterator> range =
+      addresses_.equal_range(hostname);
+  for (AddressMap::const_iterator it = range.first; it != range.second;
+       ++it) {
+    const IPAddressNumber& address = it->second;
+    uint16 type = address.size() == kIPv6AddressSize ? kDNS_AAAA : kDNS_A;
+    if (type != qtype)
+      continue;
+    AppendUint16(0xc00c, &answers);  // A pointer to the name of the question.
+    AppendUint16(type, &answers);
+    AppendUint16(1, &answers);  // Class IN.
+    AppendUint16(0, &answers);  // TTL, in two parts.
+    AppendUint16(300, &answers);
+    AppendUint16(address.size(), &answers);
+    answers.append(address.begin(), address.end());
+    ++ancount;
+  }
+
+  // The header and question of the query, followed by the answers.
+  std::string response(query, pos + 5);
+  uint16 flags = range.first == range.second ? kFlagsNameError : kFlagsOK;
+  response[2] = static_cast<char>(flags >> 8);
+  response[3] = static_cast<char>(flags & 0xff);
+  response[6] = static_cast<char>(ancount >> 8);
+  response[7] = static_cast<char>(ancount & 0xff);
+  return response + answers;
+}
+
+}  // namespace net
@@ -0,0 +1,81 @@
+// Copyright (c) 2011 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_BASE_DNS_TEST_UTIL_H_
+#define NET_BASE_DNS_TEST_UTIL_H_
+#pragma once
+
+#include <map>
+#include <string>
+
+#include "base/basictypes.h"
+#include "base/memory/ref_counted.h"
+#include "net/base/completion_callback.h"
+#include "net/base/io_buffer.h"
+#include "net/base/ip_endpoint.h"
+#include "net/base/net_util.h"
+#include "net/udp/udp_server_socket.h"
+
+namespace net {
+
+// A DNS server for tests, listening on the loopback interface. It answers the
+// A and AAAA queries for the names it knows about, and tells that the other
+// names don't exist. It runs on the message loop of the test.
+class TestDnsServer {
+ public:
+  TestDnsServer();
+  ~TestDnsServer();
+
+  // Starts listening on a port of 127.0.0.1. Returns false on failure.
+  bool Start();
+
+  // The address to send the queries to.
+  const IPEndPoint& address() const { return address_; }
+
+  // Makes |ip_literal| an address of |hostname|.
+  void AddAddress(const std::string& hostname, const std::string& ip_literal);
+
+  // Ignores the next |count| queries.
+  void set_queries_to_drop(int count) { queries_to_drop_ = count; }
+
+  // Sends a message that is not the answer to each query before the answer.
+  void set_send_stray_messages(bool send) { send_stray_messages_ = send; }
+
+  // The number of queries received so far.
+  int query_count() const { return query_count_; }
+
+ private:
+  typedef std::multimap<std::string, IPAddressNumber> AddressMap;
+
+  // Reads the queries until one is pending.
+  void Receive();
+  void OnReadComplete(int result);
+
+  // Answers the query of |size| bytes in |read_buffer_|.
+  void HandleQuery(int size);
+
+  void Send(const std::string& message);
+  void OnSendComplete(int result);
+
+  // Builds the response to the |size| bytes of |query|, or returns an empty
+  // string if |query| is not valid.
+  std::string BuildResponse(const char* query, int size) const;
+
+  UDPServerSocket socket_;
+  IPEndPoint address_;
+  IPEndPoint client_address_;
+  scoped_refptr<IOBufferWithSize> read_buffer_;
+  AddressMap addresses_;
+  int queries_to_drop_;
+  bool send_stray_messages_;
+  int query_count_;
+  CompletionCallbackImpl<TestDnsServer> read_callback_;
+  CompletionCallbackImpl<TestDnsServer> send_callback_;
+
+  DISALLOW_COPY_AND_ASSIGN(TestDnsServer);
+};
+
+}  // namespace net
+
+#endif  // NET_BASE_DNS_TEST_UTIL_H_
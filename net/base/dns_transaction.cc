@@ -0,0 +1,176 @@
+// Copyright (c) 2011 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/base/dns_transaction.h"
+
+#include "base/logging.h"
+#include "net/base/dns_query.h"
+#include "net/base/dns_response.h"
+#include "net/base/dns_util.h"
+#include "net/base/net_errors.h"
+#include "net/base/net_log.h"
+#include "net/udp/udp_client_socket.h"
+
+namespace net {
+
+DnsTransaction::DnsTransaction(const DnsConfig& config,
+                               const std::string& hostname,
+                               uint16 qtype,
+                               NetLog* net_log)
+    : config_(config),
+      qtype_(qtype),
+      net_log_(net_log),
+      next_state_(STATE_NONE),
+      attempt_(0),
+      last_error_(ERR_DNS_TIMED_OUT),
+      ALLOW_THIS_IN_INITIALIZER_LIST(
+          io_callback_(this, &DnsTransaction::OnIOComplete)),
+      user_callback_(NULL) {
+  DCHECK(config_.IsValid());
+  std::string qname;
+  if (DNSDomainFromDot(hostname, &qname))
+    query_.reset(new DnsQuery(qname, qtype));
+}
+
+DnsTransaction::~DnsTransaction() {
+}
+
+int DnsTransaction::Start(CompletionCallback* callback) {
+  DCHECK_EQ(STATE_NONE, next_state_);
+  DCHECK(!user_callback_);
+  if (!query_.get())
+    return ERR_INVALID_ARGUMENT;
+
+  next_state_ = STATE_SEND_QUERY;
+  int rv = DoLoop(OK);
+  if (rv == ERR_IO_PENDING)
+    user_callback_ = callback;
+  return rv;
+}
+
+int DnsTransaction::DoLoop(int result) {
+  DCHECK_NE(STATE_NONE, next_state_);
+  int rv = result;
+  do {
+    State state = next_state_;
+    next_state_ = STATE_NONE;
+    switch (state) {
+      case STATE_SEND_QUERY:
+        DCHECK_EQ(OK, rv);
+        rv = DoSendQuery();
+        break;
+      case STATE_SEND_QUERY_COMPLETE:
+        rv = DoSendQueryComplete(rv);
+        break;
+      case STATE_READ_RESPONSE:
+        DCHECK_EQ(OK, rv);
+        rv = DoReadResponse();
+        break;
+      case STATE_READ_RESPONSE_COMPLETE:
+        rv = DoReadResponseComplete(rv);
+        break;
+      default:
+        NOTREACHED() << "bad state";
+        rv = ERR_UNEXPECTED;
+        break;
+    }
+  } while (rv != ERR_IO_PENDING && next_state_ != STATE_NONE);
+  return rv;
+}
+
+int DnsTransaction::DoSendQuery() {
+  const IPEndPoint& server =
+      config_.nameservers[attempt_ % config_.nameservers.size()];
+  int round = attempt_ / config_.nameservers.size();
+  ++attempt_;
+
+  // Each attempt has its own socket, so that a late answer to an attempt
+  // that timed out cannot be mistaken for the answer of another server.
+  socket_.reset(new UDPClientSocket(net_log_, NetLog::Source()));
+  int rv = socket_->Connect(server);
+  if (rv != OK)
+    return NextAttempt(rv);
+
+  timer_.Stop();
+  timer_.Start(config_.timeout * (1 << round), this,
+               &DnsTransaction::OnTimeout);
+
+  next_state_ = STATE_SEND_QUERY_COMPLETE;
+  return socket_->Write(query_->io_buffer(), query_->io_buffer()->size(),
+                        &io_callback_);
+}
+
+int DnsTransaction::DoSendQueryComplete(int result) {
+  if (result < 0)
+    return NextAttempt(result);
+  // A datagram is sent whole, or not at all.
+  DCHECK_EQ(query_->io_buffer()->size(), result);
+  next_state_ = STATE_READ_RESPONSE;
+  return OK;
+}
+
+int DnsTransaction::DoReadResponse() {
+  next_state_ = STATE_READ_RESPONSE_COMPLETE;
+  response_.reset(new DnsResponse());
+  return socket_->Read(response_->io_buffer(),
+                       response_->io_buffer()->size(), &io_callback_);
+}
+
+int DnsTransaction::DoReadResponseComplete(int result) {
+  if (result < 0)
+    return NextAttempt(result);
+
+  addresses_.clear();
+  int rv = response_->Parse(result, *query_, &addresses_, &ttl_);
+  switch (rv) {
+    case ERR_DNS_MALFORMED_RESPONSE:
+      // Not an answer to the query; keep waiting for one.
+      next_state_ = STATE_READ_RESPONSE;
+      return OK;
+    case ERR_DNS_SERVER_FAILED:
+      return NextAttempt(rv);
+    default:
+      timer_.Stop();
+      socket_.reset();
+      return rv;
+  }
+}
+
+int DnsTransaction::NextAttempt(int result) {
+  timer_.Stop();
+  socket_.reset();
+  if (result == ERR_DNS_SERVER_FAILED)
+    last_error_ = result;
+
+  int max_attempts = config_.attempts * config_.nameservers.size();
+  if (attempt_ >= max_attempts)
+    return last_error_;
+  next_state_ = STATE_SEND_QUERY;
+  return OK;
+}
+
+void DnsTransaction::OnIOComplete(int result) {
+  int rv = DoLoop(result);
+  if (rv != ERR_IO_PENDING)
+    DoCallback(rv);
+}
+
+void DnsTransaction::OnTimeout() {
+  // Closing the socket cancels the pending IO.
+  int rv = NextAttempt(ERR_DNS_TIMED_OUT);
+  if (next_state_ != STATE_NONE)
+    rv = DoLoop(rv);
+  if (rv != ERR_IO_PENDING)
+    DoCallback(rv);
+}
+
+void DnsTransaction::DoCallback(int result) {
+  DCHECK_NE(ERR_IO_PENDING, result);
+  DCHECK(user_callback_);
+  CompletionCallback* callback = user_callback_;
+  user_callback_ = NULL;
+  callback->Run(result);
+}
+
+}  // namespace net
@@ -0,0 +1,96 @@
+// Copyright (c) 2011 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_BASE_DNS_TRANSACTION_H_
+#define NET_BASE_DNS_TRANSACTION_H_
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "base/memory/scoped_ptr.h"
+#include "base/time.h"
+#include "base/timer.h"
+#include "net/base/completion_callback.h"
+#include "net/base/dns_config.h"
+#include "net/base/net_util.h"
+
+namespace net {
+
+class DnsQuery;
+class DnsResponse;
+class NetLog;
+class UDPClientSocket;
+
+// Sends a DNS query over UDP to the name servers of a DnsConfig, and waits for
+// the answer. The servers are tried in turn, each for the timeout of the
+// config, which is doubled after each round, until one of them answers or the
+// number of attempts of the config runs out. Messages that don't answer the
+// query are ignored. Runs on the thread it was created on, and never blocks.
+class DnsTransaction {
+ public:
+  // Queries the records of type |qtype| of |hostname|, a dotted name.
+  DnsTransaction(const DnsConfig& config,
+                 const std::string& hostname,
+                 uint16 qtype,
+                 NetLog* net_log);
+  ~DnsTransaction();
+
+  // Starts the transaction. Returns OK with the results available, an error,
+  // or ERR_IO_PENDING, in which case |callback| is called with the result
+  // later on. Deleting the transaction cancels it. The errors include those
+  // of DnsResponse::Parse(), ERR_INVALID_ARGUMENT if |hostname| is not a
+  // valid name, and ERR_DNS_TIMED_OUT if no server answered.
+  int Start(CompletionCallback* callback);
+
+  // The addresses found, and the time they can be cached for.
+  const std::vector<IPAddressNumber>& addresses() const { return addresses_; }
+  base::TimeDelta ttl() const { return ttl_; }
+
+ private:
+  enum State {
+    STATE_SEND_QUERY,
+    STATE_SEND_QUERY_COMPLETE,
+    STATE_READ_RESPONSE,
+    STATE_READ_RESPONSE_COMPLETE,
+    STATE_NONE,
+  };
+
+  int DoLoop(int result);
+  int DoSendQuery();
+  int DoSendQueryComplete(int result);
+  int DoReadResponse();
+  int DoReadResponseComplete(int result);
+
+  // Moves on to the next attempt, if any. Returns the error of the
+  // transaction otherwise.
+  int NextAttempt(int result);
+
+  void OnIOComplete(int result);
+  void OnTimeout();
+  void DoCallback(int result);
+
+  const DnsConfig config_;
+  const uint16 qtype_;
+  scoped_ptr<DnsQuery> query_;
+  scoped_ptr<DnsResponse> response_;
+  scoped_ptr<UDPClientSocket> socket_;
+  NetLog* net_log_;
+
+  State next_state_;
+  int attempt_;  // The number of attempts started.
+  int last_error_;  // The error reported by a server, if any.
+  std::vector<IPAddressNumber> addresses_;
+  base::TimeDelta ttl_;
+
+  base::OneShotTimer<DnsTransaction> timer_;
+  CompletionCallbackImpl<DnsTransaction> io_callback_;
+  CompletionCallback* user_callback_;
+
+  DISALLOW_COPY_AND_ASSIGN(DnsTransaction);
+};
+
+}  // namespace net
+
+#endif  // NET_BASE_DNS_TRANSACTION_H_
@@ -0,0 +1,137 @@
+// Copyright (c) 2011 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/base/dns_transaction.h"
+
+#include "net/base/dns_lookup.h"
+#include "net/base/dns_test_util.h"
+#include "net/base/dns_util.h"
+#include "net/base/net_errors.h"
+#include "net/base/net_util.h"
+#include "net/base/sys_addrinfo.h"
+#include "net/base/test_completion_callback.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace net {
+
+namespace {
+
+class DnsTransactionTest : public testing::Test {
+ protected:
+  virtual void SetUp() {
+    ASSERT_TRUE(server_.Start());
+    server_.AddAddress("www.example.com", "10.0.0.1");
+    server_.AddAddress("www.example.com", "10.0.0.2");
+    server_.AddAddress("www.example.com", "2001:db8::1");
+
+    // Short timeouts keep the tests of retransmissions fast.
+    config_.nameservers.push_back(server_.address());
+    config_.timeout = base::TimeDelta::FromMilliseconds(50);
+    config_.attempts = 2;
+  }
+
+  // Runs a transaction for |hostname| to completion.
+  int Resolve(const std::string& hostname, uint16 qtype) {
+    transaction_.reset(new DnsTransaction(config_, hostname, qtype, NULL));
+    TestCompletionCallback callback;
+    return callback.GetResult(transaction_->Start(&callback));
+  }
+
+  TestDnsServer server_;
+  DnsConfig config_;
+  scoped_ptr<DnsTransaction> transaction_;
+};
+
+// Returns the addresses of |list| as a string.
+std::string AddressListToString(const AddressList& list) {
+  std::string result;
+  for (const struct addrinfo* ai = list.head(); ai; ai = ai->ai_next) {
+    if (!result.empty())
+      result += " ";
+    result += NetAddressToString(ai);
+  }
+  return result;
+}
+
+}  // namespace
+
+TEST_F(DnsTransactionTest, Resolve) {
+  ASSERT_EQ(OK, Resolve("www.example.com", kDNS_A));
+  EXPECT_EQ(2u, transaction_->addresses().size());
+  EXPECT_EQ(300, transaction_->ttl().InSeconds());
+  EXPECT_EQ(1, server_.query_count());
+
+  ASSERT_EQ(OK, Resolve("WWW.Example.com.", kDNS_AAAA));
+  EXPECT_EQ(1u, transaction_->addresses().size());
+
+  EXPECT_EQ(ERR_NAME_NOT_RESOLVED, Resolve("nowhere.example.com", kDNS_A));
+  EXPECT_EQ(ERR_INVALID_ARGUMENT, Resolve("", kDNS_A));
+}
+
+TEST_F(DnsTransactionTest, IgnoresStrayMessages) {
+  server_.set_send_stray_messages(true);
+  ASSERT_EQ(OK, Resolve("www.example.com", kDNS_A));
+  EXPECT_EQ(2u, transaction_->addresses().size());
+  EXPECT_EQ(1, server_.query_count());
+}
+
+TEST_F(DnsTransactionTest, Retransmits) {
+  server_.set_queries_to_drop(1);
+  ASSERT_EQ(OK, Resolve("www.example.com", kDNS_A));
+  EXPECT_EQ(2, server_.query_count());
+
+  server_.set_queries_to_drop(2);
+  EXPECT_EQ(ERR_DNS_TIMED_OUT, Resolve("www.example.com", kDNS_A));
+  EXPECT_EQ(4, server_.query_count());
+}
+
+TEST_F(DnsTransactionTest, TriesNextServer) {
+  TestDnsServer silent_server;
+  ASSERT_TRUE(silent_server.Start());
+  silent_server.set_queries_to_drop(100);
+  config_.nameservers.insert(config_.nameservers.begin(),
+                             silent_server.address());
+  config_.attempts = 1;
+
+  ASSERT_EQ(OK, Resolve("www.example.com", kDNS_A));
+  EXPECT_EQ(1, silent_server.query_count());
+  EXPECT_EQ(1, server_.query_count());
+}
+
+TEST_F(DnsTransactionTest, LookupBothFamilies) {
+  TestCompletionCallback callback;
+  DnsLookup lookup(config_, "www.example.com", ADDRESS_FAMILY_UNSPECIFIED,
+                   NULL);
+  ASSERT_EQ(OK, callback.GetResult(lookup.Start(&callback)));
+  EXPECT_EQ("10.0.0.1 10.0.0.2 2001:db8::1",
+            AddressListToString(lookup.addresses()));
+  EXPECT_EQ(2, server_.query_count());
+
+  DnsLookup ipv6_lookup(config_, "www.example.com", ADDRESS_FAMILY_IPV6,
+                        NULL);
+  ASSERT_EQ(OK, callback.GetResult(ipv6_lookup.Start(&callback)));
+  EXPECT_EQ("2001:db8::1", AddressListToString(ipv6_lookup.addresses()));
+  EXPECT_EQ(3, server_.query_count());
+}
+
+TEST_F(DnsTransactionTest, LookupSearchList) {
+  config_.search.push_back("corp.example.com");
+  config_.search.push_back("example.com");
+
+  // "www" has fewer dots than |ndots|, so the search list comes first: the
+  // names of the first suffix don't exist.
+  TestCompletionCallback callback;
+  DnsLookup lookup(config_, "www", ADDRESS_FAMILY_IPV4, NULL);
+  ASSERT_EQ(OK, callback.GetResult(lookup.Start(&callback)));
+  EXPECT_EQ("10.0.0.1 10.0.0.2", AddressListToString(lookup.addresses()));
+  EXPECT_EQ(2, server_.query_count());
+
+  // Fully qualified names don't use the search list.
+  DnsLookup absolute_lookup(config_, "www.", ADDRESS_FAMILY_IPV4, NULL);
+  EXPECT_EQ(ERR_NAME_NOT_RESOLVED,
+            callback.GetResult(absolute_lookup.Start(&callback)));
+  EXPECT_EQ(3, server_.query_count());
+}
+
+}  // namespace net
@@ -34,8 +34,10 @@ std::string TrimEndingDot(const std::string& host);
 // WARNING: if you're adding any new values here you may need to add them to
 // dnsrr_resolver.cc:DnsRRIsParsedByWindows.
 
+static const uint16 kDNS_A = 1;
 static const uint16 kDNS_CNAME = 5;
 static const uint16 kDNS_TXT = 16;
+static const uint16 kDNS_AAAA = 28;
 static const uint16 kDNS_CERT = 37;
 static const uint16 kDNS_DS = 43;
 static const uint16 kDNS_RRSIG = 46;
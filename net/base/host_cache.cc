@@ -4,17 +4,56 @@
 
 #include "net/base/host_cache.h"
 
+#include <algorithm>
+#include <vector>
+
 #include "base/logging.h"
+#include "base/values.h"
 #include "net/base/net_errors.h"
+#include "net/base/net_util.h"
+#include "net/base/sys_addrinfo.h"
 
 namespace net {
 
+namespace {
+
+typedef std::pair<const HostCache::Key*, const HostCache::Entry*> KeyAndEntry;
+
+// Orders the entries with the latest expiration time, which were resolved
+// last, first.
+bool ResolvedMoreRecently(const KeyAndEntry& a, const KeyAndEntry& b) {
+  return a.second->expiration > b.second->expiration;
+}
+
+// Builds the address list saved as |addresses| by HostCache::Serialize().
+bool AddressListFromValue(const ListValue* addresses, AddressList* addrlist) {
+  for (size_t i = 0; i < addresses->GetSize(); ++i) {
+    std::string address_string;
+    IPAddressNumber address;
+    if (!addresses->GetString(i, &address_string) ||
+        !ParseIPLiteralToNumber(address_string, &address)) {
+      return false;
+    }
+    AddressList address_list(address, 0, false);
+    if (i == 0)
+      *addrlist = address_list;
+    else
+      addrlist->Append(address_list.head());
+  }
+  return addresses->GetSize() > 0;
+}
+
+}  // namespace
+
 //-----------------------------------------------------------------------------
 
 HostCache::Entry::Entry(int error,
                         const AddressList& addrlist,
                         base::TimeTicks expiration)
-    : error(error), addrlist(addrlist), expiration(expiration) {
+    : error(error),
+      addrlist(addrlist),
+      expiration(expiration),
+      stale_expiration(expiration) {
 }
 
 HostCache::Entry::~Entry() {
@@ -50,6 +89,26 @@ const HostCache::Entry* HostCache::Lookup(const Key& key,
   return NULL;
 }
 
+const HostCache::Entry* HostCache::LookupStale(
+    const Key& key,
+    base::TimeTicks now,
+    base::TimeDelta max_stale) const {
+  DCHECK(CalledOnValidThread());
+  if (caching_is_disabled())
+    return NULL;
+
+  EntryMap::const_iterator it = entries_.find(key);
+  if (it == entries_.end())
+    return NULL;
+
+  Entry* entry = it->second.get();
+  if (entry->error != OK || CanUseEntry(entry, now))
+    return NULL;
+  if (entry->expiration + max_stale <= now && entry->stale_expiration <= now)
+    return NULL;
+  return entry;
+}
+
 HostCache::Entry* HostCache::Set(const Key& key,
                                  int error,
                                  const AddressList& addrlist,
@@ -77,6 +136,7 @@ HostCache::Entry* HostCache::Set(const Key& key,
     entry->error = error;
     entry->addrlist = addrlist;
     entry->expiration = expiration;
+    entry->stale_expiration = expiration;
     return entry.get();
   }
 }
@@ -86,6 +146,96 @@ void HostCache::clear() {
   entries_.clear();
 }
 
+void HostCache::Serialize(size_t max_entries,
+                          base::TimeTicks now,
+                          ListValue* list) const {
+  DCHECK(CalledOnValidThread());
+  std::vector<KeyAndEntry> entries;
+  for (EntryMap::const_iterator it = entries_.begin(); it != entries_.end();
+       ++it) {
+    // The canonical name is not saved, so skip the entries that need it.
+    const Entry* entry = it->second.get();
+    if (entry->error == OK && entry->addrlist.head() &&
+        !(it->first.host_resolver_flags & HOST_RESOLVER_CANONNAME)) {
+      entries.push_back(KeyAndEntry(&it->first, entry));
+    }
+  }
+  std::sort(entries.begin(), entries.end(), ResolvedMoreRecently);
+  if (entries.size() > max_entries)
+    entries.resize(max_entries);
+
+  base::Time wall_now = base::Time::Now();
+  for (size_t i = 0; i < entries.size(); ++i) {
+    const Key* key = entries[i].first;
+    const Entry* entry = entries[i].second;
+
+    ListValue* addresses = new ListValue();
+    for (const struct addrinfo* address = entry->addrlist.head(); address;
+         address = address->ai_next) {
+      addresses->Append(Value::CreateStringValue(NetAddressToString(address)));
+    }
+
+    base::Time expiration = wall_now + (entry->expiration - now);
+    DictionaryValue* dict = new DictionaryValue();
+    dict->SetString("hostname", key->hostname);
+    dict->SetInteger("address_family", key->address_family);
+    dict->SetInteger("flags", key->host_resolver_flags);
+    dict->SetDouble("expiration", expiration.ToDoubleT());
+    dict->Set("addresses", addresses);
+    list->Append(dict);
+  }
+}
+
+size_t HostCache::Restore(const ListValue& list,
+                          base::TimeTicks now,
+                          base::TimeDelta max_stale) {
+  DCHECK(CalledOnValidThread());
+  base::Time wall_now = base::Time::Now();
+  size_t restored = 0;
+  for (size_t i = 0; i < list.GetSize(); ++i) {
+    if (entries_.size() >= max_entries_)
+      break;
+
+    DictionaryValue* dict;
+    std::string hostname;
+    int address_family;
+    int flags;
+    double expiration;
+    ListValue* addresses;
+    AddressList addrlist;
+    if (!list.GetDictionary(i, &dict) ||
+        !dict->GetString("hostname", &hostname) ||
+        !dict->GetInteger("address_family", &address_family) ||
+        !dict->GetInteger("flags", &flags) ||
+        !dict->GetDouble("expiration", &expiration) ||
+        !dict->GetList("addresses", &addresses) ||
+        !AddressListFromValue(addresses, &addrlist)) {
+      // The file may be corrupt or written by another version; drop the
+      // entry rather than the whole cache.
+      LOG(WARNING) << "Invalid host cache entry";
+      continue;
+    }
+
+    if (address_family != ADDRESS_FAMILY_UNSPECIFIED &&
+        address_family != ADDRESS_FAMILY_IPV4 &&
+        address_family != ADDRESS_FAMILY_IPV6) {
+      continue;
+    }
+
+    Key key(hostname, static_cast<AddressFamily>(address_family), flags);
+    if (entries_.find(key) != entries_.end())
+      continue;
+
+    base::TimeTicks expiration_ticks =
+        now + (base::Time::FromDoubleT(expiration) - wall_now);
+    Entry* entry = new Entry(OK, addrlist, expiration_ticks);
+    entry->stale_expiration = std::max(expiration_ticks, now + max_stale);
+    entries_[key] = entry;
+    restored++;
+  }
+  return restored;
+}
+
 size_t HostCache::size() const {
   DCHECK(CalledOnValidThread());
   return entries_.size();
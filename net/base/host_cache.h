@@ -16,6 +16,8 @@
 #include "net/base/address_family.h"
 #include "net/base/address_list.h"
 
+class ListValue;
+
 namespace net {
 
 // Cache used by HostResolver to map hostnames to their resolved result.
@@ -32,6 +34,10 @@ class HostCache : public base::NonThreadSafe {
     // The time when this entry expires.
     base::TimeTicks expiration;
 
+    // The time until which LookupStale() returns this entry whatever its
+    // |max_stale|. Later than |expiration| only for restored entries.
+    base::TimeTicks stale_expiration;
+
    private:
     friend class base::RefCounted<Entry>;
 
@@ -85,6 +91,15 @@ class HostCache : public base::NonThreadSafe {
   // |now|. If there is no such entry, returns NULL.
   const Entry* Lookup(const Key& key, base::TimeTicks now) const;
 
+  // Returns a pointer to the entry for |key| if it is a successful resolve
+  // that expired less than |max_stale| before |now|, or a restored entry
+  // within the window given to Restore(), so that it can be used while a new
+  // resolve is in progress. Returns NULL if there is no such entry, including
+  // when the entry has not expired yet.
+  const Entry* LookupStale(const Key& key,
+                           base::TimeTicks now,
+                           base::TimeDelta max_stale) const;
+
   // Overwrites or creates an entry for |key|. Returns the pointer to the
   // entry, or NULL on failure (fails if caching is disabled).
   // (|error|, |addrlist|) is the value to set, and |now| is the current
@@ -97,6 +112,20 @@ class HostCache : public base::NonThreadSafe {
   // Empties the cache
   void clear();
 
+  // Appends to |list| up to |max_entries| of the successful entries, the most
+  // recently resolved first, so that they can be restored on the next run.
+  // Expiration times are saved as wall clock times.
+  void Serialize(size_t max_entries, base::TimeTicks now,
+                 ListValue* list) const;
+
+  // Adds to the cache the entries saved by Serialize(), except for those that
+  // it already has. The entries keep their expiration time, and can also be
+  // used through LookupStale() until |max_stale| after |now|, even if they
+  // expired since they were saved. Malformed entries are skipped. Returns the
+  // number of entries that were added.
+  size_t Restore(const ListValue& list, base::TimeTicks now,
+                 base::TimeDelta max_stale);
+
   // Returns the number of entries in the cache.
   size_t size() const;
 
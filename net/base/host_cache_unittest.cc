@@ -8,7 +8,10 @@
 #include "base/stl_util-inl.h"
 #include "base/string_util.h"
 #include "base/stringprintf.h"
+#include "base/values.h"
 #include "net/base/net_errors.h"
+#include "net/base/net_util.h"
+#include "net/base/sys_addrinfo.h"
 #include "testing/gtest/include/gtest/gtest.h"
 
 namespace net {
@@ -24,6 +27,13 @@ HostCache::Key Key(const std::string& hostname) {
   return HostCache::Key(hostname, ADDRESS_FAMILY_UNSPECIFIED, 0);
 }
 
+// Builds an address list holding |ip_literal|.
+AddressList Addresses(const std::string& ip_literal) {
+  IPAddressNumber ip_number;
+  EXPECT_TRUE(ParseIPLiteralToNumber(ip_literal, &ip_number));
+  return AddressList(ip_number, 0, false);
+}
+
 }  // namespace
 
 TEST(HostCacheTest, Basic) {
@@ -388,6 +398,150 @@ TEST(HostCacheTest, Clear) {
   EXPECT_EQ(0u, cache.size());
 }
 
+TEST(HostCacheTest, LookupStale) {
+  HostCache cache(kMaxCacheEntries, kSuccessEntryTTL,
+                  base::TimeDelta::FromSeconds(10));
+  const base::TimeDelta kMaxStale = base::TimeDelta::FromSeconds(20);
+
+  // Set t=0.
+  base::TimeTicks now;
+
+  cache.Set(Key("foobar.com"), OK, Addresses("192.168.1.1"), now);
+  cache.Set(Key("failing.com"), ERR_NAME_NOT_RESOLVED, AddressList(), now);
+
+  // Valid entries are not stale.
+  now += base::TimeDelta::FromSeconds(5);
+  EXPECT_TRUE(cache.Lookup(Key("foobar.com"), now) != NULL);
+  EXPECT_TRUE(cache.LookupStale(Key("foobar.com"), now, kMaxStale) == NULL);
+
+  // Only successful entries are used after they expire.
+  now += base::TimeDelta::FromSeconds(10);
+  EXPECT_TRUE(cache.Lookup(Key("foobar.com"), now) == NULL);
+  EXPECT_TRUE(cache.LookupStale(Key("foobar.com"), now, kMaxStale) != NULL);
+  EXPECT_TRUE(cache.LookupStale(Key("failing.com"), now, kMaxStale) == NULL);
+  EXPECT_TRUE(cache.LookupStale(Key("other.com"), now, kMaxStale) == NULL);
+
+  // Up to |kMaxStale| after they expire.
+  now += base::TimeDelta::FromSeconds(15);
+  EXPECT_TRUE(cache.LookupStale(Key("foobar.com"), now, kMaxStale) == NULL);
+}
+
+TEST(HostCacheTest, SerializeAndRestore) {
+  HostCache cache(kMaxCacheEntries, kSuccessEntryTTL, kFailureEntryTTL);
+
+  // Set t=0.
+  base::TimeTicks now;
+
+  AddressList addresses = Addresses("192.168.1.1");
+  addresses.Append(Addresses("192.168.1.2").head());
+  cache.Set(Key("foobar1.com"), OK, addresses, now);
+  now += base::TimeDelta::FromSeconds(1);
+  cache.Set(Key("foobar2.com"), OK, Addresses("192.168.1.3"), now);
+  now += base::TimeDelta::FromSeconds(1);
+  cache.Set(Key("foobar3.com"), OK, Addresses("192.168.1.4"), now);
+  cache.Set(Key("failing.com"), ERR_NAME_NOT_RESOLVED, AddressList(), now);
+  cache.Set(HostCache::Key("foobar4.com", ADDRESS_FAMILY_IPV4,
+                           HOST_RESOLVER_CANONNAME),
+            OK, Addresses("192.168.1.5"), now);
+
+  // Failures, entries that need the canonical name, and the entries beyond
+  // the limit that were resolved first are not saved.
+  ListValue list;
+  cache.Serialize(2, now, &list);
+  EXPECT_EQ(2u, list.GetSize());
+
+  HostCache restored_cache(kMaxCacheEntries, kSuccessEntryTTL,
+                           kFailureEntryTTL);
+  restored_cache.Set(Key("foobar3.com"), OK, Addresses("10.0.0.1"), now);
+  EXPECT_EQ(1u, restored_cache.Restore(list, now, base::TimeDelta()));
+  EXPECT_EQ(2u, restored_cache.size());
+
+  const HostCache::Entry* entry =
+      restored_cache.Lookup(Key("foobar3.com"), now);
+  ASSERT_TRUE(entry != NULL);
+  EXPECT_EQ("10.0.0.1", NetAddressToString(entry->addrlist.head()));
+
+  // The expiration time of the restored entries is kept.
+  entry = restored_cache.Lookup(Key("foobar2.com"), now);
+  ASSERT_TRUE(entry != NULL);
+  EXPECT_EQ("192.168.1.3", NetAddressToString(entry->addrlist.head()));
+  now += base::TimeDelta::FromMilliseconds(9500);
+  EXPECT_TRUE(restored_cache.Lookup(Key("foobar2.com"), now) == NULL);
+  EXPECT_TRUE(restored_cache.LookupStale(Key("foobar2.com"), now,
+                                         kSuccessEntryTTL) != NULL);
+
+  // All the addresses are kept.
+  list.Clear();
+  cache.Serialize(kMaxCacheEntries, now, &list);
+  EXPECT_EQ(3u, list.GetSize());
+  HostCache other_cache(kMaxCacheEntries, kSuccessEntryTTL, kFailureEntryTTL);
+  EXPECT_EQ(3u, other_cache.Restore(list, now, base::TimeDelta()));
+  entry = other_cache.LookupStale(Key("foobar1.com"), now, kSuccessEntryTTL);
+  ASSERT_TRUE(entry != NULL);
+  ASSERT_TRUE(entry->addrlist.head()->ai_next != NULL);
+  EXPECT_EQ("192.168.1.2",
+            NetAddressToString(entry->addrlist.head()->ai_next));
+}
+
+// Restored entries can be used stale for a while, even if they expired
+// before they were restored.
+TEST(HostCacheTest, RestoreExpiredEntries) {
+  HostCache cache(kMaxCacheEntries, kSuccessEntryTTL, kFailureEntryTTL);
+  const base::TimeDelta kMaxStale = base::TimeDelta::FromMinutes(5);
+
+  // Set t=0.
+  base::TimeTicks now;
+
+  cache.Set(Key("foobar1.com"), OK, Addresses("192.168.1.1"), now);
+  cache.Set(Key("foobar2.com"), OK, Addresses("192.168.1.2"), now);
+  now += kSuccessEntryTTL + base::TimeDelta::FromMinutes(1);
+  ListValue list;
+  cache.Serialize(kMaxCacheEntries, now, &list);
+
+  HostCache restored_cache(kMaxCacheEntries, kSuccessEntryTTL,
+                           kFailureEntryTTL);
+  EXPECT_EQ(2u, restored_cache.Restore(list, now, kMaxStale));
+  EXPECT_TRUE(restored_cache.Lookup(Key("foobar1.com"), now) == NULL);
+  const HostCache::Entry* entry =
+      restored_cache.LookupStale(Key("foobar1.com"), now, base::TimeDelta());
+  ASSERT_TRUE(entry != NULL);
+  EXPECT_EQ("192.168.1.1", NetAddressToString(entry->addrlist.head()));
+
+  // A new resolve ends the window.
+  restored_cache.Set(Key("foobar2.com"), OK, Addresses("192.168.1.3"), now);
+  now += kSuccessEntryTTL;
+  EXPECT_TRUE(restored_cache.LookupStale(Key("foobar1.com"), now,
+                                         base::TimeDelta()) != NULL);
+  EXPECT_TRUE(restored_cache.LookupStale(Key("foobar2.com"), now,
+                                         base::TimeDelta()) == NULL);
+
+  // Which lasts |kMaxStale| after the entries were restored.
+  now += kMaxStale - kSuccessEntryTTL;
+  EXPECT_TRUE(restored_cache.LookupStale(Key("foobar1.com"), now,
+                                         base::TimeDelta()) == NULL);
+}
+
+// Malformed entries, e.g. from a corrupt file, are skipped.
+TEST(HostCacheTest, RestoreSkipsInvalidEntries) {
+  HostCache cache(kMaxCacheEntries, kSuccessEntryTTL, kFailureEntryTTL);
+  base::TimeTicks now;
+  cache.Set(Key("foobar1.com"), OK, Addresses("192.168.1.1"), now);
+  cache.Set(Key("foobar2.com"), OK, Addresses("192.168.1.2"), now);
+
+  ListValue list;
+  cache.Serialize(kMaxCacheEntries, now, &list);
+  ASSERT_EQ(2u, list.GetSize());
+  DictionaryValue* dict;
+  ASSERT_TRUE(list.GetDictionary(0, &dict));
+  dict->Remove("addresses", NULL);
+  list.Append(Value::CreateStringValue("not an entry"));
+
+  HostCache restored_cache(kMaxCacheEntries, kSuccessEntryTTL,
+                           kFailureEntryTTL);
+  EXPECT_EQ(1u, restored_cache.Restore(list, now, base::TimeDelta()));
+  EXPECT_EQ(1u, restored_cache.size());
+}
+
 // Tests the less than and equal operators for HostCache::Key work.
 TEST(HostCacheTest, KeyComparators) {
   struct {
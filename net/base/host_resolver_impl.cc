@@ -30,6 +30,7 @@
 #include "base/values.h"
 #include "net/base/address_list.h"
 #include "net/base/address_list_net_log_param.h"
+#include "net/base/dns_lookup.h"
 #include "net/base/host_port_pair.h"
 #include "net/base/host_resolver_proc.h"
 #include "net/base/net_errors.h"
@@ -44,6 +45,19 @@ namespace net {
 
 namespace {
 
+// The outcome of looking up a request in the cache, for histograms.
+enum CacheLookupResult {
+  CACHE_LOOKUP_HIT,
+  CACHE_LOOKUP_STALE_HIT,
+  CACHE_LOOKUP_MISS,
+  CACHE_LOOKUP_MAX  // Bounding value.
+};
+
+void RecordCacheLookupResult(CacheLookupResult result) {
+  UMA_HISTOGRAM_ENUMERATION("DNS.CacheLookupResult", result,
+                            CACHE_LOOKUP_MAX);
+}
+
 // We use a separate histogram name for each platform to facilitate the
 // display of error codes by their symbolic name (since each platform has
 // different mappings).
@@ -356,6 +370,9 @@ class HostResolverImpl::Job
        error_(OK),
        os_error_(0),
        had_non_speculative_request_(false),
+       fall_back_to_resolver_proc_(false),
+       ALLOW_THIS_IN_INITIALIZER_LIST(
+           dns_callback_(this, &Job::OnDnsLookupComplete)),
        net_log_(BoundNetLog::Make(net_log,
                                   NetLog::SOURCE_HOST_RESOLVER_IMPL_JOB)) {
     net_log_.BeginEvent(
@@ -383,6 +400,43 @@ class HostResolverImpl::Job
   void Start() {
     start_time_ = base::TimeTicks::Now();
 
+    // The built-in resolver doesn't report canonical names.
+    if (resolver_->dns_config_.IsValid() &&
+        !(key_.host_resolver_flags & HOST_RESOLVER_CANONNAME)) {
+      // Like the system resolver, look in the hosts file before asking the
+      // name servers.
+      if (LookupInHosts()) {
+        // We could be running within Resolve() right now.
+        error_ = OK;
+        MessageLoop::current()->PostTask(
+            FROM_HERE, NewRunnableMethod(this, &Job::OnLookupComplete));
+        return;
+      }
+      // The name servers don't know about localhost, the system does.
+      if (IsLocalhost(key_.hostname)) {
+        StartWorkerLookup();
+        return;
+      }
+
+      fall_back_to_resolver_proc_ =
+          resolver_->dns_fall_back_to_resolver_proc_;
+      dns_lookup_.reset(new DnsLookup(resolver_->dns_config_, key_.hostname,
+                                      key_.address_family,
+                                      net_log_.net_log()));
+      int rv = dns_lookup_->Start(&dns_callback_);
+      if (rv != ERR_IO_PENDING) {
+        // We could be running within Resolve() right now.
+        MessageLoop::current()->PostTask(
+            FROM_HERE, NewRunnableMethod(this, &Job::OnDnsLookupComplete, rv));
+      }
+      return;
+    }
+
+    StartWorkerLookup();
+  }
+
+  // Called from origin loop.
+  void StartWorkerLookup() {
     // Dispatch the job to a worker thread.
     if (!base::WorkerPool::PostTask(FROM_HERE,
             NewRunnableMethod(this, &Job::DoLookup), true)) {
@@ -403,6 +457,7 @@ class HostResolverImpl::Job
 
     HostResolver* resolver = resolver_;
     resolver_ = NULL;
+    dns_lookup_.reset();
 
     // Mark the job as cancelled, so when worker thread completes it will
     // not try to post completion to origin loop.
@@ -468,6 +523,37 @@ class HostResolverImpl::Job
     STLDeleteElements(&requests_);
   }
 
+  // Sets |results_| to the addresses of the hosts file entry for the job's
+  // host name, of the job's address family. Returns false if there are none.
+  bool LookupInHosts() {
+    const DnsHosts& hosts = resolver_->dns_config_.hosts;
+    DnsHosts::const_iterator it =
+        hosts.find(StringToLowerASCII(key_.hostname));
+    if (it == hosts.end())
+      return false;
+
+    results_.Reset();
+    for (size_t i = 0; i < it->second.size(); ++i) {
+      const IPAddressNumber& address = it->second[i];
+      if ((key_.address_family == ADDRESS_FAMILY_IPV4 &&
+           address.size() != kIPv4AddressSize) ||
+          (key_.address_family == ADDRESS_FAMILY_IPV6 &&
+           address.size() != kIPv6AddressSize))
+        continue;
+      AddressList single(address, 0, false);
+      if (results_.head())
+        results_.Append(single.head());
+      else
+        results_ = single;
+    }
+    return results_.head() != NULL;
+  }
+
+  static bool IsLocalhost(const std::string& hostname) {
+    std::string name = StringToLowerASCII(hostname);
+    return name == "localhost" || EndsWith(name, ".localhost", true);
+  }
+
   // WARNING: This code runs inside a worker pool. The shutdown code cannot
   // wait for it to finish, so we must be very careful here about using other
   // objects (like MessageLoops, Singletons, etc). During shutdown these objects
@@ -492,6 +578,22 @@ class HostResolverImpl::Job
     }
   }
 
+  // Callback for when the DnsLookup completes (runs on origin thread).
+  void OnDnsLookupComplete(int result) {
+    if (was_cancelled() || !dns_lookup_.get())
+      return;
+    if (result == OK)
+      results_ = dns_lookup_->addresses();
+    dns_lookup_.reset();
+
+    if (result != OK && fall_back_to_resolver_proc_) {
+      StartWorkerLookup();
+      return;
+    }
+    error_ = result;
+    OnLookupComplete();
+  }
+
   // Callback for when DoLookup() completes (runs on origin thread).
   void OnLookupComplete() {
     // Should be running on origin loop.
@@ -626,6 +728,12 @@ class HostResolverImpl::Job
 
   AddressList results_;
 
+  // The lookup of the built-in resolver, while it runs. If it fails, the
+  // HostResolverProc gets a try if |fall_back_to_resolver_proc_|.
+  scoped_ptr<DnsLookup> dns_lookup_;
+  bool fall_back_to_resolver_proc_;
+  CompletionCallbackImpl<Job> dns_callback_;
+
   // The time when the job was started.
   base::TimeTicks start_time_;
 
@@ -911,7 +1019,11 @@ HostResolverImpl::HostResolverImpl(
       shutdown_(false),
       ipv6_probe_monitoring_(false),
       additional_resolver_flags_(0),
-      net_log_(net_log) {
+      net_log_(net_log),
+      stale_hit_count_(0),
+      ALLOW_THIS_IN_INITIALIZER_LIST(
+          refresh_callback_(this, &HostResolverImpl::OnStaleEntryRefreshed)),
+      dns_fall_back_to_resolver_proc_(true) {
   DCHECK_GT(max_jobs, 0u);
 
   // It is cumbersome to expose all of the constraints in the constructor,
@@ -953,6 +1065,13 @@ void HostResolverImpl::ProbeIPv6Support() {
   OnIPAddressChanged();  // Give initial setup call.
 }
 
+void HostResolverImpl::SetDnsConfig(const DnsConfig& config,
+                                    bool fall_back_to_resolver_proc) {
+  DCHECK(CalledOnValidThread());
+  dns_config_ = config;
+  dns_fall_back_to_resolver_proc_ = fall_back_to_resolver_proc;
+}
+
 void HostResolverImpl::SetPoolConstraints(JobPoolIndex pool_index,
                                           size_t max_outstanding_jobs,
                                           size_t max_pending_requests) {
@@ -1011,11 +1130,19 @@ int HostResolverImpl::Resolve(const RequestInfo& info,
     return net_error;
   }
 
-  // If we have an unexpired cache entry, use it.
+  // If we have an unexpired cache entry, use it. Otherwise, use an expired
+  // one if allowed, and resolve the host again in the background.
   if (info.allow_cached_response() && cache_.get()) {
-    const HostCache::Entry* cache_entry = cache_->Lookup(
-        key, base::TimeTicks::Now());
+    base::TimeTicks now = base::TimeTicks::Now();
+    const HostCache::Entry* cache_entry = cache_->Lookup(key, now);
+    bool is_stale = false;
+    if (!cache_entry) {
+      cache_entry = cache_->LookupStale(key, now, max_stale_age_);
+      is_stale = cache_entry != NULL;
+    }
     if (cache_entry) {
+      RecordCacheLookupResult(is_stale ? CACHE_LOOKUP_STALE_HIT :
+                                         CACHE_LOOKUP_HIT);
       request_net_log.AddEvent(NetLog::TYPE_HOST_RESOLVER_IMPL_CACHE_HIT, NULL);
       int net_error = cache_entry->error;
       if (net_error == OK)
@@ -1026,8 +1153,13 @@ int HostResolverImpl::Resolve(const RequestInfo& info,
                       net_error,
                       0  /* os_error (unknown since from cache) */);
 
+      if (is_stale) {
+        stale_hit_count_++;
+        RefreshStaleEntry(info);
+      }
       return net_error;
     }
+    RecordCacheLookupResult(CACHE_LOOKUP_MISS);
   }
 
   if (info.only_use_cached_response()) {  // Not allowed to do a real lookup.
@@ -1201,9 +1333,16 @@ void HostResolverImpl::OnJobComplete(Job* job,
                                      const AddressList& addrlist) {
   RemoveOutstandingJob(job);
 
-  // Write result to the cache.
-  if (cache_.get())
-    cache_->Set(job->key(), net_error, addrlist, base::TimeTicks::Now());
+  // Write result to the cache, unless it is a failure that would replace an
+  // entry that can still be served stale: on a flaky network, the old address
+  // is more useful than the error.
+  if (cache_.get()) {
+    base::TimeTicks now = base::TimeTicks::Now();
+    if (net_error == OK ||
+        !cache_->LookupStale(job->key(), now, max_stale_age_)) {
+      cache_->Set(job->key(), net_error, addrlist, now);
+    }
+  }
 
   OnJobCompleteInternal(job, net_error, os_error, addrlist);
 }
@@ -1448,6 +1587,24 @@ void HostResolverImpl::AbortAllInProgressJobs() {
   }
 }
 
+void HostResolverImpl::RefreshStaleEntry(const RequestInfo& info) {
+  // A request for the same host may be refreshing the entry already.
+  if (FindOutstandingJob(GetEffectiveKeyForRequest(info)))
+    return;
+
+  RequestInfo refresh_info(info);
+  refresh_info.set_allow_cached_response(false);
+  refresh_info.set_only_use_cached_response(false);
+  refresh_info.set_is_speculative(true);
+  refresh_info.set_priority(IDLE);
+  Resolve(refresh_info, &refresh_addresses_, &refresh_callback_, NULL,
+          BoundNetLog());
+}
+
+void HostResolverImpl::OnStaleEntryRefreshed(int result) {
+  // Nothing to do, OnJobComplete() already updated the cache.
+}
+
 void HostResolverImpl::OnIPAddressChanged() {
   if (cache_.get())
     cache_->clear();
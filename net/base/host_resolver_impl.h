@@ -10,7 +10,11 @@
 
 #include "base/memory/scoped_ptr.h"
 #include "base/threading/non_thread_safe.h"
+#include "base/time.h"
+#include "net/base/address_list.h"
 #include "net/base/capturing_net_log.h"
+#include "net/base/completion_callback.h"
+#include "net/base/dns_config.h"
 #include "net/base/host_cache.h"
 #include "net/base/host_resolver.h"
 #include "net/base/host_resolver_proc.h"
@@ -21,7 +25,9 @@ namespace net {
 
 // For each hostname that is requested, HostResolver creates a
 // HostResolverImpl::Job. This job gets dispatched to a thread in the global
-// WorkerPool, where it runs SystemHostResolverProc(). If requests for that same
+// WorkerPool, where it runs SystemHostResolverProc(), unless a DnsConfig was
+// given with SetDnsConfig(), in which case the job queries the name servers
+// itself, without leaving the origin thread. If requests for that same
 // host are made while the job is already outstanding, then they are attached
 // to the existing job rather than creating a new one. This avoids doing
 // parallel resolves for the same host.
@@ -109,6 +115,27 @@ class HostResolverImpl : public HostResolver,
                           size_t max_outstanding_jobs,
                           size_t max_pending_requests);
 
+  // Allows requests to be served from cache entries that expired less than
+  // |max_stale_age| ago, while the entry is resolved again in the
+  // background. A zero |max_stale_age| (the default) only allows the entries
+  // restored with HostCache::Restore(), within the window given there.
+  void set_max_stale_age(base::TimeDelta max_stale_age) {
+    max_stale_age_ = max_stale_age;
+  }
+
+  // Returns the number of requests that were served from an expired entry.
+  int stale_hit_count() const { return stale_hit_count_; }
+
+  // Resolves host names by sending DNS queries to the name servers of
+  // |config| from the origin thread, instead of calling the HostResolverProc
+  // on the worker pool. The hosts entries of |config| are looked up first,
+  // and localhost is always left to the HostResolverProc. If
+  // |fall_back_to_resolver_proc| is true, the names that fail to resolve this
+  // way are given to the HostResolverProc, which knows about the other
+  // sources of the system. An invalid |config| goes back to the
+  // HostResolverProc for everything.
+  void SetDnsConfig(const DnsConfig& config, bool fall_back_to_resolver_proc);
+
   // HostResolver methods:
   virtual int Resolve(const RequestInfo& info,
                       AddressList* addresses,
@@ -223,6 +250,13 @@ class HostResolverImpl : public HostResolver,
   // Aborts all in progress jobs (but might start new ones).
   void AbortAllInProgressJobs();
 
+  // Starts resolving |info| again, after a request for it was served from an
+  // expired cache entry.
+  void RefreshStaleEntry(const RequestInfo& info);
+
+  // Callback for the requests started by RefreshStaleEntry().
+  void OnStaleEntryRefreshed(int result);
+
   // NetworkChangeNotifier::IPAddressObserver methods:
   virtual void OnIPAddressChanged();
 
@@ -277,6 +311,22 @@ class HostResolverImpl : public HostResolver,
 
   NetLog* net_log_;
 
+  // How long after expiring a cache entry can still be used. See
+  // set_max_stale_age().
+  base::TimeDelta max_stale_age_;
+
+  // Number of requests served from an expired cache entry.
+  int stale_hit_count_;
+
+  // The results of the requests started by RefreshStaleEntry() go to the
+  // cache, so these are only placeholders.
+  AddressList refresh_addresses_;
+  CompletionCallbackImpl<HostResolverImpl> refresh_callback_;
+
+  // The settings of the built-in DNS resolver. See SetDnsConfig().
+  DnsConfig dns_config_;
+  bool dns_fall_back_to_resolver_proc_;
+
   DISALLOW_COPY_AND_ASSIGN(HostResolverImpl);
 };
 
@@ -11,8 +11,10 @@
 #include "base/message_loop.h"
 #include "base/string_util.h"
 #include "base/stringprintf.h"
+#include "base/values.h"
 #include "net/base/address_list.h"
 #include "net/base/completion_callback.h"
+#include "net/base/dns_test_util.h"
 #include "net/base/mock_host_resolver.h"
 #include "net/base/net_errors.h"
 #include "net/base/net_log_unittest.h"
@@ -1694,6 +1696,215 @@ TEST_F(HostResolverImplTest, DisallowNonCachedResponses) {
   EXPECT_TRUE(htons(kPortnum) == sa_in->sin_port);
   EXPECT_TRUE(htonl(0xc0a8012a) == sa_in->sin_addr.s_addr);
 }
+// Adds to |cache| an entry for |hostname| resolving to |ip_literal|, which
+// expired a minute ago.
+void AddExpiredEntry(HostCache* cache, const std::string& hostname,
+                     const std::string& ip_literal) {
+  IPAddressNumber ip_number;
+  ASSERT_TRUE(ParseIPLiteralToNumber(ip_literal, &ip_number));
+  base::TimeTicks then = base::TimeTicks::Now() -
+      cache->success_entry_ttl() - base::TimeDelta::FromMinutes(1);
+  cache->Set(HostCache::Key(hostname, ADDRESS_FAMILY_UNSPECIFIED, 0), OK,
+             AddressList(ip_number, 0, false), then);
+}
+
+TEST_F(HostResolverImplTest, ServeStaleEntries) {
+  scoped_refptr<RuleBasedHostResolverProc> resolver_proc(
+      new RuleBasedHostResolverProc(NULL));
+  resolver_proc->AddRule("just.testing", "192.168.1.42");
+  resolver_proc->AddSimulatedFailure("failing.testing");
+
+  scoped_ptr<HostResolverImpl> host_resolver(
+      CreateHostResolverImpl(resolver_proc));
+  AddExpiredEntry(host_resolver->cache(), "just.testing", "192.168.1.1");
+  AddExpiredEntry(host_resolver->cache(), "failing.testing", "192.168.1.2");
+
+  // Stale entries are not used by default.
+  HostResolver::RequestInfo info(HostPortPair("just.testing", 80));
+  AddressList addrlist;
+  TestCompletionCallback callback;
+  int rv = host_resolver->Resolve(info, &addrlist, &callback, NULL,
+                                  BoundNetLog());
+  ASSERT_EQ(ERR_IO_PENDING, rv);
+  EXPECT_EQ(OK, callback.WaitForResult());
+  EXPECT_EQ("192.168.1.42", NetAddressToString(addrlist.head()));
+  EXPECT_EQ(0, host_resolver->stale_hit_count());
+
+  AddExpiredEntry(host_resolver->cache(), "just.testing", "192.168.1.1");
+  host_resolver->set_max_stale_age(base::TimeDelta::FromHours(1));
+  rv = host_resolver->Resolve(info, &addrlist, &callback, NULL, BoundNetLog());
+  ASSERT_EQ(OK, rv);
+  EXPECT_EQ("192.168.1.1", NetAddressToString(addrlist.head()));
+  EXPECT_EQ(1, host_resolver->stale_hit_count());
+
+  // Wait for the refresh of the entry, by bypassing the cache.
+  HostResolver::RequestInfo no_cache_info(info);
+  no_cache_info.set_allow_cached_response(false);
+  rv = host_resolver->Resolve(no_cache_info, &addrlist, &callback, NULL,
+                              BoundNetLog());
+  ASSERT_EQ(ERR_IO_PENDING, rv);
+  EXPECT_EQ(OK, callback.WaitForResult());
+
+  rv = host_resolver->Resolve(info, &addrlist, &callback, NULL, BoundNetLog());
+  ASSERT_EQ(OK, rv);
+  EXPECT_EQ("192.168.1.42", NetAddressToString(addrlist.head()));
+  EXPECT_EQ(1, host_resolver->stale_hit_count());
+
+  // A failed refresh keeps the stale entry.
+  HostResolver::RequestInfo failing_info(HostPortPair("failing.testing", 80));
+  rv = host_resolver->Resolve(failing_info, &addrlist, &callback, NULL,
+                              BoundNetLog());
+  ASSERT_EQ(OK, rv);
+  EXPECT_EQ("192.168.1.2", NetAddressToString(addrlist.head()));
+
+  failing_info.set_allow_cached_response(false);
+  rv = host_resolver->Resolve(failing_info, &addrlist, &callback, NULL,
+                              BoundNetLog());
+  ASSERT_EQ(ERR_IO_PENDING, rv);
+  EXPECT_EQ(ERR_NAME_NOT_RESOLVED, callback.WaitForResult());
+
+  failing_info.set_allow_cached_response(true);
+  rv = host_resolver->Resolve(failing_info, &addrlist, &callback, NULL,
+                              BoundNetLog());
+  ASSERT_EQ(OK, rv);
+  EXPECT_EQ("192.168.1.2", NetAddressToString(addrlist.head()));
+  EXPECT_EQ(3, host_resolver->stale_hit_count());
+}
+
+// Entries restored from a previous run are served stale for the window given
+// to HostCache::Restore(), even though stale entries are not used by default.
+TEST_F(HostResolverImplTest, ServeRestoredEntries) {
+  scoped_refptr<RuleBasedHostResolverProc> resolver_proc(
+      new RuleBasedHostResolverProc(NULL));
+  resolver_proc->AddRule("just.testing", "192.168.1.42");
+
+  scoped_ptr<HostResolverImpl> host_resolver(
+      CreateHostResolverImpl(resolver_proc));
+  HostCache* cache = host_resolver->cache();
+
+  HostCache saved_cache(10, cache->success_entry_ttl(),
+                        cache->failure_entry_ttl());
+  AddExpiredEntry(&saved_cache, "just.testing", "192.168.1.1");
+  ListValue list;
+  saved_cache.Serialize(10, base::TimeTicks::Now(), &list);
+  EXPECT_EQ(1u, cache->Restore(list, base::TimeTicks::Now(),
+                               base::TimeDelta::FromHours(1)));
+
+  HostResolver::RequestInfo info(HostPortPair("just.testing", 80));
+  AddressList addrlist;
+  TestCompletionCallback callback;
+  int rv = host_resolver->Resolve(info, &addrlist, &callback, NULL,
+                                  BoundNetLog());
+  ASSERT_EQ(OK, rv);
+  EXPECT_EQ("192.168.1.1", NetAddressToString(addrlist.head()));
+  EXPECT_EQ(1, host_resolver->stale_hit_count());
+
+  // The entry is resolved again in the background.
+  HostResolver::RequestInfo no_cache_info(info);
+  no_cache_info.set_allow_cached_response(false);
+  rv = host_resolver->Resolve(no_cache_info, &addrlist, &callback, NULL,
+                              BoundNetLog());
+  ASSERT_EQ(ERR_IO_PENDING, rv);
+  EXPECT_EQ(OK, callback.WaitForResult());
+
+  rv = host_resolver->Resolve(info, &addrlist, &callback, NULL, BoundNetLog());
+  ASSERT_EQ(OK, rv);
+  EXPECT_EQ("192.168.1.42", NetAddressToString(addrlist.head()));
+  EXPECT_EQ(1, host_resolver->stale_hit_count());
+}
+
+// Tests that the built-in resolver queries the name servers, and gives the
+// names it cannot resolve to the HostResolverProc if asked to.
+TEST_F(HostResolverImplTest, BuiltInResolver) {
+  TestDnsServer server;
+  ASSERT_TRUE(server.Start());
+  server.AddAddress("just.testing", "192.168.1.1");
+
+  scoped_refptr<RuleBasedHostResolverProc> resolver_proc(
+      new RuleBasedHostResolverProc(NULL));
+  resolver_proc->AddRule("just.testing", "192.168.1.42");
+  resolver_proc->AddRule("local.testing", "192.168.1.43");
+
+  scoped_ptr<HostResolverImpl> host_resolver(
+      CreateHostResolverImpl(resolver_proc));
+  DnsConfig config;
+  config.nameservers.push_back(server.address());
+  host_resolver->SetDnsConfig(config, true);
+
+  HostResolver::RequestInfo info(HostPortPair("just.testing", 80));
+  info.set_address_family(ADDRESS_FAMILY_IPV4);
+  AddressList addrlist;
+  TestCompletionCallback callback;
+  int rv = host_resolver->Resolve(info, &addrlist, &callback, NULL,
+                                  BoundNetLog());
+  ASSERT_EQ(ERR_IO_PENDING, rv);
+  EXPECT_EQ(OK, callback.WaitForResult());
+  EXPECT_EQ("192.168.1.1", NetAddressToString(addrlist.head()));
+  EXPECT_EQ(80, addrlist.GetPort());
+  EXPECT_EQ(1, server.query_count());
+
+  // The server doesn't know about this one.
+  HostResolver::RequestInfo local_info(HostPortPair("local.testing", 80));
+  local_info.set_address_family(ADDRESS_FAMILY_IPV4);
+  rv = host_resolver->Resolve(local_info, &addrlist, &callback, NULL,
+                              BoundNetLog());
+  ASSERT_EQ(ERR_IO_PENDING, rv);
+  EXPECT_EQ(OK, callback.WaitForResult());
+  EXPECT_EQ("192.168.1.43", NetAddressToString(addrlist.head()));
+  EXPECT_EQ(2, server.query_count());
+
+  // Without the fallback, the error of the name servers is final.
+  host_resolver->SetDnsConfig(config, false);
+  local_info.set_allow_cached_response(false);
+  rv = host_resolver->Resolve(local_info, &addrlist, &callback, NULL,
+                              BoundNetLog());
+  ASSERT_EQ(ERR_IO_PENDING, rv);
+  EXPECT_EQ(ERR_NAME_NOT_RESOLVED, callback.WaitForResult());
+  EXPECT_EQ(3, server.query_count());
+}
+
+// The hosts file and localhost are looked up before the name servers, even
+// without the fallback to the HostResolverProc.
+TEST_F(HostResolverImplTest, BuiltInResolverHosts) {
+  TestDnsServer server;
+  ASSERT_TRUE(server.Start());
+  server.AddAddress("hosts.testing", "192.168.1.1");
+
+  scoped_refptr<RuleBasedHostResolverProc> resolver_proc(
+      new RuleBasedHostResolverProc(NULL));
+  resolver_proc->AddRule("localhost", "127.0.0.1");
+
+  scoped_ptr<HostResolverImpl> host_resolver(
+      CreateHostResolverImpl(resolver_proc));
+  DnsConfig config;
+  config.nameservers.push_back(server.address());
+  ParseHosts("192.168.1.44 hosts.testing\n"
+             "fe80::44 hosts.testing\n", &config.hosts);
+  host_resolver->SetDnsConfig(config, false);
+
+  HostResolver::RequestInfo info(HostPortPair("hosts.testing", 80));
+  info.set_address_family(ADDRESS_FAMILY_IPV4);
+  AddressList addrlist;
+  TestCompletionCallback callback;
+  int rv = host_resolver->Resolve(info, &addrlist, &callback, NULL,
+                                  BoundNetLog());
+  ASSERT_EQ(ERR_IO_PENDING, rv);
+  EXPECT_EQ(OK, callback.WaitForResult());
+  EXPECT_EQ("192.168.1.44", NetAddressToString(addrlist.head()));
+  EXPECT_TRUE(addrlist.head()->ai_next == NULL);
+  EXPECT_EQ(80, addrlist.GetPort());
+
+  HostResolver::RequestInfo localhost_info(HostPortPair("localhost", 80));
+  localhost_info.set_address_family(ADDRESS_FAMILY_IPV4);
+  rv = host_resolver->Resolve(localhost_info, &addrlist, &callback, NULL,
+                              BoundNetLog());
+  ASSERT_EQ(ERR_IO_PENDING, rv);
+  EXPECT_EQ(OK, callback.WaitForResult());
+  EXPECT_EQ("127.0.0.1", NetAddressToString(addrlist.head()));
+
+  EXPECT_EQ(0, server.query_count());
+}
+
 // TODO(cbentzel): Test a mix of requests with different HostResolverFlags.
 
 }  // namespace
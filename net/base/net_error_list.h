@@ -17,6 +17,7 @@
 //   500-599 ?
 //   600-699 FTP errors
 //   700-799 Certificate manager errors
+//   800-899 DNS resolver errors
 //
 
 // An asynchronous IO operation is not yet complete.  This usually does not
@@ -529,3 +530,18 @@ NET_ERROR(IMPORT_CA_CERT_FAILED, -705)
 
 // Server certificate import failed due to some internal error.
 NET_ERROR(IMPORT_SERVER_CERT_FAILED, -706)
+
+// DNS error codes.
+
+// The DNS server's response could not be parsed, or did not answer the query.
+NET_ERROR(DNS_MALFORMED_RESPONSE, -800)
+
+// The DNS server's response was truncated, and the query has to be sent over
+// TCP, which is not supported.
+NET_ERROR(DNS_SERVER_REQUIRES_TCP, -801)
+
+// The DNS server failed to process the query (SERVFAIL, REFUSED, etc).
+NET_ERROR(DNS_SERVER_FAILED, -802)
+
+// None of the DNS servers answered the query in time.
+NET_ERROR(DNS_TIMED_OUT, -803)
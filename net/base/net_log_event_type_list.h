@@ -430,6 +430,14 @@ EVENT_TYPE(SOCKET_POOL_STALLED_MAX_SOCKETS)
 // The request stalled because there are too many sockets in the group.
 EVENT_TYPE(SOCKET_POOL_STALLED_MAX_SOCKETS_PER_GROUP)
 
+// The request would have stalled on the limit of sockets of its group, but the
+// limit was raised because the group keeps stalling.  The following
+// parameters are attached:
+//   {
+//     "max_sockets_per_group": <The new limit of sockets of the group>
+//   }
+EVENT_TYPE(SOCKET_POOL_GROUP_LIMIT_RAISED)
+
 // Indicates that we reused an existing socket. Attached to the event are
 // the parameters:
 //   {
@@ -819,6 +827,16 @@ EVENT_TYPE(SPDY_SESSION_SEND_DATA)
 //   }
 EVENT_TYPE(SPDY_SESSION_RECV_DATA)
 
+// The write scheduler picked a data frame to write next.
+//   {
+//     "stream_id"    : <The stream ID of the frame>,
+//     "priority"     : <The priority the frame was queued at>,
+//     "size"         : <The size of the frame, including its header>,
+//     "deficit"      : <The bytes this priority may still write in its turn>,
+//     "queued_frames": <The data frames still queued at this priority>,
+//   }
+EVENT_TYPE(SPDY_SESSION_SCHEDULE_DATA)
+
 // Logs that a stream is stalled on the send window being closed.
 EVENT_TYPE(SPDY_SESSION_STALLED_ON_SEND_WINDOW)
 
@@ -383,6 +383,25 @@ bool X509Certificate::Equals(const X509Certificate* other) const {
   return IsSameOSCert(cert_handle_, other->cert_handle_);
 }
 
+SHA1Fingerprint X509Certificate::CalculateChainFingerprint() const {
+  if (intermediate_ca_certs_.empty())
+    return fingerprint_;
+
+  std::string chain(reinterpret_cast<const char*>(fingerprint_.data),
+                    sizeof(fingerprint_.data));
+  for (size_t i = 0; i < intermediate_ca_certs_.size(); ++i) {
+    SHA1Fingerprint fingerprint =
+        CalculateFingerprint(intermediate_ca_certs_[i]);
+    chain.append(reinterpret_cast<const char*>(fingerprint.data),
+                 sizeof(fingerprint.data));
+  }
+
+  SHA1Fingerprint chain_fingerprint;
+  base::SHA1HashBytes(reinterpret_cast<const unsigned char*>(chain.data()),
+                      chain.size(), chain_fingerprint.data);
+  return chain_fingerprint;
+}
+
 bool X509Certificate::HasIntermediateCertificate(OSCertHandle cert) {
   for (size_t i = 0; i < intermediate_ca_certs_.size(); ++i) {
     if (IsSameOSCert(cert, intermediate_ca_certs_[i]))
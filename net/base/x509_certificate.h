@@ -218,6 +218,11 @@ class X509Certificate : public base::RefCountedThreadSafe<X509Certificate> {
   // The fingerprint of this certificate.
   const SHA1Fingerprint& fingerprint() const { return fingerprint_; }
 
+  // Calculates the SHA-1 fingerprint of this certificate together with its
+  // intermediate certificates.  Returns fingerprint() if there are no
+  // intermediate certificates.
+  SHA1Fingerprint CalculateChainFingerprint() const;
+
   // Gets the DNS names in the certificate.  Pursuant to RFC 2818, Section 3.1
   // Server Identity, if the certificate has a subjectAltName extension of
   // type dNSName, this method gets the DNS names in that extension.
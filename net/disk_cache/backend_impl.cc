@@ -25,7 +25,9 @@
 #include "net/disk_cache/experiments.h"
 #include "net/disk_cache/file.h"
 #include "net/disk_cache/hash.h"
+#include "net/disk_cache/log_backend_impl.h"
 #include "net/disk_cache/mem_backend_impl.h"
+#include "net/disk_cache/memory_tier_backend.h"
 
 // This has to be defined before including histogram_macros.h from this file.
 #define NET_DISK_CACHE_BACKEND_IMPL_CC_
@@ -47,6 +49,13 @@ const int k64kEntriesStore = 240 * 1000 * 1000;
 const int kBaseTableLen = 64 * 1024;
 const int kDefaultCacheSize = 80 * 1024 * 1024;
 
+// The format of the disk caches returned by CreateCacheBackend().
+disk_cache::BackendFormat g_backend_format = disk_cache::BLOCK_FILES_FORMAT;
+
+// The size of the memory tier of the disk caches returned by
+// CreateCacheBackend(), if any.
+int g_memory_tier_size = 0;
+
 int DesiredIndexTableLen(int32 storage_size) {
   if (storage_size <= k64kEntriesStore)
     return kBaseTableLen;
@@ -267,6 +276,87 @@ void CacheCreator::DoCallback(int result) {
 
 // ------------------------------------------------------------------------
 
+// This class puts a memory tier in front of a disk cache, once the disk cache
+// is ready.
+class MemoryTierCreator {
+ public:
+  MemoryTierCreator(int max_bytes, disk_cache::Backend** backend,
+                    net::CompletionCallback* callback)
+      : max_bytes_(max_bytes), backend_(backend), callback_(callback),
+        disk_cache_(NULL),
+        ALLOW_THIS_IN_INITIALIZER_LIST(
+            my_callback_(this, &MemoryTierCreator::OnIOComplete)) {
+  }
+  ~MemoryTierCreator() {}
+
+  // Where the disk cache being created should be stored, and the callback to
+  // use for its creation.
+  disk_cache::Backend** disk_cache() { return &disk_cache_; }
+  net::CompletionCallback* callback() { return &my_callback_; }
+
+  // Returns the result for the user, given the result of the creation of the
+  // disk cache.
+  int Run(int rv);
+
+  // Callback implementation.
+  void OnIOComplete(int result);
+
+ private:
+  int Wrap(int result);
+
+  int max_bytes_;
+  disk_cache::Backend** backend_;
+  net::CompletionCallback* callback_;
+  disk_cache::Backend* disk_cache_;
+  net::CompletionCallbackImpl<MemoryTierCreator> my_callback_;
+
+  DISALLOW_COPY_AND_ASSIGN(MemoryTierCreator);
+};
+
+int MemoryTierCreator::Run(int rv) {
+  if (rv == net::ERR_IO_PENDING)
+    return rv;
+
+  rv = Wrap(rv);
+  delete this;
+  return rv;
+}
+
+void MemoryTierCreator::OnIOComplete(int result) {
+  net::CompletionCallback* callback = callback_;
+  int rv = Wrap(result);
+  delete this;
+  callback->Run(rv);
+}
+
+int MemoryTierCreator::Wrap(int result) {
+  if (result != net::OK) {
+    *backend_ = NULL;
+    return result;
+  }
+  *backend_ = new disk_cache::MemoryTierBackend(disk_cache_, max_bytes_);
+  return net::OK;
+}
+
+// Creates a cache that stores its data on disk, in the current format.
+int CreateDiskBackend(net::CacheType type, const FilePath& path, int max_bytes,
+                      bool force, base::MessageLoopProxy* thread,
+                      net::NetLog* net_log, disk_cache::Backend** backend,
+                      net::CompletionCallback* callback) {
+  if (type == net::DISK_CACHE &&
+      g_backend_format == disk_cache::LOG_STRUCTURED_FORMAT) {
+    return disk_cache::LogBackendImpl::CreateBackend(path, max_bytes, thread,
+                                                     net_log, backend,
+                                                     callback);
+  }
+
+  return disk_cache::BackendImpl::CreateBackend(path, force, max_bytes, type,
+                                                disk_cache::kNone, thread,
+                                                net_log, backend, callback);
+}
+
+// ------------------------------------------------------------------------
+
 // A task to perform final cleanup on the background thread.
 class FinalCleanup : public Task {
  public:
@@ -300,8 +390,26 @@ int CreateCacheBackend(net::CacheType type, const FilePath& path, int max_bytes,
   }
   DCHECK(thread);
 
-  return BackendImpl::CreateBackend(path, force, max_bytes, type, kNone, thread,
-                                    net_log, backend, callback);
+  if (type == net::DISK_CACHE && g_memory_tier_size) {
+    MemoryTierCreator* creator =
+        new MemoryTierCreator(g_memory_tier_size, backend, callback);
+    // This object will self-destroy when finished.
+    return creator->Run(CreateDiskBackend(type, path, max_bytes, force, thread,
+                                          net_log, creator->disk_cache(),
+                                          creator->callback()));
+  }
+
+  return CreateDiskBackend(type, path, max_bytes, force, thread, net_log,
+                           backend, callback);
+}
+
+void SetBackendFormat(BackendFormat format) {
+  g_backend_format = format;
+}
+
+void SetMemoryTierSize(int max_bytes) {
+  DCHECK_GE(max_bytes, 0);
+  g_memory_tier_size = max_bytes;
 }
 
 // Returns the preferred maximum number of bytes for the cache given the
@@ -127,6 +127,11 @@ TEST_F(DiskCacheBackendTest, AppCacheBasics) {
   BackendBasics();
 }
 
+TEST_F(DiskCacheBackendTest, MemoryTierBasics) {
+  SetMemoryTierMode();
+  BackendBasics();
+}
+
 void DiskCacheBackendTest::BackendKeying() {
   InitCache();
   const char* kName1 = "the first key";
@@ -187,6 +192,11 @@ TEST_F(DiskCacheBackendTest, AppCacheKeying) {
   BackendKeying();
 }
 
+TEST_F(DiskCacheBackendTest, MemoryTierKeying) {
+  SetMemoryTierMode();
+  BackendKeying();
+}
+
 TEST_F(DiskCacheTest, CreateBackend) {
   TestCompletionCallback cb;
 
@@ -1097,6 +1107,11 @@ TEST_F(DiskCacheBackendTest, MemoryOnlyDoomRecent) {
   BackendDoomRecent();
 }
 
+TEST_F(DiskCacheBackendTest, MemoryTierDoomRecent) {
+  SetMemoryTierMode();
+  BackendDoomRecent();
+}
+
 void DiskCacheBackendTest::BackendDoomBetween() {
   InitCache();
   Time initial = Time::Now();
@@ -1152,6 +1167,11 @@ TEST_F(DiskCacheBackendTest, MemoryOnlyDoomBetween) {
   BackendDoomBetween();
 }
 
+TEST_F(DiskCacheBackendTest, MemoryTierDoomBetween) {
+  SetMemoryTierMode();
+  BackendDoomBetween();
+}
+
 void DiskCacheBackendTest::BackendTransaction(const std::string& name,
                                               int num_entries, bool load) {
   success_ = false;
@@ -1857,6 +1877,92 @@ TEST_F(DiskCacheBackendTest, AppCacheOnlyDoomAll) {
   BackendDoomAll();
 }
 
+TEST_F(DiskCacheBackendTest, MemoryTierDoomAll) {
+  SetMemoryTierMode();
+  BackendDoomAll();
+}
+
+// Tests that small entries are served from memory once they are closed, and
+// that their data still goes to disk.
+TEST_F(DiskCacheBackendTest, MemoryTier) {
+  SetMemoryTierMode();
+  InitCache();
+
+  const int kSize = 2000;
+  scoped_refptr<net::IOBuffer> buffer1(new net::IOBuffer(kSize));
+  scoped_refptr<net::IOBuffer> buffer2(new net::IOBuffer(kSize));
+  CacheTestFillBuffer(buffer1->data(), kSize, false);
+
+  disk_cache::Entry* entry;
+  ASSERT_EQ(net::OK, CreateEntry("small", &entry));
+  EXPECT_EQ(kSize, WriteData(entry, 0, 0, buffer1, kSize, false));
+  EXPECT_EQ(kSize, WriteData(entry, 1, 0, buffer1, kSize, false));
+  entry->Close();
+
+  const int kBigSize = 200000;
+  scoped_refptr<net::IOBuffer> big_buffer(new net::IOBuffer(kBigSize));
+  CacheTestFillBuffer(big_buffer->data(), kBigSize, false);
+  ASSERT_EQ(net::OK, CreateEntry("big", &entry));
+  EXPECT_EQ(kBigSize, WriteData(entry, 1, 0, big_buffer, kBigSize, false));
+  entry->Close();
+
+  // The small entry doesn't need the cache thread.
+  TestCompletionCallback cb;
+  ASSERT_EQ(net::OK, cache_->OpenEntry("small", &entry, &cb));
+  EXPECT_EQ(kSize, entry->ReadData(1, 0, buffer2, kSize, &cb));
+  EXPECT_EQ(0, memcmp(buffer1->data(), buffer2->data(), kSize));
+
+  // Writing to it goes to disk.
+  CacheTestFillBuffer(buffer1->data(), kSize, false);
+  EXPECT_EQ(kSize / 2, WriteData(entry, 0, 0, buffer1, kSize / 2, true));
+  entry->Close();
+
+  ASSERT_EQ(net::OK, cache_->OpenEntry("small", &entry, &cb));
+  ASSERT_EQ(kSize / 2, entry->GetDataSize(0));
+  EXPECT_EQ(kSize / 2, entry->ReadData(0, 0, buffer2, kSize, &cb));
+  EXPECT_EQ(0, memcmp(buffer1->data(), buffer2->data(), kSize / 2));
+  entry->Close();
+
+  // The big entry is not kept in memory.
+  int rv = cache_->OpenEntry("big", &entry, &cb);
+  EXPECT_EQ(net::ERR_IO_PENDING, rv);
+  ASSERT_EQ(net::OK, cb.GetResult(rv));
+  entry->Close();
+
+  std::vector<std::pair<std::string, std::string> > stats;
+  cache_->GetStats(&stats);
+  bool found = false;
+  int hit_items = 0;
+  for (size_t i = 0; i < stats.size(); i++) {
+    if (stats[i].first == "Memory tier hit ratio") {
+      EXPECT_EQ("66%", stats[i].second);
+      found = true;
+    }
+    // Listed by the memory tier, not by the disk cache.
+    if (stats[i].first == "Memory tier hit") {
+      EXPECT_EQ("0x2", stats[i].second);
+      hit_items++;
+    }
+  }
+  EXPECT_TRUE(found);
+  EXPECT_EQ(1, hit_items);
+
+  // Start again with an empty memory tier.
+  delete cache_;
+  cache_ = NULL;
+  DisableFirstCleanup();
+  InitCache();
+
+  rv = cache_->OpenEntry("small", &entry, &cb);
+  EXPECT_EQ(net::ERR_IO_PENDING, rv);
+  ASSERT_EQ(net::OK, cb.GetResult(rv));
+  memset(buffer2->data(), 0, kSize);
+  EXPECT_EQ(kSize / 2, ReadData(entry, 0, 0, buffer2, kSize));
+  EXPECT_EQ(0, memcmp(buffer1->data(), buffer2->data(), kSize / 2));
+  EXPECT_EQ(kSize, ReadData(entry, 1, 0, buffer2, kSize));
+  entry->Close();
+}
+
 // If the index size changes when we doom the cache, we should not crash.
 void DiskCacheBackendTest::BackendDoomAll2() {
   EXPECT_EQ(2, cache_->GetEntryCount());
@@ -54,6 +54,22 @@ int CreateCacheBackend(net::CacheType type, const FilePath& path, int max_bytes,
                        net::NetLog* net_log, Backend** backend,
                        CompletionCallback* callback);
 
+// The formats CreateCacheBackend() can use to store a net::DISK_CACHE.
+enum BackendFormat {
+  BLOCK_FILES_FORMAT,     // Entries live in block files, updated in place.
+  LOG_STRUCTURED_FORMAT,  // Entries are appended to segment files.
+};
+
+// Selects the format of the disk caches created from now on. The default is
+// BLOCK_FILES_FORMAT. Media and application caches always use block files,
+// as they rely on sparse entries.
+void SetBackendFormat(BackendFormat format);
+
+// Sets the amount of memory used to keep small entries of the disk caches
+// created from now on, so that they can be served without going to disk. Zero
+// (the default) disables the memory tier. Only net::DISK_CACHE uses it.
+void SetMemoryTierSize(int max_bytes);
+
 // The root interface for a disk cache instance.
 class Backend {
  public:
@@ -2,12 +2,16 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <algorithm>
 #include <string>
 
 #include "base/basictypes.h"
+#include "base/compiler_specific.h"
 #include "base/file_path.h"
 #include "base/file_util.h"
 #include "base/perftimer.h"
+#include "base/shared_memory.h"
+#include "base/stl_util-inl.h"
 #include "base/string_util.h"
 #include "base/threading/thread.h"
 #include "base/test/test_file_util.h"
@@ -15,10 +19,13 @@
 #include "net/base/io_buffer.h"
 #include "net/base/net_errors.h"
 #include "net/base/test_completion_callback.h"
+#include "net/disk_cache/backend_impl.h"
 #include "net/disk_cache/block_files.h"
 #include "net/disk_cache/disk_cache.h"
 #include "net/disk_cache/disk_cache_test_util.h"
 #include "net/disk_cache/hash.h"
+#include "net/disk_cache/log_backend_impl.h"
+#include "net/disk_cache/sharded_backend.h"
 #include "testing/gtest/include/gtest/gtest.h"
 #include "testing/platform_test.h"
 
@@ -138,6 +145,121 @@ int TimeRead(int num_entries, disk_cache::Backend* cache,
   return expected;
 }
 
+// Opens an entry and reads its data without waiting for other reads, as
+// happens when a page loads many images at once.
+class ParallelRead {
+ public:
+  ParallelRead(disk_cache::Backend* cache, const TestEntry& entry,
+               int* pending)
+      : entry_(entry), pending_(pending), cache_entry_(NULL),
+        buffer_(new net::IOBuffer(kMaxSize)),
+        ALLOW_THIS_IN_INITIALIZER_LIST(
+            open_callback_(this, &ParallelRead::OnOpened)),
+        ALLOW_THIS_IN_INITIALIZER_LIST(
+            read_callback_(this, &ParallelRead::OnRead)) {
+    (*pending_)++;
+    int rv = cache->OpenEntry(entry_.key, &cache_entry_, &open_callback_);
+    if (net::ERR_IO_PENDING != rv)
+      OnOpened(rv);
+  }
+
+  ~ParallelRead() {
+    if (cache_entry_)
+      cache_entry_->Close();
+  }
+
+ private:
+  void OnOpened(int result) {
+    if (net::OK != result)
+      return Done();
+    int rv = cache_entry_->ReadData(1, 0, buffer_, entry_.data_len,
+                                    &read_callback_);
+    if (net::ERR_IO_PENDING != rv)
+      OnRead(rv);
+  }
+
+  void OnRead(int result) {
+    EXPECT_EQ(entry_.data_len, result);
+    Done();
+  }
+
+  void Done() {
+    if (!--*pending_)
+      MessageLoop::current()->Quit();
+  }
+
+  const TestEntry& entry_;
+  int* pending_;
+  disk_cache::Entry* cache_entry_;
+  scoped_refptr<net::IOBuffer> buffer_;
+  net::CompletionCallbackImpl<ParallelRead> open_callback_;
+  net::CompletionCallbackImpl<ParallelRead> read_callback_;
+
+  DISALLOW_COPY_AND_ASSIGN(ParallelRead);
+};
+
+// Reads the data of all the entries listed on |entries| at the same time.
+void TimeParallelRead(disk_cache::Backend* cache, const TestEntries& entries,
+                      const char* message) {
+  PerfTimeLogger timer(message);
+
+  int pending = 0;
+  std::vector<ParallelRead*> reads;
+  for (size_t i = 0; i < entries.size(); i++)
+    reads.push_back(new ParallelRead(cache, entries[i], &pending));
+
+  // Reads that complete right away never quit the loop.
+  if (pending)
+    MessageLoop::current()->Run();
+  timer.Done();
+
+  STLDeleteElements(&reads);
+}
+
+// Reads the data of |entry| the way the browser sends a response body to the
+// renderer: into a new shared memory segment for each read, starting with
+// |initial_size| bytes and doubling the size of the segment each time it is
+// filled, up to 512 KB. Returns the number of bytes read, or -1 on error.
+int ReadToSharedMemory(disk_cache::Entry* entry, int initial_size) {
+  const int kMaxBufferSize = 512 * 1024;
+  int buffer_size = initial_size;
+  int offset = 0;
+  for (;;) {
+    base::SharedMemory shared_memory;
+    if (!shared_memory.CreateAndMapAnonymous(buffer_size))
+      return -1;
+    scoped_refptr<net::IOBuffer> buffer(new net::WrappedIOBuffer(
+        static_cast<char*>(shared_memory.memory())));
+
+    TestCompletionCallback cb;
+    int rv = entry->ReadData(1, offset, buffer, buffer_size, &cb);
+    rv = cb.GetResult(rv);
+    if (rv <= 0)
+      return rv ? -1 : offset;
+
+    offset += rv;
+    if (rv == buffer_size)
+      buffer_size = std::min(buffer_size * 2, kMaxBufferSize);
+  }
+}
+
+// Reads the entry |key| as a large cached resource, and logs the throughput.
+void TimeLargeRead(disk_cache::Backend* cache, const std::string& key,
+                   int initial_size, const char* message) {
+  disk_cache::Entry* entry;
+  TestCompletionCallback cb;
+  int rv = cache->OpenEntry(key, &entry, &cb);
+  ASSERT_EQ(net::OK, cb.GetResult(rv));
+
+  PerfTimer timer;
+  int bytes_read = ReadToSharedMemory(entry, initial_size);
+  double seconds = timer.Elapsed().InSecondsF();
+  EXPECT_EQ(entry->GetDataSize(1), bytes_read);
+  entry->Close();
+
+  LogPerfResult(message, bytes_read / (1024.0 * 1024.0) / seconds, "MB/s");
+}
+
 int BlockSize() {
   // We can use form 1 to 4 blocks.
   return (rand() & 0x3) + 1;
@@ -207,6 +329,165 @@ TEST_F(DiskCacheTest, CacheBackendPerformance) {
   ret = TimeRead(num_entries, cache, entries, false);
   EXPECT_EQ(ret, g_cache_tests_received);
 
+  TimeParallelRead(cache, entries, "Read disk cache entries in parallel");
+
+  MessageLoop::current()->RunAllPending();
+  delete cache;
+}
+
+// Removes every file of the cache at |path| from the system cache.
+bool EvictCacheFilesFromSystemCache(const FilePath& path) {
+  file_util::FileEnumerator iter(path, false,
+                                 file_util::FileEnumerator::FILES);
+  for (FilePath file = iter.Next(); !file.value().empty(); file = iter.Next()) {
+    if (!file_util::EvictFileFromSystemCache(file))
+      return false;
+  }
+  return true;
+}
+
+// The same as CacheBackendPerformance, for the log structured cache.
+TEST_F(DiskCacheTest, LogBackendPerformance) {
+  MessageLoopForIO message_loop;
+
+  base::Thread cache_thread("CacheThread");
+  ASSERT_TRUE(cache_thread.StartWithOptions(
+                  base::Thread::Options(MessageLoop::TYPE_IO, 0)));
+
+  ScopedTestCache test_cache;
+  TestCompletionCallback cb;
+  disk_cache::Backend* cache;
+  int rv = disk_cache::LogBackendImpl::CreateBackend(
+               test_cache.path(), 0, cache_thread.message_loop_proxy(), NULL,
+               &cache, &cb);
+  ASSERT_EQ(net::OK, cb.GetResult(rv));
+
+  int seed = static_cast<int>(Time::Now().ToInternalValue());
+  srand(seed);
+
+  TestEntries entries;
+  int num_entries = 1000;
+
+  int ret = TimeWrite(num_entries, cache, &entries);
+  EXPECT_EQ(ret, g_cache_tests_received);
+
+  {
+    // Entries are written to disk as they are closed, on the cache thread.
+    // Operations complete in order, so this one waits for all the writes.
+    PerfTimeLogger timer("Flush log structured cache writes");
+    disk_cache::Entry* entry;
+    rv = cache->OpenEntry("not there", &entry, &cb);
+    EXPECT_NE(net::OK, cb.GetResult(rv));
+    timer.Done();
+  }
+
+  MessageLoop::current()->RunAllPending();
+  delete cache;
+
+  // Wait until the index is saved.
+  cache_thread.Stop();
+  ASSERT_TRUE(cache_thread.StartWithOptions(
+                  base::Thread::Options(MessageLoop::TYPE_IO, 0)));
+  ASSERT_TRUE(EvictCacheFilesFromSystemCache(test_cache.path()));
+
+  rv = disk_cache::LogBackendImpl::CreateBackend(
+           test_cache.path(), 0, cache_thread.message_loop_proxy(), NULL,
+           &cache, &cb);
+  ASSERT_EQ(net::OK, cb.GetResult(rv));
+
+  ret = TimeRead(num_entries, cache, entries, true);
+  EXPECT_EQ(ret, g_cache_tests_received);
+
+  ret = TimeRead(num_entries, cache, entries, false);
+  EXPECT_EQ(ret, g_cache_tests_received);
+
+  TimeParallelRead(cache, entries,
+                   "Read disk cache entries in parallel (log structured)");
+
+  MessageLoop::current()->RunAllPending();
+  delete cache;
+}
+
+// Measures the throughput of reading a large cached resource (as an image or
+// a media file), with the buffer sizes used for a response from the network
+// and for a response from the cache.
+TEST_F(DiskCacheTest, LargeEntryReadPerformance) {
+  MessageLoopForIO message_loop;
+
+  base::Thread cache_thread("CacheThread");
+  ASSERT_TRUE(cache_thread.StartWithOptions(
+                  base::Thread::Options(MessageLoop::TYPE_IO, 0)));
+
+  ScopedTestCache test_cache;
+  TestCompletionCallback cb;
+  disk_cache::Backend* cache;
+  int rv = disk_cache::CreateCacheBackend(
+               net::DISK_CACHE, test_cache.path(), 0, false,
+               cache_thread.message_loop_proxy(), NULL, &cache, &cb);
+  ASSERT_EQ(net::OK, cb.GetResult(rv));
+
+  const int kSize = 16 * 1024 * 1024;
+  const int kChunkSize = 1024 * 1024;
+  scoped_refptr<net::IOBuffer> buffer(new net::IOBuffer(kChunkSize));
+  CacheTestFillBuffer(buffer->data(), kChunkSize, false);
+
+  std::string key = GenerateKey(true);
+  disk_cache::Entry* entry;
+  rv = cache->CreateEntry(key, &entry, &cb);
+  ASSERT_EQ(net::OK, cb.GetResult(rv));
+  for (int offset = 0; offset < kSize; offset += kChunkSize) {
+    rv = entry->WriteData(1, offset, buffer, kChunkSize, &cb, false);
+    ASSERT_EQ(kChunkSize, cb.GetResult(rv));
+  }
+  entry->Close();
+
+  MessageLoop::current()->RunAllPending();
+  delete cache;
+  ASSERT_TRUE(EvictCacheFilesFromSystemCache(test_cache.path()));
+
+  rv = disk_cache::CreateCacheBackend(net::DISK_CACHE, test_cache.path(), 0,
+                                      false, cache_thread.message_loop_proxy(),
+                                      NULL, &cache, &cb);
+  ASSERT_EQ(net::OK, cb.GetResult(rv));
+
+  TimeLargeRead(cache, key, 512 * 1024, "Read large cache entry (cold)");
+  TimeLargeRead(cache, key, 32 * 1024,
+                "Read large cache entry (warm, growing buffers)");
+  TimeLargeRead(cache, key, 512 * 1024,
+                "Read large cache entry (warm, body sized buffers)");
+
+  MessageLoop::current()->RunAllPending();
+  delete cache;
+}
+
+// The same as CacheBackendPerformance, for a cache split in shards that serve
+// reads of different entries in parallel.
+TEST_F(DiskCacheTest, ShardedBackendPerformance) {
+  MessageLoopForIO message_loop;
+
+  ScopedTestCache test_cache;
+  TestCompletionCallback cb;
+  disk_cache::Backend* cache;
+  int rv = disk_cache::ShardedBackend::CreateBackend(
+               test_cache.path(), false, 0, net::DISK_CACHE, disk_cache::kNone,
+               0, NULL, &cache, &cb);
+  ASSERT_EQ(net::OK, cb.GetResult(rv));
+
+  int seed = static_cast<int>(Time::Now().ToInternalValue());
+  srand(seed);
+
+  TestEntries entries;
+  int num_entries = 1000;
+
+  int ret = TimeWrite(num_entries, cache, &entries);
+  EXPECT_EQ(ret, g_cache_tests_received);
+
+  ret = TimeRead(num_entries, cache, entries, false);
+  EXPECT_EQ(ret, g_cache_tests_received);
+
+  TimeParallelRead(cache, entries,
+                   "Read disk cache entries in parallel (sharded)");
+
   MessageLoop::current()->RunAllPending();
   delete cache;
 }
@@ -10,6 +10,7 @@
 #include "net/disk_cache/backend_impl.h"
 #include "net/disk_cache/disk_cache_test_util.h"
 #include "net/disk_cache/mem_backend_impl.h"
+#include "net/disk_cache/memory_tier_backend.h"
 
 void DiskCacheTest::TearDown() {
   MessageLoop::current()->RunAllPending();
@@ -29,6 +30,7 @@ DiskCacheTestWithCache::DiskCacheTestWithCache()
       first_cleanup_(true),
       integrity_(true),
       use_current_thread_(false),
+      memory_tier_(false),
       cache_thread_("CacheThread") {
 }
 
@@ -258,6 +260,9 @@ void DiskCacheTestWithCache::InitDiskCache() {
                path, force_creation_, size_, type_,
                disk_cache::kNoRandom, thread, NULL, &cache_, &cb);
   ASSERT_EQ(net::OK, cb.GetResult(rv));
+
+  if (memory_tier_)
+    cache_ = new disk_cache::MemoryTierBackend(cache_, 1024 * 1024);
 }
 
 void DiskCacheTestWithCache::InitDiskCacheImpl(const FilePath& path) {
@@ -87,6 +87,11 @@ class DiskCacheTestWithCache : public DiskCacheTest {
     type_ = type;
   }
 
+  // Puts a memory tier in front of the disk cache.
+  void SetMemoryTierMode() {
+    memory_tier_ = true;
+  }
+
   // Utility methods to access the cache and wait for each operation to finish.
   int OpenEntry(const std::string& key, disk_cache::Entry** entry);
   int CreateEntry(const std::string& key, disk_cache::Entry** entry);
@@ -134,6 +139,7 @@ class DiskCacheTestWithCache : public DiskCacheTest {
   bool first_cleanup_;
   bool integrity_;
   bool use_current_thread_;
+  bool memory_tier_;
   // This is intentionally left uninitialized, to be used by any test.
   bool success_;
 
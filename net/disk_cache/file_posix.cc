@@ -6,7 +6,9 @@
 
 #include <fcntl.h>
 
+#include "base/lazy_instance.h"
 #include "base/logging.h"
+#include "base/threading/thread_local.h"
 #include "base/threading/worker_pool.h"
 #include "net/disk_cache/disk_cache.h"
 #include "net/disk_cache/in_flight_io.h"
@@ -143,22 +145,28 @@ void FileInFlightIO::OnOperationComplete(disk_cache::BackgroundIO* operation,
   callback->OnFileIOComplete(bytes);
 }
 
-// A static object tha will broker all async operations.
-FileInFlightIO* s_file_operations = NULL;
+// The objects that broker all async operations, one per thread, as the
+// completion of an operation is delivered to the thread that started it and
+// a sharded cache has several cache threads.
+base::LazyInstance<base::ThreadLocalPointer<FileInFlightIO> >
+    g_file_operations(base::LINKER_INITIALIZED);
 
 // Returns the current FileInFlightIO.
 FileInFlightIO* GetFileInFlightIO() {
-  if (!s_file_operations) {
-    s_file_operations = new FileInFlightIO;
+  FileInFlightIO* file_operations = g_file_operations.Pointer()->Get();
+  if (!file_operations) {
+    file_operations = new FileInFlightIO;
+    g_file_operations.Pointer()->Set(file_operations);
   }
-  return s_file_operations;
+  return file_operations;
 }
 
 // Deletes the current FileInFlightIO.
 void DeleteFileInFlightIO() {
-  DCHECK(s_file_operations);
-  delete s_file_operations;
-  s_file_operations = NULL;
+  FileInFlightIO* file_operations = g_file_operations.Pointer()->Get();
+  DCHECK(file_operations);
+  delete file_operations;
+  g_file_operations.Pointer()->Set(NULL);
 }
 
 }  // namespace
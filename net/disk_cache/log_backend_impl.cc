@@ -0,0 +1,571 @@
+// Copyright (c) 2011 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/log_backend_impl.h"
+
+#include <algorithm>
+
+#include "base/compiler_specific.h"
+#include "base/logging.h"
+#include "base/message_loop_proxy.h"
+#include "base/string_number_conversions.h"
+#include "base/stringprintf.h"
+#include "base/sys_info.h"
+#include "base/task.h"
+#include "net/base/net_errors.h"
+#include "net/disk_cache/backend_impl.h"
+#include "net/disk_cache/log_entry_impl.h"
+
+using base::Time;
+
+namespace {
+
+// The size the cache settles for when it has to figure it out by itself is
+// capped at this value, as it is for BackendImpl.
+const int kMaxDefaultCacheSize = 4 * 80 * 1024 * 1024;
+
+// The state of an enumeration: the keys stored when it started, and how many
+// of them were returned already.
+struct LogIterator {
+  LogIterator() : listed(false), position(0) {}
+
+  bool listed;
+  size_t position;
+  std::vector<std::string> keys;
+};
+
+// Deletes the backend if the initialization fails, so that the caller never
+// gets a backend that cannot be used.
+class LogBackendCreator {
+ public:
+  LogBackendCreator(disk_cache::LogBackendImpl* cache,
+                    disk_cache::Backend** backend,
+                    disk_cache::CompletionCallback* callback)
+      : cache_(cache), backend_(backend), callback_(callback),
+        ALLOW_THIS_IN_INITIALIZER_LIST(
+            my_callback_(this, &LogBackendCreator::OnInitComplete)) {
+  }
+
+  int Run(int max_bytes) {
+    return cache_->Init(max_bytes, &my_callback_);
+  }
+
+ private:
+  void OnInitComplete(int result) {
+    if (result == net::OK) {
+      *backend_ = cache_;
+    } else {
+      LOG(ERROR) << "Unable to create cache";
+      delete cache_;
+    }
+
+    disk_cache::CompletionCallback* callback = callback_;
+    delete this;
+    callback->Run(result);
+  }
+
+  disk_cache::LogBackendImpl* cache_;
+  disk_cache::Backend** backend_;
+  disk_cache::CompletionCallback* callback_;
+  net::CompletionCallbackImpl<LogBackendCreator> my_callback_;
+
+  DISALLOW_COPY_AND_ASSIGN(LogBackendCreator);
+};
+
+}  // namespace
+
+namespace disk_cache {
+
+// An operation on the store, which runs on the cache thread and reports back
+// to the thread of the backend. Operations run in the order they are posted.
+class LogOperation : public base::RefCountedThreadSafe<LogOperation> {
+ public:
+  enum Type {
+    OP_INIT,
+    OP_OPEN,
+    OP_CREATE,
+    OP_OPEN_NEXT,
+    OP_READ_STREAM,
+    OP_WRITE,
+    OP_TOUCH,
+    OP_DOOM,
+    OP_DOOM_ALL,
+    OP_DOOM_BETWEEN
+  };
+
+  LogOperation(LogBackendImpl* backend, LogStore* store,
+               CompletionCallback* callback)
+      : backend_(backend), store_(store), callback_(callback), type_(OP_INIT),
+        entry_(NULL), iterator_(NULL), entry_impl_(NULL), stream_(0),
+        max_bytes_(0), result_(net::OK),
+        origin_thread_(base::MessageLoopProxy::CreateForCurrentThread()) {
+  }
+
+  // The operations.
+  void Init(const FilePath& path, int max_bytes) {
+    type_ = OP_INIT;
+    path_ = path;
+    max_bytes_ = max_bytes;
+  }
+  void OpenEntry(const std::string& key, Entry** entry) {
+    type_ = OP_OPEN;
+    key_ = key;
+    entry_ = entry;
+  }
+  void CreateEntry(const std::string& key, Entry** entry) {
+    type_ = OP_CREATE;
+    key_ = key;
+    entry_ = entry;
+  }
+  void OpenNextEntry(LogIterator* iterator, Entry** entry) {
+    type_ = OP_OPEN_NEXT;
+    iterator_ = iterator;
+    entry_ = entry;
+  }
+  // The data is left on record()->data[index].
+  void ReadStream(LogEntryImpl* entry, int index) {
+    type_ = OP_READ_STREAM;
+    key_ = entry->key();
+    entry_impl_ = entry;
+    stream_ = index;
+  }
+  // The record to write is set through record().
+  void WriteEntry() {
+    type_ = OP_WRITE;
+  }
+  void TouchEntry(const std::string& key, Time last_used) {
+    type_ = OP_TOUCH;
+    key_ = key;
+    initial_time_ = last_used;
+  }
+  void DoomEntry(const std::string& key) {
+    type_ = OP_DOOM;
+    key_ = key;
+  }
+  void DoomAllEntries() {
+    type_ = OP_DOOM_ALL;
+  }
+  void DoomEntriesBetween(Time initial_time, Time end_time) {
+    type_ = OP_DOOM_BETWEEN;
+    initial_time_ = initial_time;
+    end_time_ = end_time;
+  }
+
+  // Runs the operation on the cache thread.
+  void Run();
+
+  // Prevents the backend from being notified when the operation completes.
+  void Cancel() {
+    backend_ = NULL;
+  }
+
+  Type type() const { return type_; }
+  const std::string& key() const { return key_; }
+  LogRecord* record() { return &record_; }
+  Entry** entry() const { return entry_; }
+  LogEntryImpl* entry_impl() const { return entry_impl_; }
+  int stream() const { return stream_; }
+  CompletionCallback* callback() const { return callback_; }
+  int max_bytes() const { return max_bytes_; }
+  int result() const { return result_; }
+  const LogStoreStats& stats() const { return stats_; }
+
+ private:
+  friend class base::RefCountedThreadSafe<LogOperation>;
+  ~LogOperation() {}
+
+  void OnComplete() {
+    if (backend_)
+      backend_->OnOperationComplete(this);
+  }
+
+  LogBackendImpl* backend_;
+  LogStore* store_;
+  CompletionCallback* callback_;
+  Type type_;
+  FilePath path_;
+  std::string key_;
+  LogRecord record_;
+  Entry** entry_;
+  LogIterator* iterator_;
+  LogEntryImpl* entry_impl_;
+  int stream_;
+  Time initial_time_;
+  Time end_time_;
+  int max_bytes_;
+  int result_;
+  LogStoreStats stats_;
+  scoped_refptr<base::MessageLoopProxy> origin_thread_;
+
+  DISALLOW_COPY_AND_ASSIGN(LogOperation);
+};
+
+void LogOperation::Run() {
+  switch (type_) {
+    case OP_INIT:
+      if (!max_bytes_) {
+        max_bytes_ = kMaxDefaultCacheSize;
+        int64 available =
+            base::SysInfo::AmountOfFreeDiskSpace(path_.DirName());
+        if (available >= 0) {
+          max_bytes_ = std::min(PreferedCacheSize(available),
+                                kMaxDefaultCacheSize);
+        }
+      }
+      result_ = store_->Init(max_bytes_) ? net::OK : net::ERR_FAILED;
+      break;
+    case OP_OPEN:
+      if (!store_->ReadRecord(key_, true, &record_))
+        result_ = net::ERR_FAILED;
+      break;
+    case OP_CREATE:
+      if (store_->HasRecord(key_))
+        result_ = net::ERR_FAILED;
+      break;
+    case OP_OPEN_NEXT:
+      if (!iterator_->listed) {
+        store_->GetKeys(&iterator_->keys);
+        iterator_->listed = true;
+      }
+      result_ = net::ERR_FAILED;
+      while (iterator_->position < iterator_->keys.size()) {
+        const std::string& key = iterator_->keys[iterator_->position++];
+        if (store_->ReadRecord(key, false, &record_)) {
+          result_ = net::OK;
+          break;
+        }
+      }
+      break;
+    case OP_READ_STREAM:
+      if (!store_->ReadStream(key_, stream_, &record_.data[stream_]))
+        result_ = net::ERR_FAILED;
+      break;
+    case OP_WRITE:
+      if (!store_->WriteRecord(record_))
+        result_ = net::ERR_FAILED;
+      break;
+    case OP_TOUCH:
+      store_->TouchRecord(key_, initial_time_);
+      break;
+    case OP_DOOM:
+      if (!store_->RemoveRecord(key_))
+        result_ = net::ERR_FAILED;
+      break;
+    case OP_DOOM_ALL:
+      store_->RemoveAllRecords();
+      break;
+    case OP_DOOM_BETWEEN:
+      store_->RemoveRecordsBetween(initial_time_, end_time_);
+      break;
+    default:
+      NOTREACHED();
+  }
+
+  // There is no need to hold on to the data of the entry any longer.
+  if (type_ == OP_WRITE)
+    record_ = LogRecord();
+
+  store_->GetStats(&stats_);
+  origin_thread_->PostTask(FROM_HERE,
+                           NewRunnableMethod(this, &LogOperation::OnComplete));
+}
+
+// ------------------------------------------------------------------------
+
+LogBackendImpl::LogBackendImpl(const FilePath& path,
+                               base::MessageLoopProxy* cache_thread,
+                               net::NetLog* net_log)
+    : path_(path),
+      cache_thread_(cache_thread),
+      store_(new LogStore(path)),
+      max_size_(0),
+      net_log_(net_log) {
+}
+
+LogBackendImpl::~LogBackendImpl() {
+  // Save the entries still in use as they are now.
+  for (EntryMap::iterator it = open_entries_.begin();
+       it != open_entries_.end(); ++it) {
+    LogEntryImpl* entry = it->second;
+    if (entry->dirty()) {
+      LogOperation* operation = new LogOperation(this, store_, NULL);
+      operation->WriteEntry();
+      entry->CopyRecord(operation->record());
+      PostOperation(operation);
+    }
+    entry->OnBackendDestroyed();
+  }
+  open_entries_.clear();
+
+  for (std::set<LogOperation*>::iterator it = operations_.begin();
+       it != operations_.end(); ++it) {
+    (*it)->Cancel();
+  }
+
+  // The store writes the index as it goes away, after any pending work.
+  cache_thread_->DeleteSoon(FROM_HERE, store_);
+}
+
+// Static.
+int LogBackendImpl::CreateBackend(const FilePath& full_path, int max_bytes,
+                                  base::MessageLoopProxy* thread,
+                                  net::NetLog* net_log, Backend** backend,
+                                  CompletionCallback* callback) {
+  DCHECK(callback);
+  LogBackendImpl* cache = new LogBackendImpl(full_path, thread, net_log);
+  LogBackendCreator* creator = new LogBackendCreator(cache, backend, callback);
+  return creator->Run(max_bytes);
+}
+
+int LogBackendImpl::Init(int max_bytes, CompletionCallback* callback) {
+  LogOperation* operation = new LogOperation(this, store_, callback);
+  operation->Init(path_, max_bytes);
+  return PostOperation(operation);
+}
+
+int LogBackendImpl::MaxFileSize() const {
+  return max_size_ / 8;
+}
+
+void LogBackendImpl::InternalDoomEntry(LogEntryImpl* entry) {
+  DCHECK(!entry->doomed());
+  open_entries_.erase(entry->key());
+
+  // The entry stays usable, so its data has to be read before the removal
+  // reaches the store.
+  entry->LoadAllStreams();
+  entry->InternalDoom();
+}
+
+void LogBackendImpl::OnEntryClosed(LogEntryImpl* entry) {
+  if (entry->doomed())
+    return;
+
+  open_entries_.erase(entry->key());
+
+  LogOperation* operation = new LogOperation(this, store_, NULL);
+  if (entry->dirty()) {
+    operation->WriteEntry();
+    entry->ReleaseRecord(operation->record());
+  } else {
+    operation->TouchEntry(entry->key(), entry->GetLastUsed());
+  }
+  PostOperation(operation);
+}
+
+void LogBackendImpl::ReadStream(LogEntryImpl* entry, int index) {
+  LogOperation* operation = new LogOperation(this, store_, NULL);
+  operation->ReadStream(entry, index);
+  PostOperation(operation);
+}
+
+void LogBackendImpl::OnOperationComplete(LogOperation* operation) {
+  operations_.erase(operation);
+  stats_ = operation->stats();
+
+  int rv = operation->result();
+  switch (operation->type()) {
+    case LogOperation::OP_INIT:
+      if (rv == net::OK)
+        max_size_ = operation->max_bytes();
+      break;
+    case LogOperation::OP_OPEN:
+    case LogOperation::OP_CREATE:
+    case LogOperation::OP_OPEN_NEXT:
+      rv = FinishOpenOperation(operation);
+      break;
+    case LogOperation::OP_READ_STREAM:
+      operation->entry_impl()->OnStreamLoaded(
+          operation->stream(),
+          &operation->record()->data[operation->stream()], rv);
+      break;
+    default:
+      break;
+  }
+
+  // This object may be deleted by the callback.
+  if (operation->callback())
+    operation->callback()->Run(rv);
+}
+
+int32 LogBackendImpl::GetEntryCount() const {
+  return stats_.entry_count;
+}
+
+int LogBackendImpl::OpenEntry(const std::string& key, Entry** entry,
+                              CompletionCallback* callback) {
+  EntryMap::iterator it = open_entries_.find(key);
+  if (it != open_entries_.end()) {
+    it->second->Open();
+    *entry = it->second;
+    return net::OK;
+  }
+
+  LogOperation* operation = new LogOperation(this, store_, callback);
+  operation->OpenEntry(key, entry);
+  return PostOperation(operation);
+}
+
+int LogBackendImpl::CreateEntry(const std::string& key, Entry** entry,
+                                CompletionCallback* callback) {
+  if (open_entries_.find(key) != open_entries_.end())
+    return net::ERR_FAILED;
+
+  LogOperation* operation = new LogOperation(this, store_, callback);
+  operation->CreateEntry(key, entry);
+  return PostOperation(operation);
+}
+
+int LogBackendImpl::DoomEntry(const std::string& key,
+                              CompletionCallback* callback) {
+  EntryMap::iterator it = open_entries_.find(key);
+  if (it != open_entries_.end()) {
+    // The entry may not be on the store yet, but it exists.
+    InternalDoomEntry(it->second);
+    LogOperation* operation = new LogOperation(this, store_, NULL);
+    operation->DoomEntry(key);
+    PostOperation(operation);
+    return net::OK;
+  }
+
+  LogOperation* operation = new LogOperation(this, store_, callback);
+  operation->DoomEntry(key);
+  return PostOperation(operation);
+}
+
+int LogBackendImpl::DoomAllEntries(CompletionCallback* callback) {
+  DoomOpenEntriesBetween(Time(), Time());
+
+  LogOperation* operation = new LogOperation(this, store_, callback);
+  operation->DoomAllEntries();
+  return PostOperation(operation);
+}
+
+int LogBackendImpl::DoomEntriesBetween(const Time initial_time,
+                                       const Time end_time,
+                                       CompletionCallback* callback) {
+  DoomOpenEntriesBetween(initial_time, end_time);
+
+  LogOperation* operation = new LogOperation(this, store_, callback);
+  operation->DoomEntriesBetween(initial_time, end_time);
+  return PostOperation(operation);
+}
+
+int LogBackendImpl::DoomEntriesSince(const Time initial_time,
+                                     CompletionCallback* callback) {
+  return DoomEntriesBetween(initial_time, Time(), callback);
+}
+
+int LogBackendImpl::OpenNextEntry(void** iter, Entry** next_entry,
+                                  CompletionCallback* callback) {
+  LogIterator* iterator = static_cast<LogIterator*>(*iter);
+  if (!iterator) {
+    iterator = new LogIterator;
+    *iter = iterator;
+  }
+
+  LogOperation* operation = new LogOperation(this, store_, callback);
+  operation->OpenNextEntry(iterator, next_entry);
+  return PostOperation(operation);
+}
+
+void LogBackendImpl::EndEnumeration(void** iter) {
+  delete static_cast<LogIterator*>(*iter);
+  *iter = NULL;
+}
+
+void LogBackendImpl::GetStats(StatsItems* stats) {
+  std::pair<std::string, std::string> item;
+
+  item.first = "Entries";
+  item.second = base::StringPrintf("%d", stats_.entry_count);
+  stats->push_back(item);
+
+  item.first = "Max size";
+  item.second = base::StringPrintf("%d", max_size_);
+  stats->push_back(item);
+
+  item.first = "Segments";
+  item.second = base::StringPrintf("%d", stats_.segment_count);
+  stats->push_back(item);
+
+  item.first = "Disk size";
+  item.second = base::Int64ToString(stats_.disk_bytes);
+  stats->push_back(item);
+
+  item.first = "Live size";
+  item.second = base::Int64ToString(stats_.live_bytes);
+  stats->push_back(item);
+
+  item.first = "Bytes written";
+  item.second = base::Int64ToString(stats_.bytes_written);
+  stats->push_back(item);
+
+  item.first = "Bytes copied";
+  item.second = base::Int64ToString(stats_.bytes_copied);
+  stats->push_back(item);
+
+  item.first = "Evicted entries";
+  item.second = base::StringPrintf("%d", stats_.evicted_count);
+  stats->push_back(item);
+
+  item.first = "Checkpoints";
+  item.second = base::StringPrintf("%d", stats_.checkpoint_count);
+  stats->push_back(item);
+}
+
+int LogBackendImpl::PostOperation(LogOperation* operation) {
+  operations_.insert(operation);
+  cache_thread_->PostTask(FROM_HERE,
+                          NewRunnableMethod(operation, &LogOperation::Run));
+  return net::ERR_IO_PENDING;
+}
+
+int LogBackendImpl::FinishOpenOperation(LogOperation* operation) {
+  if (operation->result() != net::OK)
+    return net::ERR_FAILED;
+
+  LogRecord* record = operation->record();
+  const std::string& key = operation->type() == LogOperation::OP_CREATE ?
+                           operation->key() : record->key;
+
+  // Another operation may have opened the entry in the meantime.
+  EntryMap::iterator it = open_entries_.find(key);
+  if (it != open_entries_.end()) {
+    if (operation->type() == LogOperation::OP_CREATE)
+      return net::ERR_FAILED;
+    it->second->Open();
+    *operation->entry() = it->second;
+    return net::OK;
+  }
+
+  bool created = false;
+  if (operation->type() == LogOperation::OP_CREATE) {
+    created = true;
+    record->key = key;
+    record->last_used = record->last_modified = Time::Now();
+  }
+
+  LogEntryImpl* entry = new LogEntryImpl(this, record, created, net_log_);
+  open_entries_[entry->key()] = entry;
+  *operation->entry() = entry;
+  return net::OK;
+}
+
+void LogBackendImpl::DoomOpenEntriesBetween(Time initial_time, Time end_time) {
+  std::vector<LogEntryImpl*> doomed;
+  for (EntryMap::iterator it = open_entries_.begin();
+       it != open_entries_.end(); ++it) {
+    Time last_used = it->second->GetLastUsed();
+    if (last_used >= initial_time &&
+        (end_time.is_null() || last_used < end_time)) {
+      doomed.push_back(it->second);
+    }
+  }
+
+  for (size_t i = 0; i < doomed.size(); i++)
+    InternalDoomEntry(doomed[i]);
+}
+
+}  // namespace disk_cache
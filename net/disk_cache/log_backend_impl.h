@@ -0,0 +1,119 @@
+// Copyright (c) 2011 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// See net/disk_cache/disk_cache.h for the public interface of the cache.
+
+#ifndef NET_DISK_CACHE_LOG_BACKEND_IMPL_H_
+#define NET_DISK_CACHE_LOG_BACKEND_IMPL_H_
+#pragma once
+
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "base/file_path.h"
+#include "base/hash_tables.h"
+#include "base/memory/ref_counted.h"
+#include "net/disk_cache/disk_cache.h"
+#include "net/disk_cache/log_store.h"
+
+namespace base {
+class MessageLoopProxy;
+}
+
+namespace net {
+class NetLog;
+}
+
+namespace disk_cache {
+
+class LogEntryImpl;
+class LogOperation;
+
+// This class implements the Backend interface on top of a LogStore, a cache
+// that appends the streams of its entries to segment files instead of updating
+// blocks in place, for storage that copes badly with small random writes (see
+// log_store.h). The store lives on the cache thread, and every operation that
+// needs it completes asynchronously. Open entries are kept in memory (see
+// log_entry_impl.h).
+class LogBackendImpl : public Backend {
+ public:
+  LogBackendImpl(const FilePath& path, base::MessageLoopProxy* cache_thread,
+                 net::NetLog* net_log);
+  virtual ~LogBackendImpl();
+
+  // Returns a new log structured backend for the folder |full_path|, in the
+  // same way as BackendImpl::CreateBackend().
+  static int CreateBackend(const FilePath& full_path, int max_bytes,
+                           base::MessageLoopProxy* thread,
+                           net::NetLog* net_log, Backend** backend,
+                           CompletionCallback* callback);
+
+  // Performs general initialization for this current instance of the cache.
+  int Init(int max_bytes, CompletionCallback* callback);
+
+  // Returns the maximum size for a file to reside on the cache.
+  int MaxFileSize() const;
+
+  // Permanently deletes an entry, which may still be in use.
+  void InternalDoomEntry(LogEntryImpl* entry);
+
+  // Called when the last reference to |entry| goes away, to save it.
+  void OnEntryClosed(LogEntryImpl* entry);
+
+  // Reads the data of stream |index| of |entry| from the store, and hands it
+  // to LogEntryImpl::OnStreamLoaded().
+  void ReadStream(LogEntryImpl* entry, int index);
+
+  // Called when |operation| has run on the cache thread.
+  void OnOperationComplete(LogOperation* operation);
+
+  // Backend interface.
+  virtual int32 GetEntryCount() const;
+  virtual int OpenEntry(const std::string& key, Entry** entry,
+                        CompletionCallback* callback);
+  virtual int CreateEntry(const std::string& key, Entry** entry,
+                          CompletionCallback* callback);
+  virtual int DoomEntry(const std::string& key, CompletionCallback* callback);
+  virtual int DoomAllEntries(CompletionCallback* callback);
+  virtual int DoomEntriesBetween(const base::Time initial_time,
+                                 const base::Time end_time,
+                                 CompletionCallback* callback);
+  virtual int DoomEntriesSince(const base::Time initial_time,
+                               CompletionCallback* callback);
+  virtual int OpenNextEntry(void** iter, Entry** next_entry,
+                            CompletionCallback* callback);
+  virtual void EndEnumeration(void** iter);
+  virtual void GetStats(
+      std::vector<std::pair<std::string, std::string> >* stats);
+
+ private:
+  typedef base::hash_map<std::string, LogEntryImpl*> EntryMap;
+
+  // Sends |operation| to the cache thread.
+  int PostOperation(LogOperation* operation);
+
+  // Returns the result of |operation| that opens an entry, reusing the entry
+  // already open for the same key, if any.
+  int FinishOpenOperation(LogOperation* operation);
+
+  // Dooms the open entries last used between |initial_time| and |end_time|.
+  void DoomOpenEntriesBetween(base::Time initial_time, base::Time end_time);
+
+  FilePath path_;
+  scoped_refptr<base::MessageLoopProxy> cache_thread_;
+  LogStore* store_;  // Only used on the cache thread.
+  EntryMap open_entries_;
+  std::set<LogOperation*> operations_;  // Operations in progress.
+  LogStoreStats stats_;  // As of the last operation.
+  int max_size_;
+  net::NetLog* net_log_;
+
+  DISALLOW_COPY_AND_ASSIGN(LogBackendImpl);
+};
+
+}  // namespace disk_cache
+
+#endif  // NET_DISK_CACHE_LOG_BACKEND_IMPL_H_
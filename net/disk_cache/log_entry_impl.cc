@@ -0,0 +1,403 @@
+// Copyright (c) 2011 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/log_entry_impl.h"
+
+#include "base/logging.h"
+#include "net/base/io_buffer.h"
+#include "net/base/net_errors.h"
+#include "net/disk_cache/log_backend_impl.h"
+#include "net/disk_cache/net_log_parameters.h"
+
+using base::Time;
+
+namespace disk_cache {
+
+LogEntryImpl::PendingIO::PendingIO()
+    : write(false),
+      index(0),
+      offset(0),
+      buf_len(0),
+      truncate(false),
+      callback(NULL) {
+}
+
+LogEntryImpl::PendingIO::~PendingIO() {
+}
+
+LogEntryImpl::LogEntryImpl(LogBackendImpl* backend, LogRecord* record,
+                           bool created, net::NetLog* net_log)
+    : ref_count_(1),
+      backend_(backend),
+      doomed_(false) {
+  record_.key.swap(record->key);
+  record_.last_used = record->last_used;
+  record_.last_modified = record->last_modified;
+  for (int i = 0; i < LogRecord::kNumStreams; i++) {
+    record_.data_size[i] = record->data_size[i];
+    record_.has_data[i] = record->has_data[i] || !record->data_size[i];
+    record_.data[i].swap(record->data[i]);
+    dirty_[i] = created;
+    loading_[i] = false;
+  }
+
+  net_log_ = net::BoundNetLog::Make(net_log,
+                                    net::NetLog::SOURCE_DISK_CACHE_ENTRY);
+  net_log_.BeginEvent(
+      net::NetLog::TYPE_DISK_CACHE_ENTRY_IMPL,
+      make_scoped_refptr(new EntryCreationParameters(record_.key, created)));
+}
+
+void LogEntryImpl::Open() {
+  ref_count_++;
+  DCHECK(!doomed_);
+}
+
+void LogEntryImpl::InternalDoom() {
+  net_log_.AddEvent(net::NetLog::TYPE_ENTRY_DOOM, NULL);
+  doomed_ = true;
+}
+
+void LogEntryImpl::LoadAllStreams() {
+  for (int i = 0; i < LogRecord::kNumStreams; i++) {
+    if (!record_.has_data[i] && !loading_[i])
+      LoadStream(i);
+  }
+}
+
+void LogEntryImpl::OnStreamLoaded(int index, std::vector<char>* data,
+                                  int result) {
+  DCHECK(loading_[index]);
+  loading_[index] = false;
+  if (result == net::OK &&
+      data->size() == static_cast<size_t>(record_.data_size[index])) {
+    record_.data[index].swap(*data);
+    record_.has_data[index] = true;
+  } else {
+    result = net::ERR_FAILED;
+  }
+
+  std::list<PendingIO> waiting;
+  for (std::list<PendingIO>::iterator it = pending_io_.begin();
+       it != pending_io_.end();) {
+    std::list<PendingIO>::iterator current = it++;
+    if (current->index == index)
+      waiting.splice(waiting.end(), pending_io_, current);
+  }
+
+  // The callbacks may close the entry.
+  ref_count_++;
+  for (std::list<PendingIO>::iterator it = waiting.begin();
+       it != waiting.end(); ++it) {
+    int rv = result;
+    if (rv == net::OK && it->write) {
+      rv = InternalWriteData(index, it->offset, it->buf, it->buf_len,
+                             it->truncate);
+    } else if (rv == net::OK) {
+      rv = InternalReadData(index, it->offset, it->buf, it->buf_len);
+    }
+
+    if (net_log_.IsLoggingAllEvents()) {
+      net_log_.EndEvent(
+          it->write ? net::NetLog::TYPE_ENTRY_WRITE_DATA :
+                      net::NetLog::TYPE_ENTRY_READ_DATA,
+          make_scoped_refptr(new ReadWriteCompleteParameters(rv)));
+    }
+    if (it->callback)
+      it->callback->Run(rv);
+  }
+  Close();
+}
+
+void LogEntryImpl::OnBackendDestroyed() {
+  backend_ = NULL;
+
+  // The streams being read will never arrive.
+  pending_io_.clear();
+  for (int i = 0; i < LogRecord::kNumStreams; i++)
+    loading_[i] = false;
+  if (!ref_count_)
+    delete this;
+}
+
+bool LogEntryImpl::dirty() const {
+  for (int i = 0; i < LogRecord::kNumStreams; i++) {
+    if (dirty_[i])
+      return true;
+  }
+  return false;
+}
+
+void LogEntryImpl::CopyRecord(LogRecord* record) const {
+  record->key = record_.key;
+  record->last_used = record_.last_used;
+  record->last_modified = record_.last_modified;
+  for (int i = 0; i < LogRecord::kNumStreams; i++) {
+    record->data_size[i] = record_.data_size[i];
+    record->has_data[i] = dirty_[i];
+    if (dirty_[i])
+      record->data[i] = record_.data[i];
+  }
+}
+
+void LogEntryImpl::ReleaseRecord(LogRecord* record) {
+  DCHECK(!ref_count_);
+  record->key = record_.key;
+  record->last_used = record_.last_used;
+  record->last_modified = record_.last_modified;
+  for (int i = 0; i < LogRecord::kNumStreams; i++) {
+    record->data_size[i] = record_.data_size[i];
+    record->has_data[i] = dirty_[i];
+    if (dirty_[i])
+      record->data[i].swap(record_.data[i]);
+  }
+}
+
+// ------------------------------------------------------------------------
+
+void LogEntryImpl::Doom() {
+  if (doomed_)
+    return;
+
+  if (backend_)
+    backend_->DoomEntry(record_.key, NULL);
+  else
+    InternalDoom();
+}
+
+void LogEntryImpl::Close() {
+  ref_count_--;
+  DCHECK(ref_count_ >= 0);
+  if (ref_count_)
+    return;
+
+  // The reads and writes in progress complete even after the entry is
+  // closed, so it goes away once they do.
+  if (IsLoading())
+    return;
+
+  if (backend_)
+    backend_->OnEntryClosed(this);
+  delete this;
+}
+
+std::string LogEntryImpl::GetKey() const {
+  return record_.key;
+}
+
+Time LogEntryImpl::GetLastUsed() const {
+  return record_.last_used;
+}
+
+Time LogEntryImpl::GetLastModified() const {
+  return record_.last_modified;
+}
+
+int32 LogEntryImpl::GetDataSize(int index) const {
+  if (index < 0 || index >= LogRecord::kNumStreams)
+    return 0;
+  return record_.data_size[index];
+}
+
+int LogEntryImpl::ReadData(int index, int offset, net::IOBuffer* buf,
+    int buf_len, net::CompletionCallback* completion_callback) {
+  if (net_log_.IsLoggingAllEvents()) {
+    net_log_.BeginEvent(
+        net::NetLog::TYPE_ENTRY_READ_DATA,
+        make_scoped_refptr(
+            new ReadWriteDataParameters(index, offset, buf_len, false)));
+  }
+
+  if (WaitForStream(index, offset, buf_len, false, false)) {
+    PendingIO io;
+    io.index = index;
+    io.offset = offset;
+    io.buf = buf;
+    io.buf_len = buf_len;
+    io.callback = completion_callback;
+    pending_io_.push_back(io);
+    return net::ERR_IO_PENDING;
+  }
+
+  int result = InternalReadData(index, offset, buf, buf_len);
+
+  if (net_log_.IsLoggingAllEvents()) {
+    net_log_.EndEvent(
+        net::NetLog::TYPE_ENTRY_READ_DATA,
+        make_scoped_refptr(new ReadWriteCompleteParameters(result)));
+  }
+  return result;
+}
+
+int LogEntryImpl::WriteData(int index, int offset, net::IOBuffer* buf,
+    int buf_len, net::CompletionCallback* completion_callback, bool truncate) {
+  if (net_log_.IsLoggingAllEvents()) {
+    net_log_.BeginEvent(
+        net::NetLog::TYPE_ENTRY_WRITE_DATA,
+        make_scoped_refptr(
+            new ReadWriteDataParameters(index, offset, buf_len, truncate)));
+  }
+
+  if (WaitForStream(index, offset, buf_len, true, truncate)) {
+    PendingIO io;
+    io.write = true;
+    io.index = index;
+    io.offset = offset;
+    io.buf = buf;
+    io.buf_len = buf_len;
+    io.truncate = truncate;
+    io.callback = completion_callback;
+    pending_io_.push_back(io);
+    return net::ERR_IO_PENDING;
+  }
+
+  int result = InternalWriteData(index, offset, buf, buf_len, truncate);
+
+  if (net_log_.IsLoggingAllEvents()) {
+    net_log_.EndEvent(
+        net::NetLog::TYPE_ENTRY_WRITE_DATA,
+        make_scoped_refptr(new ReadWriteCompleteParameters(result)));
+  }
+  return result;
+}
+
+int LogEntryImpl::ReadSparseData(int64 offset, net::IOBuffer* buf,
+    int buf_len, net::CompletionCallback* completion_callback) {
+  return net::ERR_CACHE_OPERATION_NOT_SUPPORTED;
+}
+
+int LogEntryImpl::WriteSparseData(int64 offset, net::IOBuffer* buf,
+    int buf_len, net::CompletionCallback* completion_callback) {
+  return net::ERR_CACHE_OPERATION_NOT_SUPPORTED;
+}
+
+int LogEntryImpl::GetAvailableRange(int64 offset, int len, int64* start,
+                                    CompletionCallback* callback) {
+  return net::ERR_CACHE_OPERATION_NOT_SUPPORTED;
+}
+
+bool LogEntryImpl::CouldBeSparse() const {
+  return false;
+}
+
+int LogEntryImpl::ReadyForSparseIO(
+    net::CompletionCallback* completion_callback) {
+  return net::OK;
+}
+
+// ------------------------------------------------------------------------
+
+LogEntryImpl::~LogEntryImpl() {
+  net_log_.EndEvent(net::NetLog::TYPE_DISK_CACHE_ENTRY_IMPL, NULL);
+}
+
+bool LogEntryImpl::WaitForStream(int index, int offset, int buf_len,
+                                 bool write, bool truncate) {
+  if (index < 0 || index >= LogRecord::kNumStreams || !backend_)
+    return false;
+
+  // Keep the order of the operations on the stream.
+  if (loading_[index])
+    return true;
+  if (record_.has_data[index])
+    return false;
+
+  int entry_size = record_.data_size[index];
+  if (write) {
+    // Only a write that keeps some of the current data needs it.
+    if (offset <= 0 && (truncate || buf_len >= entry_size))
+      return false;
+  } else if (offset >= entry_size || offset < 0 || buf_len <= 0) {
+    return false;
+  }
+
+  LoadStream(index);
+  return true;
+}
+
+void LogEntryImpl::LoadStream(int index) {
+  DCHECK(!loading_[index]);
+  loading_[index] = true;
+  backend_->ReadStream(this, index);
+}
+
+bool LogEntryImpl::IsLoading() const {
+  for (int i = 0; i < LogRecord::kNumStreams; i++) {
+    if (loading_[i])
+      return true;
+  }
+  return false;
+}
+
+int LogEntryImpl::InternalReadData(int index, int offset, net::IOBuffer* buf,
+                                   int buf_len) {
+  if (index < 0 || index >= LogRecord::kNumStreams)
+    return net::ERR_INVALID_ARGUMENT;
+
+  int entry_size = GetDataSize(index);
+  if (offset >= entry_size || offset < 0 || !buf_len)
+    return 0;
+
+  if (buf_len < 0)
+    return net::ERR_INVALID_ARGUMENT;
+
+  if (offset + buf_len > entry_size)
+    buf_len = entry_size - offset;
+
+  // The stream could not be read from the store.
+  if (!record_.has_data[index])
+    return net::ERR_FAILED;
+
+  record_.last_used = Time::Now();
+
+  memcpy(buf->data(), &(record_.data[index])[offset], buf_len);
+  return buf_len;
+}
+
+int LogEntryImpl::InternalWriteData(int index, int offset, net::IOBuffer* buf,
+                                    int buf_len, bool truncate) {
+  if (index < 0 || index >= LogRecord::kNumStreams)
+    return net::ERR_INVALID_ARGUMENT;
+
+  if (offset < 0 || buf_len < 0)
+    return net::ERR_INVALID_ARGUMENT;
+
+  // Without a backend there is no limit to check, and nothing will be saved.
+  int max_file_size = backend_ ? backend_->MaxFileSize() : kint32max;
+
+  // offset of buf_len could be negative numbers.
+  if (offset > max_file_size || buf_len > max_file_size ||
+      offset + buf_len > max_file_size) {
+    return net::ERR_FAILED;
+  }
+
+  std::vector<char>& data = record_.data[index];
+  if (!record_.has_data[index]) {
+    // Nothing of the stream that could not be read from the store would be
+    // kept by this write.
+    if (offset > 0 || (!truncate && buf_len < record_.data_size[index]))
+      return net::ERR_FAILED;
+    data.clear();
+    record_.has_data[index] = true;
+  }
+
+  // Growing the stream fills any hole left by |offset| with zeros.
+  int entry_size = static_cast<int>(data.size());
+  if (entry_size < offset + buf_len || (truncate && entry_size > offset))
+    data.resize(offset + buf_len);
+  record_.data_size[index] = static_cast<int32>(data.size());
+
+  Time current = Time::Now();
+  record_.last_used = current;
+  record_.last_modified = current;
+  dirty_[index] = true;
+
+  if (!buf_len)
+    return 0;
+
+  memcpy(&data[offset], buf->data(), buf_len);
+  return buf_len;
+}
+
+}  // namespace disk_cache
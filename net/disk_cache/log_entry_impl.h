@@ -0,0 +1,145 @@
+// Copyright (c) 2011 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// See net/disk_cache/disk_cache.h for the public interface of the cache.
+
+#ifndef NET_DISK_CACHE_LOG_ENTRY_IMPL_H_
+#define NET_DISK_CACHE_LOG_ENTRY_IMPL_H_
+#pragma once
+
+#include <list>
+#include <string>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/memory/ref_counted.h"
+#include "net/base/io_buffer.h"
+#include "net/base/net_log.h"
+#include "net/disk_cache/disk_cache.h"
+#include "net/disk_cache/log_store.h"
+
+namespace disk_cache {
+
+class LogBackendImpl;
+
+// This class implements the Entry interface for the log structured cache.
+// The data of a stream is read from the store the first time it is needed,
+// and kept in memory while the entry is open, so that later reads and writes
+// complete right away. A write that replaces the whole stream does not need to
+// read it. When the last reference goes away, the backend appends the streams
+// that were modified to the log. Sparse data is not supported.
+class LogEntryImpl : public Entry {
+ public:
+  // Takes the contents of the entry from |record|, which may carry only the
+  // sizes of the streams. A |created| entry is written to the log when closed,
+  // even if no data is written to it.
+  LogEntryImpl(LogBackendImpl* backend, LogRecord* record, bool created,
+               net::NetLog* net_log);
+
+  // Adds a reference for a new user of the entry.
+  void Open();
+
+  // Marks the entry as removed from the cache, so that it is not saved.
+  void InternalDoom();
+
+  // Reads every stream that is not in memory yet, e.g. before the entry is
+  // removed from the store.
+  void LoadAllStreams();
+
+  // Called when the data of stream |index| has been read from the store.
+  // |data| is taken if the read succeeded.
+  void OnStreamLoaded(int index, std::vector<char>* data, int result);
+
+  // Called when the backend goes away before the entry is closed.
+  void OnBackendDestroyed();
+
+  const std::string& key() const { return record_.key; }
+  bool doomed() const { return doomed_; }
+
+  // Returns true if some stream has to be written.
+  bool dirty() const;
+
+  // Copies the streams that have to be written to |record|.
+  void CopyRecord(LogRecord* record) const;
+
+  // Gives away the streams that have to be written, to be saved.
+  void ReleaseRecord(LogRecord* record);
+
+  // Entry interface.
+  virtual void Doom();
+  virtual void Close();
+  virtual std::string GetKey() const;
+  virtual base::Time GetLastUsed() const;
+  virtual base::Time GetLastModified() const;
+  virtual int32 GetDataSize(int index) const;
+  virtual int ReadData(int index, int offset, net::IOBuffer* buf, int buf_len,
+                       net::CompletionCallback* completion_callback);
+  virtual int WriteData(int index, int offset, net::IOBuffer* buf, int buf_len,
+                        net::CompletionCallback* completion_callback,
+                        bool truncate);
+  virtual int ReadSparseData(int64 offset, net::IOBuffer* buf, int buf_len,
+                             net::CompletionCallback* completion_callback);
+  virtual int WriteSparseData(int64 offset, net::IOBuffer* buf, int buf_len,
+                              net::CompletionCallback* completion_callback);
+  virtual int GetAvailableRange(int64 offset, int len, int64* start,
+                                CompletionCallback* callback);
+  virtual bool CouldBeSparse() const;
+  virtual void CancelSparseIO() {}
+  virtual int ReadyForSparseIO(net::CompletionCallback* completion_callback);
+
+ private:
+  // A read or write waiting for its stream to be read from the store.
+  struct PendingIO {
+    PendingIO();
+    ~PendingIO();
+
+    bool write;
+    int index;
+    int offset;
+    scoped_refptr<net::IOBuffer> buf;
+    int buf_len;
+    bool truncate;
+    net::CompletionCallback* callback;
+  };
+
+  ~LogEntryImpl();
+
+  // Returns true if the operation described by the arguments has to wait for
+  // stream |index| to be read from the store, and starts reading it if needed.
+  bool WaitForStream(int index, int offset, int buf_len, bool write,
+                     bool truncate);
+
+  // Reads stream |index| from the store.
+  void LoadStream(int index);
+
+  // Returns true if a stream is being read from the store.
+  bool IsLoading() const;
+
+  // Do all the work for corresponding public functions.
+  int InternalReadData(int index, int offset, net::IOBuffer* buf, int buf_len);
+  int InternalWriteData(int index, int offset, net::IOBuffer* buf, int buf_len,
+                        bool truncate);
+
+  LogRecord record_;
+  int ref_count_;
+  LogBackendImpl* backend_;  // Back pointer to the cache.
+  bool doomed_;              // True if this entry was removed from the cache.
+
+  // True if the stream has to be written.
+  bool dirty_[LogRecord::kNumStreams];
+
+  // True if the stream is being read from the store.
+  bool loading_[LogRecord::kNumStreams];
+
+  // The reads and writes waiting for a stream, in the order they were issued.
+  std::list<PendingIO> pending_io_;
+
+  net::BoundNetLog net_log_;
+
+  DISALLOW_COPY_AND_ASSIGN(LogEntryImpl);
+};
+
+}  // namespace disk_cache
+
+#endif  // NET_DISK_CACHE_LOG_ENTRY_IMPL_H_
@@ -0,0 +1,833 @@
+// Copyright (c) 2011 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/log_store.h"
+
+#include <algorithm>
+
+#include "base/file_util.h"
+#include "base/logging.h"
+#include "base/pickle.h"
+#include "base/platform_file.h"
+#include "base/stringprintf.h"
+#include "net/disk_cache/cache_util.h"
+#include "net/disk_cache/file.h"
+#include "net/disk_cache/hash.h"
+
+using base::Time;
+
+namespace {
+
+const char kIndexName[] = "log_index";
+const char kTempIndexName[] = "log_index_tmp";
+
+const uint32 kIndexMagic = 0xC1F10601;
+const int kIndexVersion = 2;
+
+const uint32 kRecordMagic = 0xC1F10602;
+const uint32 kRemovalMagic = 0xC1F10603;
+
+// Segments are sized to a fraction of the cache, within these limits.
+const int kMinSegmentSize = 256 * 1024;
+const int kMaxSegmentSize = 8 * 1024 * 1024;
+const int kSegmentsPerCache = 16;
+
+// Reclaiming space starts when the segments go over the maximum size, and
+// goes on until they take kCleanTargetPercent of it. The oldest segment is
+// evicted instead of cleaned once the live records take more than
+// kEvictThresholdPercent.
+const int kCleanTargetPercent = 90;
+const int kEvictThresholdPercent = 80;
+
+// The index is written after appending this fraction of the maximum size.
+const int kCheckpointFraction = 4;
+
+// Set on every record of a write but the last one.
+const int32 kMoreStreamsFlag = 1;
+
+// Every record starts with this header, followed by the key and the data of
+// the stream.
+struct RecordHeader {
+  uint32 magic;
+  uint32 checksum;  // Of the rest of the record, after this field.
+  int32 key_len;
+  int32 stream;
+  int32 data_len;
+  int32 flags;
+  int64 last_modified;
+};
+COMPILE_ASSERT(sizeof(RecordHeader) == 32, bad_RecordHeader);
+
+const int kChecksumOffset = 2 * sizeof(uint32);
+
+uint32 RecordChecksum(const char* record, int32 record_size) {
+  return disk_cache::Hash(record + kChecksumOffset,
+                          record_size - kChecksumOffset);
+}
+
+// Returns the size of the record stored at |data|, or zero if there is no
+// valid record within the |available| bytes.
+int32 ValidateRecord(const char* data, int64 available) {
+  if (available < static_cast<int64>(sizeof(RecordHeader)))
+    return 0;
+
+  const RecordHeader* header = reinterpret_cast<const RecordHeader*>(data);
+  if (header->magic != kRecordMagic && header->magic != kRemovalMagic)
+    return 0;
+  if (header->key_len <= 0 || header->data_len < 0 || header->stream < 0 ||
+      header->stream >= disk_cache::LogRecord::kNumStreams) {
+    return 0;
+  }
+
+  int64 size = static_cast<int64>(sizeof(RecordHeader)) + header->key_len +
+               header->data_len;
+  if (size > available || size > kint32max)
+    return 0;
+
+  int32 record_size = static_cast<int32>(size);
+  if (header->checksum != RecordChecksum(data, record_size))
+    return 0;
+  return record_size;
+}
+
+// Appends to |buffer| a record for stream |index| of |record|, or a record
+// that removes the entry for |key| if |record| is NULL.
+void BuildRecord(const std::string& key, const disk_cache::LogRecord* record,
+                 int index, int32 flags, std::vector<char>* buffer) {
+  const std::vector<char>* stream = record ? &record->data[index] : NULL;
+
+  RecordHeader header;
+  memset(&header, 0, sizeof(header));
+  header.magic = record ? kRecordMagic : kRemovalMagic;
+  header.key_len = static_cast<int32>(key.size());
+  header.stream = index;
+  header.flags = flags;
+  if (record) {
+    header.data_len = static_cast<int32>(stream->size());
+    header.last_modified = record->last_modified.ToInternalValue();
+  }
+
+  size_t start = buffer->size();
+  size_t size = sizeof(header) + key.size() + header.data_len;
+  buffer->resize(start + size);
+  char* data = &(*buffer)[start];
+  memcpy(data, &header, sizeof(header));
+  memcpy(data + sizeof(header), key.data(), key.size());
+  if (header.data_len)
+    memcpy(data + sizeof(header) + key.size(), &(*stream)[0], stream->size());
+
+  reinterpret_cast<RecordHeader*>(data)->checksum =
+      RecordChecksum(data, static_cast<int32>(size));
+}
+
+}  // namespace
+
+namespace disk_cache {
+
+LogRecord::LogRecord() {
+  for (int i = 0; i < kNumStreams; i++) {
+    data_size[i] = 0;
+    has_data[i] = false;
+  }
+}
+
+LogRecord::~LogRecord() {
+}
+
+LogStoreStats::LogStoreStats()
+    : entry_count(0),
+      segment_count(0),
+      disk_bytes(0),
+      live_bytes(0),
+      bytes_written(0),
+      bytes_copied(0),
+      evicted_count(0),
+      checkpoint_count(0) {
+}
+
+LogStore::IndexEntry::IndexEntry()
+    : used(false), last_used(0), last_modified(0) {
+  memset(streams, 0, sizeof(streams));
+}
+
+LogStore::Segment::Segment() : size(0), live_bytes(0) {
+}
+
+LogStore::Segment::~Segment() {
+}
+
+LogStore::LogStore(const FilePath& path)
+    : path_(path),
+      head_(0),
+      checkpoint_head_(0),
+      bytes_since_checkpoint_(0),
+      index_dirty_(false),
+      max_size_(0),
+      segment_size_(kMinSegmentSize) {
+}
+
+LogStore::~LogStore() {
+  if (!max_size_)
+    return;  // Not initialized.
+
+  if (!Checkpoint())
+    LOG(WARNING) << "Unable to save the cache index.";
+}
+
+bool LogStore::Init(int max_bytes) {
+  DCHECK_GT(max_bytes, 0);
+  if (!file_util::CreateDirectory(path_))
+    return false;
+
+  max_size_ = max_bytes;
+  segment_size_ = std::max(kMinSegmentSize,
+                           std::min(kMaxSegmentSize,
+                                    max_bytes / kSegmentsPerCache));
+
+  int32 head;
+  int64 head_offset;
+  if (!LoadCheckpoint(&head, &head_offset)) {
+    // Without a checkpoint the old segments could bring back removed
+    // entries, so it is safer to start again.
+    return Reset();
+  }
+  head_ = head;
+  checkpoint_head_ = head;
+
+  // Replay whatever was appended after the checkpoint, stopping at the first
+  // segment that is not there.
+  for (int32 id = head; OpenSegment(id, false); id++) {
+    head_ = id;
+    if (!ReplaySegment(id, id == head ? head_offset : 0))
+      LOG(WARNING) << "Truncated cache segment " << id;
+  }
+
+  for (SegmentMap::iterator it = segments_.begin(); it != segments_.end();
+       ++it) {
+    stats_.disk_bytes += it->second.size;
+  }
+
+  // Save what was just replayed.
+  bool result = Checkpoint();
+  DeleteDeadSegments();
+  return result;
+}
+
+int LogStore::MaxFileSize() const {
+  return max_size_ / 8;
+}
+
+bool LogStore::HasRecord(const std::string& key) const {
+  return index_.find(key) != index_.end();
+}
+
+bool LogStore::ReadRecord(const std::string& key, bool update_last_used,
+                          LogRecord* record) {
+  Index::iterator it = index_.find(key);
+  if (it == index_.end())
+    return false;
+
+  IndexEntry& entry = it->second;
+  if (update_last_used) {
+    entry.used = true;
+    entry.last_used = Time::Now().ToInternalValue();
+    index_dirty_ = true;
+  }
+
+  record->key = key;
+  record->last_used = Time::FromInternalValue(entry.last_used);
+  record->last_modified = Time::FromInternalValue(entry.last_modified);
+  for (int i = 0; i < LogRecord::kNumStreams; i++) {
+    int32 size = entry.streams[i].size;
+    record->data_size[i] = size ? size - static_cast<int32>(
+                                      sizeof(RecordHeader) + key.size()) : 0;
+    record->has_data[i] = false;
+    record->data[i].clear();
+  }
+  return true;
+}
+
+bool LogStore::ReadStream(const std::string& key, int index,
+                          std::vector<char>* data) {
+  DCHECK(index >= 0 && index < LogRecord::kNumStreams);
+  Index::iterator it = index_.find(key);
+  if (it == index_.end())
+    return false;
+
+  data->clear();
+  StreamLocation location = it->second.streams[index];
+  if (!location.size)
+    return true;
+
+  SegmentMap::iterator segment = segments_.find(location.segment);
+  DCHECK(segment != segments_.end());
+
+  std::vector<char> buffer(location.size);
+  if (!segment->second.file->Read(&buffer[0], location.size,
+                                  location.offset) ||
+      ValidateRecord(&buffer[0], location.size) != location.size) {
+    LOG(WARNING) << "Invalid cache record.";
+    RemoveFromIndex(it);
+    return false;
+  }
+
+  const RecordHeader* header =
+      reinterpret_cast<const RecordHeader*>(&buffer[0]);
+  const char* stored = &buffer[0] + sizeof(RecordHeader);
+  if (header->magic != kRecordMagic || header->stream != index ||
+      key.compare(0, std::string::npos, stored, header->key_len)) {
+    RemoveFromIndex(it);
+    return false;
+  }
+  stored += header->key_len;
+
+  data->assign(stored, stored + header->data_len);
+  return true;
+}
+
+bool LogStore::WriteRecord(const LogRecord& record) {
+  int last_stream = -1;
+  int num_streams = 0;
+  for (int i = 0; i < LogRecord::kNumStreams; i++) {
+    if (record.has_data[i]) {
+      last_stream = i;
+      num_streams++;
+    }
+  }
+  DCHECK(num_streams);
+  if (!num_streams ||
+      (num_streams < LogRecord::kNumStreams && !HasRecord(record.key))) {
+    return false;
+  }
+
+  std::vector<char> buffer;
+  int32 starts[LogRecord::kNumStreams];
+  int32 sizes[LogRecord::kNumStreams];
+  for (int i = 0; i < LogRecord::kNumStreams; i++) {
+    if (!record.has_data[i])
+      continue;
+    starts[i] = static_cast<int32>(buffer.size());
+    BuildRecord(record.key, &record, i,
+                i == last_stream ? 0 : kMoreStreamsFlag, &buffer);
+    sizes[i] = static_cast<int32>(buffer.size()) - starts[i];
+  }
+
+  int32 segment, offset;
+  if (!Append(&buffer[0], static_cast<int32>(buffer.size()), &segment,
+              &offset)) {
+    return false;
+  }
+
+  IndexEntry& entry = index_[record.key];
+  for (int i = 0; i < LogRecord::kNumStreams; i++) {
+    if (record.has_data[i])
+      SetLocation(&entry, i, segment, offset + starts[i], sizes[i]);
+  }
+  entry.used = false;
+  entry.last_used = record.last_used.ToInternalValue();
+  entry.last_modified = record.last_modified.ToInternalValue();
+
+  CollectGarbage();
+  if (bytes_since_checkpoint_ > max_size_ / kCheckpointFraction)
+    Checkpoint();
+  return true;
+}
+
+void LogStore::TouchRecord(const std::string& key, Time last_used) {
+  Index::iterator it = index_.find(key);
+  if (it == index_.end())
+    return;
+
+  it->second.used = true;
+  it->second.last_used = last_used.ToInternalValue();
+  index_dirty_ = true;
+}
+
+bool LogStore::RemoveRecord(const std::string& key) {
+  Index::iterator it = index_.find(key);
+  if (it == index_.end())
+    return false;
+
+  RemoveFromIndex(it);
+  AppendRemoval(key);
+  return true;
+}
+
+void LogStore::RemoveRecordsBetween(Time initial_time, Time end_time) {
+  int64 initial = initial_time.ToInternalValue();
+  int64 end = end_time.is_null() ? kint64max : end_time.ToInternalValue();
+
+  bool removed = false;
+  for (Index::iterator it = index_.begin(); it != index_.end();) {
+    Index::iterator current = it++;
+    if (current->second.last_used >= initial &&
+        current->second.last_used < end) {
+      RemoveFromIndex(current);
+      removed = true;
+    }
+  }
+
+  // A checkpoint is cheaper than a removal record for every entry.
+  if (removed)
+    Checkpoint();
+}
+
+void LogStore::RemoveAllRecords() {
+  if (!Reset())
+    LOG(WARNING) << "Unable to reset the cache.";
+}
+
+void LogStore::GetKeys(std::vector<std::string>* keys) const {
+  keys->reserve(keys->size() + index_.size());
+  for (Index::const_iterator it = index_.begin(); it != index_.end(); ++it)
+    keys->push_back(it->first);
+}
+
+bool LogStore::Checkpoint() {
+  if (!index_dirty_ && checkpoint_head_ == head_)
+    return true;
+
+  SegmentMap::iterator head = segments_.find(head_);
+  int64 head_offset = head == segments_.end() ? 0 : head->second.size;
+
+  Pickle pickle;
+  pickle.WriteUInt32(kIndexMagic);
+  pickle.WriteInt(kIndexVersion);
+  pickle.WriteInt(head_);
+  pickle.WriteInt64(head_offset);
+
+  pickle.WriteInt(static_cast<int>(segments_.size()));
+  for (SegmentMap::iterator it = segments_.begin(); it != segments_.end(); ++it)
+    pickle.WriteInt(it->first);
+
+  pickle.WriteInt(static_cast<int>(index_.size()));
+  for (Index::iterator it = index_.begin(); it != index_.end(); ++it) {
+    const IndexEntry& entry = it->second;
+    pickle.WriteString(it->first);
+    pickle.WriteBool(entry.used);
+    pickle.WriteInt64(entry.last_used);
+    pickle.WriteInt64(entry.last_modified);
+    for (int i = 0; i < LogRecord::kNumStreams; i++) {
+      pickle.WriteInt(entry.streams[i].segment);
+      pickle.WriteInt(entry.streams[i].offset);
+      pickle.WriteInt(entry.streams[i].size);
+    }
+  }
+
+  std::string data(static_cast<const char*>(pickle.data()), pickle.size());
+  uint32 checksum = Hash(data);
+  data.append(reinterpret_cast<const char*>(&checksum), sizeof(checksum));
+
+  FilePath temp_name = path_.AppendASCII(kTempIndexName);
+  int size = static_cast<int>(data.size());
+  if (file_util::WriteFile(temp_name, data.data(), size) != size ||
+      !file_util::ReplaceFile(temp_name, path_.AppendASCII(kIndexName))) {
+    return false;
+  }
+
+  checkpoint_head_ = head_;
+  bytes_since_checkpoint_ = 0;
+  index_dirty_ = false;
+  stats_.checkpoint_count++;
+  DeleteDeadSegments();
+  return true;
+}
+
+void LogStore::GetStats(LogStoreStats* stats) const {
+  *stats = stats_;
+  stats->entry_count = static_cast<int32>(index_.size());
+  stats->segment_count = static_cast<int>(segments_.size());
+}
+
+FilePath LogStore::GetSegmentName(int32 id) const {
+  return path_.AppendASCII(base::StringPrintf("log_data_%d", id));
+}
+
+LogStore::Segment* LogStore::OpenSegment(int32 id, bool create) {
+  SegmentMap::iterator it = segments_.find(id);
+  if (it != segments_.end())
+    return &it->second;
+
+  int flags = base::PLATFORM_FILE_READ |
+              base::PLATFORM_FILE_WRITE |
+              base::PLATFORM_FILE_EXCLUSIVE_WRITE;
+  flags |= create ? base::PLATFORM_FILE_CREATE_ALWAYS :
+                    base::PLATFORM_FILE_OPEN;
+  scoped_refptr<File> file(new File(
+      base::CreatePlatformFile(GetSegmentName(id), flags, NULL, NULL)));
+  if (!file->IsValid())
+    return NULL;
+
+  Segment& segment = segments_[id];
+  segment.file = file;
+  segment.size = create ? 0 : file->GetLength();
+  return &segment;
+}
+
+bool LogStore::LoadCheckpoint(int32* head, int64* head_offset) {
+  std::string data;
+  if (!file_util::ReadFileToString(path_.AppendASCII(kIndexName), &data) ||
+      data.size() <= sizeof(uint32)) {
+    return false;
+  }
+
+  uint32 checksum;
+  size_t pickle_size = data.size() - sizeof(checksum);
+  memcpy(&checksum, data.data() + pickle_size, sizeof(checksum));
+  if (checksum != Hash(data.data(), pickle_size))
+    return false;
+
+  Pickle pickle(data.data(), static_cast<int>(pickle_size));
+  void* iter = NULL;
+  uint32 magic;
+  int version, num_segments;
+  if (!pickle.ReadUInt32(&iter, &magic) || magic != kIndexMagic ||
+      !pickle.ReadInt(&iter, &version) || version != kIndexVersion ||
+      !pickle.ReadInt(&iter, head) || *head < 0 ||
+      !pickle.ReadInt64(&iter, head_offset) || *head_offset < 0 ||
+      !pickle.ReadInt(&iter, &num_segments) || num_segments < 0) {
+    return false;
+  }
+
+  for (int i = 0; i < num_segments; i++) {
+    int id;
+    if (!pickle.ReadInt(&iter, &id))
+      return false;
+
+    // A missing segment was reclaimed after the checkpoint, and so were the
+    // entries stored there.
+    OpenSegment(id, false);
+  }
+
+  int num_entries;
+  if (!pickle.ReadInt(&iter, &num_entries) || num_entries < 0)
+    return false;
+
+  for (int i = 0; i < num_entries; i++) {
+    std::string key;
+    IndexEntry loaded;
+    bool valid = pickle.ReadString(&iter, &key) &&
+                 pickle.ReadBool(&iter, &loaded.used) &&
+                 pickle.ReadInt64(&iter, &loaded.last_used) &&
+                 pickle.ReadInt64(&iter, &loaded.last_modified);
+    for (int j = 0; valid && j < LogRecord::kNumStreams; j++) {
+      StreamLocation& location = loaded.streams[j];
+      valid = pickle.ReadInt(&iter, &location.segment) &&
+              pickle.ReadInt(&iter, &location.offset) &&
+              pickle.ReadInt(&iter, &location.size);
+    }
+    if (!valid) {
+      index_.clear();
+      segments_.clear();
+      return false;
+    }
+
+    for (int j = 0; valid && j < LogRecord::kNumStreams; j++) {
+      const StreamLocation& location = loaded.streams[j];
+      if (!location.size)
+        continue;
+      Segment* stored = OpenSegment(location.segment, false);
+      valid = stored && location.offset >= 0 &&
+              location.size >= static_cast<int>(sizeof(RecordHeader)) &&
+              location.offset + static_cast<int64>(location.size) <=
+                  stored->size;
+    }
+    if (!valid)
+      continue;
+
+    IndexEntry& entry = index_[key];
+    for (int j = 0; j < LogRecord::kNumStreams; j++) {
+      const StreamLocation& location = loaded.streams[j];
+      if (location.size) {
+        SetLocation(&entry, j, location.segment, location.offset,
+                    location.size);
+      }
+    }
+    entry.used = loaded.used;
+    entry.last_used = loaded.last_used;
+    entry.last_modified = loaded.last_modified;
+  }
+
+  // Dropping the entries of missing segments does not need to be saved.
+  index_dirty_ = false;
+  return true;
+}
+
+bool LogStore::ReplaySegment(int32 id, int64 offset) {
+  Segment& segment = segments_[id];
+  if (offset >= segment.size)
+    return true;
+
+  int64 length = segment.size - offset;
+  std::vector<char> buffer(static_cast<size_t>(length));
+  if (!segment.file->Read(&buffer[0], buffer.size(),
+                          static_cast<size_t>(offset))) {
+    return false;
+  }
+
+  // The records of the write being replayed, by stream. They are only
+  // applied once the last one is found.
+  std::string write_key;
+  std::vector<std::pair<int, StreamLocation> > write;
+
+  int64 position = 0;
+  while (position < length) {
+    const char* data = &buffer[0] + position;
+    int32 size = ValidateRecord(data, length - position);
+    if (!size) {
+      // The end of the log, most likely a record cut short by a crash. The
+      // rest of the write that it belongs to is dropped as well.
+      segment.size = offset + position;
+      segment.file->SetLength(static_cast<size_t>(segment.size));
+      return false;
+    }
+
+    const RecordHeader* header = reinterpret_cast<const RecordHeader*>(data);
+    std::string key(data + sizeof(RecordHeader), header->key_len);
+    StreamLocation location;
+    location.segment = id;
+    location.offset = static_cast<int32>(offset + position);
+    location.size = size;
+    position += size;
+    bytes_since_checkpoint_ += size;
+
+    if (header->magic == kRemovalMagic) {
+      write.clear();
+      Index::iterator it = index_.find(key);
+      if (it != index_.end())
+        RemoveFromIndex(it);
+      continue;
+    }
+
+    if (key != write_key)
+      write.clear();
+    write_key = key;
+    write.push_back(std::make_pair(header->stream, location));
+    if (header->flags & kMoreStreamsFlag)
+      continue;
+
+    // A write that leaves some streams out updates an entry that is gone.
+    if (write.size() == static_cast<size_t>(LogRecord::kNumStreams) ||
+        HasRecord(key)) {
+      IndexEntry& entry = index_[key];
+      for (size_t i = 0; i < write.size(); i++) {
+        const StreamLocation& stored = write[i].second;
+        SetLocation(&entry, write[i].first, stored.segment, stored.offset,
+                    stored.size);
+      }
+      entry.used = false;
+      entry.last_used = header->last_modified;
+      entry.last_modified = header->last_modified;
+    }
+    write.clear();
+  }
+  return true;
+}
+
+bool LogStore::Reset() {
+  index_.clear();
+  segments_.clear();
+  DeleteCache(path_, false);
+
+  int64 bytes_written = stats_.bytes_written;
+  int64 bytes_copied = stats_.bytes_copied;
+  stats_ = LogStoreStats();
+  stats_.bytes_written = bytes_written;
+  stats_.bytes_copied = bytes_copied;
+
+  head_ = checkpoint_head_ = 0;
+  bytes_since_checkpoint_ = 0;
+  index_dirty_ = true;
+  return Checkpoint();
+}
+
+bool LogStore::Append(const char* data, int32 record_size, int32* segment,
+                      int32* offset) {
+  Segment* head = OpenSegment(head_, true);
+  if (head && head->size &&
+      head->size + record_size > static_cast<int64>(segment_size_)) {
+    head_++;
+    head = OpenSegment(head_, true);
+  }
+  if (!head)
+    return false;
+
+  if (!head->file->Write(data, record_size,
+                         static_cast<size_t>(head->size))) {
+    return false;
+  }
+
+  *segment = head_;
+  *offset = static_cast<int32>(head->size);
+  head->size += record_size;
+  stats_.disk_bytes += record_size;
+  stats_.bytes_written += record_size;
+  bytes_since_checkpoint_ += record_size;
+  return true;
+}
+
+void LogStore::SetLocation(IndexEntry* entry, int index, int32 segment,
+                           int32 offset, int32 size) {
+  StreamLocation& location = entry->streams[index];
+  if (location.size) {
+    segments_[location.segment].live_bytes -= location.size;
+    stats_.live_bytes -= location.size;
+  }
+
+  location.segment = segment;
+  location.offset = offset;
+  location.size = size;
+  segments_[segment].live_bytes += size;
+  stats_.live_bytes += size;
+  index_dirty_ = true;
+}
+
+void LogStore::RemoveFromIndex(Index::iterator it) {
+  for (int i = 0; i < LogRecord::kNumStreams; i++) {
+    const StreamLocation& location = it->second.streams[i];
+    if (!location.size)
+      continue;
+    segments_[location.segment].live_bytes -= location.size;
+    stats_.live_bytes -= location.size;
+  }
+  index_.erase(it);
+  index_dirty_ = true;
+}
+
+void LogStore::AppendRemoval(const std::string& key) {
+  std::vector<char> buffer;
+  BuildRecord(key, NULL, 0, 0, &buffer);
+
+  int32 segment, offset;
+  if (!Append(&buffer[0], static_cast<int32>(buffer.size()), &segment,
+              &offset)) {
+    // Make sure that the entry is not found again when the log is replayed.
+    Checkpoint();
+  }
+}
+
+void LogStore::CollectGarbage() {
+  if (stats_.disk_bytes <= max_size_)
+    return;
+
+  int64 target = static_cast<int64>(max_size_) * kCleanTargetPercent / 100;
+  int64 evict_threshold =
+      static_cast<int64>(max_size_) * kEvictThresholdPercent / 100;
+
+  // Every segment is cleaned at most twice: the first pass of an eviction
+  // may only remove the second chance of its records.
+  size_t attempts = segments_.size() * 2;
+  while (stats_.disk_bytes > target && attempts--) {
+    bool evict = stats_.live_bytes > evict_threshold;
+
+    // The segments written after the last checkpoint may have records that
+    // remove older entries, so they are not reclaimed.
+    int32 victim = -1;
+    for (SegmentMap::iterator it = segments_.begin();
+         it != segments_.end() && it->first < checkpoint_head_; ++it) {
+      if (evict) {
+        victim = it->first;
+        break;
+      }
+      if (victim < 0 || it->second.live_bytes < segments_[victim].live_bytes)
+        victim = it->first;
+    }
+
+    if (victim < 0) {
+      // Moving the checkpoint makes the segments behind the head eligible.
+      if (head_ == checkpoint_head_ || !Checkpoint())
+        return;
+      continue;
+    }
+
+    if (!CleanSegment(victim, evict))
+      return;
+    DeleteSegment(victim);
+  }
+}
+
+bool LogStore::CleanSegment(int32 segment, bool evict) {
+  // Copy the records in the order they are stored.
+  typedef std::map<int32, std::pair<std::string, int> > Records;
+  Records records;
+  for (Index::iterator it = index_.begin(); it != index_.end(); ++it) {
+    for (int i = 0; i < LogRecord::kNumStreams; i++) {
+      const StreamLocation& location = it->second.streams[i];
+      if (location.size && location.segment == segment)
+        records[location.offset] = std::make_pair(it->first, i);
+    }
+  }
+
+  File* file = segments_[segment].file;
+  std::vector<char> buffer;
+  std::vector<std::string> copied;
+  for (Records::iterator record = records.begin(); record != records.end();
+       ++record) {
+    const std::string& key = record->second.first;
+    int index = record->second.second;
+    Index::iterator it = index_.find(key);
+    if (it == index_.end())
+      continue;  // Another stream of the entry was dropped already.
+
+    if (evict && !it->second.used) {
+      RemoveFromIndex(it);
+      stats_.evicted_count++;
+      continue;
+    }
+
+    StreamLocation location = it->second.streams[index];
+    buffer.resize(location.size);
+    if (!file->Read(&buffer[0], location.size, location.offset) ||
+        ValidateRecord(&buffer[0], location.size) != location.size) {
+      RemoveFromIndex(it);
+      continue;
+    }
+
+    // The copy does not take the rest of its write along, so it must be
+    // replayed on its own.
+    RecordHeader* header = reinterpret_cast<RecordHeader*>(&buffer[0]);
+    if (header->flags & kMoreStreamsFlag) {
+      header->flags &= ~kMoreStreamsFlag;
+      header->checksum = RecordChecksum(&buffer[0], location.size);
+    }
+
+    int32 new_segment, new_offset;
+    if (!Append(&buffer[0], location.size, &new_segment, &new_offset))
+      return false;
+    SetLocation(&it->second, index, new_segment, new_offset, location.size);
+    stats_.bytes_copied += location.size;
+    copied.push_back(key);
+  }
+
+  // Moving an entry uses up its second chance, but only once all of its
+  // streams have been moved.
+  for (size_t i = 0; i < copied.size(); i++) {
+    Index::iterator it = index_.find(copied[i]);
+    if (it != index_.end())
+      it->second.used = false;
+  }
+  return true;
+}
+
+void LogStore::DeleteDeadSegments() {
+  for (SegmentMap::iterator it = segments_.begin();
+       it != segments_.end() && it->first < checkpoint_head_;) {
+    SegmentMap::iterator current = it++;
+    if (!current->second.live_bytes)
+      DeleteSegment(current->first);
+  }
+}
+
+void LogStore::DeleteSegment(int32 id) {
+  SegmentMap::iterator it = segments_.find(id);
+  DCHECK(it != segments_.end());
+  DCHECK(!it->second.live_bytes);
+
+  stats_.disk_bytes -= it->second.size;
+  segments_.erase(it);
+  if (!DeleteCacheFile(GetSegmentName(id)))
+    LOG(WARNING) << "Unable to delete cache segment " << id;
+}
+
+}  // namespace disk_cache
@@ -0,0 +1,233 @@
+// Copyright (c) 2011 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// See net/disk_cache/disk_cache.h for the public interface of the cache.
+
+#ifndef NET_DISK_CACHE_LOG_STORE_H_
+#define NET_DISK_CACHE_LOG_STORE_H_
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/file_path.h"
+#include "base/hash_tables.h"
+#include "base/memory/ref_counted.h"
+#include "base/time.h"
+
+namespace disk_cache {
+
+class File;
+
+// The contents of an entry of the log structured cache.
+struct LogRecord {
+  enum {
+    kNumStreams = 3
+  };
+
+  LogRecord();
+  ~LogRecord();
+
+  std::string key;
+  base::Time last_used;
+  base::Time last_modified;
+
+  // The size of every stream, even when its data is not here.
+  int32 data_size[kNumStreams];
+
+  // Whether data[i] holds stream i. A record read from the store carries no
+  // data, and a record to write carries only the streams that changed.
+  bool has_data[kNumStreams];
+  std::vector<char> data[kNumStreams];
+};
+
+// Counters describing the state of a LogStore.
+struct LogStoreStats {
+  LogStoreStats();
+
+  int32 entry_count;
+  int segment_count;
+  int64 disk_bytes;     // Size of all the segment files.
+  int64 live_bytes;     // Size of the records still in the index.
+  int64 bytes_written;  // Bytes appended since the store was opened...
+  int64 bytes_copied;   // ... and how many of them moved live records.
+  int evicted_count;
+  int checkpoint_count;
+};
+
+// This class stores the entries of the log structured cache. Every version of
+// a stream of an entry is appended as a record to the segment file at the head
+// of the log, so the disk only sees large sequential writes instead of the
+// small random updates of the block files. An in-memory index maps each key to
+// the location of the latest record of each stream. Rewriting one stream, as
+// the HTTP cache does with the headers of a response validated by the server,
+// appends only that stream, and reading one stream reads only its record.
+// The records of the streams written together are appended together, and are
+// only replayed if none of them was cut short.
+//
+// The index is checkpointed to disk only once enough data has been appended
+// since the last checkpoint, or when the store is closed. Opening the store
+// loads the checkpoint and replays the records appended after it; a record cut
+// short by a crash ends the log. Removing an entry appends a small record as
+// well, so that the replay does not bring the entry back.
+//
+// Space is reclaimed a segment at a time, once the segments take more than
+// the maximum size. If the live records fit well below the limit, the segment
+// with the fewest live bytes is cleaned by copying them to the head of the
+// log. Otherwise the oldest segment is evicted, although the records read
+// since they were written get copied instead, as a second chance. Only
+// segments covered by the last checkpoint are reclaimed, so a replay never
+// misses a record that removed an entry.
+//
+// All methods block on disk IO, so this object should live on the cache
+// thread.
+class LogStore {
+ public:
+  explicit LogStore(const FilePath& path);
+  ~LogStore();
+
+  // Opens the store, with a limit of |max_bytes| for all the segments. When
+  // there is no valid checkpoint all the files on the folder are deleted, and
+  // the store starts empty. Returns false if the folder cannot be used.
+  bool Init(int max_bytes);
+
+  int max_size() const { return max_size_; }
+
+  // Returns the maximum size of the data of a single entry.
+  int MaxFileSize() const;
+
+  bool HasRecord(const std::string& key) const;
+
+  // Describes the entry for |key|, without reading the data of its streams.
+  // If |update_last_used| is true the entry is also marked as used now.
+  // Returns false if there is no entry for |key|.
+  bool ReadRecord(const std::string& key, bool update_last_used,
+                  LogRecord* record);
+
+  // Reads the data of stream |index| of the entry for |key|. Returns false if
+  // there is no entry for |key|, or if the stored data is not valid, in which
+  // case the entry is removed.
+  bool ReadStream(const std::string& key, int index, std::vector<char>* data);
+
+  // Appends the streams of |record| that carry data to the log, replacing
+  // their previous versions and keeping the other streams. Returns false if
+  // some stream is left out but there is no entry to keep it from, e.g.
+  // because it was evicted after being read.
+  bool WriteRecord(const LogRecord& record);
+
+  // Records that the entry for |key| was used at |last_used|, without
+  // writing anything.
+  void TouchRecord(const std::string& key, base::Time last_used);
+
+  // Removes the entry for |key|. Returns false if there is none.
+  bool RemoveRecord(const std::string& key);
+
+  // Removes the entries last used between |initial_time| and |end_time|.
+  // A null |end_time| means no upper limit.
+  void RemoveRecordsBetween(base::Time initial_time, base::Time end_time);
+
+  // Removes every entry and segment.
+  void RemoveAllRecords();
+
+  // Returns the keys of all the entries.
+  void GetKeys(std::vector<std::string>* keys) const;
+
+  // Writes the index to disk, if it changed since the last checkpoint.
+  bool Checkpoint();
+
+  void GetStats(LogStoreStats* stats) const;
+
+ private:
+  // Where the latest record of a stream is. |size| is zero if there is none.
+  struct StreamLocation {
+    int32 segment;
+    int32 offset;
+    int32 size;
+  };
+
+  struct IndexEntry {
+    IndexEntry();
+
+    StreamLocation streams[LogRecord::kNumStreams];
+    bool used;  // The entry was read since it was written.
+    int64 last_used;
+    int64 last_modified;
+  };
+
+  struct Segment {
+    Segment();
+    ~Segment();
+
+    scoped_refptr<File> file;
+    int64 size;
+    int64 live_bytes;
+  };
+
+  typedef base::hash_map<std::string, IndexEntry> Index;
+  typedef std::map<int32, Segment> SegmentMap;
+
+  FilePath GetSegmentName(int32 id) const;
+
+  // Opens segment |id|, creating the file if needed.
+  Segment* OpenSegment(int32 id, bool create);
+
+  // Loads the checkpoint, returning false if it is missing or invalid.
+  bool LoadCheckpoint(int32* head, int64* head_offset);
+
+  // Loads the records stored on segment |id| starting at |offset|. Returns
+  // false if the segment ends with an invalid record.
+  bool ReplaySegment(int32 id, int64 offset);
+
+  // Deletes the segment files and the checkpoint, leaving an empty store.
+  bool Reset();
+
+  // Appends |record_size| bytes of |data| to the head of the log, returning
+  // the location where they were stored.
+  bool Append(const char* data, int32 record_size, int32* segment,
+              int32* offset);
+
+  // Points stream |index| of |entry| to the given location.
+  void SetLocation(IndexEntry* entry, int index, int32 segment, int32 offset,
+                   int32 size);
+
+  // Drops |key| from the index.
+  void RemoveFromIndex(Index::iterator it);
+
+  // Appends a record removing |key| from the log.
+  void AppendRemoval(const std::string& key);
+
+  // Reclaims segments until the log fits comfortably under the maximum size.
+  void CollectGarbage();
+
+  // Moves the live records of |segment| to the head of the log, evicting the
+  // entries never read since they were written if |evict| is true. Returns
+  // false if the log could not be written.
+  bool CleanSegment(int32 segment, bool evict);
+
+  // Deletes the segments covered by the last checkpoint that have no live
+  // records.
+  void DeleteDeadSegments();
+
+  // Removes segment |id| from the disk. All its records must be dead.
+  void DeleteSegment(int32 id);
+
+  FilePath path_;
+  Index index_;
+  SegmentMap segments_;
+  int32 head_;  // The segment being appended to.
+  int32 checkpoint_head_;  // The head when the index was last written.
+  int64 bytes_since_checkpoint_;
+  bool index_dirty_;
+  int max_size_;
+  int segment_size_;
+  LogStoreStats stats_;
+
+  DISALLOW_COPY_AND_ASSIGN(LogStore);
+};
+
+}  // namespace disk_cache
+
+#endif  // NET_DISK_CACHE_LOG_STORE_H_
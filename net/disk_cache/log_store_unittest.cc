@@ -0,0 +1,300 @@
+// Copyright (c) 2011 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/basictypes.h"
+#include "base/file_path.h"
+#include "base/file_util.h"
+#include "base/message_loop.h"
+#include "base/string_number_conversions.h"
+#include "base/threading/thread.h"
+#include "net/base/io_buffer.h"
+#include "net/base/net_errors.h"
+#include "net/base/test_completion_callback.h"
+#include "net/disk_cache/disk_cache.h"
+#include "net/disk_cache/disk_cache_test_base.h"
+#include "net/disk_cache/disk_cache_test_util.h"
+#include "net/disk_cache/log_store.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace {
+
+// Returns a record for |key| whose first stream holds |size| bytes of |fill|.
+disk_cache::LogRecord MakeRecord(const std::string& key, int size, char fill) {
+  disk_cache::LogRecord record;
+  record.key = key;
+  record.last_used = record.last_modified = base::Time::Now();
+  record.data[0].assign(size, fill);
+  record.data[1].assign(key.begin(), key.end());
+  for (int i = 0; i < disk_cache::LogRecord::kNumStreams; i++) {
+    record.data_size[i] = static_cast<int32>(record.data[i].size());
+    record.has_data[i] = true;
+  }
+  return record;
+}
+
+}  // namespace
+
+TEST_F(DiskCacheTest, LogStoreReadWrite) {
+  FilePath path = GetCacheFilePath();
+  ASSERT_TRUE(DeleteCache(path));
+
+  {
+    disk_cache::LogStore store(path);
+    ASSERT_TRUE(store.Init(1024 * 1024));
+    EXPECT_TRUE(store.WriteRecord(MakeRecord("the first key", 2000, 'a')));
+    EXPECT_TRUE(store.WriteRecord(MakeRecord("the second key", 100, 'b')));
+    EXPECT_TRUE(store.WriteRecord(MakeRecord("the first key", 300, 'c')));
+    EXPECT_TRUE(store.RemoveRecord("the second key"));
+    EXPECT_FALSE(store.RemoveRecord("the second key"));
+
+    disk_cache::LogRecord record;
+    ASSERT_TRUE(store.ReadRecord("the first key", true, &record));
+    EXPECT_EQ(300, record.data_size[0]);
+    EXPECT_EQ(13, record.data_size[1]);
+    EXPECT_EQ(0, record.data_size[2]);
+    EXPECT_FALSE(record.has_data[0]);
+    EXPECT_FALSE(store.ReadRecord("the second key", true, &record));
+
+    std::vector<char> data;
+    ASSERT_TRUE(store.ReadStream("the first key", 0, &data));
+    EXPECT_EQ(300U, data.size());
+    EXPECT_EQ('c', data[0]);
+    ASSERT_TRUE(store.ReadStream("the first key", 1, &data));
+    EXPECT_EQ("the first key", std::string(data.begin(), data.end()));
+    ASSERT_TRUE(store.ReadStream("the first key", 2, &data));
+    EXPECT_TRUE(data.empty());
+    EXPECT_FALSE(store.ReadStream("the second key", 0, &data));
+  }
+
+  // The index is saved when the store goes away.
+  disk_cache::LogStore store(path);
+  ASSERT_TRUE(store.Init(1024 * 1024));
+  disk_cache::LogStoreStats stats;
+  store.GetStats(&stats);
+  EXPECT_EQ(1, stats.entry_count);
+
+  disk_cache::LogRecord record;
+  ASSERT_TRUE(store.ReadRecord("the first key", false, &record));
+  EXPECT_EQ(300, record.data_size[0]);
+  std::vector<char> data;
+  ASSERT_TRUE(store.ReadStream("the first key", 0, &data));
+  EXPECT_EQ(300U, data.size());
+  EXPECT_FALSE(store.HasRecord("the second key"));
+}
+
+// Tests that writing some of the streams of an entry appends only those, and
+// keeps the others.
+TEST_F(DiskCacheTest, LogStoreWriteStreams) {
+  FilePath path = GetCacheFilePath();
+  ASSERT_TRUE(DeleteCache(path));
+  FilePath index = path.AppendASCII("log_index");
+  FilePath saved_index = path.AppendASCII("saved_index");
+
+  {
+    disk_cache::LogStore store(path);
+    ASSERT_TRUE(store.Init(1024 * 1024));
+    EXPECT_TRUE(store.WriteRecord(MakeRecord("the key", 20000, 'a')));
+    EXPECT_TRUE(store.Checkpoint());
+    ASSERT_TRUE(file_util::CopyFile(index, saved_index));
+
+    disk_cache::LogStoreStats stats;
+    store.GetStats(&stats);
+    int64 bytes_written = stats.bytes_written;
+
+    disk_cache::LogRecord headers = MakeRecord("the key", 0, 'b');
+    headers.has_data[0] = false;
+    headers.has_data[2] = false;
+    headers.data[1].assign(100, 'b');
+    EXPECT_TRUE(store.WriteRecord(headers));
+    store.GetStats(&stats);
+    EXPECT_GT(1000, stats.bytes_written - bytes_written);
+
+    // There is nothing to keep the other streams from.
+    headers.key = "another key";
+    EXPECT_FALSE(store.WriteRecord(headers));
+    EXPECT_FALSE(store.HasRecord("another key"));
+  }
+
+  // The streams are found after a replay too.
+  ASSERT_TRUE(file_util::ReplaceFile(saved_index, index));
+  disk_cache::LogStore store(path);
+  ASSERT_TRUE(store.Init(1024 * 1024));
+  disk_cache::LogRecord record;
+  ASSERT_TRUE(store.ReadRecord("the key", false, &record));
+  EXPECT_EQ(20000, record.data_size[0]);
+  EXPECT_EQ(100, record.data_size[1]);
+
+  std::vector<char> data;
+  ASSERT_TRUE(store.ReadStream("the key", 0, &data));
+  EXPECT_EQ('a', data[0]);
+  ASSERT_TRUE(store.ReadStream("the key", 1, &data));
+  EXPECT_EQ('b', data[0]);
+}
+
+// Tests that the records written after the last checkpoint are recovered,
+// removals included, and that a record cut short is dropped.
+TEST_F(DiskCacheTest, LogStoreReplay) {
+  FilePath path = GetCacheFilePath();
+  ASSERT_TRUE(DeleteCache(path));
+  FilePath index = path.AppendASCII("log_index");
+  FilePath saved_index = path.AppendASCII("saved_index");
+
+  {
+    disk_cache::LogStore store(path);
+    ASSERT_TRUE(store.Init(1024 * 1024));
+    EXPECT_TRUE(store.WriteRecord(MakeRecord("key1", 1000, 'a')));
+    EXPECT_TRUE(store.WriteRecord(MakeRecord("key2", 1000, 'b')));
+    EXPECT_TRUE(store.Checkpoint());
+    ASSERT_TRUE(file_util::CopyFile(index, saved_index));
+
+    EXPECT_TRUE(store.RemoveRecord("key1"));
+    EXPECT_TRUE(store.WriteRecord(MakeRecord("key3", 1000, 'c')));
+    EXPECT_TRUE(store.WriteRecord(MakeRecord("key4", 1000, 'd')));
+  }
+
+  // Go back to the old checkpoint, as if the last one was never written, and
+  // cut the last record short.
+  ASSERT_TRUE(file_util::ReplaceFile(saved_index, index));
+  FilePath segment = path.AppendASCII("log_data_0");
+  int64 size;
+  ASSERT_TRUE(file_util::GetFileSize(segment, &size));
+  std::string data;
+  ASSERT_TRUE(file_util::ReadFileToString(segment, &data));
+  data.resize(static_cast<size_t>(size - 10));
+  ASSERT_EQ(static_cast<int>(data.size()),
+            file_util::WriteFile(segment, data.data(), data.size()));
+
+  disk_cache::LogStore store(path);
+  ASSERT_TRUE(store.Init(1024 * 1024));
+  EXPECT_FALSE(store.HasRecord("key1"));
+  EXPECT_TRUE(store.HasRecord("key2"));
+  EXPECT_TRUE(store.HasRecord("key3"));
+  EXPECT_FALSE(store.HasRecord("key4"));
+
+  // New records go after the last valid one.
+  EXPECT_TRUE(store.WriteRecord(MakeRecord("key4", 1000, 'e')));
+  std::vector<char> stored;
+  ASSERT_TRUE(store.ReadStream("key4", 0, &stored));
+  EXPECT_EQ('e', stored[0]);
+  ASSERT_TRUE(store.ReadStream("key3", 0, &stored));
+  EXPECT_EQ('c', stored[0]);
+}
+
+TEST_F(DiskCacheTest, LogStoreReclaimSpace) {
+  FilePath path = GetCacheFilePath();
+  ASSERT_TRUE(DeleteCache(path));
+
+  const int kMaxSize = 2 * 1024 * 1024;
+  const int kRecordSize = 20 * 1024;
+  disk_cache::LogStore store(path);
+  ASSERT_TRUE(store.Init(kMaxSize));
+
+  // Keep reading the first entry, so that it survives the evictions.
+  disk_cache::LogRecord record;
+  for (int i = 0; i < 400; i++) {
+    std::string key = "key" + base::IntToString(i);
+    ASSERT_TRUE(store.WriteRecord(MakeRecord(key, kRecordSize, 'a')));
+    EXPECT_TRUE(store.ReadRecord("key0", true, &record));
+  }
+
+  disk_cache::LogStoreStats stats;
+  store.GetStats(&stats);
+  EXPECT_LE(stats.disk_bytes, kMaxSize);
+  EXPECT_GT(stats.evicted_count, 0);
+  EXPECT_LT(stats.entry_count, 400);
+  EXPECT_TRUE(store.HasRecord("key0"));
+  EXPECT_TRUE(store.HasRecord("key399"));
+  EXPECT_FALSE(store.HasRecord("key1"));
+
+  // Overwriting the same entries leaves mostly dead segments, which are
+  // cleaned without evicting anything.
+  store.RemoveAllRecords();
+  for (int i = 0; i < 400; i++) {
+    std::string key = "key" + base::IntToString(i % 10);
+    ASSERT_TRUE(store.WriteRecord(MakeRecord(key, kRecordSize, 'b')));
+  }
+  store.GetStats(&stats);
+  EXPECT_LE(stats.disk_bytes, kMaxSize);
+  EXPECT_EQ(10, stats.entry_count);
+  EXPECT_EQ(0, stats.evicted_count);
+}
+
+TEST_F(DiskCacheTest, LogBackend) {
+  FilePath path = GetCacheFilePath();
+  ASSERT_TRUE(DeleteCache(path));
+  base::Thread cache_thread("CacheThread");
+  ASSERT_TRUE(cache_thread.StartWithOptions(
+                  base::Thread::Options(MessageLoop::TYPE_IO, 0)));
+  disk_cache::SetBackendFormat(disk_cache::LOG_STRUCTURED_FORMAT);
+
+  const int kSize = 5000;
+  scoped_refptr<net::IOBuffer> buffer1(new net::IOBuffer(kSize));
+  scoped_refptr<net::IOBuffer> buffer2(new net::IOBuffer(kSize));
+  CacheTestFillBuffer(buffer1->data(), kSize, false);
+  TestCompletionCallback cb;
+
+  disk_cache::Backend* cache = NULL;
+  int rv = disk_cache::CreateCacheBackend(net::DISK_CACHE, path, 0, false,
+                                          cache_thread.message_loop_proxy(),
+                                          NULL, &cache, &cb);
+  ASSERT_EQ(net::OK, cb.GetResult(rv));
+  ASSERT_TRUE(cache);
+
+  disk_cache::Entry* entry;
+  rv = cache->CreateEntry("the key", &entry, &cb);
+  ASSERT_EQ(net::OK, cb.GetResult(rv));
+  rv = cache->CreateEntry("the key", &entry, &cb);
+  EXPECT_NE(net::OK, cb.GetResult(rv));
+  EXPECT_EQ(kSize, entry->WriteData(1, 0, buffer1, kSize, &cb, false));
+  EXPECT_EQ(net::ERR_CACHE_OPERATION_NOT_SUPPORTED,
+            entry->WriteSparseData(0, buffer1, kSize, &cb));
+  entry->Close();
+
+  rv = cache->CreateEntry("the doomed key", &entry, &cb);
+  ASSERT_EQ(net::OK, cb.GetResult(rv));
+  entry->Doom();
+  entry->Close();
+
+  delete cache;
+  cache = NULL;
+
+  rv = disk_cache::CreateCacheBackend(net::DISK_CACHE, path, 0, false,
+                                      cache_thread.message_loop_proxy(),
+                                      NULL, &cache, &cb);
+  ASSERT_EQ(net::OK, cb.GetResult(rv));
+  EXPECT_EQ(1, cache->GetEntryCount());
+
+  rv = cache->OpenEntry("the doomed key", &entry, &cb);
+  EXPECT_NE(net::OK, cb.GetResult(rv));
+  rv = cache->OpenEntry("the key", &entry, &cb);
+  ASSERT_EQ(net::OK, cb.GetResult(rv));
+  ASSERT_EQ(kSize, entry->GetDataSize(1));
+  rv = entry->ReadData(1, 0, buffer2, kSize, &cb);
+  EXPECT_EQ(kSize, cb.GetResult(rv));
+  EXPECT_EQ(0, memcmp(buffer1->data(), buffer2->data(), kSize));
+
+  // Replacing the first stream does not need the stored data, and keeps the
+  // second one.
+  EXPECT_EQ(100, entry->WriteData(0, 0, buffer1, 100, &cb, true));
+  entry->Close();
+  rv = cache->OpenEntry("the key", &entry, &cb);
+  ASSERT_EQ(net::OK, cb.GetResult(rv));
+  EXPECT_EQ(100, entry->GetDataSize(0));
+  ASSERT_EQ(kSize, entry->GetDataSize(1));
+
+  // Dooming the entry while it is open keeps it usable.
+  rv = cache->DoomEntry("the key", &cb);
+  EXPECT_EQ(net::OK, cb.GetResult(rv));
+  rv = entry->ReadData(1, 0, buffer2, kSize, &cb);
+  EXPECT_EQ(kSize, cb.GetResult(rv));
+  EXPECT_EQ(0, memcmp(buffer1->data(), buffer2->data(), kSize));
+  entry->Close();
+
+  rv = cache->OpenEntry("the key", &entry, &cb);
+  EXPECT_NE(net::OK, cb.GetResult(rv));
+
+  delete cache;
+  disk_cache::SetBackendFormat(disk_cache::BLOCK_FILES_FORMAT);
+  MessageLoop::current()->RunAllPending();
+}
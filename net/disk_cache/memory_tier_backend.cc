@@ -0,0 +1,394 @@
+// Copyright (c) 2011 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/memory_tier_backend.h"
+
+#include <algorithm>
+
+#include "base/compiler_specific.h"
+#include "base/logging.h"
+#include "base/stl_util-inl.h"
+#include "base/stringprintf.h"
+#include "net/base/net_errors.h"
+
+using base::Time;
+
+namespace {
+
+// The biggest entry kept on the memory tier. The idea is to keep the headers
+// and the small resources that are used over and over (stylesheets, scripts
+// and images), not to take memory away from the renderers.
+const int kMaxEntrySize = 64 * 1024;
+
+// Returns true if |last_used| is between |initial_time| and |end_time|, or
+// after |initial_time| if |end_time| is null.
+bool UsedBetween(base::Time last_used, base::Time initial_time,
+                 base::Time end_time) {
+  return last_used >= initial_time &&
+         (end_time.is_null() || last_used < end_time);
+}
+
+}  // namespace
+
+namespace disk_cache {
+
+// Opens or creates an entry of the disk cache, and wraps it. The request
+// deletes itself when done, or when the backend goes away.
+class MemoryTierBackend::OpenRequest {
+ public:
+  enum Operation {
+    OPEN,
+    CREATE,
+    OPEN_NEXT
+  };
+
+  OpenRequest(MemoryTierBackend* backend, Operation operation,
+              const std::string& key, Entry** entry,
+              CompletionCallback* callback)
+      : backend_(backend), operation_(operation), key_(key), entry_(entry),
+        disk_entry_(NULL), callback_(callback), stale_(false),
+        ALLOW_THIS_IN_INITIALIZER_LIST(
+            my_callback_(this, &OpenRequest::OnIOComplete)) {
+    backend_->requests_.insert(this);
+  }
+  ~OpenRequest() {}
+
+  // Starts the operation. |iter| is only used by OPEN_NEXT.
+  int Start(void** iter) {
+    Backend* disk_cache = backend_->disk_cache_;
+    int rv;
+    switch (operation_) {
+      case OPEN:
+        rv = disk_cache->OpenEntry(key_, &disk_entry_, &my_callback_);
+        break;
+      case CREATE:
+        rv = disk_cache->CreateEntry(key_, &disk_entry_, &my_callback_);
+        break;
+      case OPEN_NEXT:
+        rv = disk_cache->OpenNextEntry(iter, &disk_entry_, &my_callback_);
+        break;
+      default:
+        NOTREACHED();
+        rv = net::ERR_UNEXPECTED;
+    }
+    if (rv == net::ERR_IO_PENDING)
+      return rv;
+    return Finish(rv);
+  }
+
+  void OnIOComplete(int result) {
+    CompletionCallback* callback = callback_;
+    int rv = Finish(result);
+    callback->Run(rv);
+  }
+
+  // Returns true if the request may return the entry for |key|.
+  bool MatchesKey(const std::string& key) const {
+    return operation_ == OPEN_NEXT || key == key_;
+  }
+
+  // The entry may be doomed by the disk cache before it is returned, so it
+  // should not make it to the memory tier.
+  void set_stale() { stale_ = true; }
+  bool stale() const { return stale_; }
+
+ private:
+  int Finish(int result) {
+    int rv = backend_->OnOpenComplete(this, result, disk_entry_,
+                                      operation_ == CREATE, entry_);
+    delete this;
+    return rv;
+  }
+
+  MemoryTierBackend* backend_;
+  Operation operation_;
+  std::string key_;
+  Entry** entry_;
+  Entry* disk_entry_;
+  CompletionCallback* callback_;
+  bool stale_;
+  net::CompletionCallbackImpl<OpenRequest> my_callback_;
+
+  DISALLOW_COPY_AND_ASSIGN(OpenRequest);
+};
+
+// ------------------------------------------------------------------------
+
+MemoryTierBackend::MemoryTierBackend(Backend* disk_cache, int max_bytes)
+    : disk_cache_(disk_cache),
+      max_size_(max_bytes),
+      max_entry_size_(std::min(max_bytes / 8, kMaxEntrySize)),
+      current_size_(0),
+      ALLOW_THIS_IN_INITIALIZER_LIST(
+          doom_callback_(this, &MemoryTierBackend::OnDiskEntryDoomed)) {
+  DCHECK(disk_cache_);
+}
+
+MemoryTierBackend::~MemoryTierBackend() {
+  // Pending IO of the entries may complete while the disk cache goes away, so
+  // the entries have to forget about us first.
+  std::vector<MemoryTierEntry*> opening;
+  for (std::set<MemoryTierEntry*>::iterator it = entries_.begin();
+       it != entries_.end(); ++it) {
+    if ((*it)->OnBackendDestroyed())
+      opening.push_back(*it);
+  }
+  entries_.clear();
+  open_entries_.clear();
+
+  // The disk cache doesn't invoke the callbacks of pending operations when it
+  // goes away.
+  delete disk_cache_;
+  for (size_t i = 0; i < opening.size(); i++)
+    opening[i]->CancelOpen();
+  STLDeleteElements(&requests_);
+}
+
+void MemoryTierBackend::DoomDiskEntry(const std::string& key) {
+  disk_cache_->DoomEntry(key, &doom_callback_);
+}
+
+void MemoryTierBackend::OnEntryDoomed(MemoryTierEntry* entry) {
+  EntryMap::iterator it = open_entries_.find(entry->key());
+  if (it != open_entries_.end() && it->second == entry)
+    open_entries_.erase(it);
+  RemoveRecord(entry->key(), NULL);
+  SetPendingOpensStale(entry->key());
+}
+
+void MemoryTierBackend::OnEntryClosed(MemoryTierEntry* entry) {
+  entries_.erase(entry);
+  if (entry->doomed())
+    return;
+
+  // Entries that were not on the list of open entries are out of date.
+  EntryMap::iterator it = open_entries_.find(entry->key());
+  if (it == open_entries_.end() || it->second != entry)
+    return;
+  open_entries_.erase(it);
+
+  if (!entry->IsComplete())
+    return;
+
+  RemoveRecord(entry->key(), NULL);
+  records_.push_front(MemoryTierRecord());
+  MemoryTierRecord& record = records_.front();
+  entry->ReleaseRecord(&record);
+  index_[record.key] = records_.begin();
+  current_size_ += record.GetSize();
+  TrimRecords();
+}
+
+int32 MemoryTierBackend::GetEntryCount() const {
+  return disk_cache_->GetEntryCount();
+}
+
+int MemoryTierBackend::OpenEntry(const std::string& key, Entry** entry,
+                                 CompletionCallback* callback) {
+  EntryMap::iterator it = open_entries_.find(key);
+  if (it != open_entries_.end()) {
+    stats_.OnEvent(Stats::MEMORY_HIT);
+    it->second->Open();
+    *entry = it->second;
+    return net::OK;
+  }
+
+  MemoryTierRecord record;
+  if (RemoveRecord(key, &record)) {
+    stats_.OnEvent(Stats::MEMORY_HIT);
+    MemoryTierEntry* memory_entry = new MemoryTierEntry(this, &record);
+    AddEntry(memory_entry, false);
+    *entry = memory_entry;
+    return net::OK;
+  }
+
+  stats_.OnEvent(Stats::MEMORY_MISS);
+  OpenRequest* request =
+      new OpenRequest(this, OpenRequest::OPEN, key, entry, callback);
+  return request->Start(NULL);
+}
+
+int MemoryTierBackend::CreateEntry(const std::string& key, Entry** entry,
+                                   CompletionCallback* callback) {
+  // The entry is already there.
+  if (open_entries_.find(key) != open_entries_.end() ||
+      index_.find(key) != index_.end()) {
+    return net::ERR_FAILED;
+  }
+
+  OpenRequest* request =
+      new OpenRequest(this, OpenRequest::CREATE, key, entry, callback);
+  return request->Start(NULL);
+}
+
+int MemoryTierBackend::DoomEntry(const std::string& key,
+                                 CompletionCallback* callback) {
+  EntryMap::iterator it = open_entries_.find(key);
+  if (it != open_entries_.end()) {
+    MemoryTierEntry* entry = it->second;
+    OnEntryDoomed(entry);
+    entry->InternalDoom();
+  } else {
+    RemoveRecord(key, NULL);
+    SetPendingOpensStale(key);
+  }
+  return disk_cache_->DoomEntry(key, callback);
+}
+
+int MemoryTierBackend::DoomAllEntries(CompletionCallback* callback) {
+  DoomEntriesInMemory(Time(), Time(), false);
+  return disk_cache_->DoomAllEntries(callback);
+}
+
+int MemoryTierBackend::DoomEntriesBetween(const Time initial_time,
+                                          const Time end_time,
+                                          CompletionCallback* callback) {
+  DoomEntriesInMemory(initial_time, end_time, true);
+  return disk_cache_->DoomEntriesBetween(initial_time, end_time, callback);
+}
+
+int MemoryTierBackend::DoomEntriesSince(const Time initial_time,
+                                        CompletionCallback* callback) {
+  DoomEntriesInMemory(initial_time, Time(), true);
+  return disk_cache_->DoomEntriesSince(initial_time, callback);
+}
+
+int MemoryTierBackend::OpenNextEntry(void** iter, Entry** next_entry,
+                                     CompletionCallback* callback) {
+  OpenRequest* request = new OpenRequest(this, OpenRequest::OPEN_NEXT,
+                                         std::string(), next_entry, callback);
+  return request->Start(iter);
+}
+
+void MemoryTierBackend::EndEnumeration(void** iter) {
+  disk_cache_->EndEnumeration(iter);
+}
+
+void MemoryTierBackend::GetStats(StatsItems* stats) {
+  disk_cache_->GetStats(stats);
+
+  std::pair<std::string, std::string> item;
+  item.first = "Memory tier entries";
+  item.second = base::StringPrintf("0x%x", static_cast<int>(index_.size()));
+  stats->push_back(item);
+
+  item.first = "Memory tier size";
+  item.second = base::StringPrintf("0x%x", current_size_);
+  stats->push_back(item);
+
+  stats_.GetMemoryTierItems(stats);
+}
+
+int MemoryTierBackend::OnOpenComplete(OpenRequest* request, int result,
+                                      Entry* disk_entry, bool created,
+                                      Entry** entry) {
+  requests_.erase(request);
+  if (result != net::OK)
+    return result;
+
+  // Another user may have opened the entry while this request was waiting
+  // for the disk cache, in which case the disk entry is the same one.
+  std::string key = disk_entry->GetKey();
+  EntryMap::iterator it = open_entries_.find(key);
+  if (it != open_entries_.end() && !created) {
+    disk_entry->Close();
+    it->second->Open();
+    *entry = it->second;
+    return net::OK;
+  }
+
+  MemoryTierEntry* memory_entry =
+      new MemoryTierEntry(this, disk_entry, created);
+  AddEntry(memory_entry, request->stale());
+  *entry = memory_entry;
+  return net::OK;
+}
+
+void MemoryTierBackend::AddEntry(MemoryTierEntry* entry, bool stale) {
+  entries_.insert(entry);
+  if (stale) {
+    entry->SetNotCacheable();
+    return;
+  }
+
+  // Whatever the memory tier has for this key is out of date now, and so is
+  // an entry created while the old one was still open.
+  RemoveRecord(entry->key(), NULL);
+  EntryMap::iterator it = open_entries_.find(entry->key());
+  if (it != open_entries_.end())
+    it->second->InternalDoom();
+  open_entries_[entry->key()] = entry;
+}
+
+void MemoryTierBackend::SetPendingOpensStale(const std::string& key) {
+  for (std::set<OpenRequest*>::iterator it = requests_.begin();
+       it != requests_.end(); ++it) {
+    if ((*it)->MatchesKey(key))
+      (*it)->set_stale();
+  }
+}
+
+bool MemoryTierBackend::RemoveRecord(const std::string& key,
+                                     MemoryTierRecord* record) {
+  RecordMap::iterator it = index_.find(key);
+  if (it == index_.end())
+    return false;
+
+  current_size_ -= it->second->GetSize();
+  DCHECK_GE(current_size_, 0);
+  if (record)
+    record->Swap(&*it->second);
+  records_.erase(it->second);
+  index_.erase(it);
+  return true;
+}
+
+void MemoryTierBackend::TrimRecords() {
+  while (current_size_ > max_size_ && !records_.empty())
+    RemoveRecord(records_.back().key, NULL);
+}
+
+void MemoryTierBackend::DoomEntriesInMemory(const Time initial_time,
+                                            const Time end_time,
+                                            bool doom_disk_entries) {
+  // Reads served from memory don't update the disk cache, so the disk cache
+  // may not know that these entries were used recently.
+  std::vector<std::string> keys;
+  for (RecordList::iterator it = records_.begin(); it != records_.end();
+       ++it) {
+    if (UsedBetween(it->last_used, initial_time, end_time))
+      keys.push_back(it->key);
+  }
+
+  std::vector<MemoryTierEntry*> entries;
+  for (EntryMap::iterator it = open_entries_.begin();
+       it != open_entries_.end(); ++it) {
+    if (UsedBetween(it->second->GetLastUsed(), initial_time, end_time))
+      entries.push_back(it->second);
+  }
+
+  for (size_t i = 0; i < keys.size(); i++) {
+    RemoveRecord(keys[i], NULL);
+    if (doom_disk_entries)
+      DoomDiskEntry(keys[i]);
+  }
+
+  for (size_t i = 0; i < entries.size(); i++) {
+    open_entries_.erase(entries[i]->key());
+    entries[i]->InternalDoom();
+    if (doom_disk_entries)
+      DoomDiskEntry(entries[i]->key());
+  }
+
+  // We don't know when the entries being opened were used.
+  for (std::set<OpenRequest*>::iterator it = requests_.begin();
+       it != requests_.end(); ++it) {
+    (*it)->set_stale();
+  }
+}
+
+void MemoryTierBackend::OnDiskEntryDoomed(int result) {
+}
+
+}  // namespace disk_cache
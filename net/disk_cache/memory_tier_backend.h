@@ -0,0 +1,129 @@
+// Copyright (c) 2011 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// See net/disk_cache/disk_cache.h for the public interface of the cache.
+
+#ifndef NET_DISK_CACHE_MEMORY_TIER_BACKEND_H_
+#define NET_DISK_CACHE_MEMORY_TIER_BACKEND_H_
+#pragma once
+
+#include <list>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "base/hash_tables.h"
+#include "net/base/completion_callback.h"
+#include "net/disk_cache/disk_cache.h"
+#include "net/disk_cache/memory_tier_entry.h"
+#include "net/disk_cache/stats.h"
+
+namespace disk_cache {
+
+// This class implements the Backend interface on top of a disk cache, keeping
+// the most recently used small entries in memory as well: the memory tier.
+// Opening an entry that is on the memory tier completes right away, without
+// going to the cache thread, and reading it never touches the disk. Writing
+// to such an entry goes to the disk cache, so the disk always has the latest
+// version of every entry. Entries go back to the memory tier when they are
+// closed, if all their data went through memory while they were open.
+//
+// Note that reads served from memory don't update the rankings of the disk
+// cache, so the disk cache may evict an entry that is still on the memory
+// tier. The memory tier keeps serving it until it is evicted from memory too.
+class MemoryTierBackend : public Backend {
+ public:
+  // Takes ownership of |disk_cache|. |max_bytes| is the amount of memory to
+  // use for the memory tier.
+  MemoryTierBackend(Backend* disk_cache, int max_bytes);
+  virtual ~MemoryTierBackend();
+
+  // Returns the biggest entry the memory tier keeps.
+  int max_entry_size() const { return max_entry_size_; }
+
+  Backend* disk_cache() const { return disk_cache_; }
+
+  // Dooms the entry of the disk cache for |key|, on behalf of an entry that is
+  // not backed by it.
+  void DoomDiskEntry(const std::string& key);
+
+  // Called when an entry is removed from the cache.
+  void OnEntryDoomed(MemoryTierEntry* entry);
+
+  // Called when the last reference to |entry| goes away.
+  void OnEntryClosed(MemoryTierEntry* entry);
+
+  // Backend interface.
+  virtual int32 GetEntryCount() const;
+  virtual int OpenEntry(const std::string& key, Entry** entry,
+                        CompletionCallback* callback);
+  virtual int CreateEntry(const std::string& key, Entry** entry,
+                          CompletionCallback* callback);
+  virtual int DoomEntry(const std::string& key, CompletionCallback* callback);
+  virtual int DoomAllEntries(CompletionCallback* callback);
+  virtual int DoomEntriesBetween(const base::Time initial_time,
+                                 const base::Time end_time,
+                                 CompletionCallback* callback);
+  virtual int DoomEntriesSince(const base::Time initial_time,
+                               CompletionCallback* callback);
+  virtual int OpenNextEntry(void** iter, Entry** next_entry,
+                            CompletionCallback* callback);
+  virtual void EndEnumeration(void** iter);
+  virtual void GetStats(StatsItems* stats);
+
+ private:
+  class OpenRequest;
+  typedef std::list<MemoryTierRecord> RecordList;
+  typedef base::hash_map<std::string, RecordList::iterator> RecordMap;
+  typedef base::hash_map<std::string, MemoryTierEntry*> EntryMap;
+
+  // Called when |request| is done. Returns the entry for the user.
+  int OnOpenComplete(OpenRequest* request, int result, Entry* disk_entry,
+                     bool created, Entry** entry);
+
+  // Adds |entry| to the list of open entries, unless it is |stale|.
+  void AddEntry(MemoryTierEntry* entry, bool stale);
+
+  // Keeps the entries being opened for |key| away from the memory tier.
+  void SetPendingOpensStale(const std::string& key);
+
+  // Removes the record for |key| from the memory tier, and copies it to
+  // |record| if not NULL. Returns false if there is no such record.
+  bool RemoveRecord(const std::string& key, MemoryTierRecord* record);
+
+  // Evicts records until the memory tier fits on its budget.
+  void TrimRecords();
+
+  // Removes the open entries, records and pending opens used between
+  // |initial_time| and |end_time| (with no limit if |end_time| is null),
+  // dooming their disk entries if |doom_disk_entries|.
+  void DoomEntriesInMemory(const base::Time initial_time,
+                           const base::Time end_time, bool doom_disk_entries);
+
+  // Called when the disk cache is done dooming an entry for DoomDiskEntry().
+  void OnDiskEntryDoomed(int result);
+
+  Backend* disk_cache_;
+  RecordList records_;  // The memory tier, most recently used first.
+  RecordMap index_;
+  EntryMap open_entries_;
+  std::set<MemoryTierEntry*> entries_;  // All live entries, doomed included.
+  std::set<OpenRequest*> requests_;  // Open operations in progress.
+  int max_size_;
+  int max_entry_size_;
+  int current_size_;
+
+  // Counts the lookups served by the memory tier (or by an open entry), and
+  // those that went to the disk cache. Not persisted.
+  Stats stats_;
+
+  net::CompletionCallbackImpl<MemoryTierBackend> doom_callback_;
+
+  DISALLOW_COPY_AND_ASSIGN(MemoryTierBackend);
+};
+
+}  // namespace disk_cache
+
+#endif  // NET_DISK_CACHE_MEMORY_TIER_BACKEND_H_
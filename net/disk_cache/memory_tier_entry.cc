@@ -0,0 +1,548 @@
+// Copyright (c) 2011 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/memory_tier_entry.h"
+
+#include <utility>
+
+#include "base/compiler_specific.h"
+#include "base/logging.h"
+#include "net/base/io_buffer.h"
+#include "net/base/net_errors.h"
+#include "net/disk_cache/memory_tier_backend.h"
+
+using base::Time;
+
+namespace disk_cache {
+
+MemoryTierRecord::MemoryTierRecord() {
+}
+
+MemoryTierRecord::~MemoryTierRecord() {
+}
+
+int MemoryTierRecord::GetSize() const {
+  int size = static_cast<int>(key.size());
+  for (int i = 0; i < kNumStreams; i++)
+    size += static_cast<int>(data[i].size());
+  return size;
+}
+
+void MemoryTierRecord::Swap(MemoryTierRecord* other) {
+  key.swap(other->key);
+  std::swap(last_used, other->last_used);
+  std::swap(last_modified, other->last_modified);
+  for (int i = 0; i < kNumStreams; i++)
+    data[i].swap(other->data[i]);
+}
+
+// ------------------------------------------------------------------------
+
+// An operation on the entry of the disk cache. The request is deleted when
+// it completes.
+class MemoryTierEntry::IORequest {
+ public:
+  IORequest(MemoryTierEntry* entry, bool read, int index, int offset,
+            net::IOBuffer* buf, int buf_len, bool truncate,
+            CompletionCallback* callback)
+      : entry_(entry), read_(read), index_(index), offset_(offset), buf_(buf),
+        buf_len_(buf_len), truncate_(truncate), callback_(callback),
+        ALLOW_THIS_IN_INITIALIZER_LIST(
+            my_callback_(this, &IORequest::OnIOComplete)) {
+  }
+  ~IORequest() {}
+
+  // Issues the operation to |disk_entry|.
+  int Start(Entry* disk_entry) {
+    if (read_)
+      return disk_entry->ReadData(index_, offset_, buf_, buf_len_,
+                                  &my_callback_);
+    return disk_entry->WriteData(index_, offset_, buf_, buf_len_,
+                                 &my_callback_, truncate_);
+  }
+
+  void OnIOComplete(int result) {
+    MemoryTierEntry* entry = entry_;
+    CompletionCallback* callback = callback_;
+    entry->OnDiskIOComplete(this, result);
+    delete this;
+    if (callback)
+      callback->Run(result);
+    entry->ReleaseIO();
+  }
+
+  bool read() const { return read_; }
+  int index() const { return index_; }
+  int offset() const { return offset_; }
+  net::IOBuffer* buf() const { return buf_; }
+  int buf_len() const { return buf_len_; }
+  bool truncate() const { return truncate_; }
+  CompletionCallback* callback() const { return callback_; }
+
+ private:
+  MemoryTierEntry* entry_;
+  bool read_;
+  int index_;
+  int offset_;
+  scoped_refptr<net::IOBuffer> buf_;
+  int buf_len_;
+  bool truncate_;
+  CompletionCallback* callback_;
+  net::CompletionCallbackImpl<IORequest> my_callback_;
+
+  DISALLOW_COPY_AND_ASSIGN(IORequest);
+};
+
+// ------------------------------------------------------------------------
+
+MemoryTierEntry::MemoryTierEntry(MemoryTierBackend* backend, Entry* disk_entry,
+                                 bool created)
+    : backend_(backend),
+      disk_entry_(disk_entry),
+      pending_disk_entry_(NULL),
+      ref_count_(1),
+      io_refs_(0),
+      pending_reads_(0),
+      opening_(false),
+      open_failed_(false),
+      cacheable_(true),
+      doomed_(false),
+      ALLOW_THIS_IN_INITIALIZER_LIST(
+          open_callback_(this, &MemoryTierEntry::OnDiskEntryOpened)) {
+  record_.key = disk_entry->GetKey();
+  if (created)
+    return;
+
+  // Sparse entries keep their data on child entries.
+  int size = 0;
+  for (int i = 0; i < MemoryTierRecord::kNumStreams; i++)
+    size += disk_entry->GetDataSize(i);
+  if (size > backend_->max_entry_size() || disk_entry->CouldBeSparse())
+    SetNotCacheable();
+}
+
+MemoryTierEntry::MemoryTierEntry(MemoryTierBackend* backend,
+                                 MemoryTierRecord* record)
+    : backend_(backend),
+      disk_entry_(NULL),
+      pending_disk_entry_(NULL),
+      ref_count_(1),
+      io_refs_(0),
+      pending_reads_(0),
+      opening_(false),
+      open_failed_(false),
+      cacheable_(true),
+      doomed_(false),
+      ALLOW_THIS_IN_INITIALIZER_LIST(
+          open_callback_(this, &MemoryTierEntry::OnDiskEntryOpened)) {
+  record_.Swap(record);
+}
+
+void MemoryTierEntry::Open() {
+  DCHECK(!doomed_);
+  ref_count_++;
+}
+
+void MemoryTierEntry::InternalDoom() {
+  doomed_ = true;
+}
+
+bool MemoryTierEntry::OnBackendDestroyed() {
+  SetNotCacheable();
+  backend_ = NULL;
+  if (!opening_)
+    return false;
+
+  // The disk cache will not tell us about the entry, so the IO waiting for it
+  // goes away without invoking the callbacks, as for any other operation of
+  // the backend.
+  while (!queued_io_.empty()) {
+    delete queued_io_.front();
+    queued_io_.pop_front();
+  }
+  return true;
+}
+
+void MemoryTierEntry::CancelOpen() {
+  DCHECK(opening_);
+  opening_ = false;
+  open_failed_ = true;
+  ReleaseIO();
+}
+
+bool MemoryTierEntry::IsComplete() const {
+  if (!cacheable_ || doomed_ || open_failed_)
+    return false;
+
+  for (int i = 0; i < MemoryTierRecord::kNumStreams; i++) {
+    if (static_cast<int>(record_.data[i].size()) != GetDataSize(i))
+      return false;
+  }
+  return record_.GetSize() <= backend_->max_entry_size();
+}
+
+void MemoryTierEntry::ReleaseRecord(MemoryTierRecord* record) {
+  DCHECK(!ref_count_);
+  if (disk_entry_) {
+    record_.last_used = disk_entry_->GetLastUsed();
+    record_.last_modified = disk_entry_->GetLastModified();
+  }
+  record->Swap(&record_);
+  cacheable_ = false;
+}
+
+// ------------------------------------------------------------------------
+
+void MemoryTierEntry::Doom() {
+  if (doomed_)
+    return;
+
+  if (backend_)
+    backend_->OnEntryDoomed(this);
+  doomed_ = true;
+
+  if (disk_entry_)
+    disk_entry_->Doom();
+  else if (backend_)
+    backend_->DoomDiskEntry(record_.key);
+}
+
+void MemoryTierEntry::Close() {
+  ref_count_--;
+  DCHECK(ref_count_ >= 0);
+  Cleanup();
+}
+
+std::string MemoryTierEntry::GetKey() const {
+  return record_.key;
+}
+
+Time MemoryTierEntry::GetLastUsed() const {
+  if (disk_entry_)
+    return disk_entry_->GetLastUsed();
+  return record_.last_used;
+}
+
+Time MemoryTierEntry::GetLastModified() const {
+  if (disk_entry_)
+    return disk_entry_->GetLastModified();
+  return record_.last_modified;
+}
+
+int32 MemoryTierEntry::GetDataSize(int index) const {
+  if (disk_entry_)
+    return disk_entry_->GetDataSize(index);
+
+  if (index < 0 || index >= MemoryTierRecord::kNumStreams)
+    return 0;
+  return static_cast<int32>(record_.data[index].size());
+}
+
+int MemoryTierEntry::ReadData(int index, int offset, net::IOBuffer* buf,
+    int buf_len, net::CompletionCallback* completion_callback) {
+  if (index < 0 || index >= MemoryTierRecord::kNumStreams)
+    return net::ERR_INVALID_ARGUMENT;
+
+  if (disk_entry_) {
+    // There is no need to look at the data if it cannot be kept in memory.
+    if (!cacheable_) {
+      return disk_entry_->ReadData(index, offset, buf, buf_len,
+                                   completion_callback);
+    }
+    return DoDiskIO(new IORequest(this, true, index, offset, buf, buf_len,
+                                  false, completion_callback));
+  }
+
+  if (opening_) {
+    queued_io_.push_back(new IORequest(this, true, index, offset, buf, buf_len,
+                                       false, completion_callback));
+    return net::ERR_IO_PENDING;
+  }
+
+  return InternalReadData(index, offset, buf, buf_len);
+}
+
+int MemoryTierEntry::WriteData(int index, int offset, net::IOBuffer* buf,
+    int buf_len, net::CompletionCallback* completion_callback, bool truncate) {
+  if (index < 0 || index >= MemoryTierRecord::kNumStreams)
+    return net::ERR_INVALID_ARGUMENT;
+
+  if (disk_entry_) {
+    if (!cacheable_) {
+      return disk_entry_->WriteData(index, offset, buf, buf_len,
+                                    completion_callback, truncate);
+    }
+    return DoDiskIO(new IORequest(this, false, index, offset, buf, buf_len,
+                                  truncate, completion_callback));
+  }
+
+  IORequest* request = new IORequest(this, false, index, offset, buf, buf_len,
+                                     truncate, completion_callback);
+  if (opening_) {
+    queued_io_.push_back(request);
+    return net::ERR_IO_PENDING;
+  }
+
+  if (offset < 0 || buf_len < 0) {
+    delete request;
+    return net::ERR_INVALID_ARGUMENT;
+  }
+
+  // The data of a doomed entry is not going to be stored anywhere, so there is
+  // no point in looking for the disk entry, which may not be the same entry
+  // anymore.
+  if (doomed_ || !backend_) {
+    delete request;
+    InternalWriteData(index, offset, buf, buf_len, truncate);
+    return buf_len;
+  }
+
+  int rv = open_failed_ ? net::ERR_FAILED : OpenDiskEntry();
+  if (rv == net::ERR_IO_PENDING) {
+    queued_io_.push_back(request);
+    return rv;
+  }
+
+  if (rv != net::OK) {
+    delete request;
+    return net::ERR_FAILED;
+  }
+  return DoDiskIO(request);
+}
+
+int MemoryTierEntry::ReadSparseData(int64 offset, net::IOBuffer* buf,
+    int buf_len, net::CompletionCallback* completion_callback) {
+  if (!disk_entry_)
+    return net::ERR_CACHE_OPERATION_NOT_SUPPORTED;
+  SetNotCacheable();
+  return disk_entry_->ReadSparseData(offset, buf, buf_len, completion_callback);
+}
+
+int MemoryTierEntry::WriteSparseData(int64 offset, net::IOBuffer* buf,
+    int buf_len, net::CompletionCallback* completion_callback) {
+  if (!disk_entry_)
+    return net::ERR_CACHE_OPERATION_NOT_SUPPORTED;
+  SetNotCacheable();
+  return disk_entry_->WriteSparseData(offset, buf, buf_len,
+                                      completion_callback);
+}
+
+int MemoryTierEntry::GetAvailableRange(int64 offset, int len, int64* start,
+                                       CompletionCallback* callback) {
+  if (!disk_entry_)
+    return net::ERR_CACHE_OPERATION_NOT_SUPPORTED;
+  SetNotCacheable();
+  return disk_entry_->GetAvailableRange(offset, len, start, callback);
+}
+
+bool MemoryTierEntry::CouldBeSparse() const {
+  // Entries that could be sparse never make it to the memory tier.
+  if (!disk_entry_)
+    return false;
+  return disk_entry_->CouldBeSparse();
+}
+
+void MemoryTierEntry::CancelSparseIO() {
+  if (disk_entry_)
+    disk_entry_->CancelSparseIO();
+}
+
+int MemoryTierEntry::ReadyForSparseIO(
+    net::CompletionCallback* completion_callback) {
+  if (!disk_entry_)
+    return net::OK;
+  return disk_entry_->ReadyForSparseIO(completion_callback);
+}
+
+// ------------------------------------------------------------------------
+
+MemoryTierEntry::~MemoryTierEntry() {
+  DCHECK(queued_io_.empty());
+  if (disk_entry_)
+    disk_entry_->Close();
+}
+
+int MemoryTierEntry::OpenDiskEntry() {
+  DCHECK(backend_);
+  opening_ = true;
+  io_refs_++;
+  int rv = backend_->disk_cache()->OpenEntry(record_.key, &pending_disk_entry_,
+                                             &open_callback_);
+  if (rv == net::ERR_IO_PENDING)
+    return rv;
+
+  opening_ = false;
+  io_refs_--;
+  if (rv == net::OK)
+    disk_entry_ = pending_disk_entry_;
+  else
+    open_failed_ = true;
+  return rv;
+}
+
+void MemoryTierEntry::OnDiskEntryOpened(int result) {
+  DCHECK(opening_);
+  opening_ = false;
+  if (result == net::OK)
+    disk_entry_ = pending_disk_entry_;
+  else
+    open_failed_ = true;
+
+  // Issue all the IO before invoking any callback, so that IO started from a
+  // callback goes after the IO that was waiting.
+  std::deque<IORequest*> requests;
+  requests.swap(queued_io_);
+  std::vector<std::pair<CompletionCallback*, int> > results;
+  for (size_t i = 0; i < requests.size(); i++) {
+    IORequest* request = requests[i];
+    CompletionCallback* callback = request->callback();
+    int rv;
+    if (disk_entry_) {
+      rv = DoDiskIO(request);
+      if (rv == net::ERR_IO_PENDING)
+        continue;
+    } else {
+      rv = request->read() ?
+          InternalReadData(request->index(), request->offset(),
+                           request->buf(), request->buf_len()) :
+          net::ERR_FAILED;
+      delete request;
+    }
+    if (callback)
+      results.push_back(std::make_pair(callback, rv));
+  }
+
+  for (size_t i = 0; i < results.size(); i++)
+    results[i].first->Run(results[i].second);
+
+  ReleaseIO();
+}
+
+int MemoryTierEntry::DoDiskIO(IORequest* request) {
+  DCHECK(disk_entry_);
+  if (request->read()) {
+    pending_reads_++;
+  } else {
+    // A read that is still in progress may overwrite what we copy now.
+    if (pending_reads_)
+      SetNotCacheable();
+    CopyWriteData(request->index(), request->offset(), request->buf(),
+                  request->buf_len(), request->truncate());
+  }
+
+  io_refs_++;
+  int rv = request->Start(disk_entry_);
+  if (rv == net::ERR_IO_PENDING)
+    return rv;
+
+  OnDiskIOComplete(request, rv);
+  delete request;
+  io_refs_--;
+  return rv;
+}
+
+void MemoryTierEntry::OnDiskIOComplete(IORequest* request, int result) {
+  if (!request->read()) {
+    if (result != request->buf_len())
+      SetNotCacheable();
+    return;
+  }
+
+  pending_reads_--;
+  if (result > 0) {
+    CopyReadData(request->index(), request->offset(), request->buf(),
+                 result);
+  }
+}
+
+void MemoryTierEntry::ReleaseIO() {
+  io_refs_--;
+  DCHECK(io_refs_ >= 0);
+  Cleanup();
+}
+
+void MemoryTierEntry::Cleanup() {
+  if (ref_count_ || io_refs_)
+    return;
+
+  if (backend_)
+    backend_->OnEntryClosed(this);
+  delete this;
+}
+
+int MemoryTierEntry::InternalReadData(int index, int offset,
+                                      net::IOBuffer* buf, int buf_len) {
+  int entry_size = static_cast<int>(record_.data[index].size());
+  if (offset >= entry_size || offset < 0 || !buf_len)
+    return 0;
+
+  if (buf_len < 0)
+    return net::ERR_INVALID_ARGUMENT;
+
+  if (offset + buf_len > entry_size)
+    buf_len = entry_size - offset;
+
+  record_.last_used = Time::Now();
+  memcpy(buf->data(), &(record_.data[index])[offset], buf_len);
+  return buf_len;
+}
+
+void MemoryTierEntry::InternalWriteData(int index, int offset,
+                                        net::IOBuffer* buf, int buf_len,
+                                        bool truncate) {
+  // Growing the stream fills any hole left by |offset| with zeros.
+  std::vector<char>& data = record_.data[index];
+  int entry_size = static_cast<int>(data.size());
+  if (entry_size < offset + buf_len || (truncate && entry_size > offset))
+    data.resize(offset + buf_len);
+
+  Time current = Time::Now();
+  record_.last_used = current;
+  record_.last_modified = current;
+
+  if (buf_len)
+    memcpy(&data[offset], buf->data(), buf_len);
+}
+
+void MemoryTierEntry::CopyReadData(int index, int offset, net::IOBuffer* buf,
+                                   int len) {
+  // Only data that extends the copy without leaving holes is kept.
+  if (!cacheable_ || offset != static_cast<int>(record_.data[index].size()))
+    return;
+
+  if (record_.GetSize() + len > backend_->max_entry_size())
+    return SetNotCacheable();
+
+  record_.data[index].insert(record_.data[index].end(), buf->data(),
+                             buf->data() + len);
+}
+
+void MemoryTierEntry::CopyWriteData(int index, int offset, net::IOBuffer* buf,
+                                    int buf_len, bool truncate) {
+  if (!cacheable_ || offset < 0 || buf_len < 0)
+    return;
+
+  // The disk entry has data that we have not seen before |offset|.
+  if (offset > static_cast<int>(record_.data[index].size()))
+    return SetNotCacheable();
+
+  if (offset + buf_len > backend_->max_entry_size())
+    return SetNotCacheable();
+
+  InternalWriteData(index, offset, buf, buf_len, truncate);
+  if (record_.GetSize() > backend_->max_entry_size())
+    SetNotCacheable();
+}
+
+void MemoryTierEntry::SetNotCacheable() {
+  cacheable_ = false;
+
+  // The data is not needed anymore once the disk entry has it.
+  if (disk_entry_) {
+    for (int i = 0; i < MemoryTierRecord::kNumStreams; i++)
+      std::vector<char>().swap(record_.data[i]);
+  }
+}
+
+}  // namespace disk_cache
@@ -0,0 +1,158 @@
+// Copyright (c) 2011 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// See net/disk_cache/disk_cache.h for the public interface of the cache.
+
+#ifndef NET_DISK_CACHE_MEMORY_TIER_ENTRY_H_
+#define NET_DISK_CACHE_MEMORY_TIER_ENTRY_H_
+#pragma once
+
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/time.h"
+#include "net/base/completion_callback.h"
+#include "net/disk_cache/disk_cache.h"
+
+namespace disk_cache {
+
+class MemoryTierBackend;
+
+// The contents of an entry, as kept by the memory tier.
+struct MemoryTierRecord {
+  enum {
+    kNumStreams = 3
+  };
+
+  MemoryTierRecord();
+  ~MemoryTierRecord();
+
+  // Returns the number of bytes of memory used by the record.
+  int GetSize() const;
+
+  // Exchanges the contents of this record with those of |other|.
+  void Swap(MemoryTierRecord* other);
+
+  std::string key;
+  base::Time last_used;
+  base::Time last_modified;
+  std::vector<char> data[kNumStreams];
+};
+
+// This class implements the Entry interface for MemoryTierBackend. An entry
+// found on the memory tier is served from memory, and it only opens the entry
+// of the disk cache when it has to write to it. Any other entry wraps an entry
+// of the disk cache, and keeps a copy of the data it reads or writes so that
+// the entry can move to the memory tier when closed, if the copy is complete.
+class MemoryTierEntry : public Entry {
+ public:
+  // Wraps |disk_entry|.
+  MemoryTierEntry(MemoryTierBackend* backend, Entry* disk_entry,
+                  bool created);
+
+  // Takes the contents of the entry from |record|.
+  MemoryTierEntry(MemoryTierBackend* backend, MemoryTierRecord* record);
+
+  // Adds a reference for a new user of the entry.
+  void Open();
+
+  // Marks the entry as removed from the cache, so that it is not kept by the
+  // memory tier when closed.
+  void InternalDoom();
+
+  // Called when the backend goes away before the entry is closed. Returns
+  // true if the entry is still waiting for the disk entry, in which case
+  // CancelOpen() has to be called once the disk cache is gone.
+  bool OnBackendDestroyed();
+  void CancelOpen();
+
+  // Returns true if all the data of the entry is in memory, and it is small
+  // enough to be kept by the memory tier.
+  bool IsComplete() const;
+
+  // Gives away the contents of the entry, to be kept by the memory tier.
+  void ReleaseRecord(MemoryTierRecord* record);
+
+  // Keeps the entry away from the memory tier.
+  void SetNotCacheable();
+
+  const std::string& key() const { return record_.key; }
+  bool doomed() const { return doomed_; }
+
+  // Entry interface.
+  virtual void Doom();
+  virtual void Close();
+  virtual std::string GetKey() const;
+  virtual base::Time GetLastUsed() const;
+  virtual base::Time GetLastModified() const;
+  virtual int32 GetDataSize(int index) const;
+  virtual int ReadData(int index, int offset, net::IOBuffer* buf, int buf_len,
+                       net::CompletionCallback* completion_callback);
+  virtual int WriteData(int index, int offset, net::IOBuffer* buf, int buf_len,
+                        net::CompletionCallback* completion_callback,
+                        bool truncate);
+  virtual int ReadSparseData(int64 offset, net::IOBuffer* buf, int buf_len,
+                             net::CompletionCallback* completion_callback);
+  virtual int WriteSparseData(int64 offset, net::IOBuffer* buf, int buf_len,
+                              net::CompletionCallback* completion_callback);
+  virtual int GetAvailableRange(int64 offset, int len, int64* start,
+                                CompletionCallback* callback);
+  virtual bool CouldBeSparse() const;
+  virtual void CancelSparseIO();
+  virtual int ReadyForSparseIO(net::CompletionCallback* completion_callback);
+
+ private:
+  class IORequest;
+
+  ~MemoryTierEntry();
+
+  // Opens the entry of the disk cache before the first write of an entry that
+  // is served from memory.
+  int OpenDiskEntry();
+  void OnDiskEntryOpened(int result);
+
+  // Issues |request| to the entry of the disk cache.
+  int DoDiskIO(IORequest* request);
+
+  // Called when |request| is done, to update the copy of the data.
+  void OnDiskIOComplete(IORequest* request, int result);
+
+  // Releases the reference held by IO in progress.
+  void ReleaseIO();
+
+  // Deletes the object when nobody is using it.
+  void Cleanup();
+
+  // Reads or writes the copy of the data.
+  int InternalReadData(int index, int offset, net::IOBuffer* buf, int buf_len);
+  void InternalWriteData(int index, int offset, net::IOBuffer* buf,
+                         int buf_len, bool truncate);
+
+  // Updates the copy of the data with the result of IO on the disk entry.
+  void CopyReadData(int index, int offset, net::IOBuffer* buf, int len);
+  void CopyWriteData(int index, int offset, net::IOBuffer* buf, int buf_len,
+                     bool truncate);
+
+  MemoryTierRecord record_;  // The copy of the data.
+  MemoryTierBackend* backend_;  // Back pointer to the cache.
+  Entry* disk_entry_;  // The entry of the disk cache, if open.
+  Entry* pending_disk_entry_;
+  std::deque<IORequest*> queued_io_;  // IO waiting for the disk entry.
+  int ref_count_;
+  int io_refs_;  // IO in progress, and the opening of the disk entry.
+  int pending_reads_;
+  bool opening_;  // True while the disk entry is being opened.
+  bool open_failed_;  // True if the disk entry could not be opened.
+  bool cacheable_;  // False if the copy of the data cannot be trusted.
+  bool doomed_;  // True if this entry was removed from the cache.
+  net::CompletionCallbackImpl<MemoryTierEntry> open_callback_;
+
+  DISALLOW_COPY_AND_ASSIGN(MemoryTierEntry);
+};
+
+}  // namespace disk_cache
+
+#endif  // NET_DISK_CACHE_MEMORY_TIER_ENTRY_H_
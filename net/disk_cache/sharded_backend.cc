@@ -0,0 +1,428 @@
+// Copyright (c) 2011 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/sharded_backend.h"
+
+#include <algorithm>
+
+#include "base/compiler_specific.h"
+#include "base/file_path.h"
+#include "base/logging.h"
+#include "base/memory/ref_counted.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/message_loop.h"
+#include "base/message_loop_proxy.h"
+#include "base/stl_util-inl.h"
+#include "base/string_util.h"
+#include "base/stringprintf.h"
+#include "base/sys_info.h"
+#include "base/task.h"
+#include "base/threading/thread.h"
+#include "net/base/net_errors.h"
+#include "net/disk_cache/backend_impl.h"
+#include "net/disk_cache/hash.h"
+
+namespace {
+
+// The size BackendImpl settles for when it has to figure it out by itself is
+// capped at this value (see BackendImpl::AdjustMaxCacheSize()).
+const int kMaxDefaultCacheSize = 4 * 80 * 1024 * 1024;
+
+// Returns the folder used by shard |index| of the cache at |path|.
+FilePath GetShardPath(const FilePath& path, int index) {
+  return path.AppendASCII(base::StringPrintf("shard_%d", index));
+}
+
+}  // namespace
+
+namespace disk_cache {
+
+// This class takes care of building an instance of the backend: it starts the
+// cache threads, figures out the size of each shard and creates the shards one
+// after another, so that the code shared by all of them is never initialized
+// from two threads at once.
+class ShardedBackend::Creator {
+ public:
+  Creator(const FilePath& path, bool force, int max_bytes,
+          net::CacheType type, uint32 flags, int num_shards,
+          net::NetLog* net_log, Backend** backend,
+          CompletionCallback* callback)
+      : path_(path), force_(force), max_bytes_(max_bytes), type_(type),
+        flags_(flags), num_shards_(num_shards), net_log_(net_log),
+        backend_(backend), callback_(callback), cache_(new ShardedBackend),
+        shard_(NULL),
+        origin_thread_(base::MessageLoopProxy::CreateForCurrentThread()),
+        ALLOW_THIS_IN_INITIALIZER_LIST(
+            my_callback_(this, &Creator::OnIOComplete)) {
+  }
+  ~Creator() {}
+
+  // Creates the backend.
+  int Run();
+
+  // Callback implementation.
+  void OnIOComplete(int result);
+
+ private:
+  // Runs on the first cache thread, to pick a size for the whole cache when
+  // the caller didn't.
+  static void ComputeMaxSize(Creator* creator, const FilePath& path);
+  static void OnMaxSizeComputed(Creator* creator, int max_bytes);
+
+  // Starts the creation of the next shard.
+  void CreateShard();
+
+  void DoCallback(int result);
+
+  FilePath path_;
+  bool force_;
+  int max_bytes_;
+  net::CacheType type_;
+  uint32 flags_;
+  int num_shards_;
+  net::NetLog* net_log_;
+  Backend** backend_;
+  CompletionCallback* callback_;
+  ShardedBackend* cache_;
+  Backend* shard_;
+  scoped_refptr<base::MessageLoopProxy> origin_thread_;
+  net::CompletionCallbackImpl<Creator> my_callback_;
+
+  DISALLOW_COPY_AND_ASSIGN(Creator);
+};
+
+int ShardedBackend::Creator::Run() {
+  for (int i = 0; i < num_shards_; i++) {
+    base::Thread* thread =
+        new base::Thread(base::StringPrintf("CacheShard%d", i).c_str());
+    cache_->threads_.push_back(thread);
+    if (!thread->StartWithOptions(
+            base::Thread::Options(MessageLoop::TYPE_IO, 0))) {
+      delete cache_;
+      delete this;
+      return net::ERR_FAILED;
+    }
+  }
+
+  if (max_bytes_) {
+    CreateShard();
+  } else {
+    // Looking at the disk may block, so do it on a cache thread.
+    cache_->threads_[0]->message_loop()->PostTask(FROM_HERE,
+        NewRunnableFunction(&Creator::ComputeMaxSize, this, path_));
+  }
+  return net::ERR_IO_PENDING;
+}
+
+// Static.
+void ShardedBackend::Creator::ComputeMaxSize(Creator* creator,
+                                             const FilePath& path) {
+  int max_bytes = kMaxDefaultCacheSize;
+  int64 available = base::SysInfo::AmountOfFreeDiskSpace(path.DirName());
+  if (available >= 0)
+    max_bytes = std::min(PreferedCacheSize(available), kMaxDefaultCacheSize);
+
+  creator->origin_thread_->PostTask(FROM_HERE,
+      NewRunnableFunction(&Creator::OnMaxSizeComputed, creator, max_bytes));
+}
+
+// Static.
+void ShardedBackend::Creator::OnMaxSizeComputed(Creator* creator,
+                                                int max_bytes) {
+  creator->max_bytes_ = max_bytes;
+  creator->CreateShard();
+}
+
+void ShardedBackend::Creator::CreateShard() {
+  int index = static_cast<int>(cache_->shards_.size());
+  int rv = BackendImpl::CreateBackend(
+      GetShardPath(path_, index), force_, max_bytes_ / num_shards_, type_,
+      flags_, cache_->threads_[index]->message_loop_proxy(), net_log_, &shard_,
+      &my_callback_);
+  DCHECK_EQ(net::ERR_IO_PENDING, rv);
+}
+
+void ShardedBackend::Creator::OnIOComplete(int result) {
+  if (result != net::OK)
+    return DoCallback(result);
+
+  cache_->shards_.push_back(shard_);
+  shard_ = NULL;
+  if (static_cast<int>(cache_->shards_.size()) < num_shards_)
+    return CreateShard();
+
+  DoCallback(net::OK);
+}
+
+void ShardedBackend::Creator::DoCallback(int result) {
+  DCHECK_NE(net::ERR_IO_PENDING, result);
+  if (result == net::OK) {
+    *backend_ = cache_;
+  } else {
+    LOG(ERROR) << "Unable to create cache";
+    *backend_ = NULL;
+    delete cache_;
+  }
+  callback_->Run(result);
+  delete this;
+}
+
+// ------------------------------------------------------------------------
+
+// Base class for the operations that span several shards. The request deletes
+// itself once it invokes the callback of the user, or when the backend goes
+// away.
+class ShardedBackend::Request {
+ public:
+  Request(ShardedBackend* backend, CompletionCallback* callback)
+      : backend_(backend), callback_(callback) {
+    backend_->requests_.insert(this);
+  }
+  virtual ~Request() {}
+
+ protected:
+  void Complete(int result) {
+    DCHECK_NE(net::ERR_IO_PENDING, result);
+    CompletionCallback* callback = callback_;
+    backend_->OnRequestComplete(this);
+    delete this;
+    if (callback)
+      callback->Run(result);
+  }
+
+  ShardedBackend* backend_;
+  CompletionCallback* callback_;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(Request);
+};
+
+// Dooms entries on every shard, and completes when all of them are done.
+class ShardedBackend::DoomRequest : public ShardedBackend::Request {
+ public:
+  enum Operation {
+    DOOM_ALL,
+    DOOM_BETWEEN,
+    DOOM_SINCE
+  };
+
+  DoomRequest(ShardedBackend* backend, Operation operation,
+              const base::Time initial_time, const base::Time end_time,
+              CompletionCallback* callback)
+      : Request(backend, callback), operation_(operation),
+        initial_time_(initial_time), end_time_(end_time), num_pending_(0),
+        result_(net::OK),
+        ALLOW_THIS_IN_INITIALIZER_LIST(
+            my_callback_(this, &DoomRequest::OnIOComplete)) {
+  }
+
+  // Starts the operation on |shard|.
+  void Start(Backend* shard) {
+    num_pending_++;
+    int rv;
+    switch (operation_) {
+      case DOOM_ALL:
+        rv = shard->DoomAllEntries(&my_callback_);
+        break;
+      case DOOM_BETWEEN:
+        rv = shard->DoomEntriesBetween(initial_time_, end_time_,
+                                       &my_callback_);
+        break;
+      case DOOM_SINCE:
+        rv = shard->DoomEntriesSince(initial_time_, &my_callback_);
+        break;
+      default:
+        NOTREACHED();
+        rv = net::ERR_UNEXPECTED;
+    }
+    DCHECK_EQ(net::ERR_IO_PENDING, rv);
+  }
+
+  void OnIOComplete(int result) {
+    if (result != net::OK)
+      result_ = result;
+    if (!--num_pending_)
+      Complete(result_);
+  }
+
+ private:
+  Operation operation_;
+  base::Time initial_time_;
+  base::Time end_time_;
+  int num_pending_;
+  int result_;
+  net::CompletionCallbackImpl<DoomRequest> my_callback_;
+
+  DISALLOW_COPY_AND_ASSIGN(DoomRequest);
+};
+
+// The iterator handed out to the user walks the shards in order.
+struct ShardedBackend::Iterator {
+  Iterator() : shard(0), shard_iter(NULL) {}
+
+  size_t shard;
+  void* shard_iter;
+};
+
+// Opens the next entry of an enumeration, moving on to the next shard when
+// the current one runs out of entries.
+class ShardedBackend::EnumerationRequest : public ShardedBackend::Request {
+ public:
+  EnumerationRequest(ShardedBackend* backend, Iterator* iterator,
+                     Entry** next_entry, CompletionCallback* callback)
+      : Request(backend, callback), iterator_(iterator),
+        next_entry_(next_entry),
+        ALLOW_THIS_IN_INITIALIZER_LIST(
+            my_callback_(this, &EnumerationRequest::OnIOComplete)) {
+  }
+
+  void Start() {
+    int rv = backend_->shards_[iterator_->shard]->OpenNextEntry(
+        &iterator_->shard_iter, next_entry_, &my_callback_);
+    DCHECK_EQ(net::ERR_IO_PENDING, rv);
+  }
+
+  void OnIOComplete(int result) {
+    // The shard ends its own enumeration when it runs out of entries.
+    if (result == net::ERR_FAILED &&
+        iterator_->shard + 1 < backend_->shards_.size()) {
+      iterator_->shard++;
+      iterator_->shard_iter = NULL;
+      return Start();
+    }
+    Complete(result);
+  }
+
+ private:
+  Iterator* iterator_;
+  Entry** next_entry_;
+  net::CompletionCallbackImpl<EnumerationRequest> my_callback_;
+
+  DISALLOW_COPY_AND_ASSIGN(EnumerationRequest);
+};
+
+// ------------------------------------------------------------------------
+
+ShardedBackend::ShardedBackend() {
+}
+
+ShardedBackend::~ShardedBackend() {
+  // Each shard waits for its thread to clean up, so the threads go last. The
+  // shards don't invoke the callbacks of pending requests when they go away.
+  STLDeleteElements(&shards_);
+  STLDeleteElements(&requests_);
+  STLDeleteElements(&threads_);
+}
+
+// Static.
+int ShardedBackend::CreateBackend(const FilePath& full_path, bool force,
+                                  int max_bytes, net::CacheType type,
+                                  uint32 flags, int num_shards,
+                                  net::NetLog* net_log, Backend** backend,
+                                  CompletionCallback* callback) {
+  DCHECK(callback);
+  DCHECK_NE(net::MEMORY_CACHE, type);
+  if (!num_shards)
+    num_shards = kDefaultNumShards;
+  Creator* creator = new Creator(full_path, force, max_bytes, type, flags,
+                                 num_shards, net_log, backend, callback);
+  // This object will self-destroy when finished.
+  return creator->Run();
+}
+
+int32 ShardedBackend::GetEntryCount() const {
+  int32 count = 0;
+  for (size_t i = 0; i < shards_.size(); i++)
+    count += shards_[i]->GetEntryCount();
+  return count;
+}
+
+int ShardedBackend::OpenEntry(const std::string& key, Entry** entry,
+                              CompletionCallback* callback) {
+  return ShardForKey(key)->OpenEntry(key, entry, callback);
+}
+
+int ShardedBackend::CreateEntry(const std::string& key, Entry** entry,
+                                CompletionCallback* callback) {
+  return ShardForKey(key)->CreateEntry(key, entry, callback);
+}
+
+int ShardedBackend::DoomEntry(const std::string& key,
+                              CompletionCallback* callback) {
+  return ShardForKey(key)->DoomEntry(key, callback);
+}
+
+int ShardedBackend::DoomAllEntries(CompletionCallback* callback) {
+  return DoomOnAllShards(new DoomRequest(this, DoomRequest::DOOM_ALL,
+                                         base::Time(), base::Time(),
+                                         callback));
+}
+
+int ShardedBackend::DoomEntriesBetween(const base::Time initial_time,
+                                       const base::Time end_time,
+                                       CompletionCallback* callback) {
+  return DoomOnAllShards(new DoomRequest(this, DoomRequest::DOOM_BETWEEN,
+                                         initial_time, end_time, callback));
+}
+
+int ShardedBackend::DoomEntriesSince(const base::Time initial_time,
+                                     CompletionCallback* callback) {
+  return DoomOnAllShards(new DoomRequest(this, DoomRequest::DOOM_SINCE,
+                                         initial_time, base::Time(),
+                                         callback));
+}
+
+int ShardedBackend::OpenNextEntry(void** iter, Entry** next_entry,
+                                  CompletionCallback* callback) {
+  DCHECK(callback);
+  Iterator* iterator = reinterpret_cast<Iterator*>(*iter);
+  if (!iterator) {
+    iterator = new Iterator;
+    *iter = iterator;
+  }
+  EnumerationRequest* request =
+      new EnumerationRequest(this, iterator, next_entry, callback);
+  request->Start();
+  return net::ERR_IO_PENDING;
+}
+
+void ShardedBackend::EndEnumeration(void** iter) {
+  scoped_ptr<Iterator> iterator(reinterpret_cast<Iterator*>(*iter));
+  *iter = NULL;
+  if (iterator.get() && iterator->shard_iter)
+    shards_[iterator->shard]->EndEnumeration(&iterator->shard_iter);
+}
+
+void ShardedBackend::GetStats(StatsItems* stats) {
+  for (size_t i = 0; i < shards_.size(); i++) {
+    StatsItems shard_stats;
+    shards_[i]->GetStats(&shard_stats);
+    for (StatsItems::iterator it = shard_stats.begin();
+         it != shard_stats.end(); ++it) {
+      stats->push_back(std::make_pair(
+          base::StringPrintf("Shard %d: %s", static_cast<int>(i),
+                             it->first.c_str()),
+          it->second));
+    }
+  }
+}
+
+Backend* ShardedBackend::ShardForKey(const std::string& key) const {
+  // Each shard indexes its entries with the low bits of the same hash, so
+  // pick the shard with the high bits to keep all of its table in use.
+  return shards_[(Hash(key) >> 24) % shards_.size()];
+}
+
+int ShardedBackend::DoomOnAllShards(DoomRequest* request) {
+  DCHECK(request);
+  for (size_t i = 0; i < shards_.size(); i++)
+    request->Start(shards_[i]);
+  return net::ERR_IO_PENDING;
+}
+
+void ShardedBackend::OnRequestComplete(Request* request) {
+  requests_.erase(request);
+}
+
+}  // namespace disk_cache
@@ -0,0 +1,102 @@
+// Copyright (c) 2011 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// See net/disk_cache/disk_cache.h for the public interface of the cache.
+
+#ifndef NET_DISK_CACHE_SHARDED_BACKEND_H_
+#define NET_DISK_CACHE_SHARDED_BACKEND_H_
+#pragma once
+
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "net/base/cache_type.h"
+#include "net/disk_cache/disk_cache.h"
+
+class FilePath;
+
+namespace base {
+class Thread;
+}
+
+namespace net {
+class NetLog;
+}
+
+namespace disk_cache {
+
+// This class implements the Backend interface on top of a few instances of
+// BackendImpl, the shards, each one with its own index, eviction lists and
+// cache thread. An entry lives in the shard selected by the hash of its key,
+// so operations on entries of different shards run in parallel, while all the
+// operations on a given entry are still executed in order by a single thread.
+//
+// Every shard stores its files on a folder of its own under the cache folder,
+// and gets the same share of the maximum size of the cache.
+class ShardedBackend : public Backend {
+ public:
+  static const int kDefaultNumShards = 4;
+
+  virtual ~ShardedBackend();
+
+  // Returns a new backend split in |num_shards| shards, or kDefaultNumShards
+  // if zero is passed. The other arguments are those of
+  // BackendImpl::CreateBackend(), but this backend runs its own cache threads.
+  static int CreateBackend(const FilePath& full_path, bool force,
+                           int max_bytes, net::CacheType type,
+                           uint32 flags, int num_shards, net::NetLog* net_log,
+                           Backend** backend, CompletionCallback* callback);
+
+  // Backend interface.
+  virtual int32 GetEntryCount() const;
+  virtual int OpenEntry(const std::string& key, Entry** entry,
+                        CompletionCallback* callback);
+  virtual int CreateEntry(const std::string& key, Entry** entry,
+                          CompletionCallback* callback);
+  virtual int DoomEntry(const std::string& key, CompletionCallback* callback);
+  virtual int DoomAllEntries(CompletionCallback* callback);
+  virtual int DoomEntriesBetween(const base::Time initial_time,
+                                 const base::Time end_time,
+                                 CompletionCallback* callback);
+  virtual int DoomEntriesSince(const base::Time initial_time,
+                               CompletionCallback* callback);
+  virtual int OpenNextEntry(void** iter, Entry** next_entry,
+                            CompletionCallback* callback);
+  virtual void EndEnumeration(void** iter);
+  virtual void GetStats(
+      std::vector<std::pair<std::string, std::string> >* stats);
+
+ private:
+  class Creator;
+  class Request;
+  class DoomRequest;
+  class EnumerationRequest;
+  struct Iterator;
+
+  ShardedBackend();
+
+  // Returns the shard that stores the entry for |key|.
+  Backend* ShardForKey(const std::string& key) const;
+
+  // Starts |request| on every shard.
+  int DoomOnAllShards(DoomRequest* request);
+
+  // Called by |request| when it is done, before it deletes itself.
+  void OnRequestComplete(Request* request);
+
+  std::vector<base::Thread*> threads_;
+  std::vector<Backend*> shards_;
+
+  // Operations spanning several shards that are still in progress.
+  std::set<Request*> requests_;
+
+  DISALLOW_COPY_AND_ASSIGN(ShardedBackend);
+};
+
+}  // namespace disk_cache
+
+#endif  // NET_DISK_CACHE_SHARDED_BACKEND_H_
@@ -60,7 +60,9 @@ static const char* kCounterNames[] = {
   "Fatal error",
   "Last report",
   "Last report timer",
-  "Doom recent entries"
+  "Doom recent entries",
+  "Memory tier hit",
+  "Memory tier miss"
 };
 COMPILE_ASSERT(arraysize(kCounterNames) == disk_cache::Stats::MAX_COUNTER,
                update_the_names);
@@ -116,7 +118,9 @@ bool CreateStats(BackendImpl* backend, Addr* address, OnDiskStats* stats) {
   return StoreStats(backend, *address, stats);
 }
 
-Stats::Stats() : backend_(NULL), size_histogram_(NULL) {
+Stats::Stats() : backend_(NULL), storage_addr_(0), size_histogram_(NULL) {
+  memset(data_sizes_, 0, sizeof(data_sizes_));
+  memset(counters_, 0, sizeof(counters_));
 }
 
 Stats::~Stats() {
@@ -198,16 +202,35 @@ void Stats::GetItems(StatsItems* items) {
   }
 
   for (int i = MIN_COUNTER + 1; i < MAX_COUNTER; i++) {
+    if (i == MEMORY_HIT || i == MEMORY_MISS)
+      continue;
     item.first = kCounterNames[i];
     item.second = base::StringPrintf("0x%" PRIx64, counters_[i]);
     items->push_back(item);
   }
 }
 
+void Stats::GetMemoryTierItems(StatsItems* items) {
+  std::pair<std::string, std::string> item;
+  for (int i = MEMORY_HIT; i <= MEMORY_MISS; i++) {
+    item.first = kCounterNames[i];
+    item.second = base::StringPrintf("0x%" PRIx64, counters_[i]);
+    items->push_back(item);
+  }
+
+  item.first = "Memory tier hit ratio";
+  item.second = base::StringPrintf("%d%%", GetMemoryHitRatio());
+  items->push_back(item);
+}
+
 int Stats::GetHitRatio() const {
   return GetRatio(OPEN_HIT, OPEN_MISS);
 }
 
+int Stats::GetMemoryHitRatio() const {
+  return GetRatio(MEMORY_HIT, MEMORY_MISS);
+}
+
 int Stats::GetResurrectRatio() const {
   return GetRatio(RESURRECT_HIT, CREATE_HIT);
 }
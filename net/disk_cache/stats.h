@@ -46,6 +46,8 @@ class Stats {
     LAST_REPORT,  // Time of the last time we sent a report.
     LAST_REPORT_TIMER,  // Timer count of the last time we sent a report.
     DOOM_RECENT,  // The cache was partially cleared.
+    MEMORY_HIT,  // An entry was opened from the memory tier.
+    MEMORY_MISS,  // The memory tier had to open an entry from the disk.
     MAX_COUNTER
   };
 
@@ -62,8 +64,11 @@ class Stats {
   void SetCounter(Counters counter, int64 value);
   int64 GetCounter(Counters counter) const;
 
+  // Lists the counters of the disk cache, and those of the memory tier.
   void GetItems(StatsItems* items);
+  void GetMemoryTierItems(StatsItems* items);
   int GetHitRatio() const;
+  int GetMemoryHitRatio() const;
   int GetResurrectRatio() const;
   void ResetRatios();
 
@@ -10,6 +10,9 @@
 // The child application has two threads: one to exercise the cache in an
 // infinite loop, and another one to asynchronously kill the process.
 
+// Pass --sharded to the main application to stress a ShardedBackend instead of
+// a single BackendImpl.
+
 // A regular build should never crash.
 // To test that the disk cache doesn't generate critical errors with regular
 // application level crashes, add the following code and re-compile:
@@ -44,18 +47,23 @@
 #include "net/disk_cache/backend_impl.h"
 #include "net/disk_cache/disk_cache.h"
 #include "net/disk_cache/disk_cache_test_util.h"
+#include "net/disk_cache/sharded_backend.h"
 
 using base::Time;
 
 const int kError = -1;
 const int kExpectedCrash = 100;
 
+const char kShardedSwitch[] = "sharded";
+
 // Starts a new process.
-int RunSlave(int iteration) {
+int RunSlave(int iteration, bool sharded) {
   FilePath exe;
   PathService::Get(base::FILE_EXE, &exe);
 
   CommandLine cmdline(exe);
+  if (sharded)
+    cmdline.AppendSwitch(kShardedSwitch);
   cmdline.AppendArg(base::IntToString(iteration));
 
   base::ProcessHandle handle;
@@ -73,9 +81,9 @@ int RunSlave(int iteration) {
 }
 
 // Main loop for the master process.
-int MasterCode() {
+int MasterCode(bool sharded) {
   for (int i = 0; i < 100000; i++) {
-    int ret = RunSlave(i);
+    int ret = RunSlave(i, sharded);
     if (kExpectedCrash != ret)
       return ret;
   }
@@ -90,7 +98,7 @@ int MasterCode() {
 // This thread will loop forever, adding and removing entries from the cache.
 // iteration is the current crash cycle, so the entries on the cache are marked
 // to know which instance of the application wrote them.
-void StressTheCache(int iteration) {
+void StressTheCache(int iteration, bool sharded) {
   int cache_size = 0x800000;  // 8MB
   FilePath path = GetCacheFilePath().InsertBeforeExtensionASCII("_stress");
 
@@ -101,10 +109,18 @@ void StressTheCache(int iteration) {
 
   TestCompletionCallback cb;
   disk_cache::Backend* cache;
-  int rv = disk_cache::BackendImpl::CreateBackend(
-               path, false, cache_size, net::DISK_CACHE,
-               disk_cache::kNoLoadProtection | disk_cache::kNoRandom,
-               cache_thread.message_loop_proxy(), NULL, &cache, &cb);
+  uint32 flags = disk_cache::kNoLoadProtection | disk_cache::kNoRandom;
+  int rv;
+  if (sharded) {
+    // The shards run on threads of their own.
+    rv = disk_cache::ShardedBackend::CreateBackend(
+             path, false, cache_size, net::DISK_CACHE, flags, 0, NULL, &cache,
+             &cb);
+  } else {
+    rv = disk_cache::BackendImpl::CreateBackend(
+             path, false, cache_size, net::DISK_CACHE, flags,
+             cache_thread.message_loop_proxy(), NULL, &cache, &cb);
+  }
 
   if (cb.GetResult(rv) != net::OK) {
     printf("Unable to initialize cache.\n");
@@ -222,8 +238,12 @@ int main(int argc, const char* argv[]) {
   // Setup an AtExitManager so Singleton objects will be destructed.
   base::AtExitManager at_exit_manager;
 
-  if (argc < 2)
-    return MasterCode();
+  CommandLine::Init(argc, argv);
+  const CommandLine& command_line = *CommandLine::ForCurrentProcess();
+  bool sharded = command_line.HasSwitch(kShardedSwitch);
+
+  if (command_line.args().empty())
+    return MasterCode(sharded);
 
   logging::SetLogAssertHandler(CrashHandler);
 
@@ -232,13 +252,13 @@ int main(int argc, const char* argv[]) {
   MessageLoop message_loop(MessageLoop::TYPE_IO);
 
   char* end;
-  long int iteration = strtol(argv[1], &end, 0);
+  long int iteration = strtol(argv[argc - 1], &end, 0);
 
   if (!StartCrashThread()) {
     printf("failed to start thread\n");
     return kError;
   }
 
-  StressTheCache(iteration);
+  StressTheCache(iteration, sharded);
   return 0;
 }
@@ -32,6 +32,7 @@ HttpStreamParser::HttpStreamParser(ClientSocketHandle* connection,
       read_buf_(read_buffer),
       read_buf_unused_offset_(0),
       response_header_start_offset_(-1),
+      response_header_search_offset_(0),
       response_body_length_(-1),
       response_body_read_(0),
       chunked_decoder_(NULL),
@@ -343,9 +344,15 @@ int HttpStreamParser::DoSendBody(int result) {
 int HttpStreamParser::DoReadHeaders() {
   io_state_ = STATE_READ_HEADERS_COMPLETE;
 
-  // Grow the read buffer if necessary.
-  if (read_buf_->RemainingCapacity() == 0)
-    read_buf_->SetCapacity(read_buf_->capacity() + kHeaderBufInitialSize);
+  // Grow the read buffer if necessary.  Doubling it keeps large headers that
+  // arrive over many reads from being copied by realloc() again and again.
+  if (read_buf_->RemainingCapacity() == 0) {
+    int capacity = std::max(2 * read_buf_->capacity(),
+                            static_cast<int>(kHeaderBufInitialSize));
+    capacity = std::min(capacity,
+                        read_buf_unused_offset_ + kMaxHeaderBufSize);
+    read_buf_->SetCapacity(capacity);
+  }
 
   // http://crbug.com/16371: We're seeing |user_buf_->data()| return NULL.
   // See if the user is passing in an IOBuffer with a NULL |data_|.
@@ -430,6 +437,7 @@ int HttpStreamParser::DoReadHeadersComplete(int result) {
       // tunnel.
       io_state_ = STATE_REQUEST_SENT;
       response_header_start_offset_ = -1;
+      response_header_search_offset_ = 0;
     } else {
       io_state_ = STATE_BODY_PENDING;
       CalculateResponseBodySize();
@@ -567,10 +575,16 @@ int HttpStreamParser::ParseResponseHeaders() {
   }
 
   if (response_header_start_offset_ >= 0) {
+    // Pick up the search where the previous one stopped, rather than scanning
+    // all of the headers again each time more of them arrive.
+    int search_start = std::max(response_header_start_offset_,
+                                response_header_search_offset_ - 2);
+    response_header_search_offset_ =
+        read_buf_->offset() - read_buf_unused_offset_;
     end_offset = HttpUtil::LocateEndOfHeaders(
         read_buf_->StartOfBuffer() + read_buf_unused_offset_,
-        read_buf_->offset() - read_buf_unused_offset_,
-        response_header_start_offset_);
+        response_header_search_offset_,
+        search_start);
   } else if (read_buf_->offset() - read_buf_unused_offset_ >= 8) {
     // Enough data to decide that this is an HTTP/0.9 response.
     // 8 bytes = (4 bytes of junk) + "http".length()
@@ -92,14 +92,13 @@ class HttpStreamParser  : public ChunkCallback {
     STATE_DONE
   };
 
-  // The number of bytes by which the header buffer is grown when it reaches
-  // capacity.
+  // The initial size of the header buffer.  It is doubled each time it
+  // reaches capacity.
   enum { kHeaderBufInitialSize = 4096 };
 
   // |kMaxHeaderBufSize| is the number of bytes that the response headers can
   // grow to. If the body start is not found within this range of the
   // response, the transaction will fail with ERR_RESPONSE_HEADERS_TOO_BIG.
-  // Note: |kMaxHeaderBufSize| should be a multiple of |kHeaderBufInitialSize|.
   enum { kMaxHeaderBufSize = 256 * 1024 };  // 256 kilobytes.
 
   // The maximum sane buffer size.
@@ -155,6 +154,10 @@ class HttpStreamParser  : public ChunkCallback {
   // -1 if not found yet.
   int response_header_start_offset_;
 
+  // The amount beyond |read_buf_unused_offset_| that has already been searched
+  // for the end of the headers.
+  int response_header_search_offset_;
+
   // The parsed response headers.  Owned by the caller.
   HttpResponseInfo* response_;
 
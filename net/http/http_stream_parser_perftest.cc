@@ -0,0 +1,122 @@
+// Copyright (c) 2011 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/memory/ref_counted.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/perftimer.h"
+#include "base/stringprintf.h"
+#include "googleurl/src/gurl.h"
+#include "net/base/address_list.h"
+#include "net/base/io_buffer.h"
+#include "net/base/net_errors.h"
+#include "net/base/net_log.h"
+#include "net/base/test_completion_callback.h"
+#include "net/http/http_request_headers.h"
+#include "net/http/http_request_info.h"
+#include "net/http/http_response_headers.h"
+#include "net/http/http_response_info.h"
+#include "net/http/http_stream_parser.h"
+#include "net/socket/client_socket_handle.h"
+#include "net/socket/socket_test_util.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace net {
+
+namespace {
+
+const int kNumResponses = 20000;
+
+// Returns the headers of a typical response to a browser request, with
+// |num_cookies| Set-Cookie headers to make them larger.
+std::string GetResponseHeaders(int num_cookies) {
+  std::string headers =
+      "HTTP/1.1 200 OK\r\n"
+      "Date: Thu, 12 May 2011 18:22:09 GMT\r\n"
+      "Server: Apache/2.2.16 (Unix)\r\n"
+      "Last-Modified: Tue, 10 May 2011 09:41:55 GMT\r\n"
+      "ETag: \"4c5b2-2710-4a2e2b2d0a6c0\"\r\n"
+      "Cache-Control: public, max-age=31536000\r\n"
+      "Expires: Fri, 11 May 2012 18:22:09 GMT\r\n"
+      "Vary: Accept-Encoding\r\n"
+      "Content-Type: text/javascript; charset=utf-8\r\n"
+      "Content-Length: 0\r\n";
+  for (int i = 0; i < num_cookies; ++i) {
+    headers += base::StringPrintf(
+        "Set-Cookie: cookie%d=0123456789abcdef0123456789abcdef; "
+        "expires=Fri, 11 May 2012 18:22:09 GMT; path=/; "
+        "domain=.example.com\r\n", i);
+  }
+  headers += "\r\n";
+  return headers;
+}
+
+// Reads |kNumResponses| copies of |response| through an HttpStreamParser on a
+// MockTCPClientSocket, delivering the response in reads of at most
+// |read_size| bytes, and logs the number of responses parsed per second.
+void TimeReadResponseHeaders(const char* message,
+                             const std::string& response,
+                             int read_size) {
+  std::vector<MockRead> reads;
+  for (size_t offset = 0; offset < response.size(); offset += read_size) {
+    size_t length = std::min(response.size() - offset,
+                             static_cast<size_t>(read_size));
+    reads.push_back(MockRead(false, response.data() + offset, length));
+  }
+
+  HttpRequestInfo request;
+  request.method = "GET";
+  request.url = GURL("http://www.example.com/");
+  HttpRequestHeaders request_headers;
+  TestCompletionCallback callback;
+
+  PerfTimer timer;
+  for (int i = 0; i < kNumResponses; ++i) {
+    StaticSocketDataProvider data(&reads[0], reads.size(), NULL, 0);
+    data.set_connect_data(MockConnect(false, OK));
+    ClientSocket* socket = new MockTCPClientSocket(AddressList(), NULL, &data);
+    ASSERT_EQ(OK, socket->Connect(&callback));
+    ClientSocketHandle handle;
+    handle.set_socket(socket);
+
+    scoped_refptr<GrowableIOBuffer> read_buffer(new GrowableIOBuffer);
+    HttpStreamParser parser(&handle, &request, read_buffer, BoundNetLog());
+    HttpResponseInfo response_info;
+    ASSERT_EQ(OK, parser.SendRequest("GET / HTTP/1.1\r\n", request_headers,
+                                     NULL, &response_info, &callback));
+    ASSERT_EQ(OK, parser.ReadResponseHeaders(&callback));
+    ASSERT_EQ(200, response_info.headers->response_code());
+  }
+  double seconds = timer.Elapsed().InSecondsF();
+
+  LogPerfResult(message, kNumResponses / seconds, "headers/s");
+}
+
+}  // namespace
+
+TEST(HttpStreamParserPerfTest, ReadResponseHeaders) {
+  TimeReadResponseHeaders("Read response headers in one read",
+                          GetResponseHeaders(0), 64 * 1024);
+}
+
+TEST(HttpStreamParserPerfTest, ReadResponseHeadersInSmallReads) {
+  TimeReadResponseHeaders("Read response headers in 32 byte reads",
+                          GetResponseHeaders(0), 32);
+}
+
+TEST(HttpStreamParserPerfTest, ReadLargeResponseHeaders) {
+  TimeReadResponseHeaders("Read 16KB response headers in one read",
+                          GetResponseHeaders(120), 64 * 1024);
+}
+
+TEST(HttpStreamParserPerfTest, ReadLargeResponseHeadersInSmallReads) {
+  TimeReadResponseHeaders("Read 16KB response headers in 256 byte reads",
+                          GetResponseHeaders(120), 256);
+}
+
+}  // namespace net
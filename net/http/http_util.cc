@@ -451,18 +451,21 @@ int HttpUtil::LocateStartOfStatusLine(const char* buf, int buf_len) {
 }
 
 int HttpUtil::LocateEndOfHeaders(const char* buf, int buf_len, int i) {
-  bool was_lf = false;
-  char last_c = '\0';
-  for (; i < buf_len; ++i) {
-    char c = buf[i];
-    if (c == '\n') {
-      if (was_lf)
-        return i + 1;
-      was_lf = true;
-    } else if (c != '\r' || last_c != '\n') {
-      was_lf = false;
-    }
-    last_c = c;
+  // The headers end at a LF which follows another LF, optionally with a CR in
+  // between.  Only the bytes around each LF matter, so hop from one LF to the
+  // next rather than looking at every byte.
+  const int start = i;
+  while (i < buf_len) {
+    const char* lf = static_cast<const char*>(
+        memchr(buf + i, '\n', buf_len - i));
+    if (!lf)
+      break;
+    i = lf - buf;
+    if (i - 1 >= start && buf[i - 1] == '\n')
+      return i + 1;
+    if (i - 2 >= start && buf[i - 1] == '\r' && buf[i - 2] == '\n')
+      return i + 1;
+    ++i;
   }
   return -1;
 }
@@ -122,7 +122,10 @@ class HttpUtil {
   // servers only send back LFs (e.g., Unix-based CGI scripts written using the
   // ASIS Apache module).  This function therefore accepts the pattern LF[CR]LF
   // as end-of-headers (just like Mozilla).
-  // The parameter |i| is the offset within |buf| to begin searching from.
+  // The parameter |i| is the offset within |buf| to begin searching from;
+  // nothing before it is examined.  A search of |buf_len| bytes that failed
+  // can be picked up as more data arrives by searching again from
+  // |buf_len - 2|, as the marker is never more than three bytes long.
   static int LocateEndOfHeaders(const char* buf, int buf_len, int i = 0);
 
   // Assemble "raw headers" in the format required by HttpResponseHeaders.
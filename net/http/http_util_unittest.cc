@@ -193,6 +193,29 @@ TEST(HttpUtilTest, LocateEndOfHeaders) {
   }
 }
 
+TEST(HttpUtilTest, LocateEndOfHeadersResumed) {
+  const char* tests[] = {
+    "foo\r\nbar\r\n\r\njunk",
+    "foo\nbar\n\njunk",
+    "foo\nbar\n\r\njunk",
+    "foo\nbar\r\n\njunk",
+    "foo\r\nbar\r\n\rjunk\r\n\r\n",
+  };
+  for (size_t i = 0; i < ARRAYSIZE_UNSAFE(tests); ++i) {
+    int input_len = static_cast<int>(strlen(tests[i]));
+    int expected = HttpUtil::LocateEndOfHeaders(tests[i], input_len);
+
+    // Splitting the input anywhere before the end of the headers and resuming
+    // the search from two bytes before the split must find the same end.
+    for (int split = 0; split < expected; ++split) {
+      EXPECT_EQ(-1, HttpUtil::LocateEndOfHeaders(tests[i], split));
+      int eoh = HttpUtil::LocateEndOfHeaders(tests[i], input_len,
+                                             std::max(0, split - 2));
+      EXPECT_EQ(expected, eoh) << tests[i] << " split at " << split;
+    }
+  }
+}
+
 TEST(HttpUtilTest, AssembleRawHeaders) {
   struct {
     const char* input;
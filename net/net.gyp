@@ -73,6 +73,16 @@
         'base/dnssec_chain_verifier.h',
         'base/dnssec_keyset.cc',
         'base/dnssec_keyset.h',
+        'base/dns_config.cc',
+        'base/dns_config.h',
+        'base/dns_lookup.cc',
+        'base/dns_lookup.h',
+        'base/dns_query.cc',
+        'base/dns_query.h',
+        'base/dns_response.cc',
+        'base/dns_response.h',
+        'base/dns_transaction.cc',
+        'base/dns_transaction.h',
         'base/dns_util.cc',
         'base/dns_util.h',
         'base/dnsrr_resolver.cc',
@@ -406,6 +416,12 @@
         'disk_cache/in_flight_backend_io.h',
         'disk_cache/in_flight_io.cc',
         'disk_cache/in_flight_io.h',
+        'disk_cache/log_backend_impl.cc',
+        'disk_cache/log_backend_impl.h',
+        'disk_cache/log_entry_impl.cc',
+        'disk_cache/log_entry_impl.h',
+        'disk_cache/log_store.cc',
+        'disk_cache/log_store.h',
         'disk_cache/mapped_file.h',
         'disk_cache/mapped_file_posix.cc',
         'disk_cache/mapped_file_win.cc',
@@ -415,8 +431,14 @@
         'disk_cache/mem_entry_impl.h',
         'disk_cache/mem_rankings.cc',
         'disk_cache/mem_rankings.h',
+        'disk_cache/memory_tier_backend.cc',
+        'disk_cache/memory_tier_backend.h',
+        'disk_cache/memory_tier_entry.cc',
+        'disk_cache/memory_tier_entry.h',
         'disk_cache/rankings.cc',
         'disk_cache/rankings.h',
+        'disk_cache/sharded_backend.cc',
+        'disk_cache/sharded_backend.h',
         'disk_cache/sparse_control.cc',
         'disk_cache/sparse_control.h',
         'disk_cache/stats.cc',
@@ -692,6 +714,8 @@
         'spdy/spdy_settings_storage.h',
         'spdy/spdy_stream.cc',
         'spdy/spdy_stream.h',
+        'spdy/spdy_write_scheduler.cc',
+        'spdy/spdy_write_scheduler.h',
         'udp/datagram_client_socket.h',
         'udp/datagram_server_socket.h',
         'udp/datagram_socket.h',
@@ -894,6 +918,9 @@
         'base/data_url_unittest.cc',
         'base/directory_lister_unittest.cc',
         'base/dnssec_unittest.cc',
+        'base/dns_config_unittest.cc',
+        'base/dns_response_unittest.cc',
+        'base/dns_transaction_unittest.cc',
         'base/dns_util_unittest.cc',
         'base/dnsrr_resolver_unittest.cc',
         'base/escape_unittest.cc',
@@ -938,6 +965,7 @@
         'disk_cache/disk_cache_test_base.cc',
         'disk_cache/disk_cache_test_base.h',
         'disk_cache/entry_unittest.cc',
+        'disk_cache/log_store_unittest.cc',
         'disk_cache/mapped_file_unittest.cc',
         'disk_cache/storage_block_unittest.cc',
         'ftp/ftp_auth_cache_unittest.cc',
@@ -1111,7 +1139,9 @@
       'sources': [
         'base/cookie_monster_perftest.cc',
         'disk_cache/disk_cache_perftest.cc',
+        'http/http_stream_parser_perftest.cc',
         'proxy/proxy_resolver_perftest.cc',
+        'spdy/spdy_framer_perftest.cc',
       ],
       'conditions': [
         # This is needed to trigger the dll copy step on windows.
@@ -1190,6 +1220,8 @@
         'base/cert_test_util.h',
         'base/cookie_monster_store_test.cc',
         'base/cookie_monster_store_test.h',
+        'base/dns_test_util.cc',
+        'base/dns_test_util.h',
         'base/net_test_suite.cc',
         'base/net_test_suite.h',
         'base/test_completion_callback.cc',
@@ -4,9 +4,12 @@
 
 #include "net/socket/client_socket_pool_base.h"
 
+#include <algorithm>
+
 #include "base/compiler_specific.h"
 #include "base/format_macros.h"
 #include "base/message_loop.h"
+#include "base/metrics/histogram.h"
 #include "base/metrics/stats_counters.h"
 #include "base/stl_util-inl.h"
 #include "base/string_util.h"
@@ -32,6 +35,29 @@ const int kCleanupInterval = 10;  // DO NOT INCREASE THIS TIMEOUT.
 // after a certain timeout has passed without receiving an ACK.
 bool g_connect_backup_jobs_enabled = true;
 
+// The most that the limit of sockets of a group can grow to, or 0 if it never
+// grows, and how long connecting to a group has to take for it to grow.
+int g_max_adaptive_sockets_per_group = 0;
+base::TimeDelta g_min_connect_time_for_adaptive_limit;
+
+// How long the last idle socket of a group is kept after a preconnect, or 0 to
+// time it out as usual.
+base::TimeDelta g_warm_idle_socket_timeout;
+
+// The number of stalls on the limit of a group before the limit grows.
+const int kStallsToRaiseGroupLimit = 2;
+
+// How long a group has to go without stalling for its limit to go back to the
+// default, in seconds.
+const int kGroupLimitResetInterval = 60;
+
+// What happened to idle sockets kept open for a warm group.
+enum WarmIdleSocketOutcome {
+  WARM_IDLE_SOCKET_KEPT,
+  WARM_IDLE_SOCKET_USED,
+  WARM_IDLE_SOCKET_OUTCOME_MAX
+};
+
 }  // namespace
 
 namespace net {
@@ -67,6 +93,7 @@ int ConnectJob::Connect() {
     timer_.Start(timeout_duration_, this, &ConnectJob::OnTimeout);
 
   idle_ = false;
+  connect_start_time_ = base::TimeTicks::Now();
 
   LogConnectStart();
 
@@ -156,6 +183,13 @@ ClientSocketPoolBaseHelper::ClientSocketPoolBaseHelper(
       handed_out_socket_count_(0),
       max_sockets_(max_sockets),
       max_sockets_per_group_(max_sockets_per_group),
+      max_adaptive_sockets_per_group_(
+          std::min(max_sockets,
+                   std::max(max_sockets_per_group,
+                            g_max_adaptive_sockets_per_group))),
+      min_connect_time_for_adaptive_limit_(
+          g_min_connect_time_for_adaptive_limit),
+      warm_idle_socket_timeout_(g_warm_idle_socket_timeout),
       unused_idle_socket_timeout_(unused_idle_socket_timeout),
       used_idle_socket_timeout_(used_idle_socket_timeout),
       connect_job_factory_(connect_job_factory),
@@ -242,6 +276,10 @@ void ClientSocketPoolBaseHelper::RequestSockets(
           "num_sockets", num_sockets)));
 
   Group* group = GetOrCreateGroup(group_name);
+  if (warm_idle_socket_timeout_ != base::TimeDelta()) {
+    // The predictor expects the group to be used soon, so keep it warm.
+    group->set_warm_until(base::TimeTicks::Now() + warm_idle_socket_timeout_);
+  }
 
   // RequestSocketsInternal() may delete the group.
   bool deleted_group = false;
@@ -282,6 +320,7 @@ int ClientSocketPoolBaseHelper::RequestSocketInternal(
   ClientSocketHandle* const handle = request->handle();
   const bool preconnecting = !handle;
   Group* group = GetOrCreateGroup(group_name);
+  MaybeResetGroupLimit(group);
 
   if (!(request->flags() & NO_IDLE_SOCKETS)) {
     // Try to reuse a socket.
@@ -293,8 +332,8 @@ int ClientSocketPoolBaseHelper::RequestSocketInternal(
     return ERR_IO_PENDING;
 
   // Can we make another active socket now?
-  if (!group->HasAvailableSocketSlot(max_sockets_per_group_) &&
-      !request->ignore_limits()) {
+  if (!group->HasAvailableSocketSlot() && !request->ignore_limits() &&
+      (preconnecting || !MaybeRaiseGroupLimit(group, request))) {
     request->net_log().AddEvent(
         NetLog::TYPE_SOCKET_POOL_STALLED_MAX_SOCKETS_PER_GROUP, NULL);
     return ERR_IO_PENDING;
@@ -398,6 +437,11 @@ bool ClientSocketPoolBaseHelper::AssignIdleSocketToGroup(
         base::TimeTicks::Now() - idle_socket_it->start_time;
     IdleSocket idle_socket = *idle_socket_it;
     idle_sockets->erase(idle_socket_it);
+    if (idle_socket.kept_warm) {
+      UMA_HISTOGRAM_ENUMERATION("Net.SocketPool.WarmIdleSocket",
+                                WARM_IDLE_SOCKET_USED,
+                                WARM_IDLE_SOCKET_OUTCOME_MAX);
+    }
     HandOutSocket(
         idle_socket.socket,
         idle_socket.socket->WasEverUsed(),
@@ -522,6 +566,8 @@ DictionaryValue* ClientSocketPoolBaseHelper::GetInfoAsValue(
   dict->SetInteger("idle_socket_count", idle_socket_count_);
   dict->SetInteger("max_socket_count", max_sockets_);
   dict->SetInteger("max_sockets_per_group", max_sockets_per_group_);
+  dict->SetInteger("max_adaptive_sockets_per_group",
+                   max_adaptive_sockets_per_group_);
   dict->SetInteger("pool_generation_number", pool_generation_number_);
 
   if (group_map_.empty())
@@ -541,6 +587,12 @@ DictionaryValue* ClientSocketPoolBaseHelper::GetInfoAsValue(
     }
 
     group_dict->SetInteger("active_socket_count", group->active_socket_count());
+    group_dict->SetInteger("max_socket_count", group->max_sockets());
+    group_dict->SetInteger(
+        "connect_time_ms",
+        static_cast<int>(group->connect_time().InMilliseconds()));
+    group_dict->SetBoolean("is_warm",
+                           group->warm_until() > base::TimeTicks::Now());
 
     ListValue* idle_socket_list = new ListValue();
     std::list<IdleSocket>::const_iterator idle_socket;
@@ -560,8 +612,7 @@ DictionaryValue* ClientSocketPoolBaseHelper::GetInfoAsValue(
     }
     group_dict->Set("connect_jobs", connect_jobs_list);
 
-    group_dict->SetBoolean("is_stalled",
-                           group->IsStalled(max_sockets_per_group_));
+    group_dict->SetBoolean("is_stalled", group->IsStalled());
     group_dict->SetBoolean("has_backup_job", group->HasBackupJob());
 
     all_groups_dict->SetWithoutPathExpansion(it->first, group_dict);
@@ -598,6 +649,18 @@ void ClientSocketPoolBaseHelper::CleanupIdleSockets(bool force) {
       base::TimeDelta timeout =
           j->socket->WasEverUsed() ?
           used_idle_socket_timeout_ : unused_idle_socket_timeout_;
+      if (!force && group->idle_sockets().size() == 1 &&
+          group->warm_until() > now && j->ShouldCleanup(now, timeout)) {
+        // Keep the last socket of a warm group until the group cools down,
+        // as long as it is still usable.
+        timeout = group->warm_until() - j->start_time;
+        if (!j->kept_warm && !j->ShouldCleanup(now, timeout)) {
+          j->kept_warm = true;
+          UMA_HISTOGRAM_ENUMERATION("Net.SocketPool.WarmIdleSocket",
+                                    WARM_IDLE_SOCKET_KEPT,
+                                    WARM_IDLE_SOCKET_OUTCOME_MAX);
+        }
+      }
       if (force || j->ShouldCleanup(now, timeout)) {
         delete j->socket;
         j = group->mutable_idle_sockets()->erase(j);
@@ -621,7 +684,7 @@ ClientSocketPoolBaseHelper::Group* ClientSocketPoolBaseHelper::GetOrCreateGroup(
   GroupMap::iterator it = group_map_.find(group_name);
   if (it != group_map_.end())
     return it->second;
-  Group* group = new Group;
+  Group* group = new Group(max_sockets_per_group_);
   group_map_[group_name] = group;
   return group;
 }
@@ -650,6 +713,21 @@ bool ClientSocketPoolBaseHelper::set_connect_backup_jobs_enabled(bool enabled) {
   return old_value;
 }
 
+// static
+void ClientSocketPoolBaseHelper::set_adaptive_group_limits(
+    int max_sockets_per_group,
+    base::TimeDelta min_connect_time) {
+  DCHECK_LE(0, max_sockets_per_group);
+  g_max_adaptive_sockets_per_group = max_sockets_per_group;
+  g_min_connect_time_for_adaptive_limit = min_connect_time;
+}
+
+// static
+void ClientSocketPoolBaseHelper::set_warm_idle_socket_timeout(
+    base::TimeDelta timeout) {
+  g_warm_idle_socket_timeout = timeout;
+}
+
 void ClientSocketPoolBaseHelper::EnableConnectBackupJobs() {
   connect_backup_jobs_enabled_ = g_connect_backup_jobs_enabled;
 }
@@ -731,7 +809,7 @@ bool ClientSocketPoolBaseHelper::FindTopStalledGroup(Group** group,
     const RequestQueue& queue = curr_group->pending_requests();
     if (queue.empty())
       continue;
-    if (curr_group->IsStalled(max_sockets_per_group_)) {
+    if (curr_group->IsStalled()) {
       has_stalled_group = true;
       bool has_higher_priority = !top_group ||
           curr_group->TopPendingPriority() < top_group->TopPendingPriority();
@@ -763,6 +841,7 @@ void ClientSocketPoolBaseHelper::OnConnectJobComplete(
 
   if (result == OK) {
     DCHECK(socket.get());
+    group->AddConnectTime(base::TimeTicks::Now() - job->connect_start_time());
     RemoveConnectJob(job, group);
     if (!group->pending_requests().empty()) {
       scoped_ptr<const Request> r(RemoveRequestFromQueue(
@@ -954,6 +1033,42 @@ bool ClientSocketPoolBaseHelper::ReachedMaxSocketsLimit() const {
   return true;
 }
 
+bool ClientSocketPoolBaseHelper::MaybeRaiseGroupLimit(Group* group,
+                                                      const Request* request) {
+  if (max_adaptive_sockets_per_group_ <= max_sockets_per_group_)
+    return false;
+
+  int stall_count = group->OnStalled(base::TimeTicks::Now());
+  if (group->max_sockets() >= max_adaptive_sockets_per_group_ ||
+      stall_count < kStallsToRaiseGroupLimit ||
+      group->connect_time() < min_connect_time_for_adaptive_limit_) {
+    return false;
+  }
+
+  // Requests keep waiting on a group which is slow to connect to, so let it
+  // open one more socket.
+  group->set_max_sockets(group->max_sockets() + 1);
+  group->ResetStallCount();
+  request->net_log().AddEvent(
+      NetLog::TYPE_SOCKET_POOL_GROUP_LIMIT_RAISED,
+      make_scoped_refptr(new NetLogIntegerParameter(
+          "max_sockets_per_group", group->max_sockets())));
+  UMA_HISTOGRAM_COUNTS_100("Net.SocketPool.GroupLimitRaised",
+                           group->max_sockets());
+  return group->HasAvailableSocketSlot();
+}
+
+void ClientSocketPoolBaseHelper::MaybeResetGroupLimit(Group* group) {
+  if (group->max_sockets() == max_sockets_per_group_)
+    return;
+  base::TimeDelta time_since_stall =
+      base::TimeTicks::Now() - group->last_stall_time();
+  if (time_since_stall < TimeDelta::FromSeconds(kGroupLimitResetInterval))
+    return;
+  group->set_max_sockets(max_sockets_per_group_);
+  group->ResetStallCount();
+}
+
 void ClientSocketPoolBaseHelper::CloseOneIdleSocket() {
   CloseOneIdleSocketExceptInGroup(NULL);
 }
@@ -1011,14 +1126,30 @@ void ClientSocketPoolBaseHelper::InvokeUserCallback(
   callback->Run(result);
 }
 
-ClientSocketPoolBaseHelper::Group::Group()
+ClientSocketPoolBaseHelper::Group::Group(int max_sockets)
     : active_socket_count_(0),
+      max_sockets_(max_sockets),
+      stall_count_(0),
       ALLOW_THIS_IN_INITIALIZER_LIST(method_factory_(this)) {}
 
 ClientSocketPoolBaseHelper::Group::~Group() {
   CleanupBackupJob();
 }
 
+int ClientSocketPoolBaseHelper::Group::OnStalled(base::TimeTicks now) {
+  last_stall_time_ = now;
+  return ++stall_count_;
+}
+
+void ClientSocketPoolBaseHelper::Group::AddConnectTime(
+    base::TimeDelta connect_time) {
+  // Weigh the new sample as 1/8, like TCP does with round trip times.
+  if (connect_time_ == base::TimeDelta())
+    connect_time_ = connect_time;
+  else
+    connect_time_ = (connect_time_ * 7 + connect_time) / 8;
+}
+
 void ClientSocketPoolBaseHelper::Group::StartBackupSocketTimer(
     const std::string& group_name,
     ClientSocketPoolBaseHelper* pool) {
@@ -1058,7 +1189,7 @@ void ClientSocketPoolBaseHelper::Group::OnBackupSocketTimerFired(
   // If our backup job is waiting on DNS, or if we can't create any sockets
   // right now due to limits, just reset the timer.
   if (pool->ReachedMaxSocketsLimit() ||
-      !HasAvailableSocketSlot(pool->max_sockets_per_group_) ||
+      !HasAvailableSocketSlot() ||
       (*jobs_.begin())->GetLoadState() == LOAD_STATE_RESOLVING_HOST) {
     StartBackupSocketTimer(group_name, pool);
     return;
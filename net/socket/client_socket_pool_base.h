@@ -103,6 +103,9 @@ class ConnectJob {
   // used preconnect job.
   void UseForNormalRequest();
 
+  // The time Connect() was called.
+  base::TimeTicks connect_start_time() const { return connect_start_time_; }
+
   virtual LoadState GetLoadState() const = 0;
 
   // If Connect returns an error (or OnConnectJobComplete reports an error
@@ -142,6 +145,7 @@ class ConnectJob {
   BoundNetLog net_log_;
   // A ConnectJob is idle until Connect() has been called.
   bool idle_;
+  base::TimeTicks connect_start_time_;
   PreconnectState preconnect_state_;
 
   DISALLOW_COPY_AND_ASSIGN(ConnectJob);
@@ -289,6 +293,20 @@ class ClientSocketPoolBaseHelper
   static bool connect_backup_jobs_enabled();
   static bool set_connect_backup_jobs_enabled(bool enabled);
 
+  // Lets the limit of sockets of a group grow, one socket at a time, up to
+  // |max_sockets_per_group|, when its requests keep stalling on the limit and
+  // connecting to it takes at least |min_connect_time|.  The limit goes back
+  // to the default once the group stops stalling.  A |max_sockets_per_group|
+  // of 0 (the default) disables it.  Applies to the pools created afterwards.
+  static void set_adaptive_group_limits(int max_sockets_per_group,
+                                        base::TimeDelta min_connect_time);
+
+  // Keeps the last idle socket of a group open for |timeout| after sockets
+  // were preconnected for it, even if the socket would otherwise time out.
+  // A zero |timeout| (the default) disables it.  Applies to the pools created
+  // afterwards.
+  static void set_warm_idle_socket_timeout(base::TimeDelta timeout);
+
   void EnableConnectBackupJobs();
 
   // ConnectJob::Delegate methods:
@@ -302,7 +320,7 @@ class ClientSocketPoolBaseHelper
 
   // Entry for a persistent socket which became idle at time |start_time|.
   struct IdleSocket {
-    IdleSocket() : socket(NULL) {}
+    IdleSocket() : socket(NULL), kept_warm(false) {}
 
     // An idle socket should be removed if it can't be reused, or has been idle
     // for too long. |now| is the current time value (TimeTicks::Now()).
@@ -316,6 +334,8 @@ class ClientSocketPoolBaseHelper
 
     ClientSocket* socket;
     base::TimeTicks start_time;
+    // True if the socket outlived its timeout to keep its group warm.
+    bool kept_warm;
   };
 
   typedef std::deque<const Request* > RequestQueue;
@@ -326,7 +346,7 @@ class ClientSocketPoolBaseHelper
   // |active_socket_count| tracks the number of sockets held by clients.
   class Group {
    public:
-    Group();
+    explicit Group(int max_sockets);
     ~Group();
 
     bool IsEmpty() const {
@@ -334,8 +354,8 @@ class ClientSocketPoolBaseHelper
           jobs_.empty() && pending_requests_.empty();
     }
 
-    bool HasAvailableSocketSlot(int max_sockets_per_group) const {
-      return NumActiveSocketSlots() < max_sockets_per_group;
+    bool HasAvailableSocketSlot() const {
+      return NumActiveSocketSlots() < max_sockets_;
     }
 
     int NumActiveSocketSlots() const {
@@ -343,11 +363,32 @@ class ClientSocketPoolBaseHelper
           static_cast<int>(idle_sockets_.size());
     }
 
-    bool IsStalled(int max_sockets_per_group) const {
-      return HasAvailableSocketSlot(max_sockets_per_group) &&
+    bool IsStalled() const {
+      return HasAvailableSocketSlot() &&
           pending_requests_.size() > jobs_.size();
     }
 
+    // The limit of sockets of the group.
+    int max_sockets() const { return max_sockets_; }
+    void set_max_sockets(int max_sockets) { max_sockets_ = max_sockets; }
+
+    // Called when a request stalls on the limit of the group.  Returns the
+    // number of stalls since the limit last changed.
+    int OnStalled(base::TimeTicks now);
+    base::TimeTicks last_stall_time() const { return last_stall_time_; }
+    void ResetStallCount() { stall_count_ = 0; }
+
+    // Adds the time it took to connect a socket to the moving average of the
+    // group.
+    void AddConnectTime(base::TimeDelta connect_time);
+    base::TimeDelta connect_time() const { return connect_time_; }
+
+    // The group keeps an idle socket open until |warm_until|.
+    base::TimeTicks warm_until() const { return warm_until_; }
+    void set_warm_until(base::TimeTicks warm_until) {
+      warm_until_ = warm_until;
+    }
+
     RequestPriority TopPendingPriority() const {
       return pending_requests_.front()->priority();
     }
@@ -390,6 +431,11 @@ class ClientSocketPoolBaseHelper
     std::set<ConnectJob*> jobs_;
     RequestQueue pending_requests_;
     int active_socket_count_;  // number of active sockets used by clients
+    int max_sockets_;
+    int stall_count_;
+    base::TimeTicks last_stall_time_;
+    base::TimeDelta connect_time_;  // Moving average of the connect times.
+    base::TimeTicks warm_until_;
     // A factory to pin the backup_job tasks.
     ScopedRunnableMethodFactory<Group> method_factory_;
   };
@@ -466,6 +512,14 @@ class ClientSocketPoolBaseHelper
   // Returns true if we can't create any more sockets due to the total limit.
   bool ReachedMaxSocketsLimit() const;
 
+  // Called when |request| stalls on the limit of |group|.  Raises the limit
+  // if the group qualifies for it, and returns true if |request| can go on.
+  bool MaybeRaiseGroupLimit(Group* group, const Request* request);
+
+  // Puts the limit of |group| back to |max_sockets_per_group_| if it hasn't
+  // stalled for a while.
+  void MaybeResetGroupLimit(Group* group);
+
   // This is the internal implementation of RequestSocket().  It differs in that
   // it does not handle logging into NetLog of the queueing status of
   // |request|.
@@ -533,6 +587,14 @@ class ClientSocketPoolBaseHelper
   // The maximum number of sockets kept per group.
   const int max_sockets_per_group_;
 
+  // The most that the limit of a group can grow to, and the connect time a
+  // group needs for its limit to grow.  See set_adaptive_group_limits().
+  const int max_adaptive_sockets_per_group_;
+  const base::TimeDelta min_connect_time_for_adaptive_limit_;
+
+  // See set_warm_idle_socket_timeout().
+  const base::TimeDelta warm_idle_socket_timeout_;
+
   // The time to wait until closing idle sockets.
   const base::TimeDelta unused_idle_socket_timeout_;
   const base::TimeDelta used_idle_socket_timeout_;
@@ -539,6 +539,10 @@ class ClientSocketPoolBaseTest : public testing::Test {
   virtual ~ClientSocketPoolBaseTest() {
     internal::ClientSocketPoolBaseHelper::set_connect_backup_jobs_enabled(
         connect_backup_jobs_enabled_);
+    internal::ClientSocketPoolBaseHelper::set_adaptive_group_limits(
+        0, base::TimeDelta());
+    internal::ClientSocketPoolBaseHelper::set_warm_idle_socket_timeout(
+        base::TimeDelta());
   }
 
   void CreatePool(int max_sockets, int max_sockets_per_group) {
@@ -3129,6 +3133,89 @@ TEST_F(ClientSocketPoolBaseTest, PreconnectClosesIdleSocketRemovesGroup) {
   EXPECT_EQ(0, pool_->NumActiveSocketsInGroup("b"));
 }
 
+// Requests that keep stalling on the limit of a group raise it, one socket at
+// a time, up to the adaptive limit.
+TEST_F(ClientSocketPoolBaseTest, AdaptiveGroupLimit) {
+  internal::ClientSocketPoolBaseHelper::set_adaptive_group_limits(
+      4, base::TimeDelta());
+  CreatePool(kDefaultMaxSockets, 2);
+  connect_job_factory_->set_job_type(TestConnectJob::kMockPendingJob);
+
+  EXPECT_EQ(ERR_IO_PENDING, StartRequest("a", kDefaultPriority));
+  EXPECT_EQ(ERR_IO_PENDING, StartRequest("a", kDefaultPriority));
+  EXPECT_EQ(2, pool_->NumConnectJobsInGroup("a"));
+
+  // The first stall waits, the second one raises the limit.
+  EXPECT_EQ(ERR_IO_PENDING, StartRequest("a", kDefaultPriority));
+  EXPECT_EQ(2, pool_->NumConnectJobsInGroup("a"));
+  CapturingBoundNetLog log(CapturingNetLog::kUnbounded);
+  ClientSocketHandle handle;
+  TestCompletionCallback callback;
+  EXPECT_EQ(ERR_IO_PENDING, handle.Init("a",
+                                        params_,
+                                        kDefaultPriority,
+                                        &callback,
+                                        pool_.get(),
+                                        log.bound()));
+  EXPECT_EQ(3, pool_->NumConnectJobsInGroup("a"));
+
+  net::CapturingNetLog::EntryList entries;
+  log.GetEntries(&entries);
+  EXPECT_TRUE(LogContainsEntryWithType(
+      entries, 1, NetLog::TYPE_SOCKET_POOL_GROUP_LIMIT_RAISED));
+
+  EXPECT_EQ(ERR_IO_PENDING, StartRequest("a", kDefaultPriority));
+  EXPECT_EQ(ERR_IO_PENDING, StartRequest("a", kDefaultPriority));
+  EXPECT_EQ(4, pool_->NumConnectJobsInGroup("a"));
+
+  // The limit doesn't grow past the adaptive limit.
+  EXPECT_EQ(ERR_IO_PENDING, StartRequest("a", kDefaultPriority));
+  EXPECT_EQ(ERR_IO_PENDING, StartRequest("a", kDefaultPriority));
+  EXPECT_EQ(4, pool_->NumConnectJobsInGroup("a"));
+
+  handle.Reset();
+}
+
+// Groups that are fast to connect to don't get a higher limit.
+TEST_F(ClientSocketPoolBaseTest, AdaptiveGroupLimitFastGroup) {
+  internal::ClientSocketPoolBaseHelper::set_adaptive_group_limits(
+      4, base::TimeDelta::FromHours(1));
+  CreatePool(kDefaultMaxSockets, 2);
+  connect_job_factory_->set_job_type(TestConnectJob::kMockPendingJob);
+
+  for (int i = 0; i < 6; ++i)
+    EXPECT_EQ(ERR_IO_PENDING, StartRequest("a", kDefaultPriority));
+  EXPECT_EQ(2, pool_->NumConnectJobsInGroup("a"));
+}
+
+// A group with preconnected sockets keeps its last idle socket after the idle
+// sockets time out.
+TEST_F(ClientSocketPoolBaseTest, WarmIdleSocket) {
+  internal::ClientSocketPoolBaseHelper::set_warm_idle_socket_timeout(
+      base::TimeDelta::FromDays(1));
+  CreatePoolWithIdleTimeouts(
+      kDefaultMaxSockets, kDefaultMaxSocketsPerGroup,
+      base::TimeDelta(),  // Time out unused sockets immediately.
+      base::TimeDelta::FromDays(1));
+
+  pool_->RequestSockets("a", &params_, 2, BoundNetLog());
+  ASSERT_EQ(2, pool_->IdleSocketCountInGroup("a"));
+
+  pool_->CleanupTimedOutIdleSockets();
+  ASSERT_EQ(1, pool_->IdleSocketCountInGroup("a"));
+
+  ClientSocketHandle handle;
+  TestCompletionCallback callback;
+  EXPECT_EQ(OK, handle.Init("a",
+                            params_,
+                            kDefaultPriority,
+                            &callback,
+                            pool_.get(),
+                            BoundNetLog()));
+  EXPECT_EQ(0, pool_->IdleSocketCountInGroup("a"));
+  EXPECT_FALSE(handle.is_reused());
+}
+
 }  // namespace
 
 }  // namespace net
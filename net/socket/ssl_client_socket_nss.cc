@@ -487,6 +487,7 @@ SSLClientSocketNSS::SSLClientSocketNSS(ClientSocketHandle* transport_socket,
       eset_mitm_detected_(false),
       predicted_cert_chain_correct_(false),
       peername_initialized_(false),
+      session_state_imported_(false),
       dnssec_provider_(NULL),
       next_handshake_state_(STATE_NONE),
       nss_fd_(NULL),
@@ -622,6 +623,7 @@ int SSLClientSocketNSS::Connect(CompletionCallback* callback) {
       net_log_.EndEventWithNetErrorCode(NetLog::TYPE_SSL_CONNECT, rv);
       return rv;
     }
+    ImportSessionState();
   }
 
   GotoState(STATE_HANDSHAKE);
@@ -676,6 +678,7 @@ void SSLClientSocketNSS::Disconnect() {
   start_cert_verification_time_ = base::TimeTicks();
   predicted_cert_chain_correct_ = false;
   peername_initialized_  = false;
+  session_state_imported_ = false;
   nss_bufs_              = NULL;
   client_certs_.clear();
   client_auth_cert_needed_ = false;
@@ -1407,7 +1410,7 @@ int SSLClientSocketNSS::DoHandshake() {
         }
 #endif
 
-        SaveSSLHostInfo();
+        LogSessionResumption();
         // SSL handshake is completed. Let's verify the certificate.
         GotoState(STATE_VERIFY_DNSSEC);
       }
@@ -1578,6 +1581,11 @@ int SSLClientSocketNSS::DoVerifyCertComplete(int result) {
   // purposes.  See https://bugzilla.mozilla.org/show_bug.cgi?id=508081 and
   // http://crbug.com/15630 for more info.
 
+  // Save the session only if the certificate verified, before a bad
+  // certificate the user allowed is accepted below.
+  if (result == OK)
+    SaveSSLHostInfo();
+
   // If we have been explicitly told to accept this certificate, override the
   // result of verifier_.Verify.
   // Eventually, we should cache the cert verification results so that we don't
@@ -1690,8 +1698,64 @@ void SSLClientSocketNSS::LogConnectionTypeMetrics() const {
   };
 }
 
-// SaveSSLHostInfo saves the certificate chain of the connection so that we can
-// start verification faster in the future.
+// ImportSessionState gives the session saved in |ssl_host_info_| to NSS, so
+// that the first connection to the server after a restart can resume it. We
+// don't wait for |ssl_host_info_| to load: if it isn't ready yet, we do a full
+// handshake.
+void SSLClientSocketNSS::ImportSessionState() {
+#if defined(SSL_SESSION_STATE_VERSION)
+  if (!ssl_host_info_.get() ||
+      ssl_host_info_->WaitForDataReady(NULL) != OK ||
+      ssl_host_info_->state().session_state.empty()) {
+    return;
+  }
+
+  const std::string& session_state = ssl_host_info_->state().session_state;
+  SECItem item;
+  item.type = siBuffer;
+  item.data = reinterpret_cast<unsigned char*>(
+      const_cast<char*>(session_state.data()));
+  item.len = session_state.size();
+
+  PRBool imported = PR_FALSE;
+  SECStatus rv = SSL_ImportSessionState(nss_fd_, &item, &imported);
+  if (rv != SECSuccess) {
+    LogFailedNSSFunction(net_log_, "SSL_ImportSessionState", "");
+    return;
+  }
+  session_state_imported_ = imported == PR_TRUE;
+#endif
+}
+
+void SSLClientSocketNSS::LogSessionResumption() {
+#if defined(SSL_SESSION_STATE_VERSION)
+  enum {
+    FULL_HANDSHAKE = 0,
+    RESUMED_FROM_MEMORY = 1,
+    RESUMED_FROM_DISK = 2,
+    DISK_SESSION_REJECTED = 3,
+    RESUMPTION_MAX,
+  };
+
+  PRBool resumed = PR_FALSE;
+  if (SSL_HandshakeResumedSession(nss_fd_, &resumed) != SECSuccess)
+    return;
+
+  int result;
+  if (resumed) {
+    result = session_state_imported_ ? RESUMED_FROM_DISK : RESUMED_FROM_MEMORY;
+  } else {
+    result = session_state_imported_ ? DISK_SESSION_REJECTED : FULL_HANDSHAKE;
+  }
+  UMA_HISTOGRAM_ENUMERATION("Net.SSLSessionResumption", result,
+                            RESUMPTION_MAX);
+#endif
+}
+
+// SaveSSLHostInfo saves the certificate chain and the session of the
+// connection so that we can start verification faster, and resume the
+// session, in the future. It must only be called once the certificate has
+// been verified, as a saved session is resumed without a full handshake.
 void SSLClientSocketNSS::SaveSSLHostInfo() {
   if (!ssl_host_info_.get())
     return;
@@ -1714,6 +1778,16 @@ void SSLClientSocketNSS::SaveSSLHostInfo() {
           certs[i]->derCert.len));
   }
 
+  state->session_state.clear();
+#if defined(SSL_SESSION_STATE_VERSION)
+  SECItem session_state;
+  if (SSL_ExportSessionState(nss_fd_, &session_state) == SECSuccess) {
+    state->session_state.assign(
+        reinterpret_cast<char*>(session_state.data), session_state.len);
+    SECITEM_FreeItem(&session_state, PR_FALSE);
+  }
+#endif
+
   ssl_host_info_->Persist();
 }
 
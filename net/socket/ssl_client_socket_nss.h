@@ -127,6 +127,8 @@ class SSLClientSocketNSS : public SSLClientSocket {
   int DoPayloadRead();
   int DoPayloadWrite();
   void LogConnectionTypeMetrics() const;
+  void ImportSessionState();
+  void LogSessionResumption();
   void SaveSSLHostInfo();
   void UncorkAfterTimeout();
 
@@ -233,6 +235,10 @@ class SSLClientSocketNSS : public SSLClientSocket {
   // True if the peer name has been initialized.
   bool peername_initialized_;
 
+  // True iff the session saved in |ssl_host_info_| was given to NSS for
+  // resumption.
+  bool session_state_imported_;
+
   // This pointer is owned by the caller of UseDNSSEC.
   DNSSECProvider* dnssec_provider_;
   // The time when we started waiting for DNSSEC records.
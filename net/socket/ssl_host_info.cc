@@ -21,6 +21,7 @@ SSLHostInfo::State::~State() {}
 
 void SSLHostInfo::State::Clear() {
   certs.clear();
+  session_state.clear();
 }
 
 SSLHostInfo::SSLHostInfo(
@@ -110,6 +111,10 @@ bool SSLHostInfo::ParseInner(const std::string& data) {
     }
   }
 
+  // The session state was added later, so it's missing from older entries.
+  if (!p.ReadString(&iter, &state->session_state))
+    state->session_state.clear();
+
   if (!state->certs.empty()) {
     std::vector<base::StringPiece> der_certs(state->certs.size());
     for (size_t i = 0; i < state->certs.size(); i++)
@@ -162,7 +167,8 @@ std::string SSLHostInfo::Serialize() const {
   }
 
   if (!p.WriteString("") ||
-      !p.WriteBool(false)) {
+      !p.WriteBool(false) ||
+      !p.WriteString(state_.session_state)) {
     return "";
   }
 
@@ -23,9 +23,9 @@ class X509Certificate;
 struct SSLConfig;
 
 // SSLHostInfo is an interface for fetching information about an SSL server.
-// This information may be stored on disk so does not include keys or session
-// information etc. Primarily it's intended for caching the server's
-// certificates.
+// This information may be stored on disk. Primarily it's intended for caching
+// the server's certificates, and the last session with the server so that it
+// can be resumed after a restart.
 class SSLHostInfo {
  public:
   SSLHostInfo(const std::string& hostname,
@@ -70,6 +70,11 @@ class SSLHostInfo {
     // returned them and in the same order.
     std::vector<std::string> certs;
 
+    // session_state is the last session with the server, as serialised by
+    // the SSL library, or empty. It includes the master secret of the
+    // session.
+    std::string session_state;
+
    private:
     DISALLOW_COPY_AND_ASSIGN(State);
   };
@@ -20,6 +20,14 @@ SpdyFrameBuilder::SpdyFrameBuilder()
   Resize(kInitialPayload);
 }
 
+SpdyFrameBuilder::SpdyFrameBuilder(size_t size)
+    : buffer_(NULL),
+      capacity_(0),
+      length_(0),
+      variable_buffer_offset_(0) {
+  Resize(size);
+}
+
 SpdyFrameBuilder::SpdyFrameBuilder(const char* data, int data_len)
     : buffer_(const_cast<char*>(data)),
       capacity_(kCapacityReadOnly),
@@ -146,6 +154,18 @@ char* SpdyFrameBuilder::BeginWriteData(uint16 length) {
   return data_ptr;
 }
 
+char* SpdyFrameBuilder::GetWritableBuffer(size_t length) {
+  DCHECK(capacity_ != kCapacityReadOnly);
+
+  char* dest = BeginWrite(length);
+  if (!dest)
+    return NULL;
+
+  EndWrite(dest, length);
+  length_ += length;
+  return dest;
+}
+
 char* SpdyFrameBuilder::BeginWrite(size_t length) {
   size_t needed_size = length_ + length;
   if (needed_size > capacity_ && !Resize(std::max(capacity_ * 2, needed_size)))
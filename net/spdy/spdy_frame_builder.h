@@ -29,6 +29,10 @@ class SpdyFrameBuilder {
  public:
   SpdyFrameBuilder();
 
+  // Initializes a SpdyFrameBuilder with a buffer of |size| bytes, for frames
+  // whose size is known in advance, so that the buffer never has to grow.
+  explicit SpdyFrameBuilder(size_t size);
+
   // Initializes a SpdyFrameBuilder from a const block of data.  The data is
   // not copied; instead the data is merely referenced by this
   // SpdyFrameBuilder.  Only const methods should be used when initialized
@@ -99,6 +103,14 @@ class SpdyFrameBuilder {
   // on this SpdyFrameBuilder.
   char* BeginWriteData(uint16 length);
 
+  // Appends |length| bytes to the payload and returns a pointer to them, for
+  // the caller to fill in. Unlike BeginWriteData, no length is written.
+  // Returns NULL on failure.
+  //
+  // The returned pointer will only be valid until the next write operation
+  // on this SpdyFrameBuilder.
+  char* GetWritableBuffer(size_t length);
+
   // Returns true if the given iterator could point to data with the given
   // length. If there is no room for the given data before the end of the
   // payload, returns false.
@@ -31,6 +31,30 @@ const int kCompressorMemLevel = 1;
 
 uLong dictionary_id = 0;
 
+// Writes |value| at |dest| as a length-prefixed string of a header block.
+// Returns a pointer past the end of the string.
+char* WriteHeaderBlockString(char* dest, const std::string& value) {
+  DCHECK_LE(value.size(), 0xffffu);
+  uint16 length = htons(static_cast<uint16>(value.size()));
+  memcpy(dest, &length, sizeof(length));
+  dest += sizeof(length);
+  memcpy(dest, value.data(), value.size());
+  return dest + value.size();
+}
+
+// Serializes |headers| into |dest|, which must have room for
+// SpdyFramer::GetSerializedLength() bytes.
+void SerializeHeaderBlock(const spdy::SpdyHeaderBlock* headers, char* dest) {
+  uint16 num_headers = htons(static_cast<uint16>(headers->size()));
+  memcpy(dest, &num_headers, sizeof(num_headers));
+  dest += sizeof(num_headers);
+  for (spdy::SpdyHeaderBlock::const_iterator it = headers->begin();
+       it != headers->end(); ++it) {
+    dest = WriteHeaderBlockString(dest, it->first);
+    dest = WriteHeaderBlockString(dest, it->second);
+  }
+}
+
 }  // namespace
 
 namespace spdy {
@@ -236,15 +260,28 @@ bool SpdyFramer::ParseHeaderBlock(const SpdyFrame* frame,
   return false;
 }
 
+/* static */
+size_t SpdyFramer::GetSerializedLength(const SpdyHeaderBlock* headers) {
+  // The number of headers, then the name and value of each header, prefixed
+  // by their length.
+  size_t length = sizeof(uint16);
+  for (SpdyHeaderBlock::const_iterator it = headers->begin();
+       it != headers->end(); ++it) {
+    length += 2 * sizeof(uint16) + it->first.size() + it->second.size();
+  }
+  return length;
+}
+
 SpdySynStreamControlFrame* SpdyFramer::CreateSynStream(
     SpdyStreamId stream_id, SpdyStreamId associated_stream_id, int priority,
     SpdyControlFlags flags, bool compressed, SpdyHeaderBlock* headers) {
-  SpdyFrameBuilder frame;
-
   DCHECK_GT(stream_id, static_cast<SpdyStreamId>(0));
   DCHECK_EQ(0u, stream_id & ~kStreamIdMask);
   DCHECK_EQ(0u, associated_stream_id & ~kStreamIdMask);
 
+  SpdyFrameBuilder frame(GetHeaderFrameSize(SpdySynStreamControlFrame::size(),
+                                            compressed, headers));
+
   frame.WriteUInt16(kControlFlagMask | spdy_version_);
   frame.WriteUInt16(SYN_STREAM);
   frame.WriteUInt32(0);  // Placeholder for the length and flags
@@ -252,30 +289,8 @@ SpdySynStreamControlFrame* SpdyFramer::CreateSynStream(
   frame.WriteUInt32(associated_stream_id);
   frame.WriteUInt16(ntohs(priority) << 6);  // Priority.
 
-  frame.WriteUInt16(headers->size());  // Number of headers.
-  SpdyHeaderBlock::iterator it;
-  for (it = headers->begin(); it != headers->end(); ++it) {
-    bool wrote_header;
-    wrote_header = frame.WriteString(it->first);
-    wrote_header &= frame.WriteString(it->second);
-    DCHECK(wrote_header);
-  }
-
-  // Write the length and flags.
-  size_t length = frame.length() - SpdyFrame::size();
-  DCHECK_EQ(0u, length & ~static_cast<size_t>(kLengthMask));
-  FlagsAndLength flags_length;
-  flags_length.length_ = htonl(static_cast<uint32>(length));
-  DCHECK_EQ(0, flags & ~kControlFlagsMask);
-  flags_length.flags_[0] = flags;
-  frame.WriteBytesToOffset(4, &flags_length, sizeof(flags_length));
-
-  scoped_ptr<SpdyFrame> syn_frame(frame.take());
-  if (compressed) {
-    return reinterpret_cast<SpdySynStreamControlFrame*>(
-        CompressFrame(*syn_frame.get()));
-  }
-  return reinterpret_cast<SpdySynStreamControlFrame*>(syn_frame.release());
+  return reinterpret_cast<SpdySynStreamControlFrame*>(
+      FinishHeaderFrame(&frame, flags, compressed, headers));
 }
 
 SpdySynReplyControlFrame* SpdyFramer::CreateSynReply(SpdyStreamId stream_id,
@@ -283,7 +298,8 @@ SpdySynReplyControlFrame* SpdyFramer::CreateSynReply(SpdyStreamId stream_id,
   DCHECK_GT(stream_id, 0u);
   DCHECK_EQ(0u, stream_id & ~kStreamIdMask);
 
-  SpdyFrameBuilder frame;
+  SpdyFrameBuilder frame(GetHeaderFrameSize(SpdySynReplyControlFrame::size(),
+                                            compressed, headers));
 
   frame.WriteUInt16(kControlFlagMask | spdy_version_);
   frame.WriteUInt16(SYN_REPLY);
@@ -291,30 +307,8 @@ SpdySynReplyControlFrame* SpdyFramer::CreateSynReply(SpdyStreamId stream_id,
   frame.WriteUInt32(stream_id);
   frame.WriteUInt16(0);  // Unused
 
-  frame.WriteUInt16(headers->size());  // Number of headers.
-  SpdyHeaderBlock::iterator it;
-  for (it = headers->begin(); it != headers->end(); ++it) {
-    bool wrote_header;
-    wrote_header = frame.WriteString(it->first);
-    wrote_header &= frame.WriteString(it->second);
-    DCHECK(wrote_header);
-  }
-
-  // Write the length and flags.
-  size_t length = frame.length() - SpdyFrame::size();
-  DCHECK_EQ(0u, length & ~static_cast<size_t>(kLengthMask));
-  FlagsAndLength flags_length;
-  flags_length.length_ = htonl(static_cast<uint32>(length));
-  DCHECK_EQ(0, flags & ~kControlFlagsMask);
-  flags_length.flags_[0] = flags;
-  frame.WriteBytesToOffset(4, &flags_length, sizeof(flags_length));
-
-  scoped_ptr<SpdyFrame> reply_frame(frame.take());
-  if (compressed) {
-    return reinterpret_cast<SpdySynReplyControlFrame*>(
-        CompressFrame(*reply_frame.get()));
-  }
-  return reinterpret_cast<SpdySynReplyControlFrame*>(reply_frame.release());
+  return reinterpret_cast<SpdySynReplyControlFrame*>(
+      FinishHeaderFrame(&frame, flags, compressed, headers));
 }
 
 /* static */
@@ -325,7 +319,7 @@ SpdyRstStreamControlFrame* SpdyFramer::CreateRstStream(SpdyStreamId stream_id,
   DCHECK_NE(status, INVALID);
   DCHECK_LT(status, NUM_STATUS_CODES);
 
-  SpdyFrameBuilder frame;
+  SpdyFrameBuilder frame(SpdyRstStreamControlFrame::size());
   frame.WriteUInt16(kControlFlagMask | spdy_version_);
   frame.WriteUInt16(RST_STREAM);
   frame.WriteUInt32(8);
@@ -337,11 +331,11 @@ SpdyRstStreamControlFrame* SpdyFramer::CreateRstStream(SpdyStreamId stream_id,
 /* static */
 SpdySettingsControlFrame* SpdyFramer::CreateSettings(
     const SpdySettings& values) {
-  SpdyFrameBuilder frame;
-  frame.WriteUInt16(kControlFlagMask | spdy_version_);
-  frame.WriteUInt16(SETTINGS);
   size_t settings_size = SpdySettingsControlFrame::size() - SpdyFrame::size() +
       8 * values.size();
+  SpdyFrameBuilder frame(SpdyFrame::size() + settings_size);
+  frame.WriteUInt16(kControlFlagMask | spdy_version_);
+  frame.WriteUInt16(SETTINGS);
   frame.WriteUInt32(settings_size);
   frame.WriteUInt32(values.size());
   SpdySettings::const_iterator it = values.begin();
@@ -355,7 +349,7 @@ SpdySettingsControlFrame* SpdyFramer::CreateSettings(
 
 /* static */
 SpdyControlFrame* SpdyFramer::CreateNopFrame() {
-  SpdyFrameBuilder frame;
+  SpdyFrameBuilder frame(SpdyFrame::size());
   frame.WriteUInt16(kControlFlagMask | spdy_version_);
   frame.WriteUInt16(NOOP);
   frame.WriteUInt32(0);
@@ -367,7 +361,7 @@ SpdyGoAwayControlFrame* SpdyFramer::CreateGoAway(
     SpdyStreamId last_accepted_stream_id) {
   DCHECK_EQ(0u, last_accepted_stream_id & ~kStreamIdMask);
 
-  SpdyFrameBuilder frame;
+  SpdyFrameBuilder frame(SpdyGoAwayControlFrame::size());
   frame.WriteUInt16(kControlFlagMask | spdy_version_);
   frame.WriteUInt16(GOAWAY);
   size_t go_away_size = SpdyGoAwayControlFrame::size() - SpdyFrame::size();
@@ -382,37 +376,16 @@ SpdyHeadersControlFrame* SpdyFramer::CreateHeaders(SpdyStreamId stream_id,
   DCHECK_GT(stream_id, 0u);
   DCHECK_EQ(0u, stream_id & ~kStreamIdMask);
 
-  SpdyFrameBuilder frame;
+  SpdyFrameBuilder frame(GetHeaderFrameSize(SpdyHeadersControlFrame::size(),
+                                            compressed, headers));
   frame.WriteUInt16(kControlFlagMask | kSpdyProtocolVersion);
   frame.WriteUInt16(HEADERS);
   frame.WriteUInt32(0);  // Placeholder for the length and flags.
   frame.WriteUInt32(stream_id);
   frame.WriteUInt16(0);  // Unused
 
-  frame.WriteUInt16(headers->size());  // Number of headers.
-  SpdyHeaderBlock::iterator it;
-  for (it = headers->begin(); it != headers->end(); ++it) {
-    bool wrote_header;
-    wrote_header = frame.WriteString(it->first);
-    wrote_header &= frame.WriteString(it->second);
-    DCHECK(wrote_header);
-  }
-
-  // Write the length and flags.
-  size_t length = frame.length() - SpdyFrame::size();
-  DCHECK_EQ(0u, length & ~static_cast<size_t>(kLengthMask));
-  FlagsAndLength flags_length;
-  flags_length.length_ = htonl(static_cast<uint32>(length));
-  DCHECK_EQ(0, flags & ~kControlFlagsMask);
-  flags_length.flags_[0] = flags;
-  frame.WriteBytesToOffset(4, &flags_length, sizeof(flags_length));
-
-  scoped_ptr<SpdyFrame> headers_frame(frame.take());
-  if (compressed) {
-    return reinterpret_cast<SpdyHeadersControlFrame*>(
-        CompressFrame(*headers_frame.get()));
-  }
-  return reinterpret_cast<SpdyHeadersControlFrame*>(headers_frame.release());
+  return reinterpret_cast<SpdyHeadersControlFrame*>(
+      FinishHeaderFrame(&frame, flags, compressed, headers));
 }
 
 /* static */
@@ -424,7 +397,7 @@ SpdyWindowUpdateControlFrame* SpdyFramer::CreateWindowUpdate(
   DCHECK_GT(delta_window_size, 0u);
   DCHECK_LE(delta_window_size, spdy::kSpdyStreamMaximumWindowSize);
 
-  SpdyFrameBuilder frame;
+  SpdyFrameBuilder frame(SpdyWindowUpdateControlFrame::size());
   frame.WriteUInt16(kControlFlagMask | spdy_version_);
   frame.WriteUInt16(WINDOW_UPDATE);
   size_t window_update_size = SpdyWindowUpdateControlFrame::size() -
@@ -458,7 +431,7 @@ bool SpdyFramer::ParseSettings(const SpdySettingsControlFrame* frame,
 SpdyDataFrame* SpdyFramer::CreateDataFrame(SpdyStreamId stream_id,
                                            const char* data,
                                            uint32 len, SpdyDataFlags flags) {
-  SpdyFrameBuilder frame;
+  SpdyFrameBuilder frame(SpdyDataFrame::size() + len);
 
   DCHECK_GT(stream_id, 0u);
   DCHECK_EQ(0u, stream_id & ~kStreamIdMask);
@@ -887,6 +860,86 @@ z_stream* SpdyFramer::GetStreamDecompressor(SpdyStreamId stream_id) {
   return stream_decompressors_[stream_id] = decompressor.release();
 }
 
+size_t SpdyFramer::GetHeaderFrameSize(size_t header_length, bool compressed,
+                                      const SpdyHeaderBlock* headers) {
+  size_t block_length = GetSerializedLength(headers);
+  if (compressed && enable_compression_) {
+    z_stream* compressor = GetHeaderCompressor();
+    if (compressor)
+      return header_length + deflateBound(compressor, block_length);
+  }
+  return header_length + block_length;
+}
+
+SpdyControlFrame* SpdyFramer::FinishHeaderFrame(
+    SpdyFrameBuilder* frame, SpdyControlFlags flags, bool compressed,
+    const SpdyHeaderBlock* headers) {
+  size_t header_length = frame->length();
+  size_t block_length = GetSerializedLength(headers);
+  size_t payload_length;
+
+  if (compressed && enable_compression_) {
+    base::StatsCounter compressed_frames("spdy.CompressedFrames");
+    base::StatsCounter pre_compress_bytes("spdy.PreCompressSize");
+    base::StatsCounter post_compress_bytes("spdy.PostCompressSize");
+
+    z_stream* compressor = GetHeaderCompressor();
+    if (!compressor)
+      return NULL;
+
+    // Rather than building the uncompressed frame and compressing it into a
+    // second one, we serialize the headers into |header_block_buffer_| and
+    // compress them straight into |frame|, which is already big enough.
+    if (header_block_buffer_.size() < block_length)
+      header_block_buffer_.resize(block_length);
+    SerializeHeaderBlock(headers, &header_block_buffer_[0]);
+
+    int compressed_max_size = deflateBound(compressor, block_length);
+    char* dest = frame->GetWritableBuffer(compressed_max_size);
+    if (!dest)
+      return NULL;
+
+    compressor->next_in = reinterpret_cast<Bytef*>(&header_block_buffer_[0]);
+    compressor->avail_in = block_length;
+    compressor->next_out = reinterpret_cast<Bytef*>(dest);
+    compressor->avail_out = compressed_max_size;
+
+    int rv = deflate(compressor, Z_SYNC_FLUSH);
+    if (rv != Z_OK) {
+      LOG(WARNING) << "deflate failure: " << rv;
+      return NULL;
+    }
+
+    int compressed_size = compressed_max_size - compressor->avail_out;
+
+    // We trust zlib. Also, we can't do anything about it.
+    // See http://www.zlib.net/zlib_faq.html#faq36
+    (void)VALGRIND_MAKE_MEM_DEFINED(dest, compressed_size);
+
+    payload_length = header_length + compressed_size - SpdyFrame::size();
+
+    pre_compress_bytes.Add(block_length);
+    post_compress_bytes.Add(payload_length);
+    compressed_frames.Increment();
+  } else {
+    char* dest = frame->GetWritableBuffer(block_length);
+    if (!dest)
+      return NULL;
+    SerializeHeaderBlock(headers, dest);
+    payload_length = frame->length() - SpdyFrame::size();
+  }
+
+  // Write the length and flags.
+  DCHECK_EQ(0u, payload_length & ~static_cast<size_t>(kLengthMask));
+  FlagsAndLength flags_length;
+  flags_length.length_ = htonl(static_cast<uint32>(payload_length));
+  DCHECK_EQ(0, flags & ~kControlFlagsMask);
+  flags_length.flags_[0] = flags;
+  frame->WriteBytesToOffset(4, &flags_length, sizeof(flags_length));
+
+  return reinterpret_cast<SpdyControlFrame*>(frame->take());
+}
+
 SpdyControlFrame* SpdyFramer::CompressControlFrame(
     const SpdyControlFrame& frame) {
   z_stream* compressor = GetHeaderCompressor();
@@ -941,7 +994,8 @@ SpdyFrame* SpdyFramer::CompressFrameWithZStream(const SpdyFrame& frame,
   int compressed_max_size = deflateBound(compressor, payload_length);
   int new_frame_size = header_length + compressed_max_size;
   scoped_ptr<SpdyFrame> new_frame(new SpdyFrame(new_frame_size));
-  memcpy(new_frame->data(), frame.data(), frame.length() + SpdyFrame::size());
+  // Only the header is copied: the payload is deflated after it.
+  memcpy(new_frame->data(), frame.data(), header_length);
 
   compressor->next_in = reinterpret_cast<Bytef*>(const_cast<char*>(payload));
   compressor->avail_in = payload_length;
@@ -1015,7 +1069,8 @@ SpdyFrame* SpdyFramer::DecompressFrameWithZStream(const SpdyFrame& frame,
   if (frame.length() > decompressed_max_size)
     return NULL;
   scoped_ptr<SpdyFrame> new_frame(new SpdyFrame(new_frame_size));
-  memcpy(new_frame->data(), frame.data(), frame.length() + SpdyFrame::size());
+  // Only the header is copied: the payload is inflated after it.
+  memcpy(new_frame->data(), frame.data(), header_length);
 
   decompressor->next_in = reinterpret_cast<Bytef*>(const_cast<char*>(payload));
   decompressor->avail_in = payload_length;
@@ -10,6 +10,7 @@
 #include <map>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "base/basictypes.h"
 #include "base/gtest_prod_util.h"
@@ -32,6 +33,7 @@ class SpdyStreamTest;
 
 namespace spdy {
 
+class SpdyFrameBuilder;
 class SpdyFramer;
 class SpdyFramerTest;
 
@@ -144,7 +146,11 @@ class SpdyFramer {
   // |priority| is the priority (0-3) for this stream.
   // |flags| is the flags to use with the data.
   //    To mark this frame as the last frame, enable CONTROL_FLAG_FIN.
-  // |compressed| specifies whether the frame should be compressed.
+  // |compressed| specifies whether the frame should be compressed.  All
+  //    header blocks share one compression context, so compressed frames
+  //    must be sent in the order they are created; callers which reorder
+  //    frames should create them uncompressed and use CompressFrame() when
+  //    they are sent.
   // |headers| is the header block to include in the frame.
   SpdySynStreamControlFrame* CreateSynStream(SpdyStreamId stream_id,
                                              SpdyStreamId associated_stream_id,
@@ -195,6 +201,10 @@ class SpdyFramer {
       SpdyStreamId stream_id,
       uint32 delta_window_size);
 
+  // Returns the number of bytes |headers| take once serialized in a
+  // SYN_STREAM, SYN_REPLY or HEADERS frame, before compression.
+  static size_t GetSerializedLength(const SpdyHeaderBlock* headers);
+
   // Given a SpdySettingsControlFrame, extract the settings.
   // Returns true on successful parse, false otherwise.
   static bool ParseSettings(const SpdySettingsControlFrame* frame,
@@ -301,6 +311,21 @@ class SpdyFramer {
   z_stream* GetStreamCompressor(SpdyStreamId id);
   z_stream* GetStreamDecompressor(SpdyStreamId id);
 
+  // Returns the size of a SYN_STREAM, SYN_REPLY or HEADERS frame whose fixed
+  // part is |header_length| bytes, big enough for |headers| once serialized
+  // and, if |compressed|, compressed.
+  size_t GetHeaderFrameSize(size_t header_length, bool compressed,
+                            const SpdyHeaderBlock* headers);
+
+  // Appends |headers| to |frame|, which holds the fixed part of a
+  // SYN_STREAM, SYN_REPLY or HEADERS frame, compressing them if |compressed|.
+  // Then sets the flags and length of the frame and returns it, or NULL on
+  // failure. |frame| must have been sized with GetHeaderFrameSize().
+  SpdyControlFrame* FinishHeaderFrame(SpdyFrameBuilder* frame,
+                                      SpdyControlFlags flags,
+                                      bool compressed,
+                                      const SpdyHeaderBlock* headers);
+
   // Compression helpers
   SpdyControlFrame* CompressControlFrame(const SpdyControlFrame& frame);
   SpdyDataFrame* CompressDataFrame(const SpdyDataFrame& frame);
@@ -345,6 +370,10 @@ class SpdyFramer {
   scoped_ptr<z_stream> header_compressor_;
   scoped_ptr<z_stream> header_decompressor_;
 
+  // Holds the serialized header block of a frame while it is compressed. It
+  // is kept between frames so that it's only allocated once per session.
+  std::vector<char> header_block_buffer_;
+
   // Per-stream data compressors.
   CompressorMap stream_compressors_;
   CompressorMap stream_decompressors_;
@@ -0,0 +1,125 @@
+// Copyright (c) 2011 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/perftimer.h"
+#include "base/stringprintf.h"
+#include "net/spdy/spdy_framer.h"
+#include "net/spdy/spdy_protocol.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace spdy {
+
+namespace {
+
+const int kNumFrames = 50000;
+
+// Fills |headers| with the headers of a typical browser request for a
+// subresource of a page; |index| makes each url different.
+void GetRequestHeaders(int index, SpdyHeaderBlock* headers) {
+  (*headers)["method"] = "GET";
+  (*headers)["url"] = base::StringPrintf(
+      "http://www.example.com/static/js/module_%d.js?v=20110512", index);
+  (*headers)["version"] = "HTTP/1.1";
+  (*headers)["host"] = "www.example.com";
+  (*headers)["scheme"] = "http";
+  (*headers)["accept"] = "*/*";
+  (*headers)["accept-charset"] = "ISO-8859-1,utf-8;q=0.7,*;q=0.3";
+  (*headers)["accept-encoding"] = "gzip,deflate,sdch";
+  (*headers)["accept-language"] = "en-US,en;q=0.8";
+  (*headers)["referer"] = "http://www.example.com/";
+  (*headers)["cookie"] =
+      "PREF=ID=0123456789abcdef:U=fedcba9876543210:FF=0:TM=1300000000:"
+      "LM=1300000001:S=AbCdEfGhIjKlMnOp; SID=DQAAAKEAAAB0ZXN0";
+  (*headers)["user-agent"] =
+      "Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/534.30 (KHTML, like "
+      "Gecko) Chrome/12.0.742.91 Safari/534.30";
+}
+
+// Fills |headers| with the headers of a typical response to such a request.
+void GetResponseHeaders(int index, SpdyHeaderBlock* headers) {
+  (*headers)["status"] = "200 OK";
+  (*headers)["version"] = "HTTP/1.1";
+  (*headers)["content-type"] = "text/javascript; charset=utf-8";
+  (*headers)["content-length"] = base::StringPrintf("%d", 10000 + index);
+  (*headers)["cache-control"] = "public, max-age=31536000";
+  (*headers)["date"] = "Thu, 12 May 2011 18:22:09 GMT";
+  (*headers)["expires"] = "Fri, 11 May 2012 18:22:09 GMT";
+  (*headers)["last-modified"] = "Tue, 10 May 2011 09:41:55 GMT";
+  (*headers)["server"] = "sffe";
+}
+
+// Creates kNumFrames SYN_STREAM frames (or SYN_REPLY frames if |reply|) on a
+// single framer, as a session would, and logs the number of frames per second.
+void TimeCreateHeaderFrames(const char* message, bool reply, bool compressed) {
+  std::vector<SpdyHeaderBlock> header_blocks(kNumFrames);
+  for (int i = 0; i < kNumFrames; ++i) {
+    if (reply)
+      GetResponseHeaders(i, &header_blocks[i]);
+    else
+      GetRequestHeaders(i, &header_blocks[i]);
+  }
+
+  SpdyFramer framer;
+  size_t bytes = 0;
+  PerfTimer timer;
+  for (int i = 0; i < kNumFrames; ++i) {
+    SpdyStreamId stream_id = 2 * i + 1;
+    scoped_ptr<SpdyFrame> frame;
+    if (reply) {
+      frame.reset(framer.CreateSynReply(stream_id, CONTROL_FLAG_NONE,
+                                        compressed, &header_blocks[i]));
+    } else {
+      frame.reset(framer.CreateSynStream(stream_id, 0, 1, CONTROL_FLAG_NONE,
+                                         compressed, &header_blocks[i]));
+    }
+    ASSERT_TRUE(frame.get() != NULL);
+    bytes += frame->length();
+  }
+  double seconds = timer.Elapsed().InSecondsF();
+
+  LogPerfResult(message, kNumFrames / seconds, "frames/s");
+  LogPerfResult(message, static_cast<double>(bytes) / kNumFrames,
+                "bytes/frame");
+}
+
+}  // namespace
+
+TEST(SpdyFramerPerfTest, CreateSynStream) {
+  TimeCreateHeaderFrames("Create SYN_STREAM frames", false, false);
+}
+
+TEST(SpdyFramerPerfTest, CreateSynStreamCompressed) {
+  TimeCreateHeaderFrames("Create compressed SYN_STREAM frames", false, true);
+}
+
+TEST(SpdyFramerPerfTest, CreateSynReply) {
+  TimeCreateHeaderFrames("Create SYN_REPLY frames", true, false);
+}
+
+TEST(SpdyFramerPerfTest, CreateSynReplyCompressed) {
+  TimeCreateHeaderFrames("Create compressed SYN_REPLY frames", true, true);
+}
+
+TEST(SpdyFramerPerfTest, CreateDataFrame) {
+  const int kDataSize = 16 * 1024;
+  std::string data(kDataSize, 'a');
+
+  SpdyFramer framer;
+  PerfTimer timer;
+  for (int i = 0; i < kNumFrames; ++i) {
+    scoped_ptr<SpdyDataFrame> frame(
+        framer.CreateDataFrame(1, data.data(), kDataSize, DATA_FLAG_NONE));
+    ASSERT_TRUE(frame.get() != NULL);
+  }
+  double seconds = timer.Elapsed().InSecondsF();
+
+  LogPerfResult("Create 16KB data frames", kNumFrames / seconds, "frames/s");
+}
+
+}  // namespace spdy
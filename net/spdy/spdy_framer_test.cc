@@ -420,6 +420,37 @@ TEST_F(SpdyFramerTest, BasicCompression) {
       SpdyFrame::size() + frame3->length()));
 }
 
+// Compressed header frames of decreasing and increasing sizes share the
+// framer's header block buffer; make sure each one decodes to its own headers.
+TEST_F(SpdyFramerTest, CompressHeaderBlocksOfDifferentSizes) {
+  SpdyFramer send_framer;
+  SpdyFramer recv_framer;
+  FramerSetEnableCompressionHelper(&send_framer, true);
+  FramerSetEnableCompressionHelper(&recv_framer, true);
+
+  const size_t kValueSizes[] = { 1000, 10, 300, 2000, 1 };
+  for (size_t i = 0; i < arraysize(kValueSizes); ++i) {
+    SpdyHeaderBlock headers;
+    headers["method"] = "GET";
+    headers["url"] = "http://www.google.com/";
+    headers["x-value"] = std::string(kValueSizes[i], 'a' + i);
+
+    scoped_ptr<SpdyFrame> frame;
+    if (i % 2) {
+      frame.reset(send_framer.CreateSynReply(1, CONTROL_FLAG_FIN, true,
+                                             &headers));
+    } else {
+      frame.reset(send_framer.CreateSynStream(1, 0, 1, CONTROL_FLAG_NONE, true,
+                                              &headers));
+    }
+    ASSERT_TRUE(frame.get() != NULL);
+
+    SpdyHeaderBlock new_headers;
+    EXPECT_TRUE(recv_framer.ParseHeaderBlock(frame.get(), &new_headers));
+    EXPECT_TRUE(headers == new_headers);
+  }
+}
+
 TEST_F(SpdyFramerTest, DecompressUncompressedFrame) {
   SpdyHeaderBlock headers;
   headers["server"] = "SpdyServer 1.0";
@@ -152,6 +152,40 @@ class NetLogSpdyDataParameter : public NetLog::EventParameters {
   DISALLOW_COPY_AND_ASSIGN(NetLogSpdyDataParameter);
 };
 
+class NetLogSpdyScheduleParameter : public NetLog::EventParameters {
+ public:
+  NetLogSpdyScheduleParameter(spdy::SpdyStreamId stream_id,
+                              int priority,
+                              int size,
+                              int deficit,
+                              size_t queued_frames)
+      : stream_id_(stream_id),
+        priority_(priority),
+        size_(size),
+        deficit_(deficit),
+        queued_frames_(queued_frames) {}
+
+  virtual Value* ToValue() const {
+    DictionaryValue* dict = new DictionaryValue();
+    dict->SetInteger("stream_id", static_cast<int>(stream_id_));
+    dict->SetInteger("priority", priority_);
+    dict->SetInteger("size", size_);
+    dict->SetInteger("deficit", deficit_);
+    dict->SetInteger("queued_frames", static_cast<int>(queued_frames_));
+    return dict;
+  }
+
+ private:
+  ~NetLogSpdyScheduleParameter() {}
+  const spdy::SpdyStreamId stream_id_;
+  const int priority_;
+  const int size_;
+  const int deficit_;
+  const size_t queued_frames_;
+
+  DISALLOW_COPY_AND_ASSIGN(NetLogSpdyScheduleParameter);
+};
+
 class NetLogSpdyRstParameter : public NetLog::EventParameters {
  public:
   NetLogSpdyRstParameter(spdy::SpdyStreamId stream_id, int status)
@@ -199,6 +233,22 @@ class NetLogSpdyGoAwayParameter : public NetLog::EventParameters {
   DISALLOW_COPY_AND_ASSIGN(NetLogSpdyGoAwayParameter);
 };
 
+// An IOBuffer which owns the SpdyFrame it points to, so that a frame
+// compressed just before it is written can be written without a copy.
+class SpdyFrameIOBuffer : public WrappedIOBuffer {
+ public:
+  explicit SpdyFrameIOBuffer(spdy::SpdyFrame* frame)
+      : WrappedIOBuffer(frame->data()),
+        frame_(frame) {}
+
+ private:
+  virtual ~SpdyFrameIOBuffer() {}
+
+  scoped_ptr<spdy::SpdyFrame> frame_;
+
+  DISALLOW_COPY_AND_ASSIGN(SpdyFrameIOBuffer);
+};
+
 }  // namespace
 
 // static
@@ -466,6 +516,9 @@ int SpdySession::WriteSynStream(
   const scoped_refptr<SpdyStream>& stream = active_streams_[stream_id];
   CHECK_EQ(stream->stream_id(), stream_id);
 
+  // The headers are compressed by WriteSocket(), because all frames share
+  // one compression context and the write scheduler may write them in a
+  // different order than they are queued.
   scoped_ptr<spdy::SpdySynStreamControlFrame> syn_frame(
       spdy_framer_.CreateSynStream(
           stream_id, 0,
@@ -562,6 +615,9 @@ void SpdySession::ResetStream(
     scoped_refptr<SpdyStream> stream = active_streams_[stream_id];
     priority = stream->priority();
   }
+  // The RST_STREAM is written ahead of any DATA frame; the ones still queued
+  // for the stream must not follow it.
+  write_scheduler_.RemoveDataFrames(stream_id);
   QueueFrame(rst_frame.get(), priority, NULL);
 
   DeleteStream(stream_id, ERR_SPDY_PROTOCOL_ERROR);
@@ -740,20 +796,36 @@ void SpdySession::WriteSocket() {
 
   // Loop sending frames until we've sent everything or until the write
   // returns error (or ERR_IO_PENDING).
-  while (in_flight_write_.buffer() || !queue_.empty()) {
+  while (in_flight_write_.buffer() || !write_scheduler_.empty()) {
     if (!in_flight_write_.buffer()) {
       // Grab the next SpdyFrame to send.
-      SpdyIOBuffer next_buffer = queue_.top();
-      queue_.pop();
+      SpdyIOBuffer next_buffer = write_scheduler_.Pop();
 
       // We've deferred compression until just before we write it to the socket,
-      // which is now.  At this time, we don't compress our data frames.
+      // which is now, so that the frames go through the compressor in the
+      // order they are written.  At this time, we don't compress our data
+      // frames.
       spdy::SpdyFrame uncompressed_frame(next_buffer.buffer()->data(), false);
+      if (!uncompressed_frame.is_control_frame() &&
+          net_log().IsLoggingAllEvents()) {
+        const spdy::SpdyDataFrame& data_frame =
+            static_cast<const spdy::SpdyDataFrame&>(uncompressed_frame);
+        int priority = next_buffer.priority();
+        net_log().AddEvent(
+            NetLog::TYPE_SPDY_SESSION_SCHEDULE_DATA,
+            make_scoped_refptr(new NetLogSpdyScheduleParameter(
+                data_frame.stream_id(), priority, next_buffer.size(),
+                write_scheduler_.deficit(priority),
+                write_scheduler_.num_queued_data_frames(priority))));
+      }
+
       size_t size;
       if (spdy_framer_.IsCompressible(uncompressed_frame)) {
-        scoped_ptr<spdy::SpdyFrame> compressed_frame(
-            spdy_framer_.CompressFrame(uncompressed_frame));
-        if (!compressed_frame.get()) {
+        // The header block is deflated straight into a frame of the right
+        // size, which is then written as is.
+        spdy::SpdyFrame* compressed_frame =
+            spdy_framer_.CompressFrame(uncompressed_frame);
+        if (!compressed_frame) {
           LOG(ERROR) << "SPDY Compression failure";
           CloseSessionOnError(net::ERR_SPDY_PROTOCOL_ERROR, true);
           return;
@@ -763,12 +835,9 @@ void SpdySession::WriteSocket() {
 
         DCHECK_GT(size, 0u);
 
-        // TODO(mbelshe): We have too much copying of data here.
-        IOBufferWithSize* buffer = new IOBufferWithSize(size);
-        memcpy(buffer->data(), compressed_frame->data(), size);
-
         // Attempt to send the frame.
-        in_flight_write_ = SpdyIOBuffer(buffer, size, 0, next_buffer.stream());
+        in_flight_write_ = SpdyIOBuffer(new SpdyFrameIOBuffer(compressed_frame),
+                                        size, 0, next_buffer.stream());
       } else {
         size = uncompressed_frame.length() + spdy::SpdyFrame::size();
         in_flight_write_ = next_buffer;
@@ -824,8 +893,7 @@ void SpdySession::CloseAllStreams(net::Error status) {
   }
 
   // We also need to drain the queue.
-  while (queue_.size())
-    queue_.pop();
+  write_scheduler_.Clear();
 }
 
 int SpdySession::GetNewStreamId() {
@@ -842,7 +910,7 @@ void SpdySession::QueueFrame(spdy::SpdyFrame* frame,
   int length = spdy::SpdyFrame::size() + frame->length();
   IOBuffer* buffer = new IOBuffer(length);
   memcpy(buffer->data(), frame->data(), length);
-  queue_.push(SpdyIOBuffer(buffer, length, priority, stream));
+  write_scheduler_.Push(SpdyIOBuffer(buffer, length, priority, stream));
 
   WriteSocketLater();
 }
@@ -893,6 +961,7 @@ Value* SpdySession::GetInfoAsValue() const {
       streams_pushed_and_claimed_count_);
   dict->SetInteger("streams_abandoned_count", streams_abandoned_count_);
   dict->SetInteger("frames_received", frames_received_);
+  dict->SetInteger("queued_frames", write_scheduler_.size());
 
   dict->SetBoolean("sent_settings", sent_settings_);
   dict->SetBoolean("received_settings", received_settings_);
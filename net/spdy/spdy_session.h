@@ -29,6 +29,7 @@
 #include "net/spdy/spdy_io_buffer.h"
 #include "net/spdy/spdy_protocol.h"
 #include "net/spdy/spdy_session_pool.h"
+#include "net/spdy/spdy_write_scheduler.h"
 
 namespace net {
 
@@ -189,6 +190,9 @@ class SpdySession : public base::RefCounted<SpdySession>,
     spdy_session_pool_ = NULL;
   }
 
+  // Access to the number of frames waiting to be written.
+  size_t num_queued_frames() const { return write_scheduler_.size(); }
+
   // Access to the number of active and pending streams.  These are primarily
   // available for testing and diagnostics.
   size_t num_active_streams() const { return active_streams_.size(); }
@@ -224,7 +228,6 @@ class SpdySession : public base::RefCounted<SpdySession>,
   typedef std::map<int, scoped_refptr<SpdyStream> > ActiveStreamMap;
   // Only HTTP push a stream.
   typedef std::map<std::string, scoped_refptr<SpdyStream> > PushedStreamMap;
-  typedef std::priority_queue<SpdyIOBuffer> OutputQueue;
 
   struct CallbackResultPair {
     CallbackResultPair() : callback(NULL), result(OK) {}
@@ -379,8 +382,9 @@ class SpdySession : public base::RefCounted<SpdySession>,
   // server, but do not have consumers yet.
   PushedStreamMap unclaimed_pushed_streams_;
 
-  // As we gather data to be sent, we put it into the output queue.
-  OutputQueue queue_;
+  // As we gather data to be sent, we put it into the write scheduler, which
+  // decides the order in which it goes out.
+  SpdyWriteScheduler write_scheduler_;
 
   // The packet we are currently sending.
   bool write_pending_;            // Will be true when a write is in progress.
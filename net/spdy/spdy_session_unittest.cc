@@ -8,6 +8,7 @@
 #include "net/spdy/spdy_session_pool.h"
 #include "net/spdy/spdy_stream.h"
 #include "net/spdy/spdy_test_util.h"
+#include "net/spdy/spdy_write_scheduler.h"
 #include "testing/platform_test.h"
 
 namespace net {
@@ -60,6 +61,199 @@ TEST_F(SpdySessionTest, SpdyIOBuffer) {
   }
 }
 
+// Copies |frame| into a SpdyIOBuffer, the way SpdySession::QueueFrame does.
+SpdyIOBuffer CreateSpdyIOBuffer(const spdy::SpdyFrame& frame, int priority) {
+  int length = spdy::SpdyFrame::size() + frame.length();
+  IOBuffer* buffer = new IOBuffer(length);
+  memcpy(buffer->data(), frame.data(), length);
+  return SpdyIOBuffer(buffer, length, priority, NULL);
+}
+
+// Returns the stream id of the SYN_STREAM or DATA frame in |buffer|.
+spdy::SpdyStreamId GetStreamId(const SpdyIOBuffer& buffer) {
+  spdy::SpdyFrame frame(buffer.buffer()->data(), false);
+  if (frame.is_control_frame())
+    return static_cast<spdy::SpdySynStreamControlFrame&>(frame).stream_id();
+  return static_cast<spdy::SpdyDataFrame&>(frame).stream_id();
+}
+
+// Simulates a SpdySession writing the frames of several streams through a
+// SpdyWriteScheduler.  Like a SpdyStream, a stream queues its SYN_STREAM
+// first, and then queues each of its full sized DATA frames as soon as the
+// previous frame has been written.  Time is measured in bytes written, as it
+// would be on a saturated link.
+class WriteSchedulerSimulation {
+ public:
+  WriteSchedulerSimulation()
+      : data_(kMaxSpdyFrameChunkSize, 'x'), bytes_written_(0) {}
+
+  // Starts a stream which will write |num_frames| DATA frames.
+  void AddStream(int stream_id, RequestPriority priority, int num_frames) {
+    Stream& stream = streams_[stream_id];
+    stream.priority = priority;
+    stream.frames_left = num_frames;
+    stream.start_time = bytes_written_;
+    stream.first_data_time = -1;
+    stream.finish_time = -1;
+    scoped_ptr<spdy::SpdyFrame> syn(
+        ConstructSpdyGet(NULL, 0, false, stream_id, priority));
+    scheduler_.Push(CreateSpdyIOBuffer(*syn, priority));
+  }
+
+  // Writes the next frame, and returns the id of the stream it belongs to.
+  int WriteFrame() {
+    SpdyIOBuffer buffer = scheduler_.Pop();
+    bytes_written_ += buffer.size();
+    int stream_id = GetStreamId(buffer);
+    Stream& stream = streams_[stream_id];
+    spdy::SpdyFrame frame(buffer.buffer()->data(), false);
+    if (!frame.is_control_frame()) {
+      if (stream.first_data_time < 0)
+        stream.first_data_time = bytes_written_;
+      if (!stream.frames_left)
+        stream.finish_time = bytes_written_;
+    }
+    if (stream.frames_left) {
+      --stream.frames_left;
+      scoped_ptr<spdy::SpdyFrame> body(ConstructSpdyBodyFrame(
+          stream_id, data_.data(), data_.size(), !stream.frames_left));
+      scheduler_.Push(CreateSpdyIOBuffer(*body, stream.priority));
+    }
+    return stream_id;
+  }
+
+  // Writes frames until |stream_id| has written all of its frames.
+  void WriteUntilFinished(int stream_id) {
+    while (streams_[stream_id].finish_time < 0)
+      WriteFrame();
+  }
+
+  // Returns the time from the start of |stream_id| until its first DATA frame
+  // was written.
+  int TimeToFirstByte(int stream_id) {
+    return streams_[stream_id].first_data_time - streams_[stream_id].start_time;
+  }
+
+  // Returns the time from the start of |stream_id| until its last frame was
+  // written.
+  int TimeToFinish(int stream_id) {
+    return streams_[stream_id].finish_time - streams_[stream_id].start_time;
+  }
+
+  int bytes_written() const { return bytes_written_; }
+
+ private:
+  struct Stream {
+    RequestPriority priority;
+    int frames_left;
+    int start_time;
+    int first_data_time;
+    int finish_time;
+  };
+
+  SpdyWriteScheduler scheduler_;
+  std::map<int, Stream> streams_;
+  const std::string data_;
+  int bytes_written_;
+};
+
+TEST_F(SpdySessionTest, WriteSchedulerWritesControlFramesFirst) {
+  SpdyWriteScheduler scheduler;
+  scoped_ptr<spdy::SpdyFrame> body(ConstructSpdyBodyFrame(1, false));
+  scoped_ptr<spdy::SpdyFrame> syn(ConstructSpdyGet(NULL, 0, false, 3, IDLE));
+  scoped_ptr<spdy::SpdyFrame> rst(ConstructSpdyRstStream(5, spdy::CANCEL));
+  scheduler.Push(CreateSpdyIOBuffer(*body, HIGHEST));
+  scheduler.Push(CreateSpdyIOBuffer(*syn, IDLE));
+  scheduler.Push(CreateSpdyIOBuffer(*rst, MEDIUM));
+  EXPECT_EQ(3u, scheduler.size());
+
+  // Control frames come out in priority order, ahead of the DATA frame.
+  SpdyIOBuffer buffer = scheduler.Pop();
+  EXPECT_EQ(MEDIUM, buffer.priority());
+  EXPECT_EQ(rst->length() + spdy::SpdyFrame::size(), buffer.size());
+  buffer = scheduler.Pop();
+  EXPECT_EQ(IDLE, buffer.priority());
+  EXPECT_EQ(3u, GetStreamId(buffer));
+  buffer = scheduler.Pop();
+  EXPECT_EQ(HIGHEST, buffer.priority());
+  EXPECT_EQ(1u, GetStreamId(buffer));
+  EXPECT_TRUE(scheduler.empty());
+}
+
+// A reset stream's queued DATA frames are dropped, so that none of them is
+// written after its RST_STREAM.
+TEST_F(SpdySessionTest, WriteSchedulerRemovesDataFramesOfResetStream) {
+  SpdyWriteScheduler scheduler;
+  scoped_ptr<spdy::SpdyFrame> body1(ConstructSpdyBodyFrame(1, false));
+  scoped_ptr<spdy::SpdyFrame> body3(ConstructSpdyBodyFrame(3, false));
+  scoped_ptr<spdy::SpdyFrame> body1_fin(ConstructSpdyBodyFrame(1, true));
+  scheduler.Push(CreateSpdyIOBuffer(*body1, HIGHEST));
+  scheduler.Push(CreateSpdyIOBuffer(*body3, HIGHEST));
+  scheduler.Push(CreateSpdyIOBuffer(*body1_fin, HIGHEST));
+  EXPECT_EQ(3u, scheduler.size());
+
+  EXPECT_EQ(2u, scheduler.RemoveDataFrames(1));
+  EXPECT_EQ(0u, scheduler.RemoveDataFrames(5));
+  scoped_ptr<spdy::SpdyFrame> rst(ConstructSpdyRstStream(1, spdy::CANCEL));
+  scheduler.Push(CreateSpdyIOBuffer(*rst, HIGHEST));
+  EXPECT_EQ(2u, scheduler.size());
+
+  SpdyIOBuffer buffer = scheduler.Pop();
+  EXPECT_EQ(rst->length() + spdy::SpdyFrame::size(), buffer.size());
+  buffer = scheduler.Pop();
+  EXPECT_EQ(3u, GetStreamId(buffer));
+  EXPECT_TRUE(scheduler.empty());
+}
+
+TEST_F(SpdySessionTest, WriteSchedulerWeightsPriorities) {
+  // Two long uploads, one at the highest and one at the lowest priority.
+  WriteSchedulerSimulation simulation;
+  simulation.AddStream(1, HIGHEST, 1000);
+  simulation.AddStream(3, IDLE, 1000);
+
+  int frames_written[2] = { 0, 0 };
+  for (int i = 0; i < 340; ++i) {
+    int stream_id = simulation.WriteFrame();
+    ++frames_written[stream_id == 1 ? 0 : 1];
+  }
+
+  // The low priority upload isn't starved, but gets about one sixteenth of
+  // the bandwidth.
+  EXPECT_GT(frames_written[1], 0);
+  EXPECT_GT(frames_written[0], 12 * frames_written[1]);
+  EXPECT_LT(frames_written[0], 20 * frames_written[1]);
+}
+
+// Measures how long a critical request has to wait behind uploads at every
+// other priority before its own data goes out.
+TEST_F(SpdySessionTest, WriteSchedulerCriticalStreamTimeToFirstByte) {
+  WriteSchedulerSimulation simulation;
+  simulation.AddStream(1, MEDIUM, 10000);
+  simulation.AddStream(3, LOW, 10000);
+  simulation.AddStream(5, LOWEST, 10000);
+  simulation.AddStream(7, IDLE, 10000);
+  while (simulation.bytes_written() < 1024 * 1024)
+    simulation.WriteFrame();
+
+  const int kCriticalFrames = 5;
+  simulation.AddStream(9, HIGHEST, kCriticalFrames);
+  simulation.WriteUntilFinished(9);
+
+  // The critical stream goes ahead of all of the uploads: only its own
+  // SYN_STREAM is written before its first DATA frame, and nothing else is
+  // interleaved with it.
+  scoped_ptr<spdy::SpdyFrame> syn(ConstructSpdyGet(NULL, 0, false, 9, HIGHEST));
+  int syn_size = syn->length() + spdy::SpdyFrame::size();
+  int frame_size = kMaxSpdyFrameChunkSize + spdy::SpdyFrame::size();
+  EXPECT_EQ(syn_size + frame_size, simulation.TimeToFirstByte(9));
+  EXPECT_EQ(syn_size + kCriticalFrames * frame_size,
+            simulation.TimeToFinish(9));
+
+  // Meanwhile, the uploads at all of the other priorities made progress.
+  for (int stream_id = 1; stream_id <= 7; stream_id += 2)
+    EXPECT_GT(simulation.TimeToFirstByte(stream_id), 0);
+}
+
 TEST_F(SpdySessionTest, GoAway) {
   SpdySessionDependencies session_deps;
   session_deps.host_resolver->set_synchronous_mode(true);
@@ -0,0 +1,149 @@
+// Copyright (c) 2011 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/spdy/spdy_write_scheduler.h"
+
+#include "base/logging.h"
+#include "net/spdy/spdy_protocol.h"
+#include "net/spdy/spdy_stream.h"
+
+namespace net {
+
+namespace {
+
+// The quantum of the lowest priority.  Every priority above it gets twice the
+// quantum of the one below, so HIGHEST gets 16 times as many bytes per round
+// as IDLE.  It is larger than a full sized DATA frame, so that every priority
+// writes at least one frame per turn.
+const int kLowestQuantum = 4 * 1024;
+
+int ClampPriority(int priority) {
+  DCHECK_GE(priority, 0);
+  DCHECK_LT(priority, NUM_PRIORITIES);
+  if (priority < 0)
+    return 0;
+  if (priority >= NUM_PRIORITIES)
+    return NUM_PRIORITIES - 1;
+  return priority;
+}
+
+}  // namespace
+
+SpdyWriteScheduler::SpdyWriteScheduler()
+    : current_priority_(0),
+      size_(0) {
+  for (int i = 0; i < NUM_PRIORITIES; ++i) {
+    deficits_[i] = 0;
+    idle_[i] = true;
+  }
+}
+
+SpdyWriteScheduler::~SpdyWriteScheduler() {}
+
+void SpdyWriteScheduler::Push(const SpdyIOBuffer& buffer) {
+  ++size_;
+
+  spdy::SpdyFrame frame(buffer.buffer()->data(), false);
+  if (frame.is_control_frame()) {
+    control_frames_.push(buffer);
+    return;
+  }
+
+  int priority = ClampPriority(buffer.priority());
+  data_frames_[priority].push_back(buffer);
+  if (!idle_[priority])
+    return;
+
+  // The priority is becoming active again.  Let it go now if it outranks the
+  // priority whose turn it is, or if that one is idle too.
+  if (priority < current_priority_ || idle_[current_priority_]) {
+    current_priority_ = priority;
+    deficits_[priority] = GetQuantum(priority);
+  }
+  idle_[priority] = false;
+}
+
+SpdyIOBuffer SpdyWriteScheduler::Pop() {
+  DCHECK(!empty());
+  --size_;
+
+  if (!control_frames_.empty()) {
+    SpdyIOBuffer buffer = control_frames_.top();
+    control_frames_.pop();
+    return buffer;
+  }
+
+  // There is at least one DATA frame queued, so this terminates: every pass
+  // around the priorities credits the non-empty ones with their quanta.
+  while (true) {
+    DataQueue& queue = data_frames_[current_priority_];
+    if (queue.empty()) {
+      // Nothing was queued in time for this turn; don't let the priority bank
+      // credit while it has nothing to send.
+      idle_[current_priority_] = true;
+      deficits_[current_priority_] = 0;
+    } else if (static_cast<int>(queue.front().size()) <=
+               deficits_[current_priority_]) {
+      // Keep the turn even if this empties the queue: the stream usually
+      // queues its next frame as soon as this one has been written.
+      SpdyIOBuffer buffer = queue.front();
+      queue.pop_front();
+      deficits_[current_priority_] -= buffer.size();
+      return buffer;
+    }
+    AdvanceToNextPriority();
+  }
+}
+
+size_t SpdyWriteScheduler::RemoveDataFrames(spdy::SpdyStreamId stream_id) {
+  size_t removed = 0;
+  for (int i = 0; i < NUM_PRIORITIES; ++i) {
+    DataQueue& queue = data_frames_[i];
+    DataQueue::iterator it = queue.begin();
+    while (it != queue.end()) {
+      spdy::SpdyDataFrame frame(it->buffer()->data(), false);
+      if (frame.stream_id() == stream_id) {
+        it = queue.erase(it);
+        ++removed;
+      } else {
+        ++it;
+      }
+    }
+  }
+  size_ -= removed;
+  return removed;
+}
+
+void SpdyWriteScheduler::Clear() {
+  while (!control_frames_.empty())
+    control_frames_.pop();
+  for (int i = 0; i < NUM_PRIORITIES; ++i) {
+    data_frames_[i].clear();
+    deficits_[i] = 0;
+    idle_[i] = true;
+  }
+  current_priority_ = 0;
+  size_ = 0;
+}
+
+size_t SpdyWriteScheduler::num_queued_data_frames(int priority) const {
+  return data_frames_[ClampPriority(priority)].size();
+}
+
+int SpdyWriteScheduler::deficit(int priority) const {
+  return deficits_[ClampPriority(priority)];
+}
+
+// static
+int SpdyWriteScheduler::GetQuantum(int priority) {
+  return kLowestQuantum << (NUM_PRIORITIES - 1 - ClampPriority(priority));
+}
+
+void SpdyWriteScheduler::AdvanceToNextPriority() {
+  current_priority_ = (current_priority_ + 1) % NUM_PRIORITIES;
+  if (!data_frames_[current_priority_].empty())
+    deficits_[current_priority_] += GetQuantum(current_priority_);
+}
+
+}  // namespace net
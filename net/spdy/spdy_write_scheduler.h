@@ -0,0 +1,94 @@
+// Copyright (c) 2011 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_SPDY_SPDY_WRITE_SCHEDULER_H_
+#define NET_SPDY_SPDY_WRITE_SCHEDULER_H_
+#pragma once
+
+#include <deque>
+#include <queue>
+
+#include "base/basictypes.h"
+#include "net/base/request_priority.h"
+#include "net/spdy/spdy_io_buffer.h"
+#include "net/spdy/spdy_protocol.h"
+
+namespace net {
+
+// Decides the order in which a SpdySession writes its queued frames.
+//
+// Control frames are small and latency sensitive (a SYN_STREAM is what starts
+// the server working on a request), so they are always written first, highest
+// priority first and FIFO within a priority.
+//
+// DATA frames are interleaved across priorities using deficit round robin.
+// When its turn comes round, a priority is credited with a quantum of bytes
+// and writes frames until the credit runs out; higher priorities get larger
+// quanta.  This keeps a large low priority upload from being starved by a
+// stream of higher priority data, and bounds how long it can hold up a more
+// important one.  A priority which had run dry and gets new data takes the
+// turn immediately if it is higher than the current one, so that a critical
+// stream starts sending without waiting for a full round.  Frames within a
+// priority are written in FIFO order; since a SpdyStream only queues its
+// next DATA frame once the previous one has been written, streams of equal
+// priority are served round robin.
+class SpdyWriteScheduler {
+ public:
+  SpdyWriteScheduler();
+  ~SpdyWriteScheduler();
+
+  // Queues |buffer|, which must hold a complete SPDY frame.
+  void Push(const SpdyIOBuffer& buffer);
+
+  // Removes and returns the next frame to write.  Must not be called when the
+  // scheduler is empty.
+  SpdyIOBuffer Pop();
+
+  // Drops the queued DATA frames of |stream_id|, e.g. because the stream is
+  // being reset, so that they don't follow its RST_STREAM onto the wire.
+  // Returns the number of frames dropped.
+  size_t RemoveDataFrames(spdy::SpdyStreamId stream_id);
+
+  // Drops all of the queued frames.
+  void Clear();
+
+  bool empty() const { return size_ == 0; }
+  size_t size() const { return size_; }
+
+  // Returns the number of DATA frames queued at |priority|.
+  size_t num_queued_data_frames(int priority) const;
+
+  // Returns the number of bytes |priority| may still write in its current
+  // turn.
+  int deficit(int priority) const;
+
+  // Returns the number of bytes |priority| is credited with on each turn.
+  static int GetQuantum(int priority);
+
+ private:
+  typedef std::priority_queue<SpdyIOBuffer> ControlQueue;
+  typedef std::deque<SpdyIOBuffer> DataQueue;
+
+  // Moves the turn on to the next priority, crediting it with its quantum.
+  void AdvanceToNextPriority();
+
+  ControlQueue control_frames_;
+
+  DataQueue data_frames_[NUM_PRIORITIES];
+  int deficits_[NUM_PRIORITIES];
+
+  // A priority is idle when it was found to have no DATA frames on its turn.
+  bool idle_[NUM_PRIORITIES];
+
+  // The priority whose turn it is to write DATA frames.
+  int current_priority_;
+
+  size_t size_;
+
+  DISALLOW_COPY_AND_ASSIGN(SpdyWriteScheduler);
+};
+
+}  // namespace net
+
+#endif  // NET_SPDY_SPDY_WRITE_SCHEDULER_H_
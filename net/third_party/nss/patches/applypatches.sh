@@ -21,3 +21,5 @@ patch -p3 < $patches_dir/peercertchain.patch
 patch -p4 < $patches_dir/ocspstapling.patch
 
 patch -p4 < $patches_dir/clientauth.patch
+
+patch -p4 < $patches_dir/sessionstate.patch
@@ -301,6 +301,41 @@ SSL_IMPORT SECStatus SSL_GetStapledOCSPResponse(PRFileDesc *fd,
 						unsigned char *out_data,
 						unsigned int *len);
 
+/* SSL_SESSION_STATE_VERSION is the version of the serialised session state
+ * produced by SSL_ExportSessionState and consumed by SSL_ImportSessionState.
+ */
+#define SSL_SESSION_STATE_VERSION 1
+
+/* SSL_ExportSessionState serialises the SSL 3.0/TLS session of a client
+ * socket, whose first handshake must be complete, so that it can be resumed
+ * by another process. On success, |state| is filled in with newly allocated
+ * data, which the caller must free with SECITEM_FreeItem(state, PR_FALSE).
+ *
+ * The result contains the master secret of the session and the caller must
+ * protect it accordingly. Sessions which used client authentication are not
+ * exported.
+ */
+SSL_IMPORT SECStatus SSL_ExportSessionState(PRFileDesc *fd, SECItem *state);
+
+/* SSL_ImportSessionState adds a session, previously exported with
+ * SSL_ExportSessionState, to the client session cache so that the next
+ * handshake of |fd| can resume it. It must be called before the handshake,
+ * once the peer ID and URL of |fd| are set and its peer address is known.
+ *
+ * The session is not imported if the cache already has a session for the
+ * peer, or if it has expired. |*imported| is set to PR_TRUE iff the session
+ * was added to the cache.
+ */
+SSL_IMPORT SECStatus SSL_ImportSessionState(PRFileDesc *fd,
+					    const SECItem *state,
+					    PRBool *imported);
+
+/* SSL_HandshakeResumedSession sets |*handshake_resumed| to PR_TRUE iff the
+ * last handshake of |fd| resumed a previous session.
+ */
+SSL_IMPORT SECStatus SSL_HandshakeResumedSession(PRFileDesc *fd,
+						 PRBool *handshake_resumed);
+
 /*
 ** Authenticate certificate hook. Called when a certificate comes in
 ** (because of SSL_REQUIRE_CERTIFICATE in SSL_Enable) to authenticate the
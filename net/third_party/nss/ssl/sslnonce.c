@@ -532,3 +532,332 @@ ssl3_SetSIDSessionTicket(sslSessionID *sid, NewSessionTicket *session_ticket)
     UNLOCK_CACHE;
     return SECSuccess;
 }
+
+/* Maximum number of certificates in an exported session: the peer's
+ * certificate and its chain. */
+#define MAX_SESSION_STATE_CERTS (MAX_PEER_CERT_CHAIN_SIZE + 1)
+
+static unsigned char *
+ssl_EncodeSessionNumber(unsigned char *p, PRUint32 num, unsigned int bytes)
+{
+    while (bytes--)
+	*p++ = (unsigned char)(num >> (bytes * 8));
+    return p;
+}
+
+static unsigned char *
+ssl_EncodeSessionBytes(unsigned char *p, const unsigned char *data,
+		       unsigned int len, unsigned int lenBytes)
+{
+    p = ssl_EncodeSessionNumber(p, len, lenBytes);
+    if (len)
+	PORT_Memcpy(p, data, len);
+    return p + len;
+}
+
+static SECStatus
+ssl_DecodeSessionNumber(SECItem *in, PRUint32 *num, unsigned int bytes)
+{
+    if (in->len < bytes)
+	return SECFailure;
+    *num = 0;
+    while (bytes--) {
+	*num = (*num << 8) | *in->data++;
+	in->len--;
+    }
+    return SECSuccess;
+}
+
+/* Points |out| at the next length-prefixed field of |in|. */
+static SECStatus
+ssl_DecodeSessionBytes(SECItem *in, SECItem *out, unsigned int lenBytes)
+{
+    PRUint32 len;
+
+    if (ssl_DecodeSessionNumber(in, &len, lenBytes) != SECSuccess ||
+	in->len < len)
+	return SECFailure;
+    out->type = siBuffer;
+    out->data = len ? in->data : NULL;
+    out->len  = len;
+    in->data += len;
+    in->len  -= len;
+    return SECSuccess;
+}
+
+/* The serialised session state is:
+ *   uint8 SSL_SESSION_STATE_VERSION
+ *   uint16 version, uint16 cipherSuite, uint8 compression,
+ *   uint8 exchKeyType, uint8 authAlgorithm, uint32 authKeyBits,
+ *   uint8 keaType, uint32 keaKeyBits, uint32 negotiatedECCurves,
+ *   uint32 creationTime, uint32 expirationTime,
+ *   opaque sessionID<0..32>, opaque masterSecret<1..48>,
+ *   uint32 ticket received_timestamp, uint32 ticket_lifetime_hint,
+ *   opaque ticket<0..2^16-1>,
+ *   uint8 number of certificates, opaque certificate<1..2^24-1> each, the
+ *   peer's certificate first.
+ */
+SECStatus
+SSL_ExportSessionState(PRFileDesc *fd, SECItem *state)
+{
+    sslSocket *ss;
+    sslSessionID *sid;
+    CERTCertificate *certs[MAX_SESSION_STATE_CERTS];
+    unsigned int numCerts = 0;
+    unsigned char masterSecret[48];
+    unsigned int masterSecretLen = 0;
+    unsigned int len, i;
+    unsigned char *p;
+    SECStatus rv = SECFailure;
+
+    ss = ssl_FindSocket(fd);
+    if (!ss) {
+	SSL_DBG(("%d: SSL[%d]: bad socket in SSL_ExportSessionState",
+		 SSL_GETPID(), fd));
+	return SECFailure;
+    }
+
+    state->data = NULL;
+    state->len = 0;
+
+    ssl_Get1stHandshakeLock(ss);
+    ssl_GetSSL3HandshakeLock(ss);
+
+    sid = ss->sec.ci.sid;
+    if (ss->sec.isServer || !ss->firstHsDone ||
+	ss->version < SSL_LIBRARY_VERSION_3_0 || !sid ||
+	sid->version < SSL_LIBRARY_VERSION_3_0 ||
+	!sid->u.ssl3.keys.resumable || sid->localCert || !sid->peerCert) {
+	PORT_SetError(SEC_ERROR_INVALID_ARGS);
+	goto done;
+    }
+
+    /* The master secret of the session is either in the clear, when bypassing
+     * PKCS #11, or a key which the internal token lets us extract. */
+    ssl_GetSpecReadLock(ss);
+    if (ss->ssl3.crSpec->msItem.len && ss->ssl3.crSpec->msItem.data) {
+	if (ss->ssl3.crSpec->msItem.len <= sizeof(masterSecret)) {
+	    masterSecretLen = ss->ssl3.crSpec->msItem.len;
+	    PORT_Memcpy(masterSecret, ss->ssl3.crSpec->msItem.data,
+			masterSecretLen);
+	}
+    } else if (ss->ssl3.crSpec->master_secret &&
+	       PK11_ExtractKeyValue(ss->ssl3.crSpec->master_secret) ==
+	       SECSuccess) {
+	SECItem *keyData = PK11_GetKeyData(ss->ssl3.crSpec->master_secret);
+	if (keyData && keyData->len <= sizeof(masterSecret)) {
+	    masterSecretLen = keyData->len;
+	    PORT_Memcpy(masterSecret, keyData->data, masterSecretLen);
+	}
+    }
+    ssl_ReleaseSpecReadLock(ss);
+    if (!masterSecretLen)
+	goto done;
+
+    /* The session ticket may be updated by another socket. */
+    LOCK_CACHE;
+
+    certs[numCerts++] = sid->peerCert;
+    for (i = 0; i < MAX_PEER_CERT_CHAIN_SIZE && sid->peerCertChain[i]; i++)
+	certs[numCerts++] = sid->peerCertChain[i];
+
+    len = 1 + 2 + 2 + 1 + 1 + 1 + 4 + 1 + 4 + 4 + 4 + 4 +
+	  1 + sid->u.ssl3.sessionIDLength + 1 + masterSecretLen +
+	  4 + 4 + 2 + sid->u.ssl3.sessionTicket.ticket.len + 1;
+    for (i = 0; i < numCerts; i++)
+	len += 3 + certs[i]->derCert.len;
+
+    if (sid->u.ssl3.sessionTicket.ticket.len > 0xffff ||
+	!SECITEM_AllocItem(NULL, state, len)) {
+	UNLOCK_CACHE;
+	goto done;
+    }
+
+    p = state->data;
+    p = ssl_EncodeSessionNumber(p, SSL_SESSION_STATE_VERSION, 1);
+    p = ssl_EncodeSessionNumber(p, sid->version, 2);
+    p = ssl_EncodeSessionNumber(p, sid->u.ssl3.cipherSuite, 2);
+    p = ssl_EncodeSessionNumber(p, sid->u.ssl3.compression, 1);
+    p = ssl_EncodeSessionNumber(p, sid->u.ssl3.exchKeyType, 1);
+    p = ssl_EncodeSessionNumber(p, sid->authAlgorithm, 1);
+    p = ssl_EncodeSessionNumber(p, sid->authKeyBits, 4);
+    p = ssl_EncodeSessionNumber(p, sid->keaType, 1);
+    p = ssl_EncodeSessionNumber(p, sid->keaKeyBits, 4);
+#ifdef NSS_ENABLE_ECC
+    p = ssl_EncodeSessionNumber(p, sid->u.ssl3.negotiatedECCurves, 4);
+#else
+    p = ssl_EncodeSessionNumber(p, 0, 4);
+#endif
+    p = ssl_EncodeSessionNumber(p, sid->creationTime, 4);
+    p = ssl_EncodeSessionNumber(p, sid->expirationTime, 4);
+    p = ssl_EncodeSessionBytes(p, sid->u.ssl3.sessionID,
+			       sid->u.ssl3.sessionIDLength, 1);
+    p = ssl_EncodeSessionBytes(p, masterSecret, masterSecretLen, 1);
+    p = ssl_EncodeSessionNumber(
+	p, sid->u.ssl3.sessionTicket.received_timestamp, 4);
+    p = ssl_EncodeSessionNumber(
+	p, sid->u.ssl3.sessionTicket.ticket_lifetime_hint, 4);
+    p = ssl_EncodeSessionBytes(p, sid->u.ssl3.sessionTicket.ticket.data,
+			       sid->u.ssl3.sessionTicket.ticket.len, 2);
+    p = ssl_EncodeSessionNumber(p, numCerts, 1);
+    for (i = 0; i < numCerts; i++) {
+	p = ssl_EncodeSessionBytes(p, certs[i]->derCert.data,
+				   certs[i]->derCert.len, 3);
+    }
+    PORT_Assert(p == state->data + state->len);
+
+    UNLOCK_CACHE;
+    rv = SECSuccess;
+
+done:
+    PORT_Memset(masterSecret, 0, sizeof(masterSecret));
+    ssl_ReleaseSSL3HandshakeLock(ss);
+    ssl_Release1stHandshakeLock(ss);
+    return rv;
+}
+
+SECStatus
+SSL_ImportSessionState(PRFileDesc *fd, const SECItem *state, PRBool *imported)
+{
+    sslSocket *ss;
+    sslSessionID *sid;
+    SECItem in = *state;
+    SECItem item;
+    PRUint32 num, numCerts, i;
+    PRUint32 now = ssl_Time();
+
+    *imported = PR_FALSE;
+
+    ss = ssl_FindSocket(fd);
+    if (!ss) {
+	SSL_DBG(("%d: SSL[%d]: bad socket in SSL_ImportSessionState",
+		 SSL_GETPID(), fd));
+	return SECFailure;
+    }
+
+    if (ss->sec.isServer || !ss->url) {
+	PORT_SetError(SEC_ERROR_INVALID_ARGS);
+	return SECFailure;
+    }
+    if (ss->opt.noCache)
+	return SECSuccess;
+
+    if (ssl_GetPeerInfo(ss) != SECSuccess)
+	return SECFailure;
+
+    /* A session established by this process is at least as fresh. */
+    sid = ssl_LookupSID(&ss->sec.ci.peer, ss->sec.ci.port, ss->peerID,
+			ss->url);
+    if (sid) {
+	ssl_FreeSID(sid);
+	return SECSuccess;
+    }
+
+    sid = PORT_ZNew(sslSessionID);
+    if (!sid)
+	return SECFailure;
+    sid->peerID     = (ss->peerID == NULL) ? NULL : PORT_Strdup(ss->peerID);
+    sid->urlSvrName = PORT_Strdup(ss->url);
+    sid->addr       = ss->sec.ci.peer;
+    sid->port       = ss->sec.ci.port;
+    sid->references = 1;
+    sid->cached     = never_cached;
+    sid->u.ssl3.keys.resumable = PR_TRUE;
+    sid->u.ssl3.keys.msIsWrapped = PR_FALSE;
+    sid->u.ssl3.policy = SSL_ALLOWED;
+
+    if (ssl_DecodeSessionNumber(&in, &num, 1) != SECSuccess ||
+	num != SSL_SESSION_STATE_VERSION)
+	goto loser;
+    if (ssl_DecodeSessionNumber(&in, &num, 2) != SECSuccess ||
+	num < SSL_LIBRARY_VERSION_3_0)
+	goto loser;
+    sid->version = (SSL3ProtocolVersion)num;
+    if (ssl_DecodeSessionNumber(&in, &num, 2) != SECSuccess)
+	goto loser;
+    sid->u.ssl3.cipherSuite = (ssl3CipherSuite)num;
+    if (ssl_DecodeSessionNumber(&in, &num, 1) != SECSuccess)
+	goto loser;
+    sid->u.ssl3.compression = (SSLCompressionMethod)num;
+    if (ssl_DecodeSessionNumber(&in, &num, 1) != SECSuccess)
+	goto loser;
+    sid->u.ssl3.exchKeyType = (SSL3KEAType)num;
+    if (ssl_DecodeSessionNumber(&in, &num, 1) != SECSuccess)
+	goto loser;
+    sid->authAlgorithm = (SSLSignType)num;
+    if (ssl_DecodeSessionNumber(&in, &sid->authKeyBits, 4) != SECSuccess)
+	goto loser;
+    if (ssl_DecodeSessionNumber(&in, &num, 1) != SECSuccess)
+	goto loser;
+    sid->keaType = (SSLKEAType)num;
+    if (ssl_DecodeSessionNumber(&in, &sid->keaKeyBits, 4) != SECSuccess ||
+	ssl_DecodeSessionNumber(&in, &num, 4) != SECSuccess)
+	goto loser;
+#ifdef NSS_ENABLE_ECC
+    sid->u.ssl3.negotiatedECCurves = num;
+#endif
+    if (ssl_DecodeSessionNumber(&in, &sid->creationTime, 4) != SECSuccess ||
+	ssl_DecodeSessionNumber(&in, &sid->expirationTime, 4) != SECSuccess)
+	goto loser;
+    if (!sid->creationTime || sid->expirationTime <= now)
+	goto loser;
+    sid->lastAccessTime = now;
+
+    if (ssl_DecodeSessionBytes(&in, &item, 1) != SECSuccess ||
+	item.len > SSL3_SESSIONID_BYTES)
+	goto loser;
+    sid->u.ssl3.sessionIDLength = item.len;
+    if (item.len)
+	PORT_Memcpy(sid->u.ssl3.sessionID, item.data, item.len);
+
+    if (ssl_DecodeSessionBytes(&in, &item, 1) != SECSuccess ||
+	item.len == 0 ||
+	item.len > sizeof(sid->u.ssl3.keys.wrapped_master_secret))
+	goto loser;
+    sid->u.ssl3.keys.wrapped_master_secret_len = item.len;
+    PORT_Memcpy(sid->u.ssl3.keys.wrapped_master_secret, item.data, item.len);
+
+    if (ssl_DecodeSessionNumber(
+	    &in, &sid->u.ssl3.sessionTicket.received_timestamp, 4) !=
+	    SECSuccess ||
+	ssl_DecodeSessionNumber(
+	    &in, &sid->u.ssl3.sessionTicket.ticket_lifetime_hint, 4) !=
+	    SECSuccess ||
+	ssl_DecodeSessionBytes(&in, &item, 2) != SECSuccess)
+	goto loser;
+    if (item.len &&
+	SECITEM_CopyItem(NULL, &sid->u.ssl3.sessionTicket.ticket, &item) !=
+	SECSuccess)
+	goto loser;
+
+    if (ssl_DecodeSessionNumber(&in, &numCerts, 1) != SECSuccess ||
+	numCerts == 0 || numCerts > MAX_SESSION_STATE_CERTS)
+	goto loser;
+    for (i = 0; i < numCerts; i++) {
+	CERTCertificate *cert;
+
+	if (ssl_DecodeSessionBytes(&in, &item, 3) != SECSuccess ||
+	    item.len == 0)
+	    goto loser;
+	cert = CERT_NewTempCertificate(CERT_GetDefaultCertDB(), &item, NULL,
+				       PR_FALSE, PR_TRUE);
+	if (!cert)
+	    goto loser;
+	if (i == 0)
+	    sid->peerCert = cert;
+	else
+	    sid->peerCertChain[i - 1] = cert;
+    }
+    if (in.len != 0)
+	goto loser;
+
+    CacheSID(sid);
+    ssl_FreeSID(sid);	/* the cache holds the remaining reference. */
+    *imported = PR_TRUE;
+    return SECSuccess;
+
+loser:
+    /* Bad or expired state is not an error: there is nothing to resume. */
+    ssl_FreeSID(sid);
+    return SECSuccess;
+}